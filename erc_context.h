@@ -0,0 +1,136 @@
+
+/*!
+ ************************************************************************
+ * \file erc_context.h
+ *
+ * \brief
+ *      Error concealment context
+ *
+ *      Everything the error concealment of one decoder instance works on:
+ *      the decoder state it reads (image parameters, the picture being
+ *      concealed, reference list 0) and the state it keeps between frames
+ *      (worker buffers, padded references, the list of lost pictures,
+ *      the edge angles of the intra concealment). Decoder instances that
+ *      run in threads of one process conceal with a context each and do
+ *      not share anything but the concealment options of erc_strategy.h.
+ *
+ *      ercConcealInterFrame(), ercConcealIntraFrame() and the lost picture
+ *      handling called from the decoded picture buffer keep working on the
+ *      decoder's global state: they bind it to the decoder context
+ *      (ercDecoderContext()) and run the context versions below.
+ *
+ ************************************************************************
+ */
+
+#ifndef _ERC_CONTEXT_H_
+#define _ERC_CONTEXT_H_
+
+#include "erc_api.h"
+
+#define ERC_PICTURE_POOL_SIZE  4                //!< pictures of lost frames kept for reuse by a context
+#define ERC_POC_INDEX_SIZE     64               //!< hash entries of the POC index, at least twice the frame stores of a DPB
+
+struct erc_inter_state;
+struct erc_intra_state;
+
+//A run of vertically adjacent corrupted blocks in one column of a condition map
+typedef struct
+{
+  int column;                                   //!< block column of the run
+  int firstRow;                                 //!< first corrupted block row
+  int lastRow;                                  //!< last corrupted block row
+  int edges;                                    //!< ERC_RUN_ABOVE | ERC_RUN_BELOW, sides with a block to conceal from
+} ercCorruptedRun_t;
+
+#define ERC_RUN_ABOVE  1                        //!< the run does not start in the first row
+#define ERC_RUN_BELOW  2                        //!< the run does not end in the last row
+
+//Corrupted runs of a condition map, collected in one pass by ercCollectCorruptedRuns().
+//The arrays are kept from frame to frame and only reallocated when the map grows.
+typedef struct
+{
+  ercCorruptedRun_t *run;                       //!< runs by column, top to bottom inside a column
+  int               *columnStart;               //!< [numColumns+1] first run of each column (in steps) in run[]
+  int                numRuns;
+  int                numColumns;
+  ercCorruptedRun_t *scan;                      //!< runs in the order they are found, row by row
+  int               *open;                      //!< [numColumns] run open in each column, -1 = none
+  int                runsSize;                  //!< allocated entries of run[] and scan[]
+  int                columnsSize;               //!< allocated entries of open[], columnStart[] has one more
+} ercRunList_t;
+
+//Lost non reference picture waiting for output
+typedef struct
+{
+  StorablePicture *picture;                     //!< concealed picture
+  int              poc;                         //!< its (missing) POC
+} ercLostPicture_t;
+
+//Ring of the lost pictures waiting for output. They are found in increasing POC
+//order (conceal_non_ref_pics() skips POCs up to img->earlier_missing_poc), so
+//the head always holds the lowest POC and is the next to be written.
+typedef struct
+{
+  ercLostPicture_t *entry;                      //!< [size] pictures, count of them from head on, wrapping
+  int               size;                       //!< allocated entries
+  int               head;                       //!< entry of the lowest POC
+  int               count;                      //!< pictures waiting
+} ercLostRing_t;
+
+//DPB frame store of a POC, an open addressing hash built once per
+//conceal_non_ref_pics() instead of a search of the DPB for every missing POC
+typedef struct
+{
+  int poc[ERC_POC_INDEX_SIZE];                  //!< POC of each hash entry
+  int frameStore[ERC_POC_INDEX_SIZE];           //!< its entry of dpb.fs[], -1 = empty hash entry
+  int valid;                                    //!< 1 while dpb.fs[] matches the index
+} ercPocIndex_t;
+
+typedef struct erc_context
+{
+  struct img_par          *img;                 //!< image parameters of the decoder instance
+  StorablePicture         *dec_picture;         //!< picture being concealed
+  StorablePicture        **list0;               //!< reference list 0
+  int                      list0Size;           //!< entries of list0
+  int                      mvPerMB;             //!< motion of the picture, selects motion search or copy (MVPERMB_THR)
+
+  ercLostRing_t            lostPictures;        //!< lost pictures waiting for output, lowest POC first
+  ercPocIndex_t            pocIndex;            //!< DPB frame store of a POC, see get_pic_from_dpb()
+  double                   timeSum;             //!< time spent in the intra concealment of the last frame
+  double                   frameStart;          //!< clock (ms) when the concealment of the current frame started
+  int                      degradedMBs;         //!< MBs of the last frame concealed below ERC_LEVEL_FULL to meet the deadline
+  int                      degradedTotal;       //!< degradedMBs summed over all frames
+  int                      prunedCandidates;    //!< MV candidates of the last frame dropped by the clustering (ercSetClusterTolerance())
+  int                      prunedTotal;         //!< prunedCandidates summed over all frames
+  ercRunList_t             corruptedRuns;       //!< corrupted runs of the condition map being concealed
+  StorablePicture         *picturePool[ERC_PICTURE_POOL_SIZE]; //!< released pictures of lost frames, see getConcealPicture()
+  int                      picturePoolSize;     //!< entries of picturePool
+
+  struct erc_inter_state  *inter;               //!< state of erc_do_p.c, NULL until the first inter frame
+  struct erc_intra_state  *intra;               //!< state of erc_do_i.c, NULL until the first intra frame
+} ercContext_t;
+
+//Concealment levels of the per picture deadline (ercSetConcealDeadline())
+#define ERC_LEVEL_FULL     0   //!< the selected strategies
+#define ERC_LEVEL_REDUCED  1   //!< inter: boundary matching (concealByTrial) without OBMC, from half the deadline on
+#define ERC_LEVEL_MINIMAL  2   //!< inter: copy from the first reference, intra: mean interpolation, past the deadline
+
+void ercInitContext(ercContext_t *ctx, struct img_par *img);
+void ercFreeContext(ercContext_t *ctx);
+ercContext_t *ercDecoderContext(struct img_par *img);
+
+int  ercConcealInterFrameCtx(ercContext_t *ctx, frame *recfr, objectBuffer_t *object_list,
+                             int32 picSizeX, int32 picSizeY, ercVariables_t *errorVar, int chroma_format_idc);
+int  ercConcealIntraFrameCtx(ercContext_t *ctx, frame *recfr, int32 picSizeX, int32 picSizeY, ercVariables_t *errorVar);
+
+int  ercCollectCorruptedRuns(ercRunList_t *runs, int *condition, int lastColumn, int lastRow, int step);
+void ercFreeRunList(ercRunList_t *runs);
+
+void ercStartDeadline(ercContext_t *ctx);
+int  ercConcealLevel(ercContext_t *ctx);
+
+void ercFreeInterState(ercContext_t *ctx);
+void ercFreeIntraState(ercContext_t *ctx);
+
+#endif
+
@@ -17,35 +17,70 @@
 
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include "global.h"
 #include "erc_do.h"
+#include "erc_strategy.h"
+#include "erc_context.h"
 
-static void concealBlocks( int lastColumn, int lastRow, int comp, frame *recfr, int32 picSizeX, int *condition );
-static void pixMeanInterpolateBlock( imgpel *src[], imgpel *block, int blockSize, int frameWidth );
+static void concealBlocks( ercContext_t *ctx, int lastColumn, int lastRow, int comp, frame *recfr, int32 picSizeX, int *condition );
+static void concealIMB( ercContext_t *ctx, int level, imgpel *currFrame, int row, int column, int predBlocks[], int frameWidth, int mbWidthInBlocks );
+static void pixMeanInterpolateBlock( ercContext_t *ctx, imgpel *src[], imgpel *block, int blockSize, int frameWidth );
 
 //Santosh
-static void pixSigmoidInterpolateBlock( imgpel *src[], imgpel *block, int blockSize, int frameWidth );
+static void pixSigmoidInterpolateBlock( ercContext_t *ctx, imgpel *src[], imgpel *block, int blockSize, int frameWidth );
 static double mySigmoid(int dist);
-static int mean_sigmoid_interpolate(imgpel *src[], int blockSize, int frameWidth, int row, int column);
+static int mean_sigmoid_interpolate(ercContext_t *ctx, imgpel *src[], int blockSize, int frameWidth, int row, int column);
 
-static void pixNBPInterpolateBlock( imgpel *src[], imgpel *block, int blockSize, int frameWidth );
+static void pixNBPInterpolateBlock( ercContext_t *ctx, imgpel *src[], imgpel *block, int blockSize, int frameWidth );
 
-#define DIR_INT		   0
 #define DIR_MODE	   0
 
 #define LOSSAREA	   0
 #define ENTROPYAREA    0
 
-#define USENBP         0
 #define MIN(a,b) (((a)<(b))?(a):(b))
 
-#define USESIGMOID     0 // Nearest Pixel Sigmoid Interpolation (NPSI) <= Santosh
 #define SIGMOIDCONST   1
 
-#define SWDI           0
-#define PMODES_INT	   0
-#define PMODES_UPDATED 1
-#define INTEGRATE      0 // If this is 1, then PMODES_UPDATED & BI should be also 1
+//Intra concealment strategies
+//Each entry names the block interpolation used for plain spatial concealment
+//and the options it runs with:
+//  sigmoid       - Nearest Pixel Sigmoid Interpolation (NPSI) weights wherever a mean is taken <= Santosh
+//  dirInt        - gradient based directional interpolation (DI)
+//  swdi          - DI switched to BI on high directional entropy (SWDI)
+//  pmodesInt     - directional interpolation from the neighbours' prediction modes
+//  pmodesUpdated - prediction mode interpolation with multiple directions and BI fallback
+//  integrate     - average the BI and the prediction mode results (pmodesUpdated has to be set)
+typedef void (*ercInterpolateFunc)(ercContext_t *ctx, imgpel *src[], imgpel *block, int blockSize, int frameWidth);
+
+typedef struct
+{
+  char              *name;
+  ercInterpolateFunc interpolate;
+  int                sigmoid;
+  int                dirInt;
+  int                swdi;
+  int                pmodesInt;
+  int                pmodesUpdated;
+  int                integrate;
+} ercIntraStrategy_t;
+
+static const ercIntraStrategy_t ercIntraStrategies[] =
+{
+  { "BI",             pixMeanInterpolateBlock,    0, 0, 0, 0, 0, 0 },
+  { "NPSI",           pixSigmoidInterpolateBlock, 1, 0, 0, 0, 0, 0 },
+  { "NBP",            pixNBPInterpolateBlock,     0, 0, 0, 0, 0, 0 },
+  { "DI",             pixMeanInterpolateBlock,    0, 1, 0, 0, 0, 0 },
+  { "SWDI",           pixMeanInterpolateBlock,    0, 0, 1, 0, 0, 0 },
+  { "PMODES",         pixMeanInterpolateBlock,    0, 0, 0, 1, 0, 0 },
+  { "PMODES_UPDATED", pixMeanInterpolateBlock,    0, 0, 0, 0, 1, 0 },
+  { "BI+PMODES",      pixMeanInterpolateBlock,    0, 0, 0, 0, 1, 1 },
+};
+
+#define NUM_INTRA_STRATEGIES ((int) (sizeof(ercIntraStrategies)/sizeof(ercIntraStrategies[0])))
+
+static const ercIntraStrategy_t *ercIntra = &ercIntraStrategies[ERC_INTRA_STRATEGY_DEFAULT];
 
 #define DIRENTROPYTHRESH 2.2
 #define EDGETHRESHOLD    0.45
@@ -62,20 +97,28 @@ typedef struct direction
 	int p1; int p2; double d1; double d2;
 } Direction;
 
-double **angles;
+//State of the intra concealment of a context, kept from frame to frame
+struct erc_intra_state
+{
+  double **angles;                  //!< edge angle of every 8x8 luma block for the directional interpolation, angles[x][y]
+  int      anglesColumns;           //!< size of angles[][], only changed with the picture size
+  int      anglesRows;
+};
+
+static double **getAngles(ercContext_t *ctx, int lastColumn, int lastRow);
 
-static void   pixDirectionalInterpolateBlock( imgpel *src[], imgpel *block, int blockSize, int frameWidth, int comp, int row_idx, int column_idx);
+static void   pixDirectionalInterpolateBlock( ercContext_t *ctx, imgpel *src[], imgpel *block, int blockSize, int frameWidth, int comp, int row_idx, int column_idx);
 static double findbestdir(imgpel *src[], int blockSize, int frameWidth, int *nbrs, double *dirEntropy, int *numDED);
 static double bestangle(double counter[], int *numDED);
 static double findBestAngle(double *gradientBoundary, double *angleBoundary, double maxgrad, imgpel *src[], int blockSize);
 static double quantize_angle(double angle);
-static int    mean_interpolate(imgpel *src[], int blockSize, int frameWidth, int row, int column);
+static int    mean_interpolate(ercContext_t *ctx, imgpel *src[], int blockSize, int frameWidth, int row, int column);
 static void   incCounter(double counter[], double angle, double gradient);
 static double counterAngle(double *gradientBoundary, double *angleBoundary, double maxgrad, imgpel *src[], int blockSize);
 
-static void  pixDirInterpolateBlockwithPModes(imgpel *src[], imgpel *block, int blockSize, int frameWidth, int comp, int row_idx, int column_idx);
-static int   findDominantPmodeChroma(imgpel *src[], int blockSize, int row_idx, int column_idx, int frameWidth);
-static int   findDominantPmodeLuma(imgpel *src[], int blockSize, int block_row, int block_column, int frameWidth);
+static void  pixDirInterpolateBlockwithPModes(ercContext_t *ctx, imgpel *src[], imgpel *block, int blockSize, int frameWidth, int comp, int row_idx, int column_idx);
+static int   findDominantPmodeChroma(ercContext_t *ctx, imgpel *src[], int blockSize, int row_idx, int column_idx, int frameWidth);
+static int   findDominantPmodeLuma(ercContext_t *ctx, imgpel *src[], int blockSize, int block_row, int block_column, int frameWidth);
 static float findDistance(int pixval[4], int ipmode, int maxval, int minval);
 
 static void boundary_pixels_pmodes(imgpel *src[], int blockSize, int frameWidth, double theta, int row, int column, struct direction *dir_pixel, int comp);
@@ -88,7 +131,7 @@ static void boundary_pmode6(imgpel *src[], int blockSize, int frameWidth, int ro
 static void boundary_pmode7(imgpel *src[], int blockSize, int frameWidth, int row, int column, struct direction *dir_pixel);
 static void boundary_pmode8(imgpel *src[], int blockSize, int frameWidth, int row, int column, struct direction *dir_pixel);
 
-static int  findDominantPmodeLumaUpdated(imgpel *src[], int blockSize, int block_row, int block_column, int frameWidth, int *fMDI, int *fBI, int edgeDir[9], int edgeStrength[9], double *dirEntropy, int *numDED);
+static int  findDominantPmodeLumaUpdated(ercContext_t *ctx, imgpel *src[], int blockSize, int block_row, int block_column, int frameWidth, int *fMDI, int *fBI, int edgeDir[9], int edgeStrength[9], double *dirEntropy, int *numDED);
 static void showEntropyArea(double dirEntropy, int blockSize, imgpel *block, int frameWidth);
 
 
@@ -117,9 +160,34 @@ static void showEntropyArea(double dirEntropy, int blockSize, imgpel *block, int
  ************************************************************************
  */
 int ercConcealIntraFrame( frame *recfr, int32 picSizeX, int32 picSizeY, ercVariables_t *errorVar ) 
+{
+  ercContext_t *ctx = ercDecoderContext(img);
+  int ret;
+
+  ret = ercConcealIntraFrameCtx( ctx, recfr, picSizeX, picSizeY, errorVar );
+  time_sum = ctx->timeSum;
+
+  return ret;
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Intra frame concealment of a concealment context, see
+ *      ercConcealIntraFrame(). MBs concealed after the deadline
+ *      (ercSetConcealDeadline()) are only mean interpolated and counted
+ *      in ctx->degradedMBs and ctx->degradedTotal.
+ * \param ctx
+ *      concealment context
+ ************************************************************************
+ */
+int ercConcealIntraFrameCtx( ercContext_t *ctx, frame *recfr, int32 picSizeX, int32 picSizeY, ercVariables_t *errorVar ) 
 {
   int lastColumn = 0, lastRow = 0, i, j;
-  time_sum = 0.0;
+  double **angles;
+
+  ctx->timeSum = 0.0;
+  ercStartDeadline(ctx);
 
   /* if concealment is on */
   if ( errorVar && errorVar->concealment ) 
@@ -132,26 +200,26 @@ int ercConcealIntraFrame( frame *recfr, int32 picSizeX, int32 picSizeY, ercVaria
       lastColumn = (int) (picSizeX>>3);
 
 	  //Santosh
-	  if (DIR_INT || SWDI)
+	  if (ercIntra->dirInt || ercIntra->swdi)
 	  {
-		  angles = (double**)malloc(lastColumn*sizeof(double*));
-		  for(i=0;i<lastColumn;i++)
-			  angles[i] = (double*)malloc(lastRow*sizeof(double));
+		  angles = getAngles(ctx, lastColumn, lastRow);
 		  for(i=0;i<lastColumn;i++)
 			  for(j=0;j<lastRow;j++)
 				  angles[i][j] = INF;
 	  }
 	  //End
 
-      concealBlocks( lastColumn, lastRow, 0, recfr, picSizeX, errorVar->yCondition );
+      concealBlocks( ctx, lastColumn, lastRow, 0, recfr, picSizeX, errorVar->yCondition );
       
       /* U (dimensions halved compared to Y) */
       lastRow = (int) (picSizeY>>4);
       lastColumn = (int) (picSizeX>>4);
-      concealBlocks( lastColumn, lastRow, 1, recfr, picSizeX, errorVar->uCondition );
+      concealBlocks( ctx, lastColumn, lastRow, 1, recfr, picSizeX, errorVar->uCondition );
       
       /* V ( dimensions equal to U ) */
-      concealBlocks( lastColumn, lastRow, 2, recfr, picSizeX, errorVar->vCondition );
+      concealBlocks( ctx, lastColumn, lastRow, 2, recfr, picSizeX, errorVar->vCondition );
+
+      ctx->degradedTotal += ctx->degradedMBs;
     }
     return 1;
   }
@@ -159,6 +227,45 @@ int ercConcealIntraFrame( frame *recfr, int32 picSizeX, int32 picSizeY, ercVaria
     return 0;
 }
 
+/*!
+ ************************************************************************
+ * \brief
+ *      Makes the angles[][] of a context hold lastColumn x lastRow
+ *      blocks, keeping the current array if it already has that size
+ ************************************************************************
+ */
+static double **getAngles(ercContext_t *ctx, int lastColumn, int lastRow)
+{
+  struct erc_intra_state *state;
+  int i;
+
+  if (ctx->intra == NULL)
+  {
+    if ((ctx->intra = (struct erc_intra_state *) calloc(1, sizeof(struct erc_intra_state))) == NULL)
+      no_mem_exit("getAngles: intra");
+  }
+  state = ctx->intra;
+
+  if (lastColumn == state->anglesColumns && lastRow == state->anglesRows)
+    return state->angles;
+
+  for (i = 0; i < state->anglesColumns; i++)
+    free(state->angles[i]);
+  free(state->angles);
+
+  if ((state->angles = (double **) malloc(lastColumn*sizeof(double *))) == NULL)
+    no_mem_exit("getAngles: angles");
+  for (i = 0; i < lastColumn; i++)
+  {
+    if ((state->angles[i] = (double *) malloc(lastRow*sizeof(double))) == NULL)
+      no_mem_exit("getAngles: angles");
+  }
+  state->anglesColumns = lastColumn;
+  state->anglesRows    = lastRow;
+
+  return state->angles;
+}
+
 /*!
  ************************************************************************
  * \brief
@@ -179,18 +286,34 @@ int ercConcealIntraFrame( frame *recfr, int32 picSizeX, int32 picSizeY, ercVaria
  ************************************************************************
  */
 void ercPixConcealIMB(imgpel *currFrame, int row, int column, int predBlocks[], int frameWidth, int mbWidthInBlocks)
+{
+  ercContext_t *ctx = ercDecoderContext(img);
+
+  ctx->timeSum = time_sum;
+  concealIMB(ctx, ERC_LEVEL_FULL, currFrame, row, column, predBlocks, frameWidth, mbWidthInBlocks);
+  time_sum = ctx->timeSum;
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Conceals one MB of a concealment context, see ercPixConcealIMB()
+ * \param ctx
+ *      concealment context
+ * \param level
+ *      ERC_LEVEL_MINIMAL replaces the selected strategy by the mean
+ *      interpolation (pixMeanInterpolateBlock()) to meet the deadline
+ ************************************************************************
+ */
+static void concealIMB(ercContext_t *ctx, int level, imgpel *currFrame, int row, int column, int predBlocks[], int frameWidth, int mbWidthInBlocks)
 {
    imgpel *src[8]={NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL};
    imgpel *currBlock = NULL;
-   imgpel *blockBI = NULL, *blockPMODES = NULL;
+   imgpel blockBI[256], blockPMODES[256];
    imgpel *currBlockBI = NULL, *currBlockDI = NULL;
 
    int comp, k, block2k, row2, column2;
-
-   blockBI     = (imgpel*)malloc(256*sizeof(imgpel));
-   blockPMODES = (imgpel*)malloc(256*sizeof(imgpel));
-
-   time_MB = 0;
+   time_t time_MB = 0;
 
    /* collect the reliable neighboring blocks */
    if (predBlocks[0])
@@ -211,23 +334,29 @@ void ercPixConcealIMB(imgpel *currFrame, int row, int column, int predBlocks[],
       src[7] = currFrame + row*frameWidth*8 + (column+mbWidthInBlocks)*8;
    
    currBlock = currFrame + row*frameWidth*8 + column*8;
+
+   if (level == ERC_LEVEL_MINIMAL)
+   {
+     if (mbWidthInBlocks == 2)
+       ctx->degradedMBs++;
+     pixMeanInterpolateBlock( ctx, src, currBlock, mbWidthInBlocks*8, frameWidth );
+     time(&time_MB);
+     ctx->timeSum += time_MB;
+     return;
+   }
    
    if (row==4 && column==6)
 	   row=4;
 
-   if(!DIR_INT && !PMODES_INT && !LOSSAREA && !SWDI)
+   if(!ercIntra->dirInt && !ercIntra->pmodesInt && !LOSSAREA && !ercIntra->swdi)
    {
 	   if (row==8 && column==34)
 		   row=8;
 
-	   if (INTEGRATE)
-			pixMeanInterpolateBlock( src, blockBI, mbWidthInBlocks*8, frameWidth );
-	   else if (USESIGMOID)
-  		    pixSigmoidInterpolateBlock( src, currBlock, mbWidthInBlocks*8, frameWidth );
-	   else if (USENBP)
-		    pixNBPInterpolateBlock( src, currBlock, mbWidthInBlocks*8, frameWidth );
+	   if (ercIntra->integrate)
+			ercIntra->interpolate( ctx, src, blockBI, mbWidthInBlocks*8, frameWidth );
 	   else
-		    pixMeanInterpolateBlock( src, currBlock, mbWidthInBlocks*8, frameWidth );
+		    ercIntra->interpolate( ctx, src, currBlock, mbWidthInBlocks*8, frameWidth );
 		   
 	   //return;
    }
@@ -239,29 +368,29 @@ void ercPixConcealIMB(imgpel *currFrame, int row, int column, int predBlocks[],
 	   comp = CHROMA;
 
    //Concealment with Gradient Based Directional Interpolation
-   if((DIR_INT || SWDI) && !LOSSAREA)
+   if((ercIntra->dirInt || ercIntra->swdi) && !LOSSAREA)
    {
 	   if (row==8 && column==34)
 		   row=8;
 	   
-	   pixDirectionalInterpolateBlock( src, currBlock, mbWidthInBlocks*8, frameWidth, comp, row, column);
+	   pixDirectionalInterpolateBlock( ctx, src, currBlock, mbWidthInBlocks*8, frameWidth, comp, row, column);
 	   //return;
    }
 
-   if((PMODES_INT || PMODES_UPDATED) && !LOSSAREA)
+   if((ercIntra->pmodesInt || ercIntra->pmodesUpdated) && !LOSSAREA)
    {
 	   //OR Use Pmodes for Error Concealment
 	   //Determine here whether to do 16x16 MB concealment or splitting to 8x8 blocks wrt pmodes
 	   //If CIF frame, then 16x16
 	   //IF QCIF frame and high neighbor spatial activity, then split to 8x8 blocks, else 16x16 MB concealment
 	   // Above comments are for older code of pmodes - June 2012
-   	   if (INTEGRATE)
-		   pixDirInterpolateBlockwithPModes( src, blockPMODES, mbWidthInBlocks*8, frameWidth, comp, row, column);
+   	   if (ercIntra->integrate)
+		   pixDirInterpolateBlockwithPModes( ctx, src, blockPMODES, mbWidthInBlocks*8, frameWidth, comp, row, column);
 	   else
-		   pixDirInterpolateBlockwithPModes( src, currBlock, mbWidthInBlocks*8, frameWidth, comp, row, column);
+		   pixDirInterpolateBlockwithPModes( ctx, src, currBlock, mbWidthInBlocks*8, frameWidth, comp, row, column);
    }
 
-   if (INTEGRATE && !LOSSAREA)
+   if (ercIntra->integrate && !LOSSAREA)
    {
        // Integrate result of BI and MDI
 	   // using weight = 1/2 for now
@@ -279,7 +408,7 @@ void ercPixConcealIMB(imgpel *currFrame, int row, int column, int predBlocks[],
    }
 
    time(&time_MB);
-   time_sum += time_MB;
+   ctx->timeSum += time_MB;
 }
 
 /*!
@@ -444,6 +573,127 @@ int ercCollectColumnBlocks( int predBlocks[], int currRow, int currColumn, int *
   return srcCounter;
 }
 
+/*!
+ ************************************************************************
+ * \brief
+ *      Collects the runs of corrupted blocks of a condition map in one
+ *      pass over the map. The map is read row by row, every step-th
+ *      block of every step-th row, and a corrupted block (ERC_BLOCK_EMPTY
+ *      or ERC_BLOCK_CORRUPTED) opens or extends the run of its column.
+ *      Rows without corrupted blocks are passed over with one test.
+ *      The runs are then sorted by column, so the concealment can take
+ *      the columns in any order without scanning the map again.
+ * \return
+ *      Number of runs (runs->numRuns)
+ * \param runs
+ *      Run list to fill, its arrays grow as needed
+ * \param condition
+ *      The block condition (ok, lost) table
+ * \param lastColumn
+ *      Number of block columns in the frame
+ * \param lastRow
+ *      Number of block rows in the frame
+ * \param step
+ *      Number of blocks belonging to a MB, when counting
+ *      in vertical/horizontal direction. (Y:2 U,V:1)
+ ************************************************************************
+ */
+int ercCollectCorruptedRuns( ercRunList_t *runs, int *condition, int lastColumn, int lastRow, int step )
+{
+  int numColumns = (lastColumn+step-1)/step;
+  int maxRuns = numColumns * (((lastRow+step-1)/step + 1)/2);
+  int row, column, i, any, numOpen = 0, *line;
+  ercCorruptedRun_t *run;
+
+  if (runs->columnsSize < numColumns)
+  {
+    free(runs->open);
+    free(runs->columnStart);
+    if ((runs->open = (int *) malloc(numColumns*sizeof(int))) == NULL)
+      no_mem_exit("ercCollectCorruptedRuns: open");
+    if ((runs->columnStart = (int *) malloc((numColumns+1)*sizeof(int))) == NULL)
+      no_mem_exit("ercCollectCorruptedRuns: columnStart");
+    runs->columnsSize = numColumns;
+  }
+  if (runs->runsSize < maxRuns)
+  {
+    free(runs->run);
+    free(runs->scan);
+    if ((runs->run = (ercCorruptedRun_t *) malloc(maxRuns*sizeof(ercCorruptedRun_t))) == NULL)
+      no_mem_exit("ercCollectCorruptedRuns: run");
+    if ((runs->scan = (ercCorruptedRun_t *) malloc(maxRuns*sizeof(ercCorruptedRun_t))) == NULL)
+      no_mem_exit("ercCollectCorruptedRuns: scan");
+    runs->runsSize = maxRuns;
+  }
+
+  runs->numRuns = 0;
+  runs->numColumns = numColumns;
+  memset(runs->columnStart, 0, (numColumns+1)*sizeof(int));
+  for (i = 0; i < numColumns; i++)
+    runs->open[i] = -1;
+
+  for (row = 0; row < lastRow; row += step)
+  {
+    line = &condition[row*lastColumn];
+
+    any = 0;
+    for (column = 0; column < lastColumn; column += step)
+      any |= (line[column] <= ERC_BLOCK_CORRUPTED);
+    if (!any && !numOpen)
+      continue;
+
+    for (column = 0, i = 0; column < lastColumn; column += step, i++)
+    {
+      if (line[column] <= ERC_BLOCK_CORRUPTED)
+      {
+        if (runs->open[i] < 0)
+        {
+          run = &runs->scan[runs->numRuns];
+          run->column   = column;
+          run->firstRow = row;
+          run->edges    = (row > 0) ? ERC_RUN_ABOVE : 0;
+          runs->columnStart[i+1]++;
+          runs->open[i] = runs->numRuns++;
+          numOpen++;
+        }
+        runs->scan[runs->open[i]].lastRow = row;
+      }
+      else if (runs->open[i] >= 0)
+      {
+        runs->scan[runs->open[i]].edges |= ERC_RUN_BELOW;
+        runs->open[i] = -1;
+        numOpen--;
+      }
+    }
+  }
+
+  /* sort by column, the scan order is kept inside a column */
+  for (i = 0; i < numColumns; i++)
+  {
+    runs->columnStart[i+1] += runs->columnStart[i];
+    runs->open[i] = runs->columnStart[i];
+  }
+  for (i = 0; i < runs->numRuns; i++)
+    runs->run[runs->open[runs->scan[i].column/step]++] = runs->scan[i];
+
+  return runs->numRuns;
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Releases the arrays of a run list
+ ************************************************************************
+ */
+void ercFreeRunList( ercRunList_t *runs )
+{
+  free(runs->run);
+  free(runs->columnStart);
+  free(runs->scan);
+  free(runs->open);
+  memset(runs, 0, sizeof(ercRunList_t));
+}
+
 /*!
  ************************************************************************
  * \brief
@@ -451,8 +701,11 @@ int ercCollectColumnBlocks( int predBlocks[], int currRow, int currColumn, int *
  *      It is called for each color component (Y,U,V) seperately
  *      Finds the corrupted blocks and calls pixel interpolation functions 
  *      to correct them, one block at a time.
- *      Scanning is done vertically and each corrupted column is corrected
+ *      The corrupted runs are collected by ercCollectCorruptedRuns() and
+ *      taken column by column; each run is corrected
  *      bi-directionally, i.e., first block, last block, first block+1, last block -1 ...
+ * \param ctx
+ *      concealment context
  * \param lastColumn  
  *      Number of block columns in the frame
  * \param lastRow     
@@ -467,12 +720,13 @@ int ercCollectColumnBlocks( int predBlocks[], int currRow, int currColumn, int *
  *      The block condition (ok, lost) table
  ************************************************************************
  */
-static void concealBlocks( int lastColumn, int lastRow, int comp, frame *recfr, int32 picSizeX, int *condition )
+static void concealBlocks( ercContext_t *ctx, int lastColumn, int lastRow, int comp, frame *recfr, int32 picSizeX, int *condition )
 {
-  int row, column, srcCounter = 0,  thr = ERC_BLOCK_CORRUPTED,
+  int r, column, srcCounter = 0,
       lastCorruptedRow = -1, firstCorruptedRow = -1, currRow = 0, 
       areaHeight = 0, i = 0, smoothColumn = 0;
-  int predBlocks[8], step = 1;
+  int predBlocks[8], step = 1, level;
+  ercCorruptedRun_t *run;
   
   /* in the Y component do the concealment MB-wise (not block-wise):
   this is useful if only whole MBs can be damaged or lost */
@@ -481,160 +735,145 @@ static void concealBlocks( int lastColumn, int lastRow, int comp, frame *recfr,
   else
     step = 1;
   
-  for ( column = 0; column < lastColumn; column += step ) 
+  /* all corrupted runs of the component, column by column */
+  ercCollectCorruptedRuns( &ctx->corruptedRuns, condition, lastColumn, lastRow, step );
+
+  for ( r = 0; r < ctx->corruptedRuns.numRuns; r++ ) 
   {
-    for ( row = 0; row < lastRow; row += step ) 
+    run = &ctx->corruptedRuns.run[r];
+    column = run->column;
+    firstCorruptedRow = run->firstRow;
+    lastCorruptedRow = run->lastRow;
+
+    if ( !(run->edges & ERC_RUN_BELOW) ) 
     {
-      if ( condition[row*lastColumn+column] <= thr ) 
+      /* correct only from above */
+      lastCorruptedRow = lastRow-step;
+      for ( currRow = firstCorruptedRow; currRow < lastRow; currRow += step ) 
       {
-        firstCorruptedRow = row;
-        /* find the last row which has corrupted blocks (in same continuous area) */
-        for ( lastCorruptedRow = row+step; lastCorruptedRow < lastRow; lastCorruptedRow += step ) 
+        srcCounter = ercCollect8PredBlocks( predBlocks, currRow, column, condition, lastRow, lastColumn, step, 1 );
+      
+        level = ercConcealLevel(ctx);
+        switch( comp ) 
         {
-          /* check blocks in the current column */
-          if ( condition[ lastCorruptedRow*lastColumn + column ] > thr ) 
-          {
-            /* current one is already OK, so the last was the previous one */
-            lastCorruptedRow -= step;
-            break;
-          }
+        case 0 :
+          concealIMB( ctx, level, recfr->yptr, currRow, column, predBlocks, picSizeX, 2);
+          break;
+        case 1 :
+          concealIMB( ctx, level, recfr->uptr, currRow, column, predBlocks, (picSizeX>>1), 1);
+          break;
+        case 2 :
+          concealIMB( ctx, level, recfr->vptr, currRow, column, predBlocks, (picSizeX>>1), 1);
+          break;
         }
-        if ( lastCorruptedRow >= lastRow ) 
+        
+        if ( comp == 0 ) 
         {
-          /* correct only from above */
-          lastCorruptedRow = lastRow-step;
-          for ( currRow = firstCorruptedRow; currRow < lastRow; currRow += step ) 
-          {
-            srcCounter = ercCollect8PredBlocks( predBlocks, currRow, column, condition, lastRow, lastColumn, step, 1 );
-          
-            switch( comp ) 
-            {
-            case 0 :
-              ercPixConcealIMB( recfr->yptr, currRow, column, predBlocks, picSizeX, 2);
-              break;
-            case 1 :
-              ercPixConcealIMB( recfr->uptr, currRow, column, predBlocks, (picSizeX>>1), 1);
-              break;
-            case 2 :
-              ercPixConcealIMB( recfr->vptr, currRow, column, predBlocks, (picSizeX>>1), 1);
-              break;
-            }
-            
-            if ( comp == 0 ) 
-            {
-              condition[ currRow*lastColumn+column] = ERC_BLOCK_CONCEALED;
-              condition[ currRow*lastColumn+column + 1] = ERC_BLOCK_CONCEALED;
-              condition[ currRow*lastColumn+column + lastColumn] = ERC_BLOCK_CONCEALED;
-              condition[ currRow*lastColumn+column + lastColumn + 1] = ERC_BLOCK_CONCEALED;
-            }
-            else 
-            {
-              condition[ currRow*lastColumn+column] = ERC_BLOCK_CONCEALED;
-            }
-            
-          }
-          row = lastRow;
-        } 
-        else if ( firstCorruptedRow == 0 ) 
+          condition[ currRow*lastColumn+column] = ERC_BLOCK_CONCEALED;
+          condition[ currRow*lastColumn+column + 1] = ERC_BLOCK_CONCEALED;
+          condition[ currRow*lastColumn+column + lastColumn] = ERC_BLOCK_CONCEALED;
+          condition[ currRow*lastColumn+column + lastColumn + 1] = ERC_BLOCK_CONCEALED;
+        }
+        else 
         {
-          /* correct only from below */
-          for ( currRow = lastCorruptedRow; currRow >= 0; currRow -= step ) 
-          {
-            srcCounter = ercCollect8PredBlocks( predBlocks, currRow, column, condition, lastRow, lastColumn, step, 1 );
-            
-            switch( comp ) 
-            {
-            case 0 :
-              ercPixConcealIMB( recfr->yptr, currRow, column, predBlocks, picSizeX, 2);
-              break;
-            case 1 :
-              ercPixConcealIMB( recfr->uptr, currRow, column, predBlocks, (picSizeX>>1), 1);
-              break;
-            case 2 :
-              ercPixConcealIMB( recfr->vptr, currRow, column, predBlocks, (picSizeX>>1), 1);
-              break;
-            }
-            
-            if ( comp == 0 ) 
-            {
-              condition[ currRow*lastColumn+column] = ERC_BLOCK_CONCEALED;
-              condition[ currRow*lastColumn+column + 1] = ERC_BLOCK_CONCEALED;
-              condition[ currRow*lastColumn+column + lastColumn] = ERC_BLOCK_CONCEALED;
-              condition[ currRow*lastColumn+column + lastColumn + 1] = ERC_BLOCK_CONCEALED;
-            }
-            else 
-            {
-              condition[ currRow*lastColumn+column] = ERC_BLOCK_CONCEALED;
-            }
-            
-          }
-          
-          row = lastCorruptedRow+step;
+          condition[ currRow*lastColumn+column] = ERC_BLOCK_CONCEALED;
+        }
+        
+      }
+    } 
+    else if ( !(run->edges & ERC_RUN_ABOVE) ) 
+    {
+      /* correct only from below */
+      for ( currRow = lastCorruptedRow; currRow >= 0; currRow -= step ) 
+      {
+        srcCounter = ercCollect8PredBlocks( predBlocks, currRow, column, condition, lastRow, lastColumn, step, 1 );
+        
+        level = ercConcealLevel(ctx);
+        switch( comp ) 
+        {
+        case 0 :
+          concealIMB( ctx, level, recfr->yptr, currRow, column, predBlocks, picSizeX, 2);
+          break;
+        case 1 :
+          concealIMB( ctx, level, recfr->uptr, currRow, column, predBlocks, (picSizeX>>1), 1);
+          break;
+        case 2 :
+          concealIMB( ctx, level, recfr->vptr, currRow, column, predBlocks, (picSizeX>>1), 1);
+          break;
+        }
+        
+        if ( comp == 0 ) 
+        {
+          condition[ currRow*lastColumn+column] = ERC_BLOCK_CONCEALED;
+          condition[ currRow*lastColumn+column + 1] = ERC_BLOCK_CONCEALED;
+          condition[ currRow*lastColumn+column + lastColumn] = ERC_BLOCK_CONCEALED;
+          condition[ currRow*lastColumn+column + lastColumn + 1] = ERC_BLOCK_CONCEALED;
+        }
+        else 
+        {
+          condition[ currRow*lastColumn+column] = ERC_BLOCK_CONCEALED;
+        }
+        
+      }
+    }
+    else 
+    {
+      /* correct bi-directionally */
+      
+      areaHeight = lastCorruptedRow-firstCorruptedRow+step;
+      
+      /* 
+      *  Conceal the corrupted area switching between the up and the bottom rows 
+      */
+      for ( i = 0; i < areaHeight; i += step ) 
+      {
+        if ( i % 2 ) 
+        {
+          currRow = lastCorruptedRow;
+          lastCorruptedRow -= step;
         }
         else 
         {
-          /* correct bi-directionally */
+          currRow = firstCorruptedRow;
+          firstCorruptedRow += step;
+        }
+        
+        if (smoothColumn > 0) 
+        {
+          srcCounter = ercCollectColumnBlocks( predBlocks, currRow, column, condition, lastRow, lastColumn, step );
+        }
+        else 
+        {
+          srcCounter = ercCollect8PredBlocks( predBlocks, currRow, column, condition, lastRow, lastColumn, step, 1 );
+        }
+        
+        level = ercConcealLevel(ctx);
+        switch( comp ) 
+        {
+        case 0 :
+          concealIMB( ctx, level, recfr->yptr, currRow, column, predBlocks, picSizeX, 2);
+          break;
           
-          row = lastCorruptedRow+step;
-          areaHeight = lastCorruptedRow-firstCorruptedRow+step;
+        case 1 :
+          concealIMB( ctx, level, recfr->uptr, currRow, column, predBlocks, (picSizeX>>1), 1);
+          break;
           
-          /* 
-          *  Conceal the corrupted area switching between the up and the bottom rows 
-          */
-          for ( i = 0; i < areaHeight; i += step ) 
-          {
-            if ( i % 2 ) 
-            {
-              currRow = lastCorruptedRow;
-              lastCorruptedRow -= step;
-            }
-            else 
-            {
-              currRow = firstCorruptedRow;
-              firstCorruptedRow += step;
-            }
-            
-            if (smoothColumn > 0) 
-            {
-              srcCounter = ercCollectColumnBlocks( predBlocks, currRow, column, condition, lastRow, lastColumn, step );
-            }
-            else 
-            {
-              srcCounter = ercCollect8PredBlocks( predBlocks, currRow, column, condition, lastRow, lastColumn, step, 1 );
-            }
-            
-            switch( comp ) 
-            {
-            case 0 :
-              ercPixConcealIMB( recfr->yptr, currRow, column, predBlocks, picSizeX, 2);
-              break;
-              
-            case 1 :
-              ercPixConcealIMB( recfr->uptr, currRow, column, predBlocks, (picSizeX>>1), 1);
-              break;
-              
-            case 2 :
-              ercPixConcealIMB( recfr->vptr, currRow, column, predBlocks, (picSizeX>>1), 1);
-              break;
-            }
-            
-            if ( comp == 0 ) 
-            {
-              condition[ currRow*lastColumn+column] = ERC_BLOCK_CONCEALED;
-              condition[ currRow*lastColumn+column + 1] = ERC_BLOCK_CONCEALED;
-              condition[ currRow*lastColumn+column + lastColumn] = ERC_BLOCK_CONCEALED;
-              condition[ currRow*lastColumn+column + lastColumn + 1] = ERC_BLOCK_CONCEALED;
-            }
-            else 
-            {
-              condition[ currRow*lastColumn+column ] = ERC_BLOCK_CONCEALED;
-            }
-          }
+        case 2 :
+          concealIMB( ctx, level, recfr->vptr, currRow, column, predBlocks, (picSizeX>>1), 1);
+          break;
+        }
+        
+        if ( comp == 0 ) 
+        {
+          condition[ currRow*lastColumn+column] = ERC_BLOCK_CONCEALED;
+          condition[ currRow*lastColumn+column + 1] = ERC_BLOCK_CONCEALED;
+          condition[ currRow*lastColumn+column + lastColumn] = ERC_BLOCK_CONCEALED;
+          condition[ currRow*lastColumn+column + lastColumn + 1] = ERC_BLOCK_CONCEALED;
+        }
+        else 
+        {
+          condition[ currRow*lastColumn+column ] = ERC_BLOCK_CONCEALED;
         }
-
-        lastCorruptedRow = -1;
-        firstCorruptedRow = -1;
-
       }
     }
   }
@@ -645,6 +884,8 @@ static void concealBlocks( int lastColumn, int lastRow, int comp, frame *recfr,
  * \brief
  *      Does the actual pixel based interpolation for block[]
  *      using weighted average
+ * \param ctx
+ *      concealment context
  * \param src[] 
  *      pointers to neighboring source blocks
  * \param block     
@@ -655,8 +896,9 @@ static void concealBlocks( int lastColumn, int lastRow, int comp, frame *recfr,
  *      Width of the frame in pixels
  ************************************************************************
  */
-static void pixMeanInterpolateBlock( imgpel *src[], imgpel *block, int blockSize, int frameWidth )
+static void pixMeanInterpolateBlock( ercContext_t *ctx, imgpel *src[], imgpel *block, int blockSize, int frameWidth )
 {
+  struct img_par *img = ctx->img;
   int row, column, k, tmp, srcCounter = 0, weight = 0, bmax = blockSize - 1;
   
   k = 0;
@@ -703,7 +945,7 @@ static void pixMeanInterpolateBlock( imgpel *src[], imgpel *block, int blockSize
 	  if(LOSSAREA)
 		  block[ k + column ] = 0;
     }
-	if (INTEGRATE)
+	if (ercIntra->integrate)
 		k += blockSize;
 	else
 		k += frameWidth;
@@ -719,6 +961,8 @@ static void pixMeanInterpolateBlock( imgpel *src[], imgpel *block, int blockSize
  * \brief
  *      Does the actual pixel based interpolation for block[]
  *      using NBP (Nearest Border Prior)
+ * \param ctx
+ *      concealment context
  * \param src[] 
  *      pointers to neighboring source blocks
  * \param block     
@@ -729,7 +973,7 @@ static void pixMeanInterpolateBlock( imgpel *src[], imgpel *block, int blockSize
  *      Width of the frame in pixels
  ************************************************************************
  */
-static void pixNBPInterpolateBlock( imgpel *src[], imgpel *block, int blockSize, int frameWidth )
+static void pixNBPInterpolateBlock( ercContext_t *ctx, imgpel *src[], imgpel *block, int blockSize, int frameWidth )
 {
   int row, column, k, tmp, srcCounter = 0, weight = 0, bmax = blockSize - 1, pAbove=0, pBelow=0, pLeft=0, pRight=0, mc=1, mr=1;
   double wAbove=0, wBelow=0, wLeft=0, wRight=0, wc=0, wr=0;
@@ -809,7 +1053,7 @@ static void pixNBPInterpolateBlock( imgpel *src[], imgpel *block, int blockSize,
 	  if(LOSSAREA)
 		  block[ k + column ] = 0;
     }
-	if (INTEGRATE)
+	if (ercIntra->integrate)
 		k += blockSize;
 	else
 		k += frameWidth;
@@ -829,6 +1073,8 @@ static double mySigmoid(int dist)
  * \brief
  *      Does the actual pixel based interpolation for block[]
  *      using weighted average with sigmoid interpolation
+ * \param ctx
+ *      concealment context
  * \param src[] 
  *      pointers to neighboring source blocks
  * \param block     
@@ -839,8 +1085,9 @@ static double mySigmoid(int dist)
  *      Width of the frame in pixels
  ************************************************************************
  */
-static void pixSigmoidInterpolateBlock( imgpel *src[], imgpel *block, int blockSize, int frameWidth )
+static void pixSigmoidInterpolateBlock( ercContext_t *ctx, imgpel *src[], imgpel *block, int blockSize, int frameWidth )
 {
+  struct img_par *img = ctx->img;
   int row, column, k, bmax = blockSize - 1;
   double weight = 0.0, srcCounter = 0.0, tmp;
   
@@ -894,7 +1141,7 @@ static void pixSigmoidInterpolateBlock( imgpel *src[], imgpel *block, int blockS
 	  if(LOSSAREA)
 		  block[ k + column ] = 0;
     }
-	if (INTEGRATE)
+	if (ercIntra->integrate)
 		k += blockSize;
 	else
 		k += frameWidth;
@@ -909,6 +1156,8 @@ static void pixSigmoidInterpolateBlock( imgpel *src[], imgpel *block, int blockS
  *      using Sobel edge detecting masks. Mask is applied to available neighboring
  *      boundary pixels, then the dominant edge direction is determined
  *      and the pixel is concealed in the direction of dominant edge using weighted interpolation. 
+ * \param ctx
+ *      concealment context
  * \param src[] 
  *      pointers to neighboring source blocks
  * \param block     
@@ -919,7 +1168,7 @@ static void pixSigmoidInterpolateBlock( imgpel *src[], imgpel *block, int blockS
  *      Width of the frame in pixels
  ************************************************************************
  */
-static void pixDirectionalInterpolateBlock(imgpel *src[], imgpel *block, int blockSize, int frameWidth, int comp, int row_idx, int column_idx)
+static void pixDirectionalInterpolateBlock(ercContext_t *ctx, imgpel *src[], imgpel *block, int blockSize, int frameWidth, int comp, int row_idx, int column_idx)
 {
 	int row, column, k, nbrs=0, srcCounter = 0, weight = 0, bmax = blockSize - 1, numDED=0;
 	double theta=0.0, dirEntropy=0.0;
@@ -929,29 +1178,29 @@ static void pixDirectionalInterpolateBlock(imgpel *src[], imgpel *block, int blo
 	{
 		theta = findbestdir(src, blockSize, frameWidth, &nbrs, &dirEntropy, &numDED);
 		
-		if ( ( (numDED == 0) || (numDED > 2) || (dirEntropy > DIRENTROPYTHRESH) ) && SWDI)
+		if ( ( (numDED == 0) || (numDED > 2) || (dirEntropy > DIRENTROPYTHRESH) ) && ercIntra->swdi)
 		{
 			// do BI
-			if (USESIGMOID)
-				pixSigmoidInterpolateBlock( src, block, blockSize, frameWidth );
+			if (ercIntra->sigmoid)
+				pixSigmoidInterpolateBlock( ctx, src, block, blockSize, frameWidth );
 			else
-				pixMeanInterpolateBlock( src, block, blockSize, frameWidth );
+				pixMeanInterpolateBlock( ctx, src, block, blockSize, frameWidth );
 			return;
 		}
 		else
 		{
-			angles[column_idx][row_idx] = theta;
+			ctx->intra->angles[column_idx][row_idx] = theta;
 		}
 	}
 	else
-		theta = angles[column_idx<<1][row_idx<<1];
+		theta = ctx->intra->angles[column_idx<<1][row_idx<<1];
 
 	if((theta == INF) || (nbrs<2))
 	{
-		if (USESIGMOID)
-			pixSigmoidInterpolateBlock( src, block, blockSize, frameWidth );
+		if (ercIntra->sigmoid)
+			pixSigmoidInterpolateBlock( ctx, src, block, blockSize, frameWidth );
 		else
-			pixMeanInterpolateBlock( src, block, blockSize, frameWidth );
+			pixMeanInterpolateBlock( ctx, src, block, blockSize, frameWidth );
 		return;
 	}
 
@@ -970,10 +1219,10 @@ static void pixDirectionalInterpolateBlock(imgpel *src[], imgpel *block, int blo
 			//Interpolation
 			if( (dir_pixel.p1==-1 && dir_pixel.p2==-1) || (dir_pixel.d1==0.0 && dir_pixel.d2==0.0) )
 			{
-				if (USESIGMOID)
-					block[k + column] = mean_sigmoid_interpolate(src, blockSize, frameWidth, row, column);
+				if (ercIntra->sigmoid)
+					block[k + column] = mean_sigmoid_interpolate(ctx, src, blockSize, frameWidth, row, column);
 				else
-					block[k + column] = mean_interpolate(src, blockSize, frameWidth, row, column);
+					block[k + column] = mean_interpolate(ctx, src, blockSize, frameWidth, row, column);
 			}
 			else if(dir_pixel.p1==-1 && dir_pixel.p2!=-1)
 				block[k+column] = dir_pixel.p2;
@@ -981,7 +1230,7 @@ static void pixDirectionalInterpolateBlock(imgpel *src[], imgpel *block, int blo
 				block[k+column] = dir_pixel.p1;
 			else
 			{
-				if(USESIGMOID)
+				if(ercIntra->sigmoid)
 					block[k + column] = (int)((mySigmoid(blockSize/2 - dir_pixel.d1)*dir_pixel.p1 + mySigmoid(blockSize/2 - dir_pixel.d2)*dir_pixel.p2)/(mySigmoid(blockSize/2 - dir_pixel.d2) + mySigmoid(blockSize/2 - dir_pixel.d1)));
 				else
 					block[k + column] = (int)((dir_pixel.d2*dir_pixel.p1 + dir_pixel.d1*dir_pixel.p2)/(dir_pixel.d1+dir_pixel.d2));
@@ -1000,11 +1249,8 @@ static double findbestdir(imgpel *src[], int blockSize, int frameWidth, int *nbr
 	int gradientx, gradienty;
 	double counter[16]; //counter for 16 quantized angles
 	double dominant_angle=0.0, sumNum=0.0, sumDen=0.0;
-	double *gradientBoundary, *angleBoundary, maxgrad=0.0, probEdge[16], totalEdgeStrength = 0.0;
+	double gradientBoundary[4*16], angleBoundary[4*16], maxgrad=0.0, probEdge[16], totalEdgeStrength = 0.0;
 	*dirEntropy = 0.0;
-	
-	gradientBoundary = (double *)malloc(4*blockSize*sizeof(double));
-	angleBoundary = (double *)malloc(4*blockSize*sizeof(double));
 
 /*Note:
 	idx = 0 to blockSize-1 is for Above pixels
@@ -1431,8 +1677,9 @@ static double quantize_angle(double angle)
 	return angle_q;
 }
 
-static int mean_interpolate(imgpel *src[], int blockSize, int frameWidth, int row, int column)
+static int mean_interpolate(ercContext_t *ctx, imgpel *src[], int blockSize, int frameWidth, int row, int column)
 {
+  struct img_par *img = ctx->img;
 	int value, weight, tmp=0, srcCounter=0, bmax=blockSize-1;
 	int d1, d2, p1, p2;
 
@@ -1544,8 +1791,9 @@ static int mean_interpolate(imgpel *src[], int blockSize, int frameWidth, int ro
 	return value;
 }
 
-static int mean_sigmoid_interpolate(imgpel *src[], int blockSize, int frameWidth, int row, int column)
+static int mean_sigmoid_interpolate(ercContext_t *ctx, imgpel *src[], int blockSize, int frameWidth, int row, int column)
 {
+  struct img_par *img = ctx->img;
 	int value, tmp=0, srcCounter=0, bmax=blockSize-1;
 	int d1, d2, p1, p2;
 	double w1, w2, weight;
@@ -1777,6 +2025,8 @@ static double counterAngle(double *gradientBoundary, double *angleBoundary, doub
  *		Sobel edge detecting masks are used to find edge magnitudes. Mask is applied to available neighboring
  *      boundary pixels, then the dominant edge direction is determined
  *      and the pixel is concealed in the direction of dominant edge using weighted interpolation. 
+ * \param ctx
+ *      concealment context
  * \param src[] 
  *      pointers to neighboring source blocks
  * \param block     
@@ -1787,13 +2037,13 @@ static double counterAngle(double *gradientBoundary, double *angleBoundary, doub
  *      Width of the frame in pixels
  ************************************************************************
  */
-static void pixDirInterpolateBlockwithPModes(imgpel *src[], imgpel *block, int blockSize, int frameWidth, int comp, int row_idx, int column_idx)
+static void pixDirInterpolateBlockwithPModes(ercContext_t *ctx, imgpel *src[], imgpel *block, int blockSize, int frameWidth, int comp, int row_idx, int column_idx)
 {
 	int row, column, k, dominant_pmode;
 	int block_row, block_column;
 	double theta, theta1, theta2;
 	struct direction dir_pixel;
-	imgpel *block2;
+	imgpel block2[256];
 	int block2k, dpm1, dpm2, numDED = 0;
 	int fMDI=0, fBI=0, edgeDir[9], edgeStrength[9];
 	double dirEntropy = 0.0;
@@ -1801,8 +2051,6 @@ static void pixDirInterpolateBlockwithPModes(imgpel *src[], imgpel *block, int b
 	//Angles as per 9 prediction modes. Note that angle for pmode=2 is not applicable.
 	double angle[] = {90.0, 0.0, -1.0, -45.0, 45.0, 67.5, 22.5, -67.5, -22.5};
 
-	block2 = (imgpel*)malloc(256*sizeof(imgpel));
-
 	// for multiple DEDs
 	for (k=0;k<9;k++)
 	{
@@ -1822,16 +2070,16 @@ static void pixDirInterpolateBlockwithPModes(imgpel *src[], imgpel *block, int b
 	if(comp==LUMA)
 	{
 		//Perpendicular to Direction, mag = max - min
-		if (PMODES_UPDATED)
-			dominant_pmode = findDominantPmodeLumaUpdated(src, blockSize, block_row, block_column, frameWidth, &fMDI, &fBI, edgeDir, edgeStrength, &dirEntropy, &numDED);
+		if (ercIntra->pmodesUpdated)
+			dominant_pmode = findDominantPmodeLumaUpdated(ctx, src, blockSize, block_row, block_column, frameWidth, &fMDI, &fBI, edgeDir, edgeStrength, &dirEntropy, &numDED);
 		else
-			dominant_pmode = findDominantPmodeLuma(src, blockSize, block_row, block_column, frameWidth);
+			dominant_pmode = findDominantPmodeLuma(ctx, src, blockSize, block_row, block_column, frameWidth);
 		
 		theta = angle[dominant_pmode];
 	}
 	else
 	{
-		dominant_pmode  = findDominantPmodeChroma(src, blockSize, row_idx, column_idx, frameWidth);
+		dominant_pmode  = findDominantPmodeChroma(ctx, src, blockSize, row_idx, column_idx, frameWidth);
 		switch(dominant_pmode)
 		{
 		case 0:
@@ -1849,14 +2097,14 @@ static void pixDirInterpolateBlockwithPModes(imgpel *src[], imgpel *block, int b
 		}
 	}	
 
-	if (comp==LUMA && fBI && PMODES_UPDATED)
+	if (comp==LUMA && fBI && ercIntra->pmodesUpdated)
 	{
 		// Too many edge directions OR Directional Entropy >= Threshold
 		// In this case, better to do BI than DI
-		if (USESIGMOID)
-			pixSigmoidInterpolateBlock( src, block, blockSize, frameWidth );
+		if (ercIntra->sigmoid)
+			pixSigmoidInterpolateBlock( ctx, src, block, blockSize, frameWidth );
 		else
-			pixMeanInterpolateBlock( src, block, blockSize, frameWidth );
+			pixMeanInterpolateBlock( ctx, src, block, blockSize, frameWidth );
 
 		if (ENTROPYAREA)
 		{
@@ -1865,7 +2113,7 @@ static void pixDirInterpolateBlockwithPModes(imgpel *src[], imgpel *block, int b
 		return;
 	}
 
-	if (comp==LUMA && fMDI && PMODES_UPDATED)
+	if (comp==LUMA && fMDI && ercIntra->pmodesUpdated)
 	{
 		// Multiple Direction Interpolation
 		for (k=0;k<9;k++)
@@ -1903,10 +2151,10 @@ static void pixDirInterpolateBlockwithPModes(imgpel *src[], imgpel *block, int b
 				
 				if( (dir_pixel.p1==-1 && dir_pixel.p2==-1) )// || (dir_pixel.d1==0.0 && dir_pixel.d2==0.0) )
 				{
-					if (USESIGMOID)
-						block[k + column] = mean_sigmoid_interpolate(src, blockSize, frameWidth, row, column);
+					if (ercIntra->sigmoid)
+						block[k + column] = mean_sigmoid_interpolate(ctx, src, blockSize, frameWidth, row, column);
 					else
-						block[k + column] = mean_interpolate(src, blockSize, frameWidth, row, column);
+						block[k + column] = mean_interpolate(ctx, src, blockSize, frameWidth, row, column);
 				}
 				else if(dir_pixel.p1==-1 && dir_pixel.p2!=-1)
 					block[k+column] = dir_pixel.p2;
@@ -1918,7 +2166,7 @@ static void pixDirInterpolateBlockwithPModes(imgpel *src[], imgpel *block, int b
 				if(LOSSAREA)
 					block[k+column] = 0; 
 			}
-			if (INTEGRATE)
+			if (ercIntra->integrate)
 				k += blockSize;
 			else
 				k += frameWidth;
@@ -1936,10 +2184,10 @@ static void pixDirInterpolateBlockwithPModes(imgpel *src[], imgpel *block, int b
 			
 				if( (dir_pixel.p1==-1 && dir_pixel.p2==-1) )// || (dir_pixel.d1==0.0 && dir_pixel.d2==0.0) )
 				{
-					if (USESIGMOID)
-						block[k + column] = mean_sigmoid_interpolate(src, blockSize, frameWidth, row, column);
+					if (ercIntra->sigmoid)
+						block[k + column] = mean_sigmoid_interpolate(ctx, src, blockSize, frameWidth, row, column);
 					else
-						block[k + column] = mean_interpolate(src, blockSize, frameWidth, row, column);
+						block[k + column] = mean_interpolate(ctx, src, blockSize, frameWidth, row, column);
 				}
 				else if(dir_pixel.p1==-1 && dir_pixel.p2!=-1)
 					block2[k+column] = dir_pixel.p2;
@@ -1963,7 +2211,7 @@ static void pixDirInterpolateBlockwithPModes(imgpel *src[], imgpel *block, int b
 				//block[k + column] = (block[k + column] + block2[block2k + column])/2;
 				block[k + column] = (block[k + column]*edgeStrength[dpm1] + block2[block2k + column]*edgeStrength[dpm2])/(edgeStrength[dpm1]+edgeStrength[dpm2]);
 			}
-			if (INTEGRATE)
+			if (ercIntra->integrate)
 				k += blockSize;
 			else
 				k += frameWidth;
@@ -1988,10 +2236,10 @@ static void pixDirInterpolateBlockwithPModes(imgpel *src[], imgpel *block, int b
 				
 				if( (dir_pixel.p1==-1 && dir_pixel.p2==-1) )// || (dir_pixel.d1==0.0 && dir_pixel.d2==0.0) )
 				{
-					if (USESIGMOID)
-						block[k + column] = mean_sigmoid_interpolate(src, blockSize, frameWidth, row, column);
+					if (ercIntra->sigmoid)
+						block[k + column] = mean_sigmoid_interpolate(ctx, src, blockSize, frameWidth, row, column);
 					else
-						block[k + column] = mean_interpolate(src, blockSize, frameWidth, row, column);
+						block[k + column] = mean_interpolate(ctx, src, blockSize, frameWidth, row, column);
 				}
 				else if(dir_pixel.p1==-1 && dir_pixel.p2!=-1)
 					block[k+column] = dir_pixel.p2;
@@ -2003,21 +2251,22 @@ static void pixDirInterpolateBlockwithPModes(imgpel *src[], imgpel *block, int b
 				if(LOSSAREA)
 					block[k+column] = 0; 
 			}
-			if (INTEGRATE)
+			if (ercIntra->integrate)
 				k += blockSize;
 			else
 				k += frameWidth;
 		}
 	}
 
-	if (ENTROPYAREA && comp==LUMA && PMODES_UPDATED)
+	if (ENTROPYAREA && comp==LUMA && ercIntra->pmodesUpdated)
 	{
 		showEntropyArea(dirEntropy, blockSize, block, frameWidth);
 	}
 }
 
-static int findDominantPmodeLuma(imgpel *src[], int blockSize, int block_row, int block_column, int frameWidth)
+static int findDominantPmodeLuma(ercContext_t *ctx, imgpel *src[], int blockSize, int block_row, int block_column, int frameWidth)
 {
+  struct img_par *img = ctx->img;
 	int maxval, minval, maxmag, counter[9]; //counter for 9 pmodes of Intra4x4
 	int k, row, column, bmax = blockSize-1, ipmode, dominant_pmode = 2, pixval[4];
 	float distance;
@@ -2326,8 +2575,9 @@ static float findDistance(int pixval[4], int ipmode, int maxval, int minval)
 	return distance;
 }
 
-static int findDominantPmodeChroma(imgpel *src[], int blockSize, int row_idx, int column_idx, int frameWidth)
+static int findDominantPmodeChroma(ercContext_t *ctx, imgpel *src[], int blockSize, int row_idx, int column_idx, int frameWidth)
 {
+  struct img_par *img = ctx->img;
 	int count, ipmode, dominant_pmode = 0, mb_nbr, counter[4]; //counter for 4 pmodes of Intra8x8 Chroma
 	
 	/* Prediction Modes for Chroma:
@@ -3193,8 +3443,9 @@ static void boundary_pmode8(imgpel *src[], int blockSize, int frameWidth, int ro
 	}
 }
 
-static int findDominantPmodeLumaUpdated(imgpel *src[], int blockSize, int block_row, int block_column, int frameWidth, int *fMDI, int *fBI, int edgeDir[9], int edgeStrength[9], double *dirEntropy, int *numDED)
+static int findDominantPmodeLumaUpdated(ercContext_t *ctx, imgpel *src[], int blockSize, int block_row, int block_column, int frameWidth, int *fMDI, int *fBI, int edgeDir[9], int edgeStrength[9], double *dirEntropy, int *numDED)
 {
+  struct img_par *img = ctx->img;
 	int edgeMagnitude[9], numOccurence[9];//counter for 9 pmodes of Intra4x4
 	int k, row, column, bmax = blockSize-1, ipmode, dominant_pmode = 2;
 	int pixvalP[4], pixvalQ[4], index, edgemagsum=0, maxedgemag, totalEdgeStrength = 0;
@@ -3533,9 +3784,89 @@ static void showEntropyArea(double dirEntropy, int blockSize, imgpel *block, int
 		{			
 			block[k+column] = pixVal; 
 		}
-		if (INTEGRATE)
+		if (ercIntra->integrate)
 			k += blockSize;
 		else
 			k += frameWidth;
 	}
 }
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Selects the intra concealment strategy used by ercPixConcealIMB()
+ * \return
+ *      1, if the strategy exists
+ *      0, otherwise (the active strategy is left unchanged)
+ * \param strategy
+ *      Index into ercIntraStrategies[]
+ ************************************************************************
+ */
+int ercSetIntraStrategy(int strategy)
+{
+  if (strategy < 0 || strategy >= NUM_INTRA_STRATEGIES)
+    return 0;
+
+  ercIntra = &ercIntraStrategies[strategy];
+  return 1;
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the index of the active intra concealment strategy
+ ************************************************************************
+ */
+int ercGetIntraStrategy(void)
+{
+  return (int) (ercIntra - ercIntraStrategies);
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the name of an intra concealment strategy, NULL if the
+ *      index is out of range
+ ************************************************************************
+ */
+char *ercIntraStrategyName(int strategy)
+{
+  if (strategy < 0 || strategy >= NUM_INTRA_STRATEGIES)
+    return NULL;
+
+  return ercIntraStrategies[strategy].name;
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the number of intra concealment strategies
+ ************************************************************************
+ */
+int ercNumIntraStrategies(void)
+{
+  return NUM_INTRA_STRATEGIES;
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Releases the memory the intra concealment of a context keeps from
+ *      frame to frame
+ ************************************************************************
+ */
+void ercFreeIntraState(ercContext_t *ctx)
+{
+  struct erc_intra_state *state = ctx->intra;
+  int i;
+
+  if (state == NULL)
+    return;
+
+  for (i = 0; i < state->anglesColumns; i++)
+    free(state->angles[i]);
+  free(state->angles);
+
+  free(state);
+  ctx->intra = NULL;
+}
@@ -19,43 +19,64 @@
  */
 
 #include <stdlib.h>
+#include <limits.h>
 #include <assert.h>
 #include <math.h>
+#include <string.h>
+#ifdef WIN32
+#include <sys/timeb.h>
+#else
+#include <sys/time.h>
+#endif
 #include "mbuffer.h"
 #include "global.h"
 #include "memalloc.h"
 #include "erc_do.h"
+#include "erc_strategy.h"
+#include "erc_pool.h"
+#include "erc_context.h"
 #include "image.h"
 
+//SIMD versions of the boundary matching kernels, see sadRun()
+#if !defined(ERC_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define ERC_SIMD_SSE2 1
+#define ERC_SIMD_AVX2 1
+#elif !defined(ERC_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define ERC_SIMD_SSE2 1
+#define ERC_SIMD_AVX2 0
+#else
+#define ERC_SIMD_SSE2 0
+#define ERC_SIMD_AVX2 0
+#endif
+
 extern int erc_mvperMB;
 struct img_par *erc_img;
 
-// picture error concealment
-// concealment_head points to first node in list, concealment_end points to 
-// last node in list. Initialise both to NULL, meaning no nodes in list yet
-struct concealment_node *concealment_head = NULL;
-struct concealment_node *concealment_end = NULL;
+// concealment context of the decoder's global state, see ercDecoderContext()
+// picture error concealment: its lostPictures ring holds the lost non reference
+// frames waiting for output, its pocIndex the frame stores of the DPB by POC
+static ercContext_t decoderContext;
 
 // static function declarations
-static int concealByCopy(frame *recfr, int currMBNum,
+static int concealByCopy(ercContext_t *ctx, frame *recfr, int currMBNum,
   objectBuffer_t *object_list, int32 picSizeX);
-static int concealByTrial(frame *recfr, imgpel *predMB, 
-                          int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
-                          int32 picSizeX, int32 picSizeY, int *yCondition);
-static int edgeDistortion (int predBlocks[], int currYBlockNum, imgpel *predMB, 
-                           imgpel *recY, int32 picSizeX, int32 regionSize);
-static void copyBetweenFrames (frame *recfr, 
+static int edgeDistortion (int predBlocks[], imgpel *predMB, imgpel *nbRing, int32 regionSize, int maxDist);
+static int usedNeighbours(int predBlocks[], int sides, int *threshold);
+static void copyBetweenFrames (ercContext_t *ctx, frame *recfr, 
    int currYBlockNum, int32 picSizeX, int32 regionSize);
-static void buildPredRegionYUV(struct img_par *img, int32 *mv, int x, int y, imgpel *predMB);
 
 // picture error concealment
-static void buildPredblockRegionYUV(struct img_par *img, int32 *mv, 
-                                    int x, int y, imgpel *predMB, int list);
+static StorablePicture *getConcealPicture(ercContext_t *ctx);
+static void releaseConcealPicture(ercContext_t *ctx, StorablePicture *picture);
+static void clearConcealMotion(StorablePicture *picture);
+static void sort_pocs(int *pocs, int size);
 static void CopyImgData(imgpel **inputY, imgpel ***inputUV, imgpel **outputY, 
-                        imgpel ***outputUV, int img_width, int img_height);
+                        imgpel ***outputUV, int img_width, int img_height, int img_width_cr, int img_height_cr);
 
 
-static void copyPredMB (int currYBlockNum, imgpel *predMB, frame *recfr, 
+static void copyPredMB (ercContext_t *ctx, int currYBlockNum, imgpel *predMB, frame *recfr, 
                         int32 picSizeX, int32 regionSize);
 
 extern const unsigned char subblk_offset_y[3][8][4];
@@ -64,10 +85,6 @@ static int uv_div[2][4] = {{0, 1, 1, 0}, {0, 1, 0, 0}}; //[x/y][yuv_format]
 
 
 //Santosh
-#define OBMA		1
-#define FOURMODES	0
-#define ABS			0
-#define OBMC		0
 #define OBMC_THRESHOLD 0
 #define OBMC_TR 10
 #define NIL  352
@@ -82,9 +99,304 @@ static int uv_div[2][4] = {{0, 1, 1, 0}, {0, 1, 0, 0}}; //[x/y][yuv_format]
 #define ECMODE8 8
 #define SEC     9
 
-imgpel *boundary;
+//Neighbour classes of the ABS mode decision (find_mb_ecmode(), fourmodes_find_mb_ecmode()).
+//The rules only tell these mb_types apart, so the mode of an MB is looked up in a table
+//indexed by the classes of its above, left, below and right neighbours.
+#define ECCLASS_NA      0   //!< neighbour not available (lost, or outside the picture)
+#define ECCLASS_SKIP    1   //!< mb_type 0
+#define ECCLASS_16x16   2   //!< mb_type 1
+#define ECCLASS_16x8    3   //!< mb_type 2
+#define ECCLASS_8x16    4   //!< mb_type 3
+#define ECCLASS_OTHER   5   //!< mb_type 4..7, sub-MB types
+#define ECCLASS_8x8     6   //!< mb_type 8
+#define ECCLASS_I4MB    7   //!< mb_type 9
+#define ECCLASS_INTRA   8   //!< mb_type 10 and above
+#define NUM_ECCLASSES   9
+
+#define NUM_ECMODE_ENTRIES (NUM_ECCLASSES*NUM_ECCLASSES*NUM_ECCLASSES*NUM_ECCLASSES)
+
+static const byte ecClassOfType[16] =
+{
+  ECCLASS_SKIP, ECCLASS_16x16, ECCLASS_16x8, ECCLASS_8x16,
+  ECCLASS_OTHER, ECCLASS_OTHER, ECCLASS_OTHER, ECCLASS_OTHER,
+  ECCLASS_8x8, ECCLASS_I4MB, ECCLASS_INTRA, ECCLASS_INTRA,
+  ECCLASS_INTRA, ECCLASS_INTRA, ECCLASS_INTRA, ECCLASS_INTRA
+};
+
+static byte ecmodeTable[2][NUM_ECMODE_ENTRIES];        //!< mode of [fourmodes][neighbour classes]
+static int  ecmodeTableBuilt = 0;
+
 extern StorablePicture *no_reference_picture;
 
+//Candidate MV cache
+//Neighbouring MBs and sub-blocks very often carry the same motion vector, and all
+//partitions of an ECMODE share the same full-MB prediction. The cache keeps the
+//prediction, the OBMA boundary ring and the per-partition boundary SAD of every
+//candidate tried for the MB currently being concealed, so duplicates are free.
+//With OBMA only the ring is needed for scoring, without it only the luma prediction;
+//the chroma prediction is built for the winning candidates only.
+#define MAX_MV_CANDIDATES  16
+#define MAX_MV_PARTITIONS  4
+#define MAX_CAND_LIST      (MAX_MV_CANDIDATES*ERC_MAX_CONCEAL_REFS)  //!< longest candidate list, the pairs of tryRecentRefs()
+#define CAND_LANES         ((MAX_CAND_LIST + 15) & ~15)      //!< candidates of a batch (batchDistortions()), padded to the SIMD width
+
+#define CAND_RING   0                                   //!< getMVCandidate(): OBMA outer boundary ring
+#define CAND_LUMA   1                                   //!< getMVCandidate(): luma prediction
+#define CAND_YUV    2                                   //!< getMVCandidate(): luma and chroma prediction
+
+typedef struct
+{
+  int32  mv[3];                                         //!< candidate MV, mv[2] = reference index
+  int    hasLuma;                                       //!< pred[] holds the luma prediction
+  int    hasChroma;                                     //!< pred[] holds the chroma prediction
+  int    hasBoundary;                                   //!< ring[] holds the OBMA outer boundary
+  int    dist[MAX_MV_PARTITIONS];                       //!< boundary SAD per partition, -1 = not measured
+  int    bound[MAX_MV_PARTITIONS];                      //!< lower bound of an aborted measurement, -1 = none
+  imgpel pred[3*MB_BLOCK_SIZE*MB_BLOCK_SIZE];           //!< full MB prediction, predMB layout
+  imgpel ring[4*MB_BLOCK_SIZE];                         //!< above, left, below, right outer boundary
+} ercMVCandidate_t;
+
+typedef struct
+{
+  int numCand;                                          //!< number of valid entries
+  int nextSlot;                                         //!< replacement position once the cache is full
+  ercMVCandidate_t cand[MAX_MV_CANDIDATES];
+} ercMVCandCache_t;
+
+//Concealment workers
+//Everything a thread writes while it conceals an MB: the MB predictions, the candidate
+//MV cache and the image parameters, whose MB coordinates and img->mpr are overwritten
+//by the prediction routines. The serial concealment runs on worker 0 with the image
+//parameters of the context, in the parallel waves each worker has a copy of them.
+//The prediction buffers are sized for 4:4:4 and kept with the worker, so concealing
+//an MB does not allocate anything.
+typedef struct
+{
+  ercContext_t    *ctx;                                 //!< context being concealed
+  struct img_par  *img;                                 //!< image parameters used for the predictions
+  struct img_par   imgCopy;                             //!< private image parameters of a parallel worker
+  imgpel           predMB[3*MB_BLOCK_SIZE*MB_BLOCK_SIZE];   //!< prediction of the MB being concealed
+  imgpel           predOBMC[3*MB_BLOCK_SIZE*MB_BLOCK_SIZE]; //!< predMB after OBMC
+  imgpel           predLR[3*BLOCK_SIZE*BLOCK_SIZE*4];   //!< 8x8 block predicted with the left/right neighbour MV (OBMC)
+  imgpel           predTD[3*BLOCK_SIZE*BLOCK_SIZE*4];   //!< 8x8 block predicted with the top/bottom neighbour MV (OBMC)
+  ercMVCandCache_t mvCandCache;                         //!< candidates of the MB being concealed
+  imgpel           nbRing[4*MB_BLOCK_SIZE];             //!< pixels around the MB being concealed, see loadNeighbourRing()
+  imgpel           candEdges[4*MB_BLOCK_SIZE*CAND_LANES];   //!< boundary pixels of a candidate batch, pixel major, see batchDistortions()
+  imgpel           coarseRing[4*MB_BLOCK_SIZE/2];       //!< nbRing at the resolution of the coarse ranking
+  int              coarseLevel;                         //!< pyramid level of coarseRing, 1 = 1/2, 2 = 1/4
+  int              level;                               //!< ERC_LEVEL_* of the MB being concealed
+  int              degradedMBs;                         //!< MBs concealed below ERC_LEVEL_FULL in the current frame
+  int              prunedCandidates;                    //!< MV candidates dropped by clusterCandidates() in the current frame
+  int              refineLeft;                          //!< MV refinement evaluations left to the MB being concealed
+  int              refineUsed;                          //!< MV refinement evaluations of the current wave
+} ercWorker_t;
+
+//Parallel inter frame concealment
+//With more than one thread the corrupted MBs are concealed in waves: an MB belongs to
+//wave (d-1)*4+c, with d its distance in MBs (8-connected) to the nearest received MB
+//and c = (x&1)+2*(y&1) the parity class of its position. Two MBs of one wave are never
+//neighbours, so each only reads MBs of earlier waves and all of them can be concealed
+//at the same time. The result depends on the waves only, not on the number of threads
+//or on which thread takes which MB. Like the serial column order, the concealment
+//proceeds from the received area inwards.
+typedef struct
+{
+  ercContext_t   *ctx;
+  frame          *recfr;
+  objectBuffer_t *object_list;
+  int32           picSizeX, picSizeY;
+  ercVariables_t *errorVar;
+  int             lastRow, lastColumn;                  //!< frame size in MBs
+  int            *mbs;                                  //!< MBs of the current wave
+  int             refineShare;                          //!< MV refinement evaluations of each MB of the wave
+} ercWaveJob_t;
+
+//The arrays that order the MBs into waves are kept from frame to frame and only
+//reallocated when the picture grows.
+typedef struct
+{
+  int  numMB;                                           //!< MBs the arrays hold
+  int  numWaves;                                        //!< waves the arrays hold
+  int *dist;                                            //!< [numMB] distance, then wave of each MB
+  int *order;                                           //!< [numMB] MBs sorted by wave
+  int *start;                                           //!< [numWaves+1] first MB of each wave in order[]
+  int *fill;                                            //!< [numWaves] next free entry of each wave
+} ercWaveScratch_t;
+
+static void concealWaveMB(void *arg, int item, int worker);
+static void concealInterFrameWaves(ercContext_t *ctx, frame *recfr, objectBuffer_t *object_list, int32 picSizeX, int32 picSizeY, 
+                                   ercVariables_t *errorVar, int numWorkers);
+static void getWaveScratch(ercWaveScratch_t *scratch, int numMB, int numWaves);
+static void initWorkerImages(ercContext_t *ctx, int numWorkers);
+
+//Motion copy concealment of a lost frame (conceal_mode 2)
+//The frame is concealed in bands of one MB row spread over the worker pool. In a band
+//every 4x4 block row is split into runs of up to ERC_MAX_RUN samples of blocks with the
+//same motion, and a run is predicted with one fetch straight into the concealed picture.
+#define ERC_MAX_RUN      64
+
+typedef struct
+{
+  ercContext_t    *ctx;                                 //!< context being concealed
+  StorablePicture *src;                                 //!< picture the motion is copied from
+  StorablePicture *dst;                                 //!< concealed picture
+  int              scale;                               //!< MV divisor, 2 for a lost B picture
+  int              mb_width;                            //!< picture width in MBs
+} ercMVCopyJob_t;
+
+static void concealMVCopyBand(void *arg, int band, int worker);
+static void predictRunYUV(ercWorker_t *worker, StorablePicture *dst, int32 *mv, int x, int y, int numBlocks, int fieldMB);
+static void interpolateRun(imgpel **refY, int x_pos, int y_pos, int dx, int dy, int maxValue, int width,
+                           imgpel **out, int ox, int oy);
+
+static void resetMVCandCache(ercWorker_t *worker);
+static ercMVCandidate_t *getMVCandidate(ercWorker_t *worker, int32 *mv, int x, int y, int need);
+static void extractPredPartition(ercContext_t *ctx, imgpel *predMB, imgpel *partMB, int x0, int y0, int width, int height);
+
+//Padded reference planes
+//The motion compensated fetches of the concealment clamp every tap into the picture.
+//Instead, the luma of each reference used while concealing a frame is copied once into
+//a plane with a guard band of ERC_PAD replicated edge pixels, and the fetches read it
+//directly. Block positions further out than the guard band are pulled back to where
+//all taps already see the replicated edge, which gives the same samples as clamping.
+//The taps of a 4x4 block and of its boundary reach at most ERC_PAD_BACK pixels left
+//of/above the block origin and ERC_PAD-ERC_PAD_BACK pixels right of/below it.
+#define ERC_PAD          32   //!< guard band of a padded plane, in pixels
+#define ERC_PAD_BACK      8   //!< farthest tap left of/above a 4x4 block or its boundary
+#define MAX_PADDED_REFS  16
+
+//6-tap luma half sample filter at p, taps s apart (1 = horizontal, row stride = vertical)
+#define TAP6(p, s)  ((p)[-2*(s)] - 5*(p)[-(s)] + 20*(p)[0] + 20*(p)[(s)] - 5*(p)[2*(s)] + (p)[3*(s)])
+
+//Sub-pel plane cache
+//Optionally each padded plane also keeps the 15 quarter sample phases of its luma,
+//interpolated lazily in tiles of SUBPEL_TILE x SUBPEL_TILE samples the first time a
+//block of that phase touches them, so later fetches of the same area are plain copies.
+//A phase plane covers every block origin left after the guard band clipping, i.e.
+//x from -SUBPEL_ORG up to size_x-1+ERC_PAD_BACK, plus the width of the block.
+//The cache is off by default; its memory is bounded by ercSetSubPelCache().
+#define SUBPEL_TILE      16
+#define SUBPEL_ORG       (ERC_PAD-ERC_PAD_BACK)
+#define SUBPEL_PHASES    16   //!< (dy<<2)+dx, phase 0 is the padded plane itself
+
+//Reference pyramid
+//For the coarse ranking of the extra MV candidates (ercSetCoarseCandidates()) a padded plane
+//also keeps its luma at 1/2 and 1/4 resolution, each sample the rounded mean of a 2x2
+//block of the level above. The levels are built the first time a candidate is ranked
+//on them. Pictures of ERC_COARSE_QUARTER_WIDTH pixels and wider are ranked at 1/4
+//resolution, narrower ones at 1/2.
+#define ERC_PYRAMID_LEVELS        2
+#define ERC_COARSE_QUARTER_WIDTH  1280
+
+typedef struct
+{
+  StorablePicture *pic;                                 //!< source picture, NULL = slot unused
+  int      size_y;                                      //!< rows taken from the source (frame or field MB height)
+  imgpel **imgY;                                        //!< imgY[y][x], valid for -ERC_PAD <= x,y < size+ERC_PAD
+  imgpel **rows;                                        //!< row pointer allocation
+  imgpel  *buf;                                         //!< sample allocation
+  int      rowsSize;                                    //!< allocated row pointers
+  int      bufSize;                                     //!< allocated samples
+
+  imgpel  *subPel[SUBPEL_PHASES];                       //!< phase planes, NULL = not allocated
+  byte    *tileDone[SUBPEL_PHASES];                     //!< 1 = tile of the phase plane interpolated
+  byte     subPelReady[SUBPEL_PHASES];                  //!< 1 = phase plane allocated
+  byte     subPelRefused[SUBPEL_PHASES];                //!< 1 = no room for the phase plane in the cache
+  ercPoolMutex_t subPelMutex[SUBPEL_PHASES];            //!< held while a phase plane is allocated or its tiles filled
+  int      subPelStride;                                //!< row length of a phase plane
+  int      tilesX, tilesY;                              //!< tiles per phase plane
+
+  imgpel  *coarse[ERC_PYRAMID_LEVELS];                  //!< luma at 1/2 and 1/4 resolution, rows contiguous
+  int      coarseSize[ERC_PYRAMID_LEVELS];              //!< allocated samples of each level
+  int      coarseLevels;                                //!< levels built for pic, 0..ERC_PYRAMID_LEVELS
+} ercPaddedPlane_t;
+
+static int subPelCacheLimit = 0;                        //!< bytes allowed for phase planes per context, 0 = cache off
+static int concealDeadline = 0;                         //!< ms allowed to conceal one picture, 0 = no deadline
+static int mvCandidates = 0;                            //!< ERC_MVCAND_* tried after the neighbour MVs, 0 = none
+static int earlyExitSAD = 0;                            //!< boundary SAD per pixel that ends the MV search, 0 = off
+static int refineRange = 0;                             //!< integer pel range of the MV refinement, 0 = off
+static int refineBudget = 0;                            //!< MV refinement evaluations per picture, 0 = no limit
+static int concealRefs = 1;                             //!< recent references each candidate MV is tried against, 1 = its own only
+static int refCandidates = ERC_REF_CANDIDATES_DEFAULT;  //!< (MV, reference) pairs tried per MB or partition
+static int clusterTolerance = 0;                        //!< quarter pels within which neighbour MVs are one candidate, 0 = off
+static int coarseCandidates = 0;                        //!< extra candidates measured after the coarse ranking, 0 = no ranking
+
+//State of the inter concealment of a context (ercContext_t), kept from frame to frame
+struct erc_inter_state
+{
+  ercWorker_t      workers[ERC_MAX_THREADS];
+  ercPaddedPlane_t paddedRef[MAX_PADDED_REFS];
+  int              paddedRefNext;                       //!< slot of the next padded plane built
+  int              subPelCacheUsed;                     //!< bytes allocated for phase planes
+  ercWaveScratch_t waveScratch;
+};
+
+static struct erc_inter_state *getInterState(ercContext_t *ctx);
+static void resetPaddedRefs(struct erc_inter_state *state);
+static ercPaddedPlane_t *getPaddedRef(struct erc_inter_state *state, StorablePicture *pic, int size_y);
+static void freeSubPelPlanes(struct erc_inter_state *state, ercPaddedPlane_t *plane);
+static imgpel *getCoarseLevel(ercPaddedPlane_t *plane, int level);
+static int coarseLevel(int32 picSizeX);
+static imgpel *getSubPelSamples(struct erc_inter_state *state, ercPaddedPlane_t *plane, int phase, int x, int y, int maxValue);
+static void interpolateBlock(imgpel **refY, int x_pos, int y_pos, int dx, int dy, int maxValue, int block[BLOCK_SIZE][BLOCK_SIZE]);
+static void getConcealBlock(int ref_frame, StorablePicture **list, int x_pos, int y_pos, ercWorker_t *worker, int block[BLOCK_SIZE][BLOCK_SIZE]);
+static void buildPredRegionLuma(ercWorker_t *worker, int32 *mv, int x, int y, imgpel *predMB);
+static void buildPredRegionChroma(ercWorker_t *worker, int32 *mv, int x, int y, imgpel *predMB);
+static void setConcealMBPosition(struct img_par *img, int x, int y);
+
+//Partitioning of the MB for the adaptive block size (ECMODE) concealment
+//The boundary sides follow the order of predBlocks[4..7]: above, left, below, right.
+typedef struct
+{
+  int comp;                                             //!< 8x8 block of the MB receiving the motion info
+  int x0, y0;                                           //!< luma position inside the MB
+  int width, height;                                    //!< luma size, 8 or 16
+  int nbComp[4][2];                                     //!< neighbour 8x8 blocks along each side, -1 = side not on the MB boundary
+} ecPartition_t;
+
+typedef struct
+{
+  int numPart;
+  ecPartition_t part[4];
+} ecPartitionMode_t;
+
+#define NO_SIDE {-1, -1}
+
+static const ecPartitionMode_t ecPartitionTable[SEC] =
+{
+  { 0 },
+  //ECMODE1: 16x16
+  { 1, { { 0,  0,  0, 16, 16, { { 2, 3 }, { 1, 3 }, { 0, 1 }, { 0, 2 } } } } },
+  //ECMODE2: 16x8 upper, lower
+  { 2, { { 0,  0,  0, 16,  8, { { 2, 3 }, { 1, 1 }, NO_SIDE,  { 0, 0 } } },
+         { 2,  0,  8, 16,  8, { NO_SIDE,  { 3, 3 }, { 0, 1 }, { 2, 2 } } } } },
+  //ECMODE3: 8x16 left, right
+  { 2, { { 0,  0,  0,  8, 16, { { 2, 2 }, { 1, 3 }, { 0, 0 }, NO_SIDE  } },
+         { 1,  8,  0,  8, 16, { { 3, 3 }, NO_SIDE,  { 1, 1 }, { 0, 2 } } } } },
+  //ECMODE4: 8x8 top-left, top-right, bottom-left, bottom-right
+  { 4, { { 0,  0,  0,  8,  8, { { 2, 2 }, { 1, 1 }, NO_SIDE,  NO_SIDE  } },
+         { 1,  8,  0,  8,  8, { { 3, 3 }, NO_SIDE,  NO_SIDE,  { 0, 0 } } },
+         { 2,  0,  8,  8,  8, { NO_SIDE,  { 3, 3 }, { 0, 0 }, NO_SIDE  } },
+         { 3,  8,  8,  8,  8, { NO_SIDE,  NO_SIDE,  { 1, 1 }, { 2, 2 } } } } },
+  //ECMODE5: 16x8 upper, 8x8 bottom-left, 8x8 bottom-right
+  { 3, { { 0,  0,  0, 16,  8, { { 2, 3 }, { 1, 1 }, NO_SIDE,  { 0, 0 } } },
+         { 2,  0,  8,  8,  8, { NO_SIDE,  { 3, 3 }, { 0, 0 }, NO_SIDE  } },
+         { 3,  8,  8,  8,  8, { NO_SIDE,  NO_SIDE,  { 1, 1 }, { 2, 2 } } } } },
+  //ECMODE6: 8x8 top-left, 8x8 top-right, 16x8 lower
+  { 3, { { 0,  0,  0,  8,  8, { { 2, 2 }, { 1, 1 }, NO_SIDE,  NO_SIDE  } },
+         { 1,  8,  0,  8,  8, { { 3, 3 }, NO_SIDE,  NO_SIDE,  { 0, 0 } } },
+         { 2,  0,  8, 16,  8, { NO_SIDE,  { 3, 3 }, { 0, 1 }, { 2, 2 } } } } },
+  //ECMODE7: 8x8 top-left, 8x8 bottom-left, 8x16 right
+  { 3, { { 0,  0,  0,  8,  8, { { 2, 2 }, { 1, 1 }, NO_SIDE,  NO_SIDE  } },
+         { 2,  0,  8,  8,  8, { NO_SIDE,  { 3, 3 }, { 0, 0 }, NO_SIDE  } },
+         { 1,  8,  0,  8, 16, { { 3, 3 }, NO_SIDE,  { 1, 1 }, { 0, 2 } } } } },
+  //ECMODE8: 8x16 left, 8x8 top-right, 8x8 bottom-right
+  { 3, { { 0,  0,  0,  8, 16, { { 2, 2 }, { 1, 3 }, { 0, 0 }, NO_SIDE  } },
+         { 1,  8,  0,  8,  8, { { 3, 3 }, NO_SIDE,  NO_SIDE,  { 0, 0 } } },
+         { 3,  8,  8,  8,  8, { NO_SIDE,  NO_SIDE,  { 1, 1 }, { 2, 2 } } } } },
+};
+
 //Matrices for OBMC computation - 16x16 case
 
 static int H_E[16][16] = 
@@ -186,63 +498,100 @@ static int H_TD_8x8[8][8] =
 };
 
 
-static void buildOuterPredRegionYUV(struct img_par *img, int32 *mv, int x, int y, imgpel *predMB, imgpel *boundary);
-void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, struct img_par *img, int index, int above[4], int left[4], int below[4], int right[4]);
-static int edgeDistortionOBMA (int predBlocks[], int currYBlockNum, imgpel *predMB, imgpel *recY, int32 picSizeX, int32 regionSize, imgpel *boundary);
+static void buildOuterBoundary(ercWorker_t *worker, int32 *mv, int x, int y, imgpel *boundary);
+static void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, ercWorker_t *worker, int index, int above[4], int left[4], int below[4], int right[4]);
+static int edgeDistortionOBMA (int predBlocks[], imgpel *boundary, imgpel *nbRing, int32 regionSize, int maxDist);
 
-static int concealABS(frame *recfr, imgpel *predMB, int currMBNum, objectBuffer_t *object_list, 
+static int concealByTrial(frame *recfr, ercWorker_t *worker, 
+                          int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
+                          int32 picSizeX, int32 picSizeY, int *yCondition);
+static int extraMVCandidates(ercWorker_t *worker, objectBuffer_t *object_list, int predBlocks[], int currMBNum,
+                             int numMBPerLine, int32 allmv[8][2], int x, int y, int32 extraMV[][3]);
+static void colocatedMV(ercWorker_t *worker, StorablePicture *ref, int x, int y, int32 *mv);
+static int refineMV(ercWorker_t *worker, int predBlocks[], int x, int y, int32 regionSize,
+                    const ecPartition_t *part, int p, int32 *mvBest, int minDist);
+static int tryRecentRefs(ercWorker_t *worker, int predBlocks[], int x, int y, int32 regionSize,
+                         const ecPartition_t *part, int p, int32 *mvBest, int *minDist);
+static int clusterCandidates(ercWorker_t *worker, int32 candMV[][3], int candMode[], int numCand);
+static int concealABS(frame *recfr, ercWorker_t *worker, int currMBNum, objectBuffer_t *object_list, 
 					  int predBlocks[], int32 picSizeX, int32 picSizeY, int *yCondition);
-int find_mb_ecmode(int predBlocks[],int numMBPerLine,int currMBNum);
-
-int fourmodes_find_mb_ecmode(int predBlocks[],int numMBPerLine,int currMBNum);
-
-static int concealABS_ECMODE1(frame *recfr, imgpel *predMB,int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
-                      int32 picSizeX, int32 picSizeY, int *yCondition);
-static int concealABS_ECMODE2(frame *recfr, imgpel *predMB,int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
-                      int32 picSizeX, int32 picSizeY, int *yCondition);
-static int concealABS_ECMODE3(frame *recfr, imgpel *predMB,int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
-                      int32 picSizeX, int32 picSizeY, int *yCondition);
-static int concealABS_ECMODE4(frame *recfr, imgpel *predMB,int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
-                      int32 picSizeX, int32 picSizeY, int *yCondition);
-static int concealABS_ECMODE5(frame *recfr, imgpel *predMB,int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
-                      int32 picSizeX, int32 picSizeY, int *yCondition);
-static int concealABS_ECMODE6(frame *recfr, imgpel *predMB,int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
-                      int32 picSizeX, int32 picSizeY, int *yCondition);
-static int concealABS_ECMODE7(frame *recfr, imgpel *predMB,int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
-                      int32 picSizeX, int32 picSizeY, int *yCondition);
-static int concealABS_ECMODE8(frame *recfr, imgpel *predMB,int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
-                      int32 picSizeX, int32 picSizeY, int *yCondition);
-
-static void buildOuterPredRegionYUV_ECMODE2(struct img_par *img, int32 *mv, int x, int y, imgpel *predMB, imgpel *boundary, int pos);
-static int edgeDistortion_ECMODE2 (int predBlocks[], int currYBlockNum, imgpel *predMB, imgpel *recY, int32 picSizeX, int32 regionSize, imgpel *boundary, int pos);
-
-static void buildOuterPredRegionYUV_ECMODE3(struct img_par *img, int32 *mv, int x, int y, imgpel *predMB, imgpel *boundary, int pos);
-static int edgeDistortion_ECMODE3(int predBlocks[], int currYBlockNum, imgpel *predMB, imgpel *recY, int32 picSizeX, int32 regionSize, imgpel *boundary, int pos);
+int find_mb_ecmode(struct img_par *img, int predBlocks[],int numMBPerLine,int currMBNum);
+static int ecmodeRules(int mode_A, int mode_L, int mode_B, int mode_R,
+                       int mode_A_available, int mode_L_available, int mode_B_available, int mode_R_available);
+int fourmodes_find_mb_ecmode(struct img_par *img, int predBlocks[],int numMBPerLine,int currMBNum);
+static int fourmodesEcmodeRules(int mode_A, int mode_L, int mode_B, int mode_R,
+                                int mode_A_available, int mode_L_available, int mode_B_available, int mode_R_available);
+static void buildEcmodeTables(void);
+
+static void concealInterMB(ercContext_t *ctx, ercWorker_t *worker, frame *recfr, int currMBNum, objectBuffer_t *object_list,
+                           int predBlocks[], int32 picSizeX, int32 picSizeY, ercVariables_t *errorVar);
+static int concealByPartition(frame *recfr, ercWorker_t *worker, int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
+                              int32 picSizeX, int32 picSizeY, int *yCondition, int mb_ecmode);
+static int partitionDistortion(const ecPartition_t *part, int predBlocks[], ercMVCandidate_t *cand,
+                               imgpel *nbRing, int maxDist);
+static int sadRun(imgpel *a, imgpel *b, int len);
+static int boundarySAD(imgpel *edge, int strideE, imgpel *neighbor, int strideN, int len);
+static void copyPredPartition(ercContext_t *ctx, imgpel *src, imgpel *dst, const ecPartition_t *part);
+static void buildPartitionPredYUV(ercWorker_t *worker, int32 *mv, int x, int y, imgpel *partMB, const ecPartition_t *part);
+static int candidateDistortion(ercWorker_t *worker, int32 *mv, int x, int y, int predBlocks[], int32 regionSize,
+                               const ecPartition_t *part, int p, int maxDist);
+static int candidateDistortions(ercWorker_t *worker, int32 mvs[][3], int numCand, int x, int y, int predBlocks[],
+                                int32 regionSize, const ecPartition_t *part, int p, int maxDist, int stopDist, int dist[]);
+static int batchDistortions(ercWorker_t *worker, int32 mvs[][3], int numCand, int x, int y, int predBlocks[],
+                            int32 regionSize, const ecPartition_t *part, int p, int dist[]);
+static void candidateSADs(imgpel *edges, imgpel *nb, int numPos, int numLanes, int sad[]);
+static int rankExtraCandidates(ercWorker_t *worker, int32 extraMV[][3], int numExtraMV, imgpel *recY, int currYBlockNum,
+                               int x, int y, int predBlocks[], int32 picSizeX, int32 regionSize);
+static int coarseDistortion(ercWorker_t *worker, int32 *mv, int x, int y, int predBlocks[], int32 regionSize);
+static int measureDistortion(ercMVCandidate_t *cand, imgpel *nbRing, int predBlocks[], int32 regionSize,
+                             const ecPartition_t *part, int p, int maxDist);
+static void loadNeighbourRing(ercWorker_t *worker, imgpel *recY, int predBlocks[], int currYBlockNum,
+                              int32 picSizeX, int32 regionSize);
+static void loadCoarseRing(ercWorker_t *worker, imgpel *currBlock, int predBlocks[], int32 picSizeX, int32 regionSize);
+
+static void OBMC_MB(ercWorker_t *worker, int predBlocks[], objectBuffer_t *object_list, int currMBNum, int numMBPerLine, int picSizeX);
 
-static void buildOuterPredRegionYUV_ECMODE4(struct img_par *img, int32 *mv, int x, int y, imgpel *predMB, imgpel *boundary, int pos);
-static int edgeDistortion_ECMODE4(int predBlocks[], int currYBlockNum, imgpel *predMB, imgpel *recY, int32 picSizeX, int32 regionSize, imgpel *boundary, int pos);
-
-static void buildOuterPredRegionYUV_ECMODE5(struct img_par *img, int32 *mv, int x, int y, imgpel *predMB, imgpel *boundary, int pos);
-static int edgeDistortion_ECMODE5(int predBlocks[], int currYBlockNum, imgpel *predMB, imgpel *recY, int32 picSizeX, int32 regionSize, imgpel *boundary, int pos);
-
-static void buildOuterPredRegionYUV_ECMODE6(struct img_par *img, int32 *mv, int x, int y, imgpel *predMB, imgpel *boundary, int pos);
-static int edgeDistortion_ECMODE6(int predBlocks[], int currYBlockNum, imgpel *predMB, imgpel *recY, int32 picSizeX, int32 regionSize, imgpel *boundary, int pos);
+int findaveragemv(int allmv[8][2],int comp);
+int findmedianmv(int allmv[8][2],int comp);
 
-static void buildOuterPredRegionYUV_ECMODE7(struct img_par *img, int32 *mv, int x, int y, imgpel *predMB, imgpel *boundary, int pos);
-static int edgeDistortion_ECMODE7(int predBlocks[], int currYBlockNum, imgpel *predMB, imgpel *recY, int32 picSizeX, int32 regionSize, imgpel *boundary, int pos);
+//Inter concealment strategies
+//Each entry names the MB concealment routine and the options it runs with:
+//  obma      - match the outer boundary of the candidate (OBMA) instead of its inner edge
+//  obmc      - overlapped block motion compensation of the concealed MB
+//  fourmodes - restrict the adaptive block size (ABS) classifier to ECMODE1..4
+typedef int (*ercConcealMBFunc)(frame *recfr, ercWorker_t *worker, int currMBNum, objectBuffer_t *object_list,
+                                int predBlocks[], int32 picSizeX, int32 picSizeY, int *yCondition);
 
-static void buildOuterPredRegionYUV_ECMODE8(struct img_par *img, int32 *mv, int x, int y, imgpel *predMB, imgpel *boundary, int pos);
-static int edgeDistortion_ECMODE8(int predBlocks[], int currYBlockNum, imgpel *predMB, imgpel *recY, int32 picSizeX, int32 regionSize, imgpel *boundary, int pos);
+typedef struct
+{
+  char            *name;
+  ercConcealMBFunc concealMB;
+  int              obma;
+  int              obmc;
+  int              fourmodes;
+} ercInterStrategy_t;
+
+static const ercInterStrategy_t ercInterStrategies[] =
+{
+  { "BM",        concealByTrial, 0, 0, 0 },
+  { "OBMA",      concealByTrial, 1, 0, 0 },
+  { "OBMA+OBMC", concealByTrial, 1, 1, 0 },
+  { "ABS",       concealABS,     1, 0, 0 },
+  { "ABS4",      concealABS,     1, 0, 1 },
+  { "ABS+OBMC",  concealABS,     1, 1, 0 },
+  { "ABS4+OBMC", concealABS,     1, 1, 1 },
+};
 
-static void OBMC_MB(imgpel *predMB, imgpel *predMB_OBMC, int predBlocks[], objectBuffer_t *object_list, int currMBNum, int numMBPerLine, int picSizeX);
+#define NUM_INTER_STRATEGIES ((int) (sizeof(ercInterStrategies)/sizeof(ercInterStrategies[0])))
 
-int findaveragemv(int allmv[8][2],int comp);
-int findmedianmv(int allmv[8][2],int comp);
+static const ercInterStrategy_t *ercInter = &ercInterStrategies[ERC_INTER_STRATEGY_DEFAULT];
 
 /*!
  ************************************************************************
  * \brief
- *      The main function for Inter (P) frame concealment.
+ *      The main function for Inter (P) frame concealment of the decoder.
+ *      Conceals the decoder's dec_picture from listX[0], see
+ *      ercConcealInterFrameCtx().
  * \return
  *      0, if the concealment was not successful and simple concealment should be used
  *      1, otherwise (even if none of the blocks were concealed)
@@ -262,12 +611,55 @@ int findmedianmv(int allmv[8][2],int comp);
  */
 int ercConcealInterFrame(frame *recfr, objectBuffer_t *object_list, 
                          int32 picSizeX, int32 picSizeY, ercVariables_t *errorVar, int chroma_format_idc ) 
+{
+  return ercConcealInterFrameCtx(ercDecoderContext(erc_img), recfr, object_list, picSizeX, picSizeY, errorVar,
+                                 chroma_format_idc);
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Inter (P) frame concealment of a context: conceals ctx->dec_picture
+ *      from the references in ctx->list0, with ctx->img describing the
+ *      picture. The caller sets these (and ctx->mvPerMB) for every frame.
+ *      With more than one concealment thread (ercSetConcealThreads())
+ *      the MBs are concealed in parallel waves, see ercWaveJob_t.
+ *      With a deadline (ercSetConcealDeadline()) the MBs left when it
+ *      runs short are concealed at a lower level, see concealInterMB(),
+ *      and counted in ctx->degradedMBs and ctx->degradedTotal. The
+ *      candidates dropped by the MV clustering (ercSetClusterTolerance())
+ *      are counted in ctx->prunedCandidates and ctx->prunedTotal.
+ * \return
+ *      0, if the concealment was not successful and simple concealment should be used
+ *      1, otherwise (even if none of the blocks were concealed)
+ * \param ctx
+ *      concealment context
+ * \param recfr
+ *      Reconstructed frame buffer
+ * \param object_list
+ *      Motion info for all MBs in the frame
+ * \param picSizeX
+ *      Width of the frame in pixels
+ * \param picSizeY
+ *      Height of the frame in pixels
+ * \param errorVar   
+ *      Variables for error concealment
+ * \param chroma_format_idc   
+ *      Chroma format IDC
+ ************************************************************************
+ */
+int ercConcealInterFrameCtx(ercContext_t *ctx, frame *recfr, objectBuffer_t *object_list, 
+                            int32 picSizeX, int32 picSizeY, ercVariables_t *errorVar, int chroma_format_idc ) 
 {
   int lastColumn = 0, lastRow = 0, predBlocks[8];
   int lastCorruptedRow = -1, firstCorruptedRow = -1, currRow = 0, 
-    row, column, columnInd, areaHeight = 0, i = 0;
-  imgpel *predMB;
+    r, column, columnInd, areaHeight = 0, i = 0;
+  ercWorker_t *worker;
+  ercRunList_t *runs;
+  ercCorruptedRun_t *run;
 
+  ercStartDeadline(ctx);
+  ctx->prunedCandidates = 0;
   
   /* if concealment is on */
   if ( errorVar && errorVar->concealment ) 
@@ -275,115 +667,74 @@ int ercConcealInterFrame(frame *recfr, objectBuffer_t *object_list,
     /* if there are segments to be concealed */
     if ( errorVar->nOfCorruptedSegments ) 
     {
-      if (chroma_format_idc != YUV400)
-        predMB = (imgpel *) malloc ( (256 + (img->mb_cr_size_x*img->mb_cr_size_y)*2) * sizeof (imgpel));
-      else
-        predMB = (imgpel *) malloc(256 * sizeof (imgpel));
-
-	  //Above, Left, Below, Right: each has 16 pixels on outer boundary
-	  boundary = (imgpel*)malloc((16*4)*sizeof(imgpel));
+      worker = &getInterState(ctx)->workers[0];
+      resetPaddedRefs(ctx->inter);
+      for (i = 0; i < ERC_MAX_THREADS; i++)
+      {
+        ctx->inter->workers[i].degradedMBs = 0;
+        ctx->inter->workers[i].prunedCandidates = 0;
+        ctx->inter->workers[i].refineUsed = 0;
+      }
+      worker->refineLeft = refineBudget > 0 ? refineBudget : INT_MAX;
 
 	  //erc_mvperMB=1;//Remove this
       
-      if ( predMB == NULL ) no_mem_exit("ercConcealInterFrame: predMB");
-      
       lastRow = (int) (picSizeY>>4);
       lastColumn = (int) (picSizeX>>4);
       
-      for ( columnInd = 0; columnInd < lastColumn; columnInd ++) 
-      {        
-        column = ((columnInd%2) ? (lastColumn - columnInd/2 -1) : (columnInd/2));
+      if (ercGetConcealThreads() > 1 && ctx->list0Size <= MAX_PADDED_REFS)
+        concealInterFrameWaves(ctx, recfr, object_list, picSizeX, picSizeY, errorVar, ercGetConcealThreads());
+      else
+      {
+        initWorkerImages(ctx, 1);
+
+        /* the corrupted runs of all columns in one pass over the map */
+        runs = &ctx->corruptedRuns;
+        ercCollectCorruptedRuns(runs, errorVar->yCondition, (lastColumn<<1), (lastRow<<1), 2);
+
+        for ( columnInd = 0; columnInd < lastColumn; columnInd ++) 
+        {        
+          column = ((columnInd%2) ? (lastColumn - columnInd/2 -1) : (columnInd/2));
         
-        for ( row = 0; row < lastRow; row++) 
-        {
-			//Santosh
-			//erc_mvperMB = 20;
-
-          if ( errorVar->yCondition[MBxy2YBlock(column, row, 0, picSizeX)] <= ERC_BLOCK_CORRUPTED ) 
-          {                           // ERC_BLOCK_CORRUPTED (1) or ERC_BLOCK_EMPTY (0)
-            firstCorruptedRow = row;
-            /* find the last row which has corrupted blocks (in same continuous area) */
-            for ( lastCorruptedRow = row+1; lastCorruptedRow < lastRow; lastCorruptedRow++) 
-            {
-              /* check blocks in the current column */
-              if (errorVar->yCondition[MBxy2YBlock(column, lastCorruptedRow, 0, picSizeX)] > ERC_BLOCK_CORRUPTED) 
-              {
-                /* current one is already OK, so the last was the previous one */
-                lastCorruptedRow --;
-                break;
-              }
-            }
-            if ( lastCorruptedRow >= lastRow ) 
+          for ( r = runs->columnStart[column]; r < runs->columnStart[column+1]; r++) 
+          {
+            run = &runs->run[r];
+            firstCorruptedRow = run->firstRow>>1;
+            lastCorruptedRow = run->lastRow>>1;
+
+            if ( !(run->edges & ERC_RUN_BELOW) ) 
             {
               /* correct only from above */
               lastCorruptedRow = lastRow-1;
               for ( currRow = firstCorruptedRow; currRow < lastRow; currRow++ ) 
               {
-                
+              
                 ercCollect8PredBlocks (predBlocks, (currRow<<1), (column<<1), 
                   errorVar->yCondition, (lastRow<<1), (lastColumn<<1), 2, 0);      
-                
-                if(erc_mvperMB >= MVPERMB_THR)
-				{
-					if(ABS)
-						concealABS(recfr, predMB, 
-						currRow*lastColumn+column, object_list, predBlocks, 
-						picSizeX, picSizeY,
-						errorVar->yCondition);		
-					else
-						concealByTrial(recfr, predMB, 
-						currRow*lastColumn+column, object_list, predBlocks, 
-						picSizeX, picSizeY,
-						errorVar->yCondition);
-				}
-                  
-                else 
-                  concealByCopy(recfr, currRow*lastColumn+column, 
-                    object_list, picSizeX);
-                
-                ercMarkCurrMBConcealed (currRow*lastColumn+column, -1, picSizeX, errorVar);
+              
+                concealInterMB(ctx, worker, recfr, currRow*lastColumn+column, object_list, predBlocks,
+                  picSizeX, picSizeY, errorVar);
               }
-              row = lastRow;
             } 
-            else if ( firstCorruptedRow == 0 ) 
+            else if ( !(run->edges & ERC_RUN_ABOVE) ) 
             {
               /* correct only from below */
               for ( currRow = lastCorruptedRow; currRow >= 0; currRow-- ) 
               {
-                
+              
                 ercCollect8PredBlocks (predBlocks, (currRow<<1), (column<<1), 
                   errorVar->yCondition, (lastRow<<1), (lastColumn<<1), 2, 0);      
-                
-                if(erc_mvperMB >= MVPERMB_THR)
-                {
-					if(ABS)
-						concealABS(recfr, predMB, 
-						currRow*lastColumn+column, object_list, predBlocks, 
-						picSizeX, picSizeY,
-						errorVar->yCondition);		
-					else
-						concealByTrial(recfr, predMB, 
-						currRow*lastColumn+column, object_list, predBlocks, 
-						picSizeX, picSizeY,
-						errorVar->yCondition);
-				}
-                else 
-                  concealByCopy(recfr, currRow*lastColumn+column, 
-                    object_list, picSizeX);
-                
-                ercMarkCurrMBConcealed (currRow*lastColumn+column, -1, picSizeX, errorVar);
-              }
               
-              row = lastCorruptedRow+1;
+                concealInterMB(ctx, worker, recfr, currRow*lastColumn+column, object_list, predBlocks,
+                  picSizeX, picSizeY, errorVar);
+              }
             }
             else 
             {
               /* correct bi-directionally */
-              
-              row = lastCorruptedRow+1;
-              
+            
               areaHeight = lastCorruptedRow-firstCorruptedRow+1;
-              
+            
               /* 
               *  Conceal the corrupted area switching between the up and the bottom rows 
               */
@@ -399,37 +750,25 @@ int ercConcealInterFrame(frame *recfr, objectBuffer_t *object_list,
                   currRow = firstCorruptedRow;
                   firstCorruptedRow ++; 
                 }
-                
+              
                 ercCollect8PredBlocks (predBlocks, (currRow<<1), (column<<1), 
                   errorVar->yCondition, (lastRow<<1), (lastColumn<<1), 2, 0);      
-                
-                if(erc_mvperMB >= MVPERMB_THR)
-                {
-					if(ABS)
-						concealABS(recfr, predMB, 
-						currRow*lastColumn+column, object_list, predBlocks, 
-						picSizeX, picSizeY,
-						errorVar->yCondition);		
-					else
-						concealByTrial(recfr, predMB, 
-						currRow*lastColumn+column, object_list, predBlocks, 
-						picSizeX, picSizeY,
-						errorVar->yCondition);
-				}
-                else
-                  concealByCopy(recfr, currRow*lastColumn+column, 
-                    object_list, picSizeX);
-                
-                ercMarkCurrMBConcealed (currRow*lastColumn+column, -1, picSizeX, errorVar);                
+              
+                concealInterMB(ctx, worker, recfr, currRow*lastColumn+column, object_list, predBlocks,
+                  picSizeX, picSizeY, errorVar);
               }
             }
-            lastCorruptedRow = -1;
-            firstCorruptedRow = -1;
           }
         }
       }
-    
-      free(predMB);
+
+      for (i = 0; i < ERC_MAX_THREADS; i++)
+      {
+        ctx->degradedMBs += ctx->inter->workers[i].degradedMBs;
+        ctx->prunedCandidates += ctx->inter->workers[i].prunedCandidates;
+      }
+      ctx->degradedTotal += ctx->degradedMBs;
+      ctx->prunedTotal += ctx->prunedCandidates;
     }
     return 1;
   }
@@ -437,6 +776,285 @@ int ercConcealInterFrame(frame *recfr, objectBuffer_t *object_list,
     return 0;
 }
 
+/*!
+ ************************************************************************
+ * \brief
+ *      Conceals one corrupted MB of an inter frame and marks it as
+ *      concealed. MBs of a picture with little motion are copied from
+ *      the first reference, the others are concealed with the selected
+ *      strategy, or at a lower level when the deadline runs short:
+ *      boundary matching without OBMC (ERC_LEVEL_REDUCED), then the copy
+ *      (ERC_LEVEL_MINIMAL).
+ ************************************************************************
+ */
+static void concealInterMB(ercContext_t *ctx, ercWorker_t *worker, frame *recfr, int currMBNum, objectBuffer_t *object_list,
+                           int predBlocks[], int32 picSizeX, int32 picSizeY, ercVariables_t *errorVar)
+{
+  if(ctx->mvPerMB >= MVPERMB_THR)
+  {
+    worker->level = ercConcealLevel(ctx);
+    if (worker->level != ERC_LEVEL_FULL)
+      worker->degradedMBs++;
+
+    if (worker->level == ERC_LEVEL_FULL)
+      ercInter->concealMB(recfr, worker, currMBNum, object_list, predBlocks, 
+        picSizeX, picSizeY, errorVar->yCondition);
+    else if (worker->level == ERC_LEVEL_REDUCED)
+      concealByTrial(recfr, worker, currMBNum, object_list, predBlocks, 
+        picSizeX, picSizeY, errorVar->yCondition);
+    else
+      concealByCopy(ctx, recfr, currMBNum, object_list, picSizeX);
+  }
+  else
+    concealByCopy(ctx, recfr, currMBNum, object_list, picSizeX);
+
+  ercMarkCurrMBConcealed (currMBNum, -1, picSizeX, errorVar);
+}
+
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Conceals one MB of the current wave, job of the worker pool
+ * \param arg
+ *      the wave (ercWaveJob_t)
+ * \param item
+ *      index of the MB in the wave
+ * \param worker
+ *      worker number, selects the scratch state
+ ************************************************************************
+ */
+static void concealWaveMB(void *arg, int item, int worker)
+{
+  ercWaveJob_t *job = (ercWaveJob_t *) arg;
+  int predBlocks[8];
+  int currMBNum = job->mbs[item];
+  int row = currMBNum / job->lastColumn;
+  int column = currMBNum % job->lastColumn;
+  ercWorker_t *w = &job->ctx->inter->workers[worker];
+
+  ercCollect8PredBlocks (predBlocks, (row<<1), (column<<1), 
+    job->errorVar->yCondition, (job->lastRow<<1), (job->lastColumn<<1), 2, 0);
+
+  /* the share of the wave, so that the result does not depend on the threads */
+  w->refineLeft = job->refineShare;
+  concealInterMB(job->ctx, w, job->recfr, currMBNum, job->object_list, predBlocks,
+    job->picSizeX, job->picSizeY, job->errorVar);
+  w->refineUsed += job->refineShare - w->refineLeft;
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Parallel version of the MB loop of ercConcealInterFrame(). The
+ *      corrupted MBs are concealed wave by wave on the worker pool, see
+ *      ercWaveJob_t for the order.
+ * \param ctx
+ *      concealment context
+ * \param recfr
+ *      Reconstructed frame buffer
+ * \param object_list
+ *      Motion info for all MBs in the frame
+ * \param picSizeX
+ *      Width of the frame in pixels
+ * \param picSizeY
+ *      Height of the frame in pixels
+ * \param errorVar   
+ *      Variables for error concealment
+ * \param numWorkers
+ *      number of threads
+ ************************************************************************
+ */
+static void concealInterFrameWaves(ercContext_t *ctx, frame *recfr, objectBuffer_t *object_list, int32 picSizeX, int32 picSizeY, 
+                                   ercVariables_t *errorVar, int numWorkers)
+{
+  ercWaveScratch_t *scratch = &ctx->inter->waveScratch;
+  ercWaveJob_t job;
+  int *dist, *order, *start, *fill;
+  int lastRow, lastColumn, numMB, numWaves, maxDist, head, tail;
+  int mb, row, column, r, c, wave, size_y, refineLeft;
+  ercPaddedPlane_t *plane;
+
+  lastRow = (int) (picSizeY>>4);
+  lastColumn = (int) (picSizeX>>4);
+  numMB = lastRow*lastColumn;
+
+  /* no MB is further than the larger picture dimension from the received area */
+  getWaveScratch(scratch, numMB, 4*max(lastRow, lastColumn));
+  dist  = scratch->dist;
+  order = scratch->order;
+  start = scratch->start;
+  fill  = scratch->fill;
+
+  /* distance of every MB to the received area, breadth first from the received MBs */
+  head = tail = 0;
+  for (mb = 0; mb < numMB; mb++)
+  {
+    if (errorVar->yCondition[MBxy2YBlock(mb%lastColumn, mb/lastColumn, 0, picSizeX)] > ERC_BLOCK_CORRUPTED)
+    {
+      dist[mb] = 0;
+      order[tail++] = mb;
+    }
+    else
+      dist[mb] = -1;
+  }
+
+  maxDist = 1;
+  while (head < tail)
+  {
+    mb = order[head++];
+    row = mb/lastColumn;
+    column = mb%lastColumn;
+
+    for (r = max(row-1, 0); r <= min(row+1, lastRow-1); r++)
+    {
+      for (c = max(column-1, 0); c <= min(column+1, lastColumn-1); c++)
+      {
+        if (dist[r*lastColumn+c] < 0)
+        {
+          dist[r*lastColumn+c] = dist[mb]+1;
+          maxDist = max(maxDist, dist[mb]+1);
+          order[tail++] = r*lastColumn+c;
+        }
+      }
+    }
+  }
+
+  /* bucket the corrupted MBs by wave, raster order inside a wave */
+  numWaves = 4*maxDist;
+  memset(start, 0, (numWaves+1)*sizeof(int));
+
+  for (mb = 0; mb < numMB; mb++)
+  {
+    if (dist[mb] < 0)
+      dist[mb] = 1;               // nothing received at all
+    if (dist[mb] > 0)
+    {
+      dist[mb] = (dist[mb]-1)*4 + ((mb%lastColumn)&1) + 2*((mb/lastColumn)&1);
+      start[dist[mb]+1]++;
+    }
+    else
+      dist[mb] = -1;
+  }
+  for (wave = 0; wave < numWaves; wave++)
+  {
+    start[wave+1] += start[wave];
+    fill[wave] = start[wave];
+  }
+  for (mb = 0; mb < numMB; mb++)
+  {
+    if (dist[mb] >= 0)
+      order[fill[dist[mb]]++] = mb;
+  }
+
+  /* the padded references and the pyramid level of the coarse ranking are built up front,
+     the workers only read them */
+  size_y = ctx->dec_picture->size_y;
+  if (ctx->dec_picture->mb_field[ctx->img->current_mb_nr])
+    size_y = ctx->dec_picture->size_y/2;
+  for (r = 0; r < ctx->list0Size; r++)
+  {
+    plane = getPaddedRef(ctx->inter, ctx->list0[r], size_y);
+    if (coarseCandidates > 0)
+      getCoarseLevel(plane, coarseLevel(picSizeX));
+  }
+
+  initWorkerImages(ctx, numWorkers);
+
+  job.ctx         = ctx;
+  job.recfr       = recfr;
+  job.object_list = object_list;
+  job.picSizeX    = picSizeX;
+  job.picSizeY    = picSizeY;
+  job.errorVar    = errorVar;
+  job.lastRow     = lastRow;
+  job.lastColumn  = lastColumn;
+
+  refineLeft = refineBudget > 0 ? refineBudget : INT_MAX;
+
+  for (wave = 0; wave < numWaves; wave++)
+  {
+    if (start[wave+1] == start[wave])
+      continue;
+
+    /* the MV refinement evaluations left are shared evenly by the MBs of the wave */
+    job.mbs = order + start[wave];
+    job.refineShare = refineBudget > 0 ? refineLeft / (start[wave+1] - start[wave]) : INT_MAX;
+    ercPoolRun(numWorkers, concealWaveMB, &job, start[wave+1] - start[wave]);
+
+    for (r = 0; r < numWorkers; r++)
+    {
+      refineLeft -= ctx->inter->workers[r].refineUsed;
+      ctx->inter->workers[r].refineUsed = 0;
+    }
+  }
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Makes the wave arrays large enough for a picture, keeping the
+ *      current ones if they already are.
+ * \param scratch
+ *      wave arrays of a context
+ * \param numMB
+ *      MBs of the picture
+ * \param numWaves
+ *      largest number of waves of the picture
+ ************************************************************************
+ */
+static void getWaveScratch(ercWaveScratch_t *scratch, int numMB, int numWaves)
+{
+  if (numMB > scratch->numMB)
+  {
+    free(scratch->dist);
+    free(scratch->order);
+    if ((scratch->dist = (int *) malloc(numMB*sizeof(int))) == NULL)
+      no_mem_exit("getWaveScratch: dist");
+    if ((scratch->order = (int *) malloc(numMB*sizeof(int))) == NULL)
+      no_mem_exit("getWaveScratch: order");
+    scratch->numMB = numMB;
+  }
+
+  if (numWaves > scratch->numWaves)
+  {
+    free(scratch->start);
+    free(scratch->fill);
+    if ((scratch->start = (int *) malloc((numWaves+1)*sizeof(int))) == NULL)
+      no_mem_exit("getWaveScratch: start");
+    if ((scratch->fill = (int *) malloc(numWaves*sizeof(int))) == NULL)
+      no_mem_exit("getWaveScratch: fill");
+    scratch->numWaves = numWaves;
+  }
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Points the workers of a context at the context and at their image
+ *      parameters: worker 0 uses the context's own, the others get a
+ *      copy of them.
+ * \param ctx
+ *      concealment context
+ * \param numWorkers
+ *      number of threads
+ ************************************************************************
+ */
+static void initWorkerImages(ercContext_t *ctx, int numWorkers)
+{
+  ercWorker_t *workers = ctx->inter->workers;
+  int w;
+
+  workers[0].ctx = ctx;
+  workers[0].img = ctx->img;
+  for (w = 1; w < numWorkers; w++)
+  {
+    workers[w].ctx     = ctx;
+    workers[w].imgCopy = *ctx->img;
+    workers[w].img     = &workers[w].imgCopy;
+  }
+}
+
 /*!
  ************************************************************************
  * \brief
@@ -445,6 +1063,8 @@ int ercConcealInterFrame(frame *recfr, objectBuffer_t *object_list,
  *      to COPY MBs. 
  * \return
  *      Always zero (0).
+ * \param ctx
+ *      concealment context
  * \param recfr
  *      Reconstructed frame buffer
  * \param currMBNum
@@ -455,7 +1075,7 @@ int ercConcealInterFrame(frame *recfr, objectBuffer_t *object_list,
  *      Width of the frame in pixels
  ************************************************************************
  */
-static int concealByCopy(frame *recfr, int currMBNum,
+static int concealByCopy(ercContext_t *ctx, frame *recfr, int currMBNum,
   objectBuffer_t *object_list, int32 picSizeX)
 {
   objectBuffer_t *currRegion;
@@ -466,7 +1086,7 @@ static int concealByCopy(frame *recfr, int currMBNum,
   currRegion->xMin = (xPosMB(currMBNum,picSizeX)<<4);
   currRegion->yMin = (yPosMB(currMBNum,picSizeX)<<4);
    
-  copyBetweenFrames (recfr, MBNum2YBlock(currMBNum,0,picSizeX), picSizeX, 16);
+  copyBetweenFrames (ctx, recfr, MBNum2YBlock(currMBNum,0,picSizeX), picSizeX, 16);
    
   return 0;
 }
@@ -476,6 +1096,8 @@ static int concealByCopy(frame *recfr, int currMBNum,
  * \brief
  *      Copies the co-located pixel values from the reference to the current frame. 
  *      Used by concealByCopy
+ * \param ctx
+ *      concealment context
  * \param recfr
  *      Reconstructed frame buffer
  * \param currYBlockNum
@@ -486,35 +1108,40 @@ static int concealByCopy(frame *recfr, int currMBNum,
  *      can be 16 or 8 to tell the dimension of the region to copy
  ************************************************************************
  */
-static void copyBetweenFrames (frame *recfr, 
+static void copyBetweenFrames (ercContext_t *ctx, frame *recfr, 
    int currYBlockNum, int32 picSizeX, int32 regionSize)
 {
-  int j, k, location, xmin, ymin;
-  StorablePicture* refPic = listX[0][0];
+  int j, location, xmin, ymin, width;
+  StorablePicture* refPic = ctx->list0[0];
+  StorablePicture *dec_picture = ctx->dec_picture;
 
   /* set the position of the region to be copied */
   xmin = (xPosYBlock(currYBlockNum,picSizeX)<<3);
   ymin = (yPosYBlock(currYBlockNum,picSizeX)<<3);
    
   for (j = ymin; j < ymin + regionSize; j++)
-    for (k = xmin; k < xmin + regionSize; k++)
-    {
-      location = j * picSizeX + k; 
+  {
+    location = j * picSizeX + xmin; 
 //th      recfr->yptr[location] = dec_picture->imgY[j][k];
-      recfr->yptr[location] = refPic->imgY[j][k];
-    }
+    memcpy(&recfr->yptr[location], &refPic->imgY[j][xmin], regionSize*sizeof(imgpel));
+  }
+
+  if (dec_picture->chroma_format_idc == YUV400)
+    return;
      
-    for (j = ymin >> uv_div[1][dec_picture->chroma_format_idc]; j < (ymin + regionSize) >> uv_div[1][dec_picture->chroma_format_idc]; j++)
-      for (k = xmin >> uv_div[0][dec_picture->chroma_format_idc]; k < (xmin + regionSize) >> uv_div[0][dec_picture->chroma_format_idc]; k++)
-      {
+  width = regionSize >> uv_div[0][dec_picture->chroma_format_idc];
+  xmin >>= uv_div[0][dec_picture->chroma_format_idc];
+
+  for (j = ymin >> uv_div[1][dec_picture->chroma_format_idc]; j < (ymin + regionSize) >> uv_div[1][dec_picture->chroma_format_idc]; j++)
+  {
 //        location = j * picSizeX / 2 + k;
-        location = ((j * picSizeX) >> uv_div[0][dec_picture->chroma_format_idc]) + k;
+    location = ((j * picSizeX) >> uv_div[0][dec_picture->chroma_format_idc]) + xmin;
         
 //th        recfr->uptr[location] = dec_picture->imgUV[0][j][k];
 //th        recfr->vptr[location] = dec_picture->imgUV[1][j][k];
-        recfr->uptr[location] = refPic->imgUV[0][j][k];
-        recfr->vptr[location] = refPic->imgUV[1][j][k];
-      }                                
+    memcpy(&recfr->uptr[location], &refPic->imgUV[0][j][xmin], width*sizeof(imgpel));
+    memcpy(&recfr->vptr[location], &refPic->imgUV[1][j][xmin], width*sizeof(imgpel));
+  }                                
 }
 
 /*!
@@ -523,12 +1150,17 @@ static void copyBetweenFrames (frame *recfr,
  *      It conceals a given MB by using the motion vectors of one reliable neighbor. That MV of a 
  *      neighbor is selected wich gives the lowest pixel difference at the edges of the MB 
  *      (see function edgeDistortion). This corresponds to a spatial smoothness criteria.
+ *      The extra candidates enabled with ercSetMVCandidates() are tried after the
+ *      neighbours, the zero motion last. With ercSetEarlyExitSAD() the search stops at
+ *      the first candidate whose boundary difference per pixel is below the threshold.
+ *      Otherwise the best candidate can be refined around, see refineMV().
  * \return
  *      Always zero (0).
  * \param recfr
  *      Reconstructed frame buffer
- * \param predMB
- *      memory area for storing temporary pixel values for a macroblock
+ * \param worker
+ *      scratch state of the concealing thread, its predMB is the memory area
+ *      for storing temporary pixel values for a macroblock
  *      the Y,U,V planes are concatenated y = predMB, u = predMB+256, v = predMB+320
  * \param currMBNum
  *      current MB index
@@ -544,7 +1176,7 @@ static void copyBetweenFrames (frame *recfr,
  *      array for conditions of Y blocks from ercVariables_t
  ************************************************************************
  */
-static int concealByTrial(frame *recfr, imgpel *predMB, 
+static int concealByTrial(frame *recfr, ercWorker_t *worker, 
                           int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
                           int32 picSizeX, int32 picSizeY, int *yCondition)
 {
@@ -553,20 +1185,18 @@ static int concealByTrial(frame *recfr, imgpel *predMB,
       fInterNeighborExists, numIntraNeighbours,
       fZeroMotionChecked, predSplitted = 0,
       threshold = ERC_BLOCK_OK,
-      minDist, currDist, i, k, bestDir;
+      minDist, i, k,
+      fEarlyExit = 0, numExtraMV, numCand, numSearched, numTried;
   int32 regionSize;
   objectBuffer_t *currRegion;
   int32 mvBest[3] , mvPred[3], *mvptr;
+  int32 extraMV[7][3], candMV[MAX_MV_CANDIDATES][3];
+  int candMode[MAX_MV_CANDIDATES], candDist[MAX_MV_CANDIDATES];
+  ercMVCandidate_t *cand;
+  imgpel *predMB = worker->predMB;
 
   //Santosh
   int32 allmv[8][2]; //array for storing all the nbr MVs
-//  int amv[3], mmv[3], pmv[3];
-
-  //Santosh
-  imgpel *predMB_OBMC;
-	
-  if(OBMC)
-	predMB_OBMC = (imgpel *) malloc ( (256 + (img->mb_cr_size_x*img->mb_cr_size_y)*2) * sizeof (imgpel));
 
   //initialization
   for(i=0;i<8;i++)
@@ -574,6 +1204,8 @@ static int concealByTrial(frame *recfr, imgpel *predMB,
 		  allmv[i][k] = NIL; 
   
   numMBPerLine = (int) (picSizeX>>4);
+
+  resetMVCandCache(worker);
   
   comp = 0;
   regionSize = 16;
@@ -587,11 +1219,14 @@ static int concealByTrial(frame *recfr, imgpel *predMB,
     
     currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
     currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
+
+    loadNeighbourRing(worker, recfr->yptr, predBlocks, MBNum2YBlock(currMBNum,comp,picSizeX), picSizeX, regionSize);
     
     do 
     { /* reliability loop */
       
       minDist = 0; 
+      numCand = 0;
       fInterNeighborExists = 0; 
       numIntraNeighbours = 0; 
       fZeroMotionChecked = 0;
@@ -658,11 +1293,6 @@ static int concealByTrial(frame *recfr, imgpel *predMB,
 
                   mvPred[0] = mvPred[1] = 0;
                   mvPred[2] = 0;
-
-				  if(OBMA)
-					buildOuterPredRegionYUV(erc_img, mvPred, currRegion->xMin, currRegion->yMin, predMB, boundary);
-				  else
-					buildPredRegionYUV(erc_img, mvPred, currRegion->xMin, currRegion->yMin, predMB);
                 }
               }
               /* build motion using the neighbour's Motion Parameters */
@@ -677,11 +1307,6 @@ static int concealByTrial(frame *recfr, imgpel *predMB,
                 mvPred[0] = mvptr[0];
                 mvPred[1] = mvptr[1];
                 mvPred[2] = mvptr[2];		
-
-				if(OBMA)
-					buildOuterPredRegionYUV(erc_img, mvPred, currRegion->xMin, currRegion->yMin, predMB, boundary);
-				else
-					buildPredRegionYUV(erc_img, mvPred, currRegion->xMin, currRegion->yMin, predMB);
               }
 
 			  //Store this MV
@@ -707,29 +1332,14 @@ static int concealByTrial(frame *recfr, imgpel *predMB,
 				  allmv[(i-4)*2+1][1] = mvPred[1];
 			  }
               
-			  /* measure absolute boundary pixel difference */
-			  if(OBMA)
-				currDist = edgeDistortionOBMA(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize, boundary);
-			  else
-				currDist = edgeDistortion(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize);
-			  
-			  /* if so far best -> store the pixels as the best concealment */
-              if (currDist < minDist || !fInterNeighborExists) 
-              {                
-                minDist = currDist;
-                bestDir = i;
-                
-                for (k=0;k<3;k++) 
-                  mvBest[k] = mvPred[k];
+			  /* the candidate is measured with the others of the list below */
+              for (k=0;k<3;k++) 
+                candMV[numCand][k] = mvPred[k];
                 
-                currRegion->regionMode = 
-                  (isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-                  ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-                  ((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-                
-                copyPredMB(MBNum2YBlock(currMBNum,comp,picSizeX), predMB, recfr, 
-                  picSizeX, regionSize);
-              }
+              candMode[numCand++] = 
+                (isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
+                ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
+                ((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
               
               fInterNeighborExists = 1;
             }
@@ -740,286 +1350,99 @@ static int concealByTrial(frame *recfr, imgpel *predMB,
     threshold--;
     
     } while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
+
+    /* the extra candidates, only at the full concealment level */
+    numExtraMV = 0;
+    if (mvCandidates && worker->level == ERC_LEVEL_FULL)
+      numExtraMV = extraMVCandidates(worker, object_list, predBlocks, currMBNum, numMBPerLine, allmv,
+                                     currRegion->xMin, currRegion->yMin, extraMV);
+
+    /* only the extra candidates that rank best on the reference pyramid are measured */
+    if (coarseCandidates > 0 && numExtraMV > coarseCandidates)
+      numExtraMV = rankExtraCandidates(worker, extraMV, numExtraMV, recfr->yptr, MBNum2YBlock(currMBNum,comp,picSizeX),
+                                       currRegion->xMin, currRegion->yMin, predBlocks, picSizeX, regionSize);
+
+    for (i = 0; i < numExtraMV; i++)
+    {
+      for (k=0;k<3;k++) 
+        candMV[numCand][k] = extraMV[i][k];
+
+      candMode[numCand++] = (extraMV[i][0] == 0 && extraMV[i][1] == 0 && extraMV[i][2] == 0) ?
+        ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
+        ((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
+    }
+
+    if (clusterTolerance > 0)
+      numCand = clusterCandidates(worker, candMV, candMode, numCand);
+    numSearched = numCand;
     
     /* always try zero motion */
     if (!fZeroMotionChecked) 
     {
-      mvPred[0] = mvPred[1] = 0;
-      mvPred[2] = 0;
-
-      if(OBMA)
-		buildOuterPredRegionYUV(erc_img, mvPred, currRegion->xMin, currRegion->yMin, predMB, boundary);
-	  else
-		buildPredRegionYUV(erc_img, mvPred, currRegion->xMin, currRegion->yMin, predMB);
-
-	  if(OBMA)
-		currDist = edgeDistortionOBMA(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize, boundary);
-	  else
-		currDist = edgeDistortion(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize);
-      
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = 
-          ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-        
-        copyPredMB(MBNum2YBlock(currMBNum,comp,picSizeX), predMB, recfr, 
-          picSizeX, regionSize);
-      }
-    }
+      for (k=0;k<3;k++) 
+        candMV[numCand][k] = 0;
 
+      candMode[numCand++] = 
+        ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
+    }
 
-	//Santosh
-	/* Try other MV candidates here.....PMV, AMV, MMV, MVD
-	PMV = MV of co-located MB in previous (Inter) frame 
-	AMV = Average MV of nbr MBs
-	MMV = Median MV of nbr MBs
-	MVD = Diagonal MVs
-	*/
-
-	/*Average MV*/
-/*	amv[0] = findaveragemv(allmv,0);
-	amv[1] = findaveragemv(allmv,1);
-	amv[2] = 0;
-*/	
-/*	if(OBMA)
-		buildOuterPredRegionYUV(erc_img, amv, currRegion->xMin, currRegion->yMin, predMB, boundary);
-	else
-		buildPredRegionYUV(erc_img, amv, currRegion->xMin, currRegion->yMin, predMB);
+    /* measure the list, the search ends at the first candidate whose distortion per neighbour
+       edge of regionSize pixels is below the early exit SAD */
+    numTried = candidateDistortions(worker, candMV, numCand, currRegion->xMin, currRegion->yMin, predBlocks,
+                                    regionSize, NULL, 0, INT_MAX, earlyExitSAD*regionSize, candDist);
 
-	if(OBMA)
-		currDist = edgeDistortionOBMA(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize, boundary);
-	else
-		currDist = edgeDistortion(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize);
-      
-    if (currDist < minDist || !fInterNeighborExists) 
+    /* the first one of the best candidates is stored as the concealment */
+    for (i = 0; i < numTried; i++)
     {
-        minDist = currDist;            
+      if (i == 0 || candDist[i] < minDist)
+      {
+        minDist = candDist[i];
         for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = 
-          ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-        
-        copyPredMB(MBNum2YBlock(currMBNum,comp,picSizeX), predMB, recfr, 
-          picSizeX, regionSize);
+          mvBest[k] = candMV[i][k];
+
+        currRegion->regionMode = candMode[i];
+      }
     }
 
-	/*Median MV*/
-/*	mmv[0] = findmedianmv(allmv,0);
-	mmv[0] = findmedianmv(allmv,1);
-	mmv[2] = 0;
-*/
-/*	if(OBMA)
-		buildOuterPredRegionYUV(erc_img, mmv, currRegion->xMin, currRegion->yMin, predMB, boundary);
-	else
-		buildPredRegionYUV(erc_img, mmv, currRegion->xMin, currRegion->yMin, predMB);
+    /* zero motion, when it is only tried at the end of the list, does not end the search */
+    fEarlyExit = (numTried <= numSearched && candDist[numTried-1] < earlyExitSAD*regionSize);
 
-	if(OBMA)
-		currDist = edgeDistortionOBMA(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize, boundary);
-	else
-		currDist = edgeDistortion(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize);
-      
-    if (currDist < minDist || !fInterNeighborExists) 
+    /* the best candidates against the other recent references, only at the full concealment level */
+    if (concealRefs > 1 && !fEarlyExit && worker->level == ERC_LEVEL_FULL &&
+        tryRecentRefs(worker, predBlocks, currRegion->xMin, currRegion->yMin, regionSize, NULL, 0, mvBest, &minDist))
     {
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = 
-          ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-        
-        copyPredMB(MBNum2YBlock(currMBNum,comp,picSizeX), predMB, recfr, 
-          picSizeX, regionSize);
+      currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
     }
 
-	/*PMV = MV of co-located MB in previous (Inter) frame*/
-/*	if(listX[0][0]->slice_type==0)
-	{
-		//Reference frame is INTER 
-
-		//CHECK for mb_type nneded - TO DO!
-		pmv[0] = listX[0][0]->mv[0][currRegion->yMin>>2][currRegion->xMin>>2][0];
-		pmv[1] = listX[0][0]->mv[0][currRegion->yMin>>2][currRegion->xMin>>2][1];
-		pmv[2] = 0;
-
-		if(OBMA)
-			buildOuterPredRegionYUV(erc_img, mmv, currRegion->xMin, currRegion->yMin, predMB, boundary);
-		else
-			buildPredRegionYUV(erc_img, mmv, currRegion->xMin, currRegion->yMin, predMB);
-
-		if(OBMA)
-			currDist = edgeDistortionOBMA(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize, boundary);
-		else
-			currDist = edgeDistortion(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize);
-      
-		if (currDist < minDist || !fInterNeighborExists) 
-		{
-			minDist = currDist;            
-			for (k=0;k<3;k++) 
-			  mvBest[k] = mvPred[k];
-        
-			currRegion->regionMode = 
-			  ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-        
-			copyPredMB(MBNum2YBlock(currMBNum,comp,picSizeX), predMB, recfr, 
-			  picSizeX, regionSize);
-		}
-
-	}	
-*/
-	/*Diagonal 4 MVs*/
-/*
-	//Top-Left
-	if(predBlocks[1]>=ERC_BLOCK_CONCEALED)
-	{
-		predMBNum = currMBNum-numMBPerLine-1;
-		mvptr = getParam(object_list, predMBNum, 3, mv);        
-        mvPred[0] = mvptr[0];
-        mvPred[1] = mvptr[1];
-        mvPred[2] = mvptr[2];
-		
-		if(OBMA)
-			buildOuterPredRegionYUV(erc_img, mvPred, currRegion->xMin, currRegion->yMin, predMB, boundary);
-		else
-			buildPredRegionYUV(erc_img, mvPred, currRegion->xMin, currRegion->yMin, predMB);
-
-		if(OBMA)
-			currDist = edgeDistortionOBMA(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize, boundary);
-		else
-			currDist = edgeDistortion(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize);
-      
-		if (currDist < minDist || !fInterNeighborExists) 
-		{
-			minDist = currDist;            
-			for (k=0;k<3;k++) 
-			  mvBest[k] = mvPred[k];
-        
-			currRegion->regionMode = 
-			  ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-        
-			copyPredMB(MBNum2YBlock(currMBNum,comp,picSizeX), predMB, recfr, 
-			  picSizeX, regionSize);
-		}
-	}
-
-	//Top-Right
-	if(predBlocks[0]>=ERC_BLOCK_CONCEALED)
-	{
-		predMBNum = currMBNum-numMBPerLine+1;
-		mvptr = getParam(object_list, predMBNum, 2, mv);        
-        mvPred[0] = mvptr[0];
-        mvPred[1] = mvptr[1];
-        mvPred[2] = mvptr[2];
-		
-		if(OBMA)
-			buildOuterPredRegionYUV(erc_img, mvPred, currRegion->xMin, currRegion->yMin, predMB, boundary);
-		else
-			buildPredRegionYUV(erc_img, mvPred, currRegion->xMin, currRegion->yMin, predMB);
-
-		if(OBMA)
-			currDist = edgeDistortionOBMA(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize, boundary);
-		else
-			currDist = edgeDistortion(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize);
-      
-		if (currDist < minDist || !fInterNeighborExists) 
-		{
-			minDist = currDist;            
-			for (k=0;k<3;k++) 
-			  mvBest[k] = mvPred[k];
-        
-			currRegion->regionMode = 
-			  ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-        
-			copyPredMB(MBNum2YBlock(currMBNum,comp,picSizeX), predMB, recfr, 
-			  picSizeX, regionSize);
-		}
-	}
-
-	//Bottom-Left
-	if(predBlocks[2]>=ERC_BLOCK_CONCEALED)
-	{
-		predMBNum = currMBNum+numMBPerLine-1;
-		mvptr = getParam(object_list, predMBNum, 1, mv);        
-        mvPred[0] = mvptr[0];
-        mvPred[1] = mvptr[1];
-        mvPred[2] = mvptr[2];
-		
-		if(OBMA)
-			buildOuterPredRegionYUV(erc_img, mvPred, currRegion->xMin, currRegion->yMin, predMB, boundary);
-		else
-			buildPredRegionYUV(erc_img, mvPred, currRegion->xMin, currRegion->yMin, predMB);
-
-		if(OBMA)
-			currDist = edgeDistortionOBMA(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize, boundary);
-		else
-			currDist = edgeDistortion(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize);
-      
-		if (currDist < minDist || !fInterNeighborExists) 
-		{
-			minDist = currDist;            
-			for (k=0;k<3;k++) 
-			  mvBest[k] = mvPred[k];
-        
-			currRegion->regionMode = 
-			  ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-        
-			copyPredMB(MBNum2YBlock(currMBNum,comp,picSizeX), predMB, recfr, 
-			  picSizeX, regionSize);
-		}
-	}
+    /* refine the best candidate, only at the full concealment level */
+    if (refineRange > 0 && !fEarlyExit && worker->level == ERC_LEVEL_FULL &&
+        refineMV(worker, predBlocks, currRegion->xMin, currRegion->yMin, regionSize, NULL, 0, mvBest, minDist))
+    {
+      currRegion->regionMode = (mvBest[0] == 0 && mvBest[1] == 0 && mvBest[2] == 0) ?
+        ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
+        ((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
+    }
 
-	//Bottom-Right
-	if(predBlocks[3]>=ERC_BLOCK_CONCEALED)
-	{
-		predMBNum = currMBNum+numMBPerLine+1;
-		mvptr = getParam(object_list, predMBNum, 0, mv);        
-        mvPred[0] = mvptr[0];
-        mvPred[1] = mvptr[1];
-        mvPred[2] = mvptr[2];
-		
-		if(OBMA)
-			buildOuterPredRegionYUV(erc_img, mvPred, currRegion->xMin, currRegion->yMin, predMB, boundary);
-		else
-			buildPredRegionYUV(erc_img, mvPred, currRegion->xMin, currRegion->yMin, predMB);
-
-		if(OBMA)
-			currDist = edgeDistortionOBMA(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize, boundary);
-		else
-			currDist = edgeDistortion(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize);
-      
-		if (currDist < minDist || !fInterNeighborExists) 
-		{
-			minDist = currDist;            
-			for (k=0;k<3;k++) 
-			  mvBest[k] = mvPred[k];
-        
-			currRegion->regionMode = 
-			  ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-        
-			copyPredMB(MBNum2YBlock(currMBNum,comp,picSizeX), predMB, recfr, 
-			  picSizeX, regionSize);
-		}
-	}
-*/
+    /* store the pixels of the best candidate as the concealment, its full prediction is built only now */
+    cand = getMVCandidate(worker, mvBest, currRegion->xMin, currRegion->yMin, CAND_YUV);
+    copyPredMB(worker->ctx, MBNum2YBlock(currMBNum,comp,picSizeX), cand->pred, recfr, 
+      picSizeX, regionSize);
 
     for (i=0; i<3; i++)
       currRegion->mv[i] = mvBest[i];
 
 	//We found the best MV....now do OBMC
-	if(OBMC)
+	if(ercInter->obmc && worker->level == ERC_LEVEL_FULL)
 	{
 		//construct MB with best mv found above
 		if(mvBest[0]!=NIL)
 		{
-			buildPredRegionYUV(erc_img, mvBest, currRegion->xMin, currRegion->yMin, predMB);
+			cand = getMVCandidate(worker, mvBest, currRegion->xMin, currRegion->yMin, CAND_YUV);
+			memcpy(predMB, cand->pred, (256 + (worker->img->mb_cr_size_x*worker->img->mb_cr_size_y)*2) * sizeof (imgpel));
 		}
 
-		OBMC_MB(predMB,predMB_OBMC,predBlocks,object_list,currMBNum,numMBPerLine,picSizeX);
-		copyPredMB(MBNum2YBlock(currMBNum,0,picSizeX), predMB_OBMC, recfr, picSizeX, regionSize);
+		OBMC_MB(worker,predBlocks,object_list,currMBNum,numMBPerLine,picSizeX);
+		copyPredMB(worker->ctx, MBNum2YBlock(currMBNum,0,picSizeX), worker->predOBMC, recfr, picSizeX, regionSize);
 	}
     
     yCondition[MBNum2YBlock(currMBNum,comp,picSizeX)] = ERC_BLOCK_CONCEALED;
@@ -1031,6 +1454,367 @@ static int concealByTrial(frame *recfr, imgpel *predMB,
     return 0;
 }
 
+/*!
+ ************************************************************************
+ * \brief
+ *      Scales the co-located MV candidate to the POC distance between the
+ *      picture being concealed and the reference it is tried against, as
+ *      temporal direct mode does: the co-located block of the first
+ *      reference spans the distance to its own reference, whose POC is
+ *      kept in ref_pic_id (2*POC for frames). The MV is left as it is
+ *      when the distances are the same.
+ * \param ref
+ *      the first reference, holding the co-located block
+ * \param x, y
+ *      above-left corner pixel of the MB
+ * \param mv
+ *      the co-located MV with the reference index it is tried against,
+ *      scaled in place
+ ************************************************************************
+ */
+static void colocatedMV(ercWorker_t *worker, StorablePicture *ref, int x, int y, int32 *mv)
+{
+  int td, tb, tx, scale;
+
+  td = ref->poc - (int) (ref->ref_pic_id[LIST_0][y>>2][x>>2] >> 1);
+  tb = worker->ctx->dec_picture->poc - worker->ctx->list0[mv[2]]->poc;
+  if (td == 0 || tb == td)
+    return;
+
+  td = max(-128, min(127, td));
+  tb = max(-128, min(127, tb));
+  tx = (16384 + mabs(td/2)) / td;
+  scale = max(-1024, min(1023, (tb*tx + 32) >> 6));
+
+  mv[0] = (scale*mv[0] + 128) >> 8;
+  mv[1] = (scale*mv[1] + 128) >> 8;
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Collects the extra MV candidates of concealByTrial() selected with
+ *      ercSetMVCandidates(), in the order of their expected hit rate:
+ *      the median of the neighbour MVs, the MV of the co-located block in
+ *      the first reference (with its reference index, see colocatedMV()),
+ *      the average of the neighbour MVs and the MVs
+ *      of the reliable diagonal neighbours. Candidates equal to a tried
+ *      one cost nothing, their distortion is kept by getMVCandidate().
+ * \return
+ *      The number of candidates stored in extraMV.
+ * \param allmv
+ *      the MVs of the neighbours tried, NIL where none
+ * \param x
+ *      The x-coordinate of the above-left corner pixel of the MB
+ * \param y
+ *      The y-coordinate of the above-left corner pixel of the MB
+ * \param extraMV
+ *      receives up to 7 candidates
+ ************************************************************************
+ */
+static int extraMVCandidates(ercWorker_t *worker, objectBuffer_t *object_list, int predBlocks[], int currMBNum,
+                             int numMBPerLine, int32 allmv[8][2], int x, int y, int32 extraMV[][3])
+{
+  static const int diagBlock[4]  = { 1, 0, 2, 3 };    //top-left, top-right, bottom-left, bottom-right
+  static const int diagComp[4]   = { 3, 2, 1, 0 };
+  static const int diagOffset[4][2] = { {-1,-1}, {-1,1}, {1,-1}, {1,1} };
+  StorablePicture *ref;
+  int32 *mvptr;
+  int i, n = 0, fNeighbourMV = 0, predMBNum;
+
+  for (i = 0; i < 8; i++)
+    fNeighbourMV |= (allmv[i][0] != NIL);
+
+  if ((mvCandidates & ERC_MVCAND_MEDIAN) && fNeighbourMV)
+  {
+    extraMV[n][0] = findmedianmv(allmv,0);
+    extraMV[n][1] = findmedianmv(allmv,1);
+    extraMV[n][2] = 0;
+    n++;
+  }
+
+  if ((mvCandidates & ERC_MVCAND_COLOCATED) && worker->ctx->list0Size > 0)
+  {
+    ref = worker->ctx->list0[0];
+    // the motion of a non existing or concealed reference is not its own
+    if (ref->slice_type == P_SLICE && !ref->non_existing && !ref->concealed_pic &&
+        (y>>2) < (ref->size_y>>2) && (x>>2) < (ref->size_x>>2) && ref->ref_idx[LIST_0][y>>2][x>>2] >= 0)
+    {
+      extraMV[n][0] = ref->mv[LIST_0][y>>2][x>>2][0];
+      extraMV[n][1] = ref->mv[LIST_0][y>>2][x>>2][1];
+      extraMV[n][2] = min(ref->ref_idx[LIST_0][y>>2][x>>2], worker->ctx->list0Size-1);
+      colocatedMV(worker, ref, x, y, extraMV[n]);
+      n++;
+    }
+  }
+
+  if ((mvCandidates & ERC_MVCAND_AVERAGE) && fNeighbourMV)
+  {
+    extraMV[n][0] = findaveragemv(allmv,0);
+    extraMV[n][1] = findaveragemv(allmv,1);
+    extraMV[n][2] = 0;
+    n++;
+  }
+
+  if (mvCandidates & ERC_MVCAND_DIAGONAL)
+  {
+    for (i = 0; i < 4; i++)
+    {
+      if (predBlocks[diagBlock[i]] < ERC_BLOCK_CONCEALED)
+        continue;
+
+      predMBNum = currMBNum + diagOffset[i][0]*numMBPerLine + diagOffset[i][1];
+      if (isBlock(object_list, predMBNum, diagComp[i], INTRA))
+        continue;
+
+      if (isBlock(object_list, predMBNum, diagComp[i], INTER_COPY))
+      {
+        extraMV[n][0] = extraMV[n][1] = extraMV[n][2] = 0;
+      }
+      else
+      {
+        mvptr = getParam(object_list, predMBNum, diagComp[i], mv);
+        extraMV[n][0] = mvptr[0];
+        extraMV[n][1] = mvptr[1];
+        extraMV[n][2] = mvptr[2];
+      }
+      n++;
+    }
+  }
+
+  return n;
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Tries the candidate MVs measured for an MB (concealByTrial()) or a
+ *      partition (concealByPartition()) against the most recent references
+ *      of list 0 (ercSetConcealRefs()), best candidate first, until the
+ *      (MV, reference) pairs of ercSetRefCandidates() are used up. The
+ *      predictions of every reference come from its own padded plane and
+ *      sub-pel cache, and pairs that were measured before cost nothing.
+ * \return
+ *      1 if mvBest was replaced, 0 otherwise
+ * \param x
+ *      The x-coordinate of the above-left corner pixel of the region
+ * \param y
+ *      The y-coordinate of the above-left corner pixel of the region
+ * \param part
+ *      the partition, NULL for the whole region of concealByTrial()
+ * \param p
+ *      index of the partition in its ECMODE
+ * \param mvBest
+ *      the MV found by the candidate search, replaced by the best pair
+ * \param minDist
+ *      the distortion of mvBest, updated with it
+ ************************************************************************
+ */
+static int tryRecentRefs(ercWorker_t *worker, int predBlocks[], int x, int y, int32 regionSize,
+                         const ecPartition_t *part, int p, int32 *mvBest, int *minDist)
+{
+  ercMVCandCache_t *cache = &worker->mvCandCache;
+  StorablePicture **list0 = worker->ctx->list0;
+  int32 candMV[MAX_MV_CANDIDATES][3], pairMV[MAX_CAND_LIST][3];
+  int candDist[MAX_MV_CANDIDATES], pairDist[MAX_CAND_LIST];
+  int numCand = 0, numRefs, numPairs = 0, fReplaced = 0;
+  int i, j, k, r, dist;
+
+  /* the measured candidates sorted by distortion, the cache changes while the pairs are tried */
+  for (i = 0; i < cache->numCand; i++)
+  {
+    dist = cache->cand[i].dist[p];
+    if (dist < 0 && cache->cand[i].bound[p] >= 0)
+      dist = measureDistortion(&cache->cand[i], worker->nbRing, predBlocks, regionSize, part, p, INT_MAX);
+    if (dist < 0)
+      continue;
+
+    for (j = numCand; j > 0 && candDist[j-1] > dist; j--)
+    {
+      candDist[j] = candDist[j-1];
+      for (k = 0; k < 3; k++)
+        candMV[j][k] = candMV[j-1][k];
+    }
+    candDist[j] = dist;
+    for (k = 0; k < 3; k++)
+      candMV[j][k] = cache->cand[i].mv[k];
+    numCand++;
+  }
+
+  numRefs = min(concealRefs, worker->ctx->list0Size);
+
+  for (i = 0; i < numCand && numPairs < refCandidates; i++)
+  {
+    for (r = 0; r < numRefs && numPairs < refCandidates; r++)
+    {
+      if (r == candMV[i][2] || list0[r] == no_reference_picture)
+        continue;
+
+      pairMV[numPairs][0] = candMV[i][0];
+      pairMV[numPairs][1] = candMV[i][1];
+      pairMV[numPairs][2] = r;
+      numPairs++;
+    }
+  }
+
+  candidateDistortions(worker, pairMV, numPairs, x, y, predBlocks, regionSize, part, p, *minDist, 0, pairDist);
+
+  for (i = 0; i < numPairs; i++)
+  {
+    if (pairDist[i] < *minDist)
+    {
+      *minDist = pairDist[i];
+      for (k = 0; k < 3; k++)
+        mvBest[k] = pairMV[i][k];
+      fReplaced = 1;
+    }
+  }
+
+  return fReplaced;
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Reduces the candidate list of an MB or partition before it is
+ *      measured: a candidate within the clustering tolerance
+ *      (ercSetClusterTolerance()) of an earlier one with the same
+ *      reference, in both components, joins its cluster and is dropped.
+ *      The first candidate of a cluster, that of the highest priority,
+ *      represents it. Zero motion is kept, it is the copy of the MB.
+ *      The dropped candidates are counted in worker->prunedCandidates.
+ * \return
+ *      The number of candidates left, in their order
+ * \param candMV
+ *      the candidate MVs
+ * \param candMode
+ *      the region mode of each candidate
+ * \param numCand
+ *      the number of candidates
+ ************************************************************************
+ */
+static int clusterCandidates(ercWorker_t *worker, int32 candMV[][3], int candMode[], int numCand)
+{
+  int i, j, k, n = 0;
+
+  for (i = 0; i < numCand; i++)
+  {
+    if (candMV[i][0] != 0 || candMV[i][1] != 0 || candMV[i][2] != 0)
+    {
+      for (j = 0; j < n; j++)
+      {
+        if (candMV[j][2] == candMV[i][2] &&
+            mabs(candMV[j][0]-candMV[i][0]) <= clusterTolerance && mabs(candMV[j][1]-candMV[i][1]) <= clusterTolerance)
+          break;
+      }
+
+      if (j < n)
+      {
+        worker->prunedCandidates++;
+        continue;
+      }
+    }
+
+    for (k = 0; k < 3; k++)
+      candMV[n][k] = candMV[i][k];
+    candMode[n++] = candMode[i];
+  }
+
+  return n;
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Refines the MV chosen for an MB (concealByTrial()) or a partition
+ *      (concealByPartition()) with a small diamond search around it: in
+ *      integer pel steps as long as the distortion drops and the MV stays
+ *      within the range of ercSetRefineRange(), then one half and one
+ *      quarter pel step. The positions are scored with the boundary
+ *      matching of the strategy, each one takes one evaluation of
+ *      worker->refineLeft and the search stops when none is left.
+ * \return
+ *      1 if mvBest was replaced, 0 otherwise
+ * \param x
+ *      The x-coordinate of the above-left corner pixel of the region
+ * \param y
+ *      The y-coordinate of the above-left corner pixel of the region
+ * \param part
+ *      the partition, NULL for the whole region of concealByTrial()
+ * \param p
+ *      index of the partition in its ECMODE
+ * \param mvBest
+ *      the MV found by the candidate search, replaced by the refined one
+ * \param minDist
+ *      the distortion of mvBest
+ ************************************************************************
+ */
+static int refineMV(ercWorker_t *worker, int predBlocks[], int x, int y, int32 regionSize,
+                    const ecPartition_t *part, int p, int32 *mvBest, int minDist)
+{
+  static const int diamond[4][2] = { {0,-1}, {-1,0}, {1,0}, {0,1} };  //the opposite of direction i is 3-i
+  int32 center[3], mv[4][3], org[2];
+  int dist[4], posDir[4];
+  int step, i, n, from, dir, fOutOfBudget = 0, fRefined = 0;
+
+  org[0] = mvBest[0];
+  org[1] = mvBest[1];
+
+  for (step = 4; step > 0; step >>= 1)
+  {
+    from = -1;
+    do
+    {
+      for (i = 0; i < 3; i++)
+        center[i] = mvBest[i];
+      dir = -1;
+
+      /* the positions of the diamond that are within range and budget */
+      for (i = 0, n = 0; i < 4; i++)
+      {
+        /* the position the search came from is known to be worse */
+        if (i == 3-from)
+          continue;
+
+        mv[n][0] = center[0] + diamond[i][0]*step;
+        mv[n][1] = center[1] + diamond[i][1]*step;
+        mv[n][2] = center[2];
+        if (mabs(mv[n][0]-org[0]) > 4*refineRange || mabs(mv[n][1]-org[1]) > 4*refineRange)
+          continue;
+
+        if (worker->refineLeft <= 0)
+        {
+          fOutOfBudget = 1;
+          break;
+        }
+        worker->refineLeft--;
+        posDir[n++] = i;
+      }
+
+      candidateDistortions(worker, mv, n, x, y, predBlocks, regionSize, part, p, minDist, 0, dist);
+
+      for (i = 0; i < n; i++)
+      {
+        if (dist[i] < minDist)
+        {
+          minDist = dist[i];
+          mvBest[0] = mv[i][0];
+          mvBest[1] = mv[i][1];
+          dir = posDir[i];
+        }
+      }
+
+      if (dir >= 0)
+        fRefined = 1;
+      if (fOutOfBudget)
+        return fRefined;
+      from = dir;
+    } while (dir >= 0 && step == 4);
+  }
+
+  return fRefined;
+}
+
 /*!
 ************************************************************************
 * \brief
@@ -1038,8 +1822,10 @@ static int concealByTrial(frame *recfr, imgpel *predMB,
 *      of the reference frame. It not only copies the pixel values but builds the interpolation 
 *      when the pixel positions to be copied from is not full pixel (any 1/4 pixel position).
 *      It copies the resulting pixel vlaues into predMB.
-* \param img
-*      The pointer of img_par struture of current frame
+*      Only the luma is built here, which is all the boundary matching of
+*      a candidate MV needs; buildPredRegionChroma() adds the chroma.
+* \param worker
+*      the concealing worker, its img_par struture is that of the current frame
 * \param mv
 *      The pointer of the predicted MV of the current (being concealed) MB
 * \param x
@@ -1051,38 +1837,22 @@ static int concealByTrial(frame *recfr, imgpel *predMB,
 *      the Y,U,V planes are concatenated y = predMB, u = predMB+256, v = predMB+320
 ************************************************************************
 */
-static void buildPredRegionYUV(struct img_par *img, int32 *mv, int x, int y, imgpel *predMB)
+static void buildPredRegionLuma(ercWorker_t *worker, int32 *mv, int x, int y, imgpel *predMB)
 {
+  struct img_par *img = worker->img;
+  StorablePicture **list0 = worker->ctx->list0;
   int tmp_block[BLOCK_SIZE][BLOCK_SIZE];
-  int i=0,j=0,ii=0,jj=0,i1=0,j1=0,j4=0,i4=0;
-  int jf=0;
-  int uv;
+  int i=0,j=0,ii=0,jj=0,j4=0,i4=0;
   int vec1_x=0,vec1_y=0;
   int ioff,joff;
-  imgpel *pMB = predMB;
-  
-  int ii0,jj0,ii1,jj1,if1,jf1,if0,jf0;
   int mv_mul;
   
-  //FRExt
-  int f1_x, f1_y, f2_x, f2_y, f3, f4, ifx;
-  int b8, b4;
-  int yuv = dec_picture->chroma_format_idc - 1;
-  
   int ref_frame = max (mv[2], 0); // !!KS: quick fix, we sometimes seem to get negative ref_pic here, so restrict to zero an above
 
-  /* Update coordinates of the current concealed macroblock */
-  img->mb_x = x/MB_BLOCK_SIZE;
-  img->mb_y = y/MB_BLOCK_SIZE;
-  img->block_y = img->mb_y * BLOCK_SIZE;
-  img->pix_c_y = img->mb_y * img->mb_cr_size_y;
-  img->block_x = img->mb_x * BLOCK_SIZE;
-  img->pix_c_x = img->mb_x * img->mb_cr_size_x;
+  setConcealMBPosition(img, x, y);
 
   mv_mul=4;
 
-  // luma *******************************************************
-
   for(j=0;j<MB_BLOCK_SIZE/BLOCK_SIZE;j++)
   {
     joff=j*4;
@@ -1095,7 +1865,7 @@ static void buildPredRegionYUV(struct img_par *img, int32 *mv, int x, int y, img
       vec1_x = i4*4*mv_mul + mv[0];
       vec1_y = j4*4*mv_mul + mv[1];
 
-      get_block(ref_frame, listX[0], vec1_x,vec1_y,img,tmp_block);
+      getConcealBlock(ref_frame, list0, vec1_x,vec1_y,worker,tmp_block);
 
       for(ii=0;ii<BLOCK_SIZE;ii++)
         for(jj=0;jj<MB_BLOCK_SIZE/BLOCK_SIZE;jj++)
@@ -1107,73 +1877,119 @@ static void buildPredRegionYUV(struct img_par *img, int32 *mv, int x, int y, img
   {
     for (j = 0; j < 16; j++)
     {
-      pMB[i*16+j] = img->mpr[j][i];
+      predMB[i*16+j] = img->mpr[j][i];
     }
   }
-  pMB += 256;
+}
 
-  if (dec_picture->chroma_format_idc != YUV400)
-  {
-    // chroma *******************************************************
-    f1_x = 64/img->mb_cr_size_x;
-    f2_x=f1_x-1;
+/*!
+************************************************************************
+* \brief
+*      Updates the coordinates of the current concealed macroblock in img
+************************************************************************
+*/
+static void setConcealMBPosition(struct img_par *img, int x, int y)
+{
+  img->mb_x = x/MB_BLOCK_SIZE;
+  img->mb_y = y/MB_BLOCK_SIZE;
+  img->block_y = img->mb_y * BLOCK_SIZE;
+  img->pix_c_y = img->mb_y * img->mb_cr_size_y;
+  img->block_x = img->mb_x * BLOCK_SIZE;
+  img->pix_c_x = img->mb_x * img->mb_cr_size_x;
+}
 
-    f1_y = 64/img->mb_cr_size_y;
-    f2_y=f1_y-1;
+/*!
+************************************************************************
+* \brief
+*      Chroma part of the motion prediction of buildPredRegionLuma(),
+*      fills the U and V planes of predMB (predMB+256, predMB+320) with
+*      the bilinear interpolation
+************************************************************************
+*/
+static void buildPredRegionChroma(ercWorker_t *worker, int32 *mv, int x, int y, imgpel *predMB)
+{
+  struct img_par *img = worker->img;
+  StorablePicture *dec_picture = worker->ctx->dec_picture;
+  StorablePicture **list0 = worker->ctx->list0;
+  int i=0,j=0,ii=0,jj=0,i1=0,j1=0,j4=0,i4=0;
+  int jf=0;
+  int uv;
+  int ioff,joff;
+  imgpel *pMB = predMB + 256;
+  
+  int ii0,jj0,ii1,jj1,if1,jf1,if0,jf0;
+  
+  //FRExt
+  int f1_x, f1_y, f2_x, f2_y, f3, f4, ifx;
+  int b8, b4;
+  int yuv = dec_picture->chroma_format_idc - 1;
+  
+  int ref_frame = max (mv[2], 0);
 
-    f3=f1_x*f1_y;
-    f4=f3>>1;
+  if (dec_picture->chroma_format_idc == YUV400)
+    return;
+
+  setConcealMBPosition(img, x, y);
+
+  // chroma *******************************************************
+  f1_x = 64/img->mb_cr_size_x;
+  f2_x=f1_x-1;
+
+  f1_y = 64/img->mb_cr_size_y;
+  f2_y=f1_y-1;
+
+  f3=f1_x*f1_y;
+  f4=f3>>1;
 
-    for(uv=0;uv<2;uv++)
+  for(uv=0;uv<2;uv++)
+  {
+    for (b8=0;b8<(img->num_blk8x8_uv/2);b8++)
     {
-      for (b8=0;b8<(img->num_blk8x8_uv/2);b8++)
+      for(b4=0;b4<4;b4++)
       {
-        for(b4=0;b4<4;b4++)
-        {
-          joff = subblk_offset_y[yuv][b8][b4];
-          j4=img->pix_c_y+joff;
-          ioff = subblk_offset_x[yuv][b8][b4];
-          i4=img->pix_c_x+ioff;
+        joff = subblk_offset_y[yuv][b8][b4];
+        j4=img->pix_c_y+joff;
+        ioff = subblk_offset_x[yuv][b8][b4];
+        i4=img->pix_c_x+ioff;
 
-          for(jj=0;jj<4;jj++)
+        for(jj=0;jj<4;jj++)
+        {
+          jf=(j4+jj)/(img->mb_cr_size_y/4);     // jf  = Subblock_y-coordinate
+          for(ii=0;ii<4;ii++)
           {
-            jf=(j4+jj)/(img->mb_cr_size_y/4);     // jf  = Subblock_y-coordinate
-            for(ii=0;ii<4;ii++)
-            {
-              ifx=(i4+ii)/(img->mb_cr_size_x/4);  // ifx = Subblock_x-coordinate
+            ifx=(i4+ii)/(img->mb_cr_size_x/4);  // ifx = Subblock_x-coordinate
 
-              i1=(i4+ii)*f1_x + mv[0];
-              j1=(j4+jj)*f1_y + mv[1];
-            
-              ii0=max (0, min (i1/f1_x,   dec_picture->size_x_cr-1));
-              jj0=max (0, min (j1/f1_y,   dec_picture->size_y_cr-1));
-              ii1=max (0, min ((i1+f2_x)/f1_x, dec_picture->size_x_cr-1));
-              jj1=max (0, min ((j1+f2_y)/f1_y, dec_picture->size_y_cr-1));
-            
-              if1=(i1 & f2_x);
-              jf1=(j1 & f2_y);
-              if0=f1_x-if1;
-              jf0=f1_y-jf1;
-            
-              img->mpr[ii+ioff][jj+joff]=(if0*jf0*listX[0][ref_frame]->imgUV[uv][jj0][ii0]+
-                                          if1*jf0*listX[0][ref_frame]->imgUV[uv][jj0][ii1]+
-                                          if0*jf1*listX[0][ref_frame]->imgUV[uv][jj1][ii0]+
-                                          if1*jf1*listX[0][ref_frame]->imgUV[uv][jj1][ii1]+f4)/f3;
-            }
+            i1=(i4+ii)*f1_x + mv[0];
+            j1=(j4+jj)*f1_y + mv[1];
+          
+            ii0=max (0, min (i1/f1_x,   dec_picture->size_x_cr-1));
+            jj0=max (0, min (j1/f1_y,   dec_picture->size_y_cr-1));
+            ii1=max (0, min ((i1+f2_x)/f1_x, dec_picture->size_x_cr-1));
+            jj1=max (0, min ((j1+f2_y)/f1_y, dec_picture->size_y_cr-1));
+          
+            if1=(i1 & f2_x);
+            jf1=(j1 & f2_y);
+            if0=f1_x-if1;
+            jf0=f1_y-jf1;
+          
+            img->mpr[ii+ioff][jj+joff]=(if0*jf0*list0[ref_frame]->imgUV[uv][jj0][ii0]+
+                                        if1*jf0*list0[ref_frame]->imgUV[uv][jj0][ii1]+
+                                        if0*jf1*list0[ref_frame]->imgUV[uv][jj1][ii0]+
+                                        if1*jf1*list0[ref_frame]->imgUV[uv][jj1][ii1]+f4)/f3;
           }
         }
       }
+    }
 
-      for (i = 0; i < 8; i++)
+    for (i = 0; i < 8; i++)
+    {
+      for (j = 0; j < 8; j++)
       {
-        for (j = 0; j < 8; j++)
-        {
-          pMB[i*8+j] = img->mpr[j][i];
-        }
+        pMB[i*8+j] = img->mpr[j][i];
       }
-      pMB += 64;
-
     }
+    pMB += 64;
+
   }
 }
 /*!
@@ -1182,6 +1998,8 @@ static void buildPredRegionYUV(struct img_par *img, int32 *mv, int x, int y, img
  *      Copies pixel values between a YUV frame and the temporary pixel value storage place. This is
  *      used to save some pixel values temporarily before overwriting it, or to copy back to a given 
  *      location in a frame the saved pixel values.
+ * \param ctx
+ *      concealment context, its dec_picture receives the pixels
  * \param currYBlockNum   
  *      index of the block (8x8) in the Y plane
  * \param predMB          
@@ -1195,10 +2013,12 @@ static void buildPredRegionYUV(struct img_par *img, int32 *mv, int x, int y, img
  *      can be 16 or 8 to tell the dimension of the region to copy
  ************************************************************************
  */
-static void copyPredMB (int currYBlockNum, imgpel *predMB, frame *recfr, 
+static void copyPredMB (ercContext_t *ctx, int currYBlockNum, imgpel *predMB, frame *recfr, 
                         int32 picSizeX, int32 regionSize) 
 {
   
+  struct img_par *img = ctx->img;
+  StorablePicture *dec_picture = ctx->dec_picture;
   int j, k, xmin, ymin, xmax, ymax;
   int32 locationTmp, locationPred;
   int uv_x = uv_div[0][dec_picture->chroma_format_idc];
@@ -1282,216 +2102,106 @@ static void copyPredMB (int currYBlockNum, imgpel *predMB, frame *recfr,
  *      in predBlocks) only they are used in calculating the edge distorion; otherwise also the already
  *      concealed neighbor blocks can also be used.
  * \return 
- *      The calculated weighted pixel difference at the edges of the MB.
+ *      The calculated weighted pixel difference at the edges of the MB,
+ *      or a value of at least maxDist if the calculation was stopped.
  * \param predBlocks      
  *      status array of the neighboring blocks (if they are OK, concealed or lost)
- * \param currYBlockNum   
- *      index of the block (8x8) in the Y plane
  * \param predMB          
  *      memory area where the temporary pixel values are stored
  *      the Y,U,V planes are concatenated y = predMB, u = predMB+256, v = predMB+320
- * \param recY            
- *      pointer to a Y plane of a YUV frame
- * \param picSizeX        
- *      picture width in pixels
+ * \param nbRing
+ *      pixels of the neighbours, see loadNeighbourRing()
  * \param regionSize      
  *      can be 16 or 8 to tell the dimension of the region to copy
+ * \param maxDist
+ *      the distortion to beat, the remaining neighbours are skipped once
+ *      the result cannot get below it (INT_MAX measures all of them)
  ************************************************************************
  */
-static int edgeDistortion (int predBlocks[], int currYBlockNum, imgpel *predMB, 
-                           imgpel *recY, int32 picSizeX, int32 regionSize)
+static int edgeDistortion (int predBlocks[], imgpel *predMB, imgpel *nbRing, int32 regionSize, int maxDist)
 {
-  int i, j, distortion, numOfPredBlocks, threshold = ERC_BLOCK_OK;
-  imgpel *currBlock = NULL, *neighbor = NULL;
+  int j, distortion, numOfPredBlocks, limit, threshold;
   int32 currBlockOffset = 0;
   
-  currBlock = recY + (yPosYBlock(currYBlockNum,picSizeX)<<3)*picSizeX + (xPosYBlock(currYBlockNum,picSizeX)<<3);
-  
-  do 
+  numOfPredBlocks = usedNeighbours(predBlocks, 15, &threshold);
+  if(numOfPredBlocks == 0)
   {
+    return 0;
+    // assert (numOfPredBlocks != 0); !!!KS hmm, trying to continue...
+  }
+
+  /* stop as soon as the distortion per neighbour can no longer get below maxDist */
+  limit = (maxDist > INT_MAX/4) ? INT_MAX : maxDist*numOfPredBlocks;
+  distortion = 0;
     
-    distortion = 0; numOfPredBlocks = 0;
-    
-    /* loop the 4 neighbours */
-    for (j = 4; j < 8; j++) 
+  /* loop the 4 neighbours */
+  for (j = 4; j < 8 && distortion < limit; j++) 
+  {
+    /* if reliable, count boundary pixel difference */
+    if (predBlocks[j] >= threshold) 
     {
-      /* if reliable, count boundary pixel difference */
-      if (predBlocks[j] >= threshold) 
+      
+      switch (j) 
       {
-        
-        switch (j) 
-        {
-        case 4:
-          neighbor = currBlock - picSizeX;
-          for ( i = 0; i < regionSize; i++ ) 
-          {
-            distortion += mabs((int)(predMB[i] - neighbor[i]));
-          }
-          break;          
-        case 5:
-          neighbor = currBlock - 1;
-          for ( i = 0; i < regionSize; i++ ) 
-          {
-            distortion += mabs((int)(predMB[i*16] - neighbor[i*picSizeX]));
-          }
-          break;                
-        case 6:
-          neighbor = currBlock + regionSize*picSizeX;
-          currBlockOffset = (regionSize-1)*16;
-          for ( i = 0; i < regionSize; i++ ) 
-          {
-            distortion += mabs((int)(predMB[i+currBlockOffset] - neighbor[i]));
-          }
-          break;                
-        case 7:
-          neighbor = currBlock + regionSize;
-          currBlockOffset = regionSize-1;
-          for ( i = 0; i < regionSize; i++ ) 
-          {
-            distortion += mabs((int)(predMB[i*16+currBlockOffset] - neighbor[i*picSizeX]));
-          }
-          break;
-        }
-        
-        numOfPredBlocks++;
+      case 4:
+        distortion += sadRun(predMB, nbRing, regionSize);
+        break;          
+      case 5:
+        distortion += boundarySAD(predMB, 16, nbRing + 16, 1, regionSize);
+        break;                
+      case 6:
+        currBlockOffset = (regionSize-1)*16;
+        distortion += sadRun(predMB + currBlockOffset, nbRing + 32, regionSize);
+        break;                
+      case 7:
+        currBlockOffset = regionSize-1;
+        distortion += boundarySAD(predMB + currBlockOffset, 16, nbRing + 48, 1, regionSize);
+        break;
       }
     }
-    
-    threshold--;
-    if (threshold < ERC_BLOCK_CONCEALED)
-      break;
-  } while (numOfPredBlocks == 0);
-  
-  if(numOfPredBlocks == 0)
-  {
-    return 0;
-    // assert (numOfPredBlocks != 0); !!!KS hmm, trying to continue...
   }
+  
   return (distortion/numOfPredBlocks);
 }
 
-// picture error concealment below
-
 /*!
-************************************************************************
-* \brief
-* The motion prediction pixels are calculated from the given location (in 
-* 1/4 pixel units) of the referenced frame. It copies the sub block from the 
-* corresponding reference to the frame to be concealed.
-*
-*************************************************************************
-*/
-static void buildPredblockRegionYUV(struct img_par *img, int32 *mv, 
-                                    int x, int y, imgpel *predMB, int list)
+ ************************************************************************
+ * \brief
+ *      Selects the neighbours the boundary matching compares with: the
+ *      correctly received ones among the given sides or, if there is
+ *      none, the already concealed ones.
+ * \return
+ *      The number of selected neighbours, 0 if there is none.
+ * \param predBlocks
+ *      status array of the neighboring blocks (if they are OK, concealed or lost)
+ * \param sides
+ *      bit s set if the neighbour predBlocks[4+s] may be used
+ * \param threshold
+ *      set to the status the selected neighbours have at least
+ ************************************************************************
+ */
+static int usedNeighbours(int predBlocks[], int sides, int *threshold)
 {
-    int tmp_block[BLOCK_SIZE][BLOCK_SIZE];
-    int i=0,j=0,ii=0,jj=0,i1=0,j1=0,j4=0,i4=0;
-    int jf=0;
-    int uv;
-    int vec1_x=0,vec1_y=0;
-    int ioff,joff;
-    imgpel *pMB = predMB;
-
-    int ii0,jj0,ii1,jj1,if1,jf1,if0,jf0;
-    int mv_mul;
-
-    //FRExt
-    int f1_x, f1_y, f2_x, f2_y, f3, f4, ifx;
-    int yuv = dec_picture->chroma_format_idc - 1;
-
-    int ref_frame = mv[2];
+  int s, numOfPredBlocks;
 
-    /* Update coordinates of the current concealed macroblock */
-
-    img->mb_x = x/BLOCK_SIZE;
-    img->mb_y = y/BLOCK_SIZE;
-    img->block_y = img->mb_y * BLOCK_SIZE;
-    img->pix_c_y = img->mb_y * img->mb_cr_size_y/4;
-    img->block_x = img->mb_x * BLOCK_SIZE;
-    img->pix_c_x = img->mb_x * img->mb_cr_size_x/4;
-
-    mv_mul=4;
-
-    // luma *******************************************************
-
-    vec1_x = x*mv_mul + mv[0];
-    vec1_y = y*mv_mul + mv[1];
-
-    get_block(ref_frame, listX[list], vec1_x,vec1_y,img,tmp_block);
-
-    for(ii=0;ii<BLOCK_SIZE;ii++)
-        for(jj=0;jj<MB_BLOCK_SIZE/BLOCK_SIZE;jj++)
-            img->mpr[ii][jj]=tmp_block[ii][jj];
-
-
-    for (i = 0; i < 4; i++)
+  for (*threshold = ERC_BLOCK_OK; *threshold >= ERC_BLOCK_CONCEALED; (*threshold)--)
+  {
+    numOfPredBlocks = 0;
+    for (s = 0; s < 4; s++)
     {
-        for (j = 0; j < 4; j++)
-        {
-            pMB[i*4+j] = img->mpr[j][i];
-        }
+      if ((sides & (1<<s)) && predBlocks[4+s] >= *threshold)
+        numOfPredBlocks++;
     }
-    pMB += 16;
-
-    if (dec_picture->chroma_format_idc != YUV400)
-    {
-        // chroma *******************************************************
-        f1_x = 64/(img->mb_cr_size_x);
-        f2_x=f1_x-1;
 
-        f1_y = 64/(img->mb_cr_size_y);
-        f2_y=f1_y-1;
-
-        f3=f1_x*f1_y;
-        f4=f3>>1;
-
-        for(uv=0;uv<2;uv++)
-        {
-            joff = subblk_offset_y[yuv][0][0];
-            j4=img->pix_c_y+joff;
-            ioff = subblk_offset_x[yuv][0][0];
-            i4=img->pix_c_x+ioff;
-
-            for(jj=0;jj<2;jj++)
-            {
-                jf=(j4+jj)/(img->mb_cr_size_y/4);     // jf  = Subblock_y-coordinate
-                for(ii=0;ii<2;ii++)
-                {
-                    ifx=(i4+ii)/(img->mb_cr_size_x/4);  // ifx = Subblock_x-coordinate
-
-                    i1=(i4+ii)*f1_x + mv[0];
-                    j1=(j4+jj)*f1_y + mv[1];
-
-                    ii0=max (0, min (i1/f1_x,   dec_picture->size_x_cr-1));
-                    jj0=max (0, min (j1/f1_y,   dec_picture->size_y_cr-1));
-                    ii1=max (0, min ((i1+f2_x)/f1_x, dec_picture->size_x_cr-1));
-                    jj1=max (0, min ((j1+f2_y)/f1_y, dec_picture->size_y_cr-1));
-
-                    if1=(i1 & f2_x);
-                    jf1=(j1 & f2_y);
-                    if0=f1_x-if1;
-                    jf0=f1_y-jf1;
-
-                    img->mpr[ii][jj]=(if0*jf0*listX[list][ref_frame]->imgUV[uv][jj0][ii0]+
-                        if1*jf0*listX[list][ref_frame]->imgUV[uv][jj0][ii1]+
-                        if0*jf1*listX[list][ref_frame]->imgUV[uv][jj1][ii0]+
-                        if1*jf1*listX[list][ref_frame]->imgUV[uv][jj1][ii1]+f4)/f3;
-                }
-            }
-
-            for (i = 0; i < 2; i++)
-            {
-                for (j = 0; j < 2; j++)
-                {
-                    pMB[i*2+j] = img->mpr[j][i];
-                }
-            }
-            pMB += 4;
+    if (numOfPredBlocks > 0)
+      return numOfPredBlocks;
+  }
 
-        }
-    }
+  return 0;
 }
 
+// picture error concealment below
+
 /*!
 ************************************************************************
 * \brief
@@ -1564,26 +2274,25 @@ static int compare_pic_by_poc_desc( const void *arg1, const void *arg2 )
 /*!
 ************************************************************************
 * \brief
-*    Copy image data from one array to another array
+*    Copy image data from one array to another array, row by row.
+*    The chroma size is that of the pictures (0 for 4:0:0).
 ************************************************************************
 */
 
 static
 void CopyImgData(imgpel **inputY, imgpel ***inputUV, imgpel **outputY, 
-                 imgpel ***outputUV, int img_width, int img_height)
+                 imgpel ***outputUV, int img_width, int img_height, int img_width_cr, int img_height_cr)
 {
-    int x, y;
+    int y;
 
     for (y=0; y<img_height; y++)
-        for (x=0; x<img_width; x++)
-            outputY[y][x] = inputY[y][x];
+        memcpy(outputY[y], inputY[y], img_width*sizeof(imgpel));
 
-    for (y=0; y<img_height/2; y++)
-        for (x=0; x<img_width/2; x++)
-        {
-            outputUV[0][y][x] = inputUV[0][y][x];
-            outputUV[1][y][x] = inputUV[1][y][x];
-        }
+    for (y=0; y<img_height_cr; y++)
+    {
+        memcpy(outputUV[0][y], inputUV[0][y], img_width_cr*sizeof(imgpel));
+        memcpy(outputUV[1][y], inputUV[1][y], img_width_cr*sizeof(imgpel));
+    }
 }
 
 /*!
@@ -1615,25 +2324,321 @@ get_last_ref_pic_from_dpb()
     return NULL;
 }
 
+/*!
+ ************************************************************************
+ * \brief
+ *      H.264 quarter sample luma interpolation of a run of 4x4 blocks
+ *      with the same motion, BLOCK_SIZE rows of width samples, written
+ *      straight into a picture. Same arithmetic as interpolateBlock().
+ * \param refY
+ *      padded plane, rows contiguous
+ * \param x_pos, y_pos
+ *      full sample position of the run, every 4x4 block origin within
+ *      the guard band
+ * \param dx, dy
+ *      quarter sample phase
+ * \param maxValue
+ *      largest sample value
+ * \param width
+ *      width of the run, at most ERC_MAX_RUN
+ * \param out
+ *      destination picture rows
+ * \param ox, oy
+ *      position of the run in the destination
+ ************************************************************************
+ */
+static void interpolateRun(imgpel **refY, int x_pos, int y_pos, int dx, int dy, int maxValue, int width,
+                           imgpel **out, int ox, int oy)
+{
+  int i, j;
+  int result, stride;
+  int tmpV[ERC_MAX_RUN][BLOCK_SIZE+5];
+  int tmpH[BLOCK_SIZE][ERC_MAX_RUN+5];
+  imgpel *p, *o;
+
+  stride = (int) (refY[1] - refY[0]);
+
+  if (dx == 0 && dy == 0)
+  {  /* fullpel position */
+    for (j = 0; j < BLOCK_SIZE; j++)
+      memcpy(out[oy+j] + ox, refY[y_pos+j] + x_pos, width*sizeof(imgpel));
+  }
+  else if (dy == 0)
+  {  /* No vertical interpolation */
+    for (j = 0; j < BLOCK_SIZE; j++)
+    {
+      p = refY[y_pos+j] + x_pos;
+      o = out[oy+j] + ox;
+      for (i = 0; i < width; i++)
+      {
+        result = max(0, min(maxValue, (TAP6(p+i, 1)+16)/32));
+        if ((dx&1) == 1)
+          result = (result + p[i+dx/2] + 1)/2;
+        o[i] = (imgpel) result;
+      }
+    }
+  }
+  else if (dx == 0)
+  {  /* No horizontal interpolation */
+    for (j = 0; j < BLOCK_SIZE; j++)
+    {
+      p = refY[y_pos+j] + x_pos;
+      o = out[oy+j] + ox;
+      for (i = 0; i < width; i++)
+      {
+        result = max(0, min(maxValue, (TAP6(p+i, stride)+16)/32));
+        if ((dy&1) == 1)
+          result = (result + p[i+(dy/2)*stride] + 1)/2;
+        o[i] = (imgpel) result;
+      }
+    }
+  }
+  else if (dx == 2)
+  {  /* Vertical & horizontal interpolation */
+    for (j = -2; j < BLOCK_SIZE+3; j++)
+    {
+      p = refY[y_pos+j] + x_pos;
+      for (i = 0; i < width; i++)
+        tmpV[i][j+2] = TAP6(p+i, 1);
+    }
+
+    for (j = 0; j < BLOCK_SIZE; j++)
+    {
+      o = out[oy+j] + ox;
+      for (i = 0; i < width; i++)
+      {
+        result = max(0, min(maxValue, (TAP6(&tmpV[i][j+2], 1)+512)/1024));
+        if ((dy&1) == 1)
+          result = (result + max(0, min(maxValue, (tmpV[i][j+2+dy/2]+16)/32)) + 1)/2;
+        o[i] = (imgpel) result;
+      }
+    }
+  }
+  else if (dy == 2)
+  {  /* Horizontal & vertical interpolation */
+    for (j = 0; j < BLOCK_SIZE; j++)
+    {
+      p = refY[y_pos+j] + x_pos;
+      for (i = -2; i < width+3; i++)
+        tmpH[j][i+2] = TAP6(p+i, stride);
+    }
+
+    for (j = 0; j < BLOCK_SIZE; j++)
+    {
+      o = out[oy+j] + ox;
+      for (i = 0; i < width; i++)
+      {
+        result = max(0, min(maxValue, (TAP6(&tmpH[j][i+2], 1)+512)/1024));
+        if ((dx&1) == 1)
+          result = (result + max(0, min(maxValue, (tmpH[j][i+2+dx/2]+16)/32)) + 1)/2;
+        o[i] = (imgpel) result;
+      }
+    }
+  }
+  else
+  {  /* Diagonal interpolation */
+    for (j = 0; j < BLOCK_SIZE; j++)
+    {
+      p = refY[dy == 1 ? y_pos+j : y_pos+j+1] + x_pos;
+      o = out[oy+j] + ox;
+      for (i = 0; i < width; i++)
+        o[i] = (imgpel) max(0, min(maxValue, (TAP6(p+i, 1)+16)/32));
+    }
+
+    for (j = 0; j < BLOCK_SIZE; j++)
+    {
+      p = refY[y_pos+j] + (dx == 1 ? x_pos : x_pos+1);
+      o = out[oy+j] + ox;
+      for (i = 0; i < width; i++)
+        o[i] = (imgpel) ((o[i] + max(0, min(maxValue, (TAP6(p+i, stride)+16)/32)) + 1)/2);
+    }
+  }
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Predicts a run of 4x4 blocks with the same motion of a frame
+ *      concealed by motion copy, luma and chroma, straight into the
+ *      concealed picture. Same result as predicting the blocks one by
+ *      one from the clamped reference.
+ * \param worker
+ *      the concealing worker
+ * \param dst
+ *      concealed picture
+ * \param mv
+ *      motion of the run, mv[2] = reference index in list 0
+ * \param x, y
+ *      luma position of the run
+ * \param numBlocks
+ *      number of 4x4 blocks of the run
+ * \param fieldMB
+ *      1 if the MBs of the run are field MBs
+ ************************************************************************
+ */
+static void predictRunYUV(ercWorker_t *worker, StorablePicture *dst, int32 *mv, int x, int y, int numBlocks, int fieldMB)
+{
+  struct img_par *img = worker->img;
+  StorablePicture *dec_picture = worker->ctx->dec_picture;
+  int block[BLOCK_SIZE][BLOCK_SIZE];
+  int i, j, k, uv, ii, jj, i1, j1, i4, j4;
+  int dx, dy, x_pos, y_pos, maxold_x, maxold_y;
+  int ii0, jj0, ii1, jj1, if1, jf1, if0, jf0;
+  int f1_x, f1_y, f2_x, f2_y, f3, f4;
+  int yuv = dec_picture->chroma_format_idc - 1;
+  int ref_frame = mv[2];
+  StorablePicture *ref = worker->ctx->list0[ref_frame];
+
+  // luma *******************************************************
+  dx = (x*4 + mv[0])&3;
+  dy = (y*4 + mv[1])&3;
+  x_pos = (x*4 + mv[0] - dx)/4;
+  y_pos = (y*4 + mv[1] - dy)/4;
+
+  maxold_x = dec_picture->size_x-1;
+  maxold_y = fieldMB ? dec_picture->size_y/2 - 1 : dec_picture->size_y-1;
+
+  if ((ref != no_reference_picture || img->framepoc >= img->recovery_poc) &&
+      x_pos >= -(ERC_PAD-ERC_PAD_BACK) && x_pos + (numBlocks-1)*BLOCK_SIZE <= maxold_x+ERC_PAD_BACK &&
+      y_pos >= -(ERC_PAD-ERC_PAD_BACK) && y_pos <= maxold_y+ERC_PAD_BACK)
+  {
+    interpolateRun(getPaddedRef(worker->ctx->inter, ref, maxold_y+1)->imgY, x_pos, y_pos, dx, dy, img->max_imgpel_value,
+                   numBlocks*BLOCK_SIZE, dst->imgY, x, y);
+  }
+  else
+  {
+    // no reference, or a block beyond the guard band: one block at a time
+    for (k = 0; k < numBlocks; k++)
+    {
+      img->current_mb_nr = (y/MB_BLOCK_SIZE)*dst->PicWidthInMbs + (x+k*BLOCK_SIZE)/MB_BLOCK_SIZE;
+      getConcealBlock(ref_frame, worker->ctx->list0, (x+k*BLOCK_SIZE)*4 + mv[0], y*4 + mv[1], worker, block);
+
+      for (j = 0; j < BLOCK_SIZE; j++)
+        for (i = 0; i < BLOCK_SIZE; i++)
+          dst->imgY[y+j][x+k*BLOCK_SIZE+i] = (imgpel) block[i][j];
+    }
+  }
+
+  if (dec_picture->chroma_format_idc != YUV400)
+  {
+    // chroma *******************************************************
+    f1_x = 64/(img->mb_cr_size_x);
+    f2_x=f1_x-1;
+
+    f1_y = 64/(img->mb_cr_size_y);
+    f2_y=f1_y-1;
+
+    f3=f1_x*f1_y;
+    f4=f3>>1;
+
+    j4 = (y/BLOCK_SIZE) * img->mb_cr_size_y/4 + subblk_offset_y[yuv][0][0];
+
+    for (k = 0; k < numBlocks; k++)
+    {
+      i4 = (x/BLOCK_SIZE + k) * img->mb_cr_size_x/4 + subblk_offset_x[yuv][0][0];
+
+      for(uv=0;uv<2;uv++)
+      {
+        for(jj=0;jj<2;jj++)
+        {
+          for(ii=0;ii<2;ii++)
+          {
+            i1=(i4+ii)*f1_x + mv[0];
+            j1=(j4+jj)*f1_y + mv[1];
+
+            ii0=max (0, min (i1/f1_x,   dec_picture->size_x_cr-1));
+            jj0=max (0, min (j1/f1_y,   dec_picture->size_y_cr-1));
+            ii1=max (0, min ((i1+f2_x)/f1_x, dec_picture->size_x_cr-1));
+            jj1=max (0, min ((j1+f2_y)/f1_y, dec_picture->size_y_cr-1));
+
+            if1=(i1 & f2_x);
+            jf1=(j1 & f2_y);
+            if0=f1_x-if1;
+            jf0=f1_y-jf1;
+
+            dst->imgUV[uv][y/2+jj][x/2+k*2+ii] = (imgpel) ((if0*jf0*ref->imgUV[uv][jj0][ii0]+
+                                                            if1*jf0*ref->imgUV[uv][jj0][ii1]+
+                                                            if0*jf1*ref->imgUV[uv][jj1][ii0]+
+                                                            if1*jf1*ref->imgUV[uv][jj1][ii1]+f4)/f3);
+          }
+        }
+      }
+    }
+  }
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Conceals one MB row of a frame by motion copy, job of the worker
+ *      pool. The motion of the source picture is copied, and every 4x4
+ *      block row is split into runs of blocks with the same motion that
+ *      are predicted with one fetch.
+ * \param arg
+ *      the frame (ercMVCopyJob_t)
+ * \param band
+ *      MB row
+ * \param worker
+ *      worker number, selects the image parameters
+ ************************************************************************
+ */
+static void concealMVCopyBand(void *arg, int band, int worker)
+{
+  ercMVCopyJob_t *job = (ercMVCopyJob_t *) arg;
+  StorablePicture *src = job->src;
+  StorablePicture *dst = job->dst;
+  ercWorker_t *w = &job->ctx->inter->workers[worker];
+  int32 mv[3];
+  int i, j, n, numBlocksX, fieldMB;
+
+  numBlocksX = job->mb_width*4;
+
+  for (i = band*4; i < band*4+4; i++)
+  {
+    for (j = 0; j < numBlocksX; j++)
+    {
+      dst->mv[LIST_0][i][j][0] = src->mv[LIST_0][i][j][0] / job->scale;
+      dst->mv[LIST_0][i][j][1] = src->mv[LIST_0][i][j][1] / job->scale;
+      dst->ref_idx[LIST_0][i][j] = max(src->ref_idx[LIST_0][i][j], 0);
+    }
+
+    for (j = 0; j < numBlocksX; j += n)
+    {
+      mv[0] = dst->mv[LIST_0][i][j][0];
+      mv[1] = dst->mv[LIST_0][i][j][1];
+      mv[2] = dst->ref_idx[LIST_0][i][j];
+      fieldMB = src->mb_field[band*job->mb_width + j/4];
+
+      for (n = 1; j+n < numBlocksX && n < ERC_MAX_RUN/BLOCK_SIZE; n++)
+      {
+        if (dst->mv[LIST_0][i][j+n][0] != mv[0] || dst->mv[LIST_0][i][j+n][1] != mv[1] ||
+            dst->ref_idx[LIST_0][i][j+n] != mv[2] || src->mb_field[band*job->mb_width + (j+n)/4] != fieldMB)
+          break;
+      }
+
+      predictRunYUV(w, dst, mv, j*BLOCK_SIZE, i*BLOCK_SIZE, n, fieldMB);
+    }
+  }
+}
+
 /*!
 ************************************************************************
 * \brief
 * Conceals the lost reference or non reference frame by either frame copy 
-* or motion vector copy concealment. 
+* or motion vector copy concealment. The reference lists are built by the
+* decoded picture buffer (init_lists()) and taken over by the context.
 *
 ************************************************************************
 */
 
-static void copy_to_conceal(StorablePicture *src, StorablePicture *dst, ImageParameters *img)
+static void copy_to_conceal(ercContext_t *ctx, StorablePicture *src, StorablePicture *dst)
 {
+    ImageParameters *img = ctx->img;
     int i=0;
-    int mv[3];
-    int multiplier;
-    imgpel *predMB, *storeYUV;
-    int j, y, x, mb_height, mb_width, ii=0, jj=0;
-    int uv;
-    int mm, nn;
+    int mb_height, mb_width;
     int scale = 1;
+    int numWorkers, fieldMBs;
+    ercMVCopyJob_t job;
     // struct inp_par *test;
 
     img->current_mb_nr = 0;
@@ -1657,7 +2662,7 @@ static void copy_to_conceal(StorablePicture *src, StorablePicture *dst, ImagePar
     dst->qp = src->qp;
     dst->slice_qp_delta = src->slice_qp_delta;
 
-    dec_picture = src;
+    ctx->dec_picture = src;
 
     // Conceals the missing frame by frame copy concealment
     if (img->conceal_mode==1)
@@ -1669,23 +2674,14 @@ static void copy_to_conceal(StorablePicture *src, StorablePicture *dst, ImagePar
 
         CopyImgData(src->imgY, src->imgUV, 
             dst->imgY, dst->imgUV,
-            img->width, img->height);
+            img->width, img->height, img->width_cr, img->height_cr);
 
     }
 
     // Conceals the missing frame by motion vector copy concealment
     if (img->conceal_mode==2)
     {
-        if (dec_picture->chroma_format_idc != YUV400)
-        {
-            storeYUV = (imgpel *) malloc ( (16 + (img->mb_cr_size_x*img->mb_cr_size_y)*2/16) * sizeof (imgpel));
-        }
-        else
-        {
-            storeYUV = (imgpel *) malloc (16  * sizeof (imgpel));
-        }
-
-        erc_img = img;
+        resetPaddedRefs(getInterState(ctx));
 
         dst->PicWidthInMbs = src->PicWidthInMbs;
         dst->PicSizeInMbs = src->PicSizeInMbs;
@@ -1697,66 +2693,38 @@ static void copy_to_conceal(StorablePicture *src, StorablePicture *dst, ImagePar
             init_lists_for_non_reference_loss(dst->slice_type, img->currentSlice->structure);
         else
             init_lists(dst->slice_type, img->currentSlice->structure);
+        ctx->list0     = listX[0];
+        ctx->list0Size = listXsize[0];
 
-        multiplier = BLOCK_SIZE;
-
-        for(i=0;i<mb_height*4;i++)
-        {
-            mm = i*BLOCK_SIZE;
-            for(j=0;j<mb_width*4;j++)
-            {                       
-                nn = j*BLOCK_SIZE;
-
-                mv[0] = src->mv[LIST_0][i][j][0] / scale;
-                mv[1] = src->mv[LIST_0][i][j][1] / scale;
-                mv[2] = src->ref_idx[LIST_0][i][j];
-
-
-                if(mv[2]<0)
-                    mv[2]=0;
-
-                dst->mv[LIST_0][i][j][0] = mv[0];
-                dst->mv[LIST_0][i][j][1] = mv[1];
-                dst->ref_idx[LIST_0][i][j] = mv[2];
-
-                x = (j)*multiplier;
-                y = (i)*multiplier;
+        numWorkers = ercGetConcealThreads();
 
-                if ((mm%16==0) && (nn%16==0))
-                    img->current_mb_nr++;
+        // the padded references are built up front, the bands only read them
+        fieldMBs = 0;
+        for (i = 0; i < (int) dst->PicSizeInMbs; i++)
+            fieldMBs |= src->mb_field[i];
 
-                buildPredblockRegionYUV(erc_img, mv, x, y, storeYUV, LIST_0);
-
-                predMB = storeYUV;
-
-                for(ii=0;ii<multiplier;ii++)
-                {
-                    for(jj=0;jj<multiplier;jj++)
-                    {
-                        dst->imgY[i*multiplier+ii][j*multiplier+jj] = predMB[ii*(multiplier)+jj];
-                    }
-                }
+        if (ctx->list0Size * (fieldMBs ? 2 : 1) <= MAX_PADDED_REFS)
+        {
+            for (i = 0; i < ctx->list0Size; i++)
+            {
+                getPaddedRef(ctx->inter, ctx->list0[i], src->size_y);
+                if (fieldMBs)
+                    getPaddedRef(ctx->inter, ctx->list0[i], src->size_y/2);
+            }
+        }
+        else
+            numWorkers = 1;
 
-                predMB = predMB + (multiplier*multiplier);
+        initWorkerImages(ctx, numWorkers);
 
-                if (dec_picture->chroma_format_idc != YUV400)
-                {
+        job.ctx      = ctx;
+        job.src      = src;
+        job.dst      = dst;
+        job.scale    = scale;
+        job.mb_width = mb_width;
+        ercPoolRun(numWorkers, concealMVCopyBand, &job, mb_height);
 
-                    for(uv=0;uv<2;uv++)
-                    {
-                        for(ii=0;ii< (multiplier/2);ii++)
-                        {
-                            for(jj=0;jj< (multiplier/2);jj++)
-                            {
-                                dst->imgUV[uv][i*multiplier/2 +ii][j*multiplier/2 +jj] = predMB[ii*(multiplier/2)+jj];
-                            }
-                        }
-                        predMB = predMB + (multiplier*multiplier/4);
-                    }
-                }
-            }
-        }
-        free(storeYUV);
+        img->current_mb_nr = mb_height*mb_width;
     }
 }
 
@@ -1780,30 +2748,130 @@ copy_prev_pic_to_concealed_pic(StorablePicture *picture, ImageParameters *img)
 
     /* copy all the struc from this to current concealment pic */
     img->conceal_slice_type = P_SLICE;
-    copy_to_conceal(ref_pic, picture, img);
+    copy_to_conceal(ercDecoderContext(img), ref_pic, picture);
 }
 
 
 /*!
 ************************************************************************
 * \brief
-* This function conceals a missing reference frame. The routine is called
-* based on the difference in frame number. It conceals an IDR frame loss
-* based on the sudden decrease in frame number.
+* Returns a frame at the current picture size for a lost frame, taken
+* from the picture pool of the context or newly allocated. A pooled
+* picture gets the header of a new one and its motion is cleared as
+* alloc_storable_picture() returns it: a frame copy stores the picture
+* in the DPB with the motion untouched, where direct mode and the
+* concealment of later frames read it. The samples are left as they
+* are, copy_to_conceal() rewrites them.
 *
 ************************************************************************
 */
 
-void conceal_lost_frames(ImageParameters *img)
+static StorablePicture *getConcealPicture(ercContext_t *ctx)
 {
-    int CurrFrameNum;
-    int UnusedShortTermFrameNum;
-    StorablePicture *picture = NULL;
-    int tmp1 = img->delta_pic_order_cnt[0];
-    int tmp2 = img->delta_pic_order_cnt[1];
-    int i;
+    ImageParameters *img = ctx->img;
+    StorablePicture *picture;
 
-    img->delta_pic_order_cnt[0] = img->delta_pic_order_cnt[1] = 0;
+    while (ctx->picturePoolSize > 0)
+    {
+        picture = ctx->picturePool[--ctx->picturePoolSize];
+
+        if (picture->size_x == img->width && picture->size_y == img->height &&
+            picture->size_x_cr == img->width_cr && picture->size_y_cr == img->height_cr)
+        {
+            picture->structure = FRAME;
+            picture->pic_num = picture->frame_num = 0;
+            picture->long_term_frame_idx = picture->long_term_pic_num = 0;
+            picture->is_long_term = 0;
+            picture->used_for_reference = 0;
+            picture->non_existing = 0;
+            picture->is_output = 0;
+            picture->max_slice_id = 0;
+            picture->coded_frame = 0;
+            picture->MbaffFrameFlag = 0;
+            picture->concealed_pic = 0;
+            picture->idr_flag = 0;
+            picture->slice_type = 0;
+            picture->top_field = picture->bottom_field = picture->frame = no_reference_picture;
+            picture->dec_ref_pic_marking_buffer = NULL;
+            clearConcealMotion(picture);
+            return picture;
+        }
+
+        // the picture size has changed
+        free_storable_picture(picture);
+    }
+
+    return alloc_storable_picture (FRAME, img->width, img->height, img->width_cr, img->height_cr);
+}
+
+/*!
+************************************************************************
+* \brief
+* Clears the motion of a pooled picture: the MVs, reference indices and
+* reference picture ids of both lists and the field flags of its MBs.
+*
+************************************************************************
+*/
+
+static void clearConcealMotion(StorablePicture *picture)
+{
+    int columns = picture->size_x/BLOCK_SIZE;
+    int list, j;
+
+    // one block row at a time, the rows are not known to be contiguous
+    for (list = LIST_0; list <= LIST_1; list++)
+    {
+        for (j = 0; j < picture->size_y/BLOCK_SIZE; j++)
+        {
+            memset(picture->mv[list][j][0], 0, columns*2*sizeof(short));
+            memset(picture->ref_idx[list][j], 0, columns*sizeof(char));
+            memset(picture->ref_pic_id[list][j], 0, columns*sizeof(int64));
+            memset(picture->ref_id[list][j], 0, columns*sizeof(int64));
+        }
+    }
+    memset(picture->mb_field, 0, (picture->size_y/MB_BLOCK_SIZE)*(picture->size_x/MB_BLOCK_SIZE)*sizeof(byte));
+}
+
+/*!
+************************************************************************
+* \brief
+* Gives a picture of a lost frame that is no longer used back to the
+* picture pool of the context, or frees it if the pool is full.
+*
+************************************************************************
+*/
+
+static void releaseConcealPicture(ercContext_t *ctx, StorablePicture *picture)
+{
+    if (picture == NULL)
+        return;
+
+    if (ctx->picturePoolSize < ERC_PICTURE_POOL_SIZE)
+        ctx->picturePool[ctx->picturePoolSize++] = picture;
+    else
+        free_storable_picture(picture);
+}
+
+/*!
+************************************************************************
+* \brief
+* This function conceals a missing reference frame. The routine is called
+* based on the difference in frame number. It conceals an IDR frame loss
+* based on the sudden decrease in frame number.
+*
+************************************************************************
+*/
+
+void conceal_lost_frames(ImageParameters *img)
+{
+    int CurrFrameNum;
+    int UnusedShortTermFrameNum;
+    StorablePicture *picture = NULL;
+    int tmp1 = img->delta_pic_order_cnt[0];
+    int tmp2 = img->delta_pic_order_cnt[1];
+    int i;
+
+    img->delta_pic_order_cnt[0] = img->delta_pic_order_cnt[1] = 0;
 
     // printf("A gap in frame number is found, try to fill it.\n");
 
@@ -1822,7 +2890,7 @@ void conceal_lost_frames(ImageParameters *img)
 
     while (CurrFrameNum != UnusedShortTermFrameNum)
     {
-        picture = alloc_storable_picture (FRAME, img->width, img->height, img->width_cr, img->height_cr);
+        picture = getConcealPicture(ercDecoderContext(img));
 
         picture->coded_frame = 1;
         picture->pic_num = UnusedShortTermFrameNum;
@@ -2034,26 +3102,87 @@ void init_lists_for_non_reference_loss(int currSliceType, PictureStructure currP
 }
 
 
+/*!
+************************************************************************
+* \brief
+* Hash entry of a POC in the POC index. POCs mostly step by two, so
+* consecutive frames get consecutive entries.
+*
+************************************************************************
+*/
+
+#define POC_HASH(poc)  ((int) (((unsigned int) (poc) >> 1) % ERC_POC_INDEX_SIZE))
+
+/*!
+************************************************************************
+* \brief
+* Builds the POC index of all dpb.size frame stores. A POC found in
+* several frame stores keeps the last one, as the search from the end
+* in get_pic_from_dpb(). The index is left invalid for a DPB too large
+* for it and get_pic_from_dpb() falls back to the search.
+*
+************************************************************************
+*/
+
+static void build_poc_index(ercPocIndex_t *index)
+{
+    unsigned int i;
+    int h;
+
+    index->valid = 0;
+    if (2*dpb.size > ERC_POC_INDEX_SIZE)
+        return;
+
+    for (h = 0; h < ERC_POC_INDEX_SIZE; h++)
+        index->frameStore[h] = -1;
+
+    for (i = 0; i < dpb.size; i++)
+    {
+        h = POC_HASH(dpb.fs[i]->poc);
+        while (index->frameStore[h] >= 0 && index->poc[h] != dpb.fs[i]->poc)
+            h = (h + 1) % ERC_POC_INDEX_SIZE;
+        index->poc[h] = dpb.fs[i]->poc;
+        index->frameStore[h] = i;
+    }
+    index->valid = 1;
+}
+
 /*!
 ************************************************************************
 * \brief
 * Get from the dpb the picture corresponding to a POC.  The POC varies 
 * depending on whether it is a frame copy or motion vector copy concealment. 
-* The frame corresponding to the POC is returned.
+* The frame corresponding to the POC is returned. While the POC index is
+* valid (inside conceal_non_ref_pics(), where dpb.used_size is dpb.size)
+* the frame store is looked up there instead of searched.
 *
 ************************************************************************
 */
 
 StorablePicture *get_pic_from_dpb(int missingpoc, unsigned int *pos)
 {
+    ercPocIndex_t *index = &decoderContext.pocIndex;
     int used_size = dpb.used_size - 1;
-    int i, concealfrom = 0;
+    int i, h, concealfrom = 0;
 
     if(img->conceal_mode == 1)
         concealfrom = missingpoc - img->poc_gap;
     else if (img->conceal_mode == 2)
         concealfrom = missingpoc + img->poc_gap;
 
+    if (index->valid)
+    {
+        for (h = POC_HASH(concealfrom); index->frameStore[h] >= 0; h = (h + 1) % ERC_POC_INDEX_SIZE)
+        {
+            if (index->poc[h] == concealfrom)
+            {
+                *pos = index->frameStore[h];
+                return dpb.fs[*pos]->frame;
+            }
+        }
+        return NULL;
+    }
+
     for(i = used_size; i >= 0; i--)
     {
         if(dpb.fs[i]->poc == concealfrom)
@@ -2083,132 +3212,80 @@ int comp(const void *i, const void *j)
 /*!
 ************************************************************************
 * \brief
-* Initialises a node, allocates memory for the node, and returns
-* a pointer to the new node.
-*
-************************************************************************
-*/
-
-struct concealment_node * init_node( StorablePicture* picture, int missingpoc )
-{
-    struct concealment_node *ptr;
-
-    ptr = (struct concealment_node *) calloc( 1, sizeof(struct concealment_node ) );
-
-    if( ptr == NULL )
-        return (struct concealment_node *) NULL;
-    else {
-        ptr->picture = picture;
-        ptr->missingpocs = missingpoc;
-        ptr->next = NULL;
-        return ptr;
-    }
-}
-
-/*!
-************************************************************************
-* \brief
-* Prints the details of a node
+* Sorts the POCs of the dpb in ascending order, like qsort() with comp().
+* Between two calls the POCs only move up by the sliding window and get
+* one new POC appended, so the array is already sorted but for a few
+* entries and the insertion sort takes linear time.
 *
 ************************************************************************
 */
 
-void print_node( struct concealment_node *ptr )
+static void sort_pocs(int *pocs, int size)
 {
-    printf("Missing POC=%d\n", ptr->missingpocs );
-}
-
+    int i, j, poc;
 
-/*!
-************************************************************************
-* \brief
-* Prints all nodes from the current address passed to it.
-*
-************************************************************************
-*/
-
-void print_list( struct concealment_node *ptr )
-{
-    while( ptr != NULL )
+    for (i = 1; i < size; i++)
     {
-        print_node( ptr );
-        ptr = ptr->next;
+        poc = pocs[i];
+        for (j = i; j > 0 && pocs[j-1] > poc; j--)
+            pocs[j] = pocs[j-1];
+        pocs[j] = poc;
     }
 }
 
 /*!
 ************************************************************************
 * \brief
-* Adds a node to the end of the list.
+* Appends a lost picture to the ring of the pictures waiting for output.
+* The ring doubles when full, which only happens for the first few losses.
 *
 ************************************************************************
 */
 
-
-void add_node( struct concealment_node *concealment_new )
+static void push_lost_picture(ercLostRing_t *ring, StorablePicture *picture, int poc)
 {
-    if( concealment_head == NULL )
+    ercLostPicture_t *entry;
+    int i, size;
+
+    if (ring->count == ring->size)
     {
-        concealment_end = concealment_head = concealment_new;
-        return;
+        size = ring->size ? 2*ring->size : 8;
+        if ((entry = (ercLostPicture_t *) malloc(size*sizeof(ercLostPicture_t))) == NULL)
+            no_mem_exit("push_lost_picture: entry");
+        for (i = 0; i < ring->count; i++)
+            entry[i] = ring->entry[(ring->head + i) % ring->size];
+        free(ring->entry);
+        ring->entry = entry;
+        ring->size = size;
+        ring->head = 0;
     }
-    concealment_end->next = concealment_new;
-    concealment_end = concealment_new;
-}
-
-
-/*!
-************************************************************************
-* \brief
-* Deletes the specified node pointed to by 'ptr' from the list
-*
-************************************************************************
-*/
 
-
-void delete_node( struct concealment_node *ptr )
-{
-    // We only need to delete the first node in the linked list
-    if( ptr == concealment_head ) {
-        concealment_head = concealment_head->next;
-        if( concealment_end == ptr )
-            concealment_end = concealment_end->next;
-        free(ptr);
-    }
+    entry = &ring->entry[(ring->head + ring->count) % ring->size];
+    entry->picture = picture;
+    entry->poc = poc;
+    ring->count++;
 }
 
 /*!
 ************************************************************************
 * \brief
-* Deletes all nodes from the place specified by ptr
+* Removes the lost picture of the lowest POC from the ring and returns it,
+* NULL for an empty ring.
 *
 ************************************************************************
 */
 
-void delete_list( struct concealment_node *ptr )
+static StorablePicture *pop_lost_picture(ercLostRing_t *ring)
 {
-    struct concealment_node *temp;
-
-    if( concealment_head == NULL ) return;
+    StorablePicture *picture;
 
-    if( ptr == concealment_head ) {
-        concealment_head = NULL;
-        concealment_end = NULL;
-    }
-    else 
-    {
-        temp = concealment_head;
-
-        while( temp->next != ptr )
-            temp = temp->next;
-        concealment_end = temp;
-    }
+    if (ring->count == 0)
+        return NULL;
 
-    while( ptr != NULL ) {
-        temp = ptr->next;
-        free( ptr );
-        ptr = temp;
-    }
+    picture = ring->entry[ring->head].picture;
+    ring->head = (ring->head + 1) % ring->size;
+    ring->count--;
+    return picture;
 }
 
 /*!
@@ -2216,8 +3293,8 @@ void delete_list( struct concealment_node *ptr )
 * \brief
 * Stores the missing non reference frames in the concealment buffer. The
 * detection is based on the POC difference in the sorted POC array. A missing 
-* non reference frame is detected when the dpb is full. A singly linked list 
-* is maintained for storing the missing non reference frames. 
+* non reference frame is detected when the dpb is full. The missing non
+* reference frames wait for output in a ring, lowest POC first.
 *
 ************************************************************************
 */
@@ -2228,27 +3305,27 @@ void conceal_non_ref_pics(int diff)
     unsigned int i, pos;
     StorablePicture *conceal_from_picture = NULL;
     StorablePicture *conceal_to_picture = NULL;
-    struct concealment_node *concealment_ptr = NULL;
     int temp_used_size = dpb.used_size;
 
     if(dpb.used_size == 0 )
         return;
 
-    qsort(pocs_in_dpb, dpb.size, sizeof(int), comp);
+    sort_pocs(pocs_in_dpb, dpb.size);
+    build_poc_index(&decoderContext.pocIndex);
 
     for(i=0;i<dpb.size-diff;i++)
     {
         dpb.used_size = dpb.size;
         if((pocs_in_dpb[i+1]-pocs_in_dpb[i])>img->poc_gap)
         {
-            conceal_to_picture = alloc_storable_picture (FRAME, img->width, img->height, img->width_cr, img->height_cr);
-
             missingpoc = pocs_in_dpb[i] + img->poc_gap;
             // Diagnostics
             // printf("\n missingpoc = %d\n",missingpoc);
 
             if(missingpoc > img->earlier_missing_poc)
             {
+                conceal_to_picture = getConcealPicture(ercDecoderContext(img));
+
                 img->earlier_missing_poc = missingpoc;
                 conceal_to_picture->top_poc= missingpoc;
                 conceal_to_picture->bottom_poc=missingpoc;
@@ -2264,15 +3341,17 @@ void conceal_non_ref_pics(int diff)
 
                 update_ref_list_for_concealment();
                 img->conceal_slice_type = B_SLICE;
-                copy_to_conceal(conceal_from_picture, conceal_to_picture, img);
-                concealment_ptr = init_node( conceal_to_picture, missingpoc );
-                add_node(concealment_ptr);
+                copy_to_conceal(ercDecoderContext(img), conceal_from_picture, conceal_to_picture);
+                push_lost_picture(&decoderContext.lostPictures, conceal_to_picture, missingpoc);
                 // Diagnostics
-                // print_node(concealment_ptr);
+                // printf("Missing POC=%d\n", missingpoc);
             }
         }
     }
 
+    // the frame stores change with the next picture stored in the dpb
+    decoderContext.pocIndex.valid = 0;
+
     //restore the original value
     //dpb.used_size = dpb.size;
     dpb.used_size = temp_used_size;
@@ -2289,13 +3368,8 @@ void conceal_non_ref_pics(int diff)
 
 void sliding_window_poc_management(StorablePicture *p)
 {
-    unsigned int i;
-
-    if (dpb.used_size == dpb.size)
-    {
-        for(i=0;i<dpb.size-1; i++)
-            pocs_in_dpb[i] = pocs_in_dpb[i+1];
-    }
+    if (dpb.used_size == dpb.size && dpb.size > 0)
+        memmove(pocs_in_dpb, pocs_in_dpb+1, (dpb.size-1)*sizeof(int));
 
 //    pocs_in_dpb[dpb.used_size-1] = p->poc;
 }
@@ -2306,8 +3380,8 @@ void sliding_window_poc_management(StorablePicture *p)
 * \brief
 * Outputs the non reference frames. The POCs in the concealment buffer are
 * sorted in ascending order and outputted when the lowest POC in the 
-* concealment buffer is lower than the lowest in the dpb. The linked list 
-* entry corresponding to the outputted POC is immediately deleted.
+* concealment buffer is lower than the lowest in the dpb. The outputted
+* picture is immediately removed from the ring and released.
 *
 ************************************************************************
 */
@@ -2317,16 +3391,16 @@ void write_lost_non_ref_pic(int poc, int p_out)
     FrameStore concealment_fs;
     if(poc > 0)
     {
-        if((poc - dpb.last_output_poc) > img->poc_gap)
+        if((poc - dpb.last_output_poc) > img->poc_gap && decoderContext.lostPictures.count > 0)
         {
 
-            concealment_fs.frame = concealment_head->picture;
+            concealment_fs.frame = pop_lost_picture(&decoderContext.lostPictures);
             concealment_fs.is_output = 0;
             concealment_fs.is_reference = 0;
             concealment_fs.is_used = 3;
 
             write_stored_frame(&concealment_fs, p_out);
-            delete_node(concealment_head);
+            releaseConcealPicture(&decoderContext, concealment_fs.frame);
         }
     }
 }
@@ -2346,8 +3420,7 @@ void write_lost_ref_after_idr(int pos)
 
     if(last_out_fs->frame == NULL)
     {
-        last_out_fs->frame = alloc_storable_picture (FRAME, img->width, img->height, 
-            img->width_cr, img->height_cr);
+        last_out_fs->frame = getConcealPicture(ercDecoderContext(img));
         last_out_fs->is_used = 3;                        
     }
 
@@ -2356,175 +3429,715 @@ void write_lost_ref_after_idr(int pos)
         temp = 2;
         img->conceal_mode = 1;
     }
-    copy_to_conceal(dpb.fs[pos]->frame, last_out_fs->frame, img);
+    copy_to_conceal(ercDecoderContext(img), dpb.fs[pos]->frame, last_out_fs->frame);
 
     img->conceal_mode = temp;
 }
 
 
-//Santosh
-//************************************************************************************************************************
+/*!
+ ************************************************************************
+ * \brief
+ *      Empties the candidate MV cache. Called once for every MB to be
+ *      concealed, since the cached predictions are only valid for the
+ *      MB position (and reference lists) they were built for.
+ ************************************************************************
+ */
+static void resetMVCandCache(ercWorker_t *worker)
+{
+  worker->mvCandCache.numCand  = 0;
+  worker->mvCandCache.nextSlot = 0;
+}
 
-static void buildOuterPredRegionYUV(struct img_par *img, int32 *mv, int x, int y, imgpel *predMB, imgpel *boundary)
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the cache entry of the given candidate MV for the current
+ *      MB, building the OBMA boundary or the luma or chroma prediction if
+ *      the entry does not hold it yet.
+ * \param worker
+ *      the concealing worker, owner of the cache
+ * \param mv
+ *      The candidate MV (mv[2] = reference index in list 0, an index
+ *      outside the list selects the first reference)
+ * \param x
+ *      The x-coordinate of the above-left corner pixel of the current MB
+ * \param y
+ *      The y-coordinate of the above-left corner pixel of the current MB
+ * \param need
+ *      CAND_RING for the outer boundary ring (OBMA scoring), CAND_LUMA
+ *      for the luma prediction (boundary matching), CAND_YUV for the
+ *      full prediction (concealment)
+ ************************************************************************
+ */
+static ercMVCandidate_t *getMVCandidate(ercWorker_t *worker, int32 *mv, int x, int y, int need)
 {
-  int tmp_block[BLOCK_SIZE][BLOCK_SIZE];
-  int i=0,j=0,ii=0,jj=0,i1=0,j1=0,j4=0,i4=0;
-  int jf=0;
-  int uv;
-  int vec1_x=0,vec1_y=0;
-  int ioff,joff;
-  imgpel *pMB = predMB;
-  
-  int ii0,jj0,ii1,jj1,if1,jf1,if0,jf0;
-  int mv_mul;
+  ercMVCandCache_t *cache = &worker->mvCandCache;
+  ercMVCandidate_t *cand = NULL;
+  int32 key[3];
+  int i;
+
+  key[0] = mv[0];
+  key[1] = mv[1];
+  key[2] = max (mv[2], 0);
+  if (key[2] >= worker->ctx->list0Size)
+    key[2] = 0;
+
+  for (i = 0; i < cache->numCand; i++)
+  {
+    if (cache->cand[i].mv[0] == key[0] && cache->cand[i].mv[1] == key[1] && cache->cand[i].mv[2] == key[2])
+    {
+      cand = &cache->cand[i];
+      break;
+    }
+  }
 
-  int above[4], left[4], below[4], right[4], index;
-  
-  //FRExt
-  int f1_x, f1_y, f2_x, f2_y, f3, f4, ifx;
-  int b8, b4;
-  int yuv = dec_picture->chroma_format_idc - 1;
-  
-  int ref_frame = max (mv[2], 0); // !!KS: quick fix, we sometimes seem to get negative ref_pic here, so restrict to zero an above
+  if (cand == NULL)
+  {
+    if (cache->numCand < MAX_MV_CANDIDATES)
+    {
+      cand = &cache->cand[cache->numCand++];
+    }
+    else
+    {
+      cand = &cache->cand[cache->nextSlot];
+      cache->nextSlot = (cache->nextSlot + 1) % MAX_MV_CANDIDATES;
+    }
 
-  /* Update coordinates of the current concealed macroblock */
-  img->mb_x = x/MB_BLOCK_SIZE;
-  img->mb_y = y/MB_BLOCK_SIZE;
-  img->block_y = img->mb_y * BLOCK_SIZE;
-  img->pix_c_y = img->mb_y * img->mb_cr_size_y;
-  img->block_x = img->mb_x * BLOCK_SIZE;
-  img->pix_c_x = img->mb_x * img->mb_cr_size_x;
+    for (i = 0; i < 3; i++)
+      cand->mv[i] = key[i];
+    for (i = 0; i < MAX_MV_PARTITIONS; i++)
+      cand->dist[i] = cand->bound[i] = -1;
+    cand->hasLuma = 0;
+    cand->hasChroma = 0;
+    cand->hasBoundary = 0;
+  }
 
-  mv_mul=4;
+  if (need == CAND_RING && !cand->hasBoundary)
+  {
+    buildOuterBoundary(worker, key, x, y, cand->ring);
+    cand->hasBoundary = 1;
+  }
+  if (need != CAND_RING && !cand->hasLuma)
+  {
+    buildPredRegionLuma(worker, key, x, y, cand->pred);
+    cand->hasLuma = 1;
+  }
+  if (need == CAND_YUV && !cand->hasChroma)
+  {
+    buildPredRegionChroma(worker, key, x, y, cand->pred);
+    cand->hasChroma = 1;
+  }
 
-  // luma *******************************************************
+  return cand;
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Copies one rectangular partition of a full MB prediction into a
+ *      compact buffer: luma width*height, followed by the two chroma
+ *      partitions of (width/2)*(height/2) samples each.
+ * \param ctx
+ *      concealment context
+ * \param predMB
+ *      full MB prediction, y = predMB, u = predMB+256, v = predMB+320
+ * \param partMB
+ *      destination of the partition
+ * \param x0, y0
+ *      luma position of the partition inside the MB
+ * \param width, height
+ *      luma size of the partition
+ ************************************************************************
+ */
+static void extractPredPartition(ercContext_t *ctx, imgpel *predMB, imgpel *partMB, int x0, int y0, int width, int height)
+{
+  int j, uv;
+  imgpel *pMB = partMB;
 
-  for(i=0;i<4;i++)
+  for (j = y0; j < y0 + height; j++)
   {
-	  above[i]=0;left[i]=0;below[i]=0;right[i]=0;
+    memcpy(pMB, predMB + j*16 + x0, width * sizeof(imgpel));
+    pMB += width;
   }
 
-  for(j=0;j<MB_BLOCK_SIZE/BLOCK_SIZE;j++)
+  if (ctx->dec_picture->chroma_format_idc != YUV400)
   {
-    joff=j*4;
-    j4=img->block_y+j;
-    for(i=0;i<MB_BLOCK_SIZE/BLOCK_SIZE;i++)
+    for (uv = 0; uv < 2; uv++)
     {
-      ioff=i*4;
-      i4=img->block_x+i;
+      for (j = (y0>>1); j < ((y0 + height)>>1); j++)
+      {
+        memcpy(pMB, predMB + 256 + uv*64 + j*8 + (x0>>1), (width>>1) * sizeof(imgpel));
+        pMB += (width>>1);
+      }
+    }
+  }
+}
 
-      vec1_x = i4*4*mv_mul + mv[0];
-      vec1_y = j4*4*mv_mul + mv[1];
+/*!
+ ************************************************************************
+ * \brief
+ *      Forgets the padded reference planes of a context and their sub-pel
+ *      tiles. Must be called before a frame is concealed, since the
+ *      decoded picture buffer may have changed since the last one. The
+ *      allocations are kept for reuse, unless the sub-pel cache has been
+ *      made smaller than what the phase planes take.
+ ************************************************************************
+ */
+static void resetPaddedRefs(struct erc_inter_state *state)
+{
+  int i;
 
-      get_block(ref_frame, listX[0], vec1_x,vec1_y,img,tmp_block);
+  for (i = 0; i < MAX_PADDED_REFS; i++)
+  {
+    if (state->subPelCacheUsed > subPelCacheLimit)
+      freeSubPelPlanes(state, &state->paddedRef[i]);
+    state->paddedRef[i].pic = NULL;
+  }
+  state->paddedRefNext = 0;
+}
 
-	  index = i+4*j;
-	  get_boundary(ref_frame, listX[0], vec1_x, vec1_y, img, index, above, left, below, right);
-	  
-	  if(j==0)
-	  {
-		  boundary[4*i+0]=above[0];boundary[4*i+1]=above[1];boundary[4*i+2]=above[2];boundary[4*i+3]=above[3];
-	  }
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the padded luma plane of a reference picture, building
+ *      it on first use.
+ * \return
+ *      The padded plane, imgY[y][x] is valid for
+ *      -ERC_PAD <= x < size_x+ERC_PAD and -ERC_PAD <= y < size_y+ERC_PAD
+ * \param state
+ *      inter concealment state of the context
+ * \param pic
+ *      reference picture
+ * \param size_y
+ *      number of rows taken from pic, the rows below are replicated
+ *      (half the picture height for field MBs)
+ ************************************************************************
+ */
+static ercPaddedPlane_t *getPaddedRef(struct erc_inter_state *state, StorablePicture *pic, int size_y)
+{
+  ercPaddedPlane_t *plane;
+  int i, j, stride, rows, tilesX, tilesY;
+  imgpel *line;
 
-	  if(i==0)
-	  {
-		  boundary[16+4*j+0]=left[0];boundary[16+4*j+1]=left[1];boundary[16+4*j+2]=left[2];boundary[16+4*j+3]=left[3];
-	  }
+  for (i = 0; i < MAX_PADDED_REFS; i++)
+  {
+    if (state->paddedRef[i].pic == pic && state->paddedRef[i].size_y == size_y)
+      return &state->paddedRef[i];
+  }
 
-	  if(j==3) //MB_BLOCK_SIZE/BLOCK_SIZE - 1 = 3
-	  {
-		  boundary[32+4*i+0]=below[0];boundary[32+4*i+1]=below[1];boundary[32+4*i+2]=below[2];boundary[32+4*i+3]=below[3];
-	  }
+  plane = &state->paddedRef[state->paddedRefNext];
+  state->paddedRefNext = (state->paddedRefNext + 1) % MAX_PADDED_REFS;
 
-	  if(i==3)
-	  {
-		  boundary[48+4*j+0]=right[0];boundary[48+4*j+1]=right[1];boundary[48+4*j+2]=right[2];boundary[48+4*j+3]=right[3];
-	  }
+  stride = pic->size_x + 2*ERC_PAD;
+  rows   = size_y + 2*ERC_PAD;
 
-      for(ii=0;ii<BLOCK_SIZE;ii++)
-        for(jj=0;jj<MB_BLOCK_SIZE/BLOCK_SIZE;jj++)
-          img->mpr[ii+ioff][jj+joff]=tmp_block[ii][jj];
-    }
+  if (plane->bufSize < stride*rows)
+  {
+    free(plane->buf);
+    if ((plane->buf = (imgpel *) malloc(stride*rows*sizeof(imgpel))) == NULL)
+      no_mem_exit("getPaddedRef: buf");
+    plane->bufSize = stride*rows;
   }
-
-  for (i = 0; i < 16; i++)
+  if (plane->rowsSize < rows)
   {
-    for (j = 0; j < 16; j++)
-    {
-      pMB[i*16+j] = img->mpr[j][i];
-    }
+    free(plane->rows);
+    if ((plane->rows = (imgpel **) malloc(rows*sizeof(imgpel *))) == NULL)
+      no_mem_exit("getPaddedRef: rows");
+    plane->rowsSize = rows;
   }
 
-  pMB += 256;
+  for (j = 0; j < rows; j++)
+    plane->rows[j] = plane->buf + j*stride + ERC_PAD;
+  plane->imgY = plane->rows + ERC_PAD;
 
-  if (dec_picture->chroma_format_idc != YUV400)
+  for (j = 0; j < size_y; j++)
   {
-    // chroma *******************************************************
-    f1_x = 64/img->mb_cr_size_x;
-    f2_x=f1_x-1;
+    line = plane->imgY[j];
+    memcpy(line, pic->imgY[j], pic->size_x*sizeof(imgpel));
+    for (i = 1; i <= ERC_PAD; i++)
+    {
+      line[-i] = line[0];
+      line[pic->size_x-1+i] = line[pic->size_x-1];
+    }
+  }
+  for (j = 1; j <= ERC_PAD; j++)
+  {
+    memcpy(plane->imgY[-j] - ERC_PAD, plane->imgY[0] - ERC_PAD, stride*sizeof(imgpel));
+    memcpy(plane->imgY[size_y-1+j] - ERC_PAD, plane->imgY[size_y-1] - ERC_PAD, stride*sizeof(imgpel));
+  }
 
-    f1_y = 64/img->mb_cr_size_y;
-    f2_y=f1_y-1;
+  plane->pic    = pic;
+  plane->size_y = size_y;
+  plane->coarseLevels = 0;
 
-    f3=f1_x*f1_y;
-    f4=f3>>1;
+  // the phase planes of the previous picture are reused if the geometry is the same
+  tilesX = (SUBPEL_ORG + pic->size_x + ERC_PAD_BACK + BLOCK_SIZE + SUBPEL_TILE-1) / SUBPEL_TILE;
+  tilesY = (SUBPEL_ORG + size_y      + ERC_PAD_BACK + BLOCK_SIZE + SUBPEL_TILE-1) / SUBPEL_TILE;
+  if (tilesX != plane->tilesX || tilesY != plane->tilesY)
+  {
+    freeSubPelPlanes(state, plane);
+    plane->tilesX = tilesX;
+    plane->tilesY = tilesY;
+    plane->subPelStride = tilesX*SUBPEL_TILE;
+  }
+  for (i = 0; i < SUBPEL_PHASES; i++)
+  {
+    if (plane->tileDone[i])
+      memset(plane->tileDone[i], 0, tilesX*tilesY);
+    plane->subPelRefused[i] = 0;
+  }
+
+  return plane;
+}
 
-    for(uv=0;uv<2;uv++)
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns one level of the pyramid of a padded plane, building it
+ *      and the levels above it on first use.
+ * \return
+ *      The samples of the level, (pic->size_x>>level) per row and
+ *      (size_y>>level) rows
+ * \param plane
+ *      padded reference plane
+ * \param level
+ *      1 for 1/2 resolution, 2 for 1/4
+ ************************************************************************
+ */
+static imgpel *getCoarseLevel(ercPaddedPlane_t *plane, int level)
+{
+  int l, i, j, width, height, srcWidth;
+  imgpel *dst, *src0, *src1;
+
+  for (l = plane->coarseLevels+1; l <= level; l++)
+  {
+    width  = plane->pic->size_x >> l;
+    height = plane->size_y >> l;
+
+    if (plane->coarseSize[l-1] < width*height)
     {
-      for (b8=0;b8<(img->num_blk8x8_uv/2);b8++)
-      {
-        for(b4=0;b4<4;b4++)
-		{
-          joff = subblk_offset_y[yuv][b8][b4];
-          j4=img->pix_c_y+joff;
-          ioff = subblk_offset_x[yuv][b8][b4];
-          i4=img->pix_c_x+ioff;
+      free(plane->coarse[l-1]);
+      if ((plane->coarse[l-1] = (imgpel *) malloc(width*height*sizeof(imgpel))) == NULL)
+        no_mem_exit("getCoarseLevel: coarse");
+      plane->coarseSize[l-1] = width*height;
+    }
 
-          for(jj=0;jj<4;jj++)
-          {
-            jf=(j4+jj)/(img->mb_cr_size_y/4);     // jf  = Subblock_y-coordinate
-            for(ii=0;ii<4;ii++)
-            {
-              ifx=(i4+ii)/(img->mb_cr_size_x/4);  // ifx = Subblock_x-coordinate
+    dst = plane->coarse[l-1];
+    srcWidth = plane->pic->size_x >> (l-1);
+    for (j = 0; j < height; j++)
+    {
+      src0 = (l == 1) ? plane->imgY[2*j]   : plane->coarse[l-2] + (2*j)*srcWidth;
+      src1 = (l == 1) ? plane->imgY[2*j+1] : plane->coarse[l-2] + (2*j+1)*srcWidth;
+      for (i = 0; i < width; i++, dst++)
+        *dst = (imgpel) ((src0[2*i] + src0[2*i+1] + src1[2*i] + src1[2*i+1] + 2) >> 2);
+    }
 
-              i1=(i4+ii)*f1_x + mv[0];
-              j1=(j4+jj)*f1_y + mv[1];
-            
-              ii0=max (0, min (i1/f1_x,   dec_picture->size_x_cr-1));
-              jj0=max (0, min (j1/f1_y,   dec_picture->size_y_cr-1));
-              ii1=max (0, min ((i1+f2_x)/f1_x, dec_picture->size_x_cr-1));
-              jj1=max (0, min ((j1+f2_y)/f1_y, dec_picture->size_y_cr-1));
-            
-              if1=(i1 & f2_x);
-              jf1=(j1 & f2_y);
-              if0=f1_x-if1;
-              jf0=f1_y-jf1;
-            
-              img->mpr[ii+ioff][jj+joff]=(if0*jf0*listX[0][ref_frame]->imgUV[uv][jj0][ii0]+
-                                          if1*jf0*listX[0][ref_frame]->imgUV[uv][jj0][ii1]+
-                                          if0*jf1*listX[0][ref_frame]->imgUV[uv][jj1][ii0]+
-                                          if1*jf1*listX[0][ref_frame]->imgUV[uv][jj1][ii1]+f4)/f3;
-            }
-          }
-        }
-      }
+    plane->coarseLevels = l;
+  }
+
+  return plane->coarse[level-1];
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the pyramid level the MV candidates of a picture are
+ *      ranked on, see ercSetCoarseCandidates()
+ ************************************************************************
+ */
+static int coarseLevel(int32 picSizeX)
+{
+  return (picSizeX >= ERC_COARSE_QUARTER_WIDTH) ? 2 : 1;
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Releases the phase planes of a padded plane of a context.
+ ************************************************************************
+ */
+static void freeSubPelPlanes(struct erc_inter_state *state, ercPaddedPlane_t *plane)
+{
+  int i;
+
+  for (i = 0; i < SUBPEL_PHASES; i++)
+  {
+    if (plane->subPel[i])
+    {
+      state->subPelCacheUsed -= plane->subPelStride*plane->tilesY*SUBPEL_TILE*sizeof(imgpel) + plane->tilesX*plane->tilesY;
+      free(plane->subPel[i]);
+      free(plane->tileDone[i]);
+      plane->subPel[i]   = NULL;
+      plane->tileDone[i] = NULL;
+      plane->subPelReady[i] = 0;
+    }
+  }
+}
 
-      for (i = 0; i < 8; i++)
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the samples of one quarter sample phase of a padded plane
+ *      for a 4x4 block, interpolating the tiles it touches if they have
+ *      not been interpolated yet. The workers of the parallel concealment
+ *      share the tiles: a block whose tiles are done is read without a
+ *      lock, a missing tile is filled under the lock of its phase plane.
+ * \return
+ *      Pointer to sample (x,y) of the phase plane, rows are
+ *      plane->subPelStride apart. NULL if the cache is off or full, the
+ *      block has then to be interpolated directly.
+ * \param state
+ *      inter concealment state of the context
+ * \param plane
+ *      padded reference plane
+ * \param phase
+ *      (dy<<2)+dx, 1..15
+ * \param x, y
+ *      full sample position of the block, already clipped to the guard band
+ * \param maxValue
+ *      largest sample value
+ ************************************************************************
+ */
+static imgpel *getSubPelSamples(struct erc_inter_state *state, ercPaddedPlane_t *plane, int phase, int x, int y, int maxValue)
+{
+  int size, tx, ty, bx, by, i, j, fMissing;
+  int block[BLOCK_SIZE][BLOCK_SIZE];
+  imgpel *tile;
+
+  if (subPelCacheLimit == 0 || ercPoolTestFlag(&plane->subPelRefused[phase]))
+    return NULL;
+
+  x += SUBPEL_ORG;
+  y += SUBPEL_ORG;
+
+  fMissing = !ercPoolTestFlag(&plane->subPelReady[phase]);
+  for (ty = y/SUBPEL_TILE; !fMissing && ty <= (y+BLOCK_SIZE-1)/SUBPEL_TILE; ty++)
+  {
+    for (tx = x/SUBPEL_TILE; !fMissing && tx <= (x+BLOCK_SIZE-1)/SUBPEL_TILE; tx++)
+      fMissing = !ercPoolTestFlag(&plane->tileDone[phase][ty*plane->tilesX+tx]);
+  }
+
+  if (!fMissing)
+    return plane->subPel[phase] + y*plane->subPelStride + x;
+
+  ercPoolMutexLock(&plane->subPelMutex[phase]);
+
+  if (plane->subPel[phase] == NULL)
+  {
+    // the cache is shared by all phase planes of the context
+    size = plane->subPelStride*plane->tilesY*SUBPEL_TILE*sizeof(imgpel) + plane->tilesX*plane->tilesY;
+    ercPoolLock();
+    if (state->subPelCacheUsed + size > subPelCacheLimit)
+      size = 0;
+    else
+      state->subPelCacheUsed += size;
+    ercPoolUnlock();
+
+    if (size == 0)
+    {
+      ercPoolSetFlag(&plane->subPelRefused[phase]);
+      ercPoolMutexUnlock(&plane->subPelMutex[phase]);
+      return NULL;
+    }
+
+    if ((plane->subPel[phase] = (imgpel *) malloc(plane->subPelStride*plane->tilesY*SUBPEL_TILE*sizeof(imgpel))) == NULL)
+      no_mem_exit("getSubPelSamples: subPel");
+    if ((plane->tileDone[phase] = (byte *) calloc(plane->tilesX*plane->tilesY, sizeof(byte))) == NULL)
+      no_mem_exit("getSubPelSamples: tileDone");
+    ercPoolSetFlag(&plane->subPelReady[phase]);
+  }
+
+  for (ty = y/SUBPEL_TILE; ty <= (y+BLOCK_SIZE-1)/SUBPEL_TILE; ty++)
+  {
+    for (tx = x/SUBPEL_TILE; tx <= (x+BLOCK_SIZE-1)/SUBPEL_TILE; tx++)
+    {
+      if (plane->tileDone[phase][ty*plane->tilesX+tx])
+        continue;
+
+      for (by = 0; by < SUBPEL_TILE; by += BLOCK_SIZE)
       {
-        for (j = 0; j < 8; j++)
+        for (bx = 0; bx < SUBPEL_TILE; bx += BLOCK_SIZE)
         {
-          pMB[i*8+j] = img->mpr[j][i];
+          interpolateBlock(plane->imgY, tx*SUBPEL_TILE+bx-SUBPEL_ORG, ty*SUBPEL_TILE+by-SUBPEL_ORG,
+                           phase&3, phase>>2, maxValue, block);
+
+          tile = plane->subPel[phase] + (ty*SUBPEL_TILE+by)*plane->subPelStride + tx*SUBPEL_TILE+bx;
+          for (j = 0; j < BLOCK_SIZE; j++)
+            for (i = 0; i < BLOCK_SIZE; i++)
+              tile[j*plane->subPelStride+i] = (imgpel) block[i][j];
         }
       }
-      pMB += 64;
+      ercPoolSetFlag(&plane->tileDone[phase][ty*plane->tilesX+tx]);
+    }
+  }
+
+  ercPoolMutexUnlock(&plane->subPelMutex[phase]);
+
+  return plane->subPel[phase] + y*plane->subPelStride + x;
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Motion compensated 4x4 luma block for concealment. Same result as
+ *      get_block(), but the taps are read from the padded reference
+ *      plane without clamping, or the block is copied from the sub-pel
+ *      plane cache when it is enabled.
+ * \param ref_frame
+ *      reference index in list
+ * \param list
+ *      reference picture list
+ * \param x_pos, y_pos
+ *      position of the block in the reference, 1/4 pel units
+ * \param worker
+ *      the concealing worker
+ * \param block
+ *      prediction, block[x][y]
+ ************************************************************************
+ */
+static void getConcealBlock(int ref_frame, StorablePicture **list, int x_pos, int y_pos, ercWorker_t *worker, int block[BLOCK_SIZE][BLOCK_SIZE])
+{
+  struct img_par *img = worker->img;
+  StorablePicture *dec_picture = worker->ctx->dec_picture;
+  int dx, dy;
+  int i, j;
+  int maxold_x, maxold_y;
+  ercPaddedPlane_t *plane;
+  imgpel *p;
+
+  if (list[ref_frame] == no_reference_picture && img->framepoc < img->recovery_poc)
+  {
+    get_block(ref_frame, list, x_pos, y_pos, img, block);
+    return;
+  }
+
+  dx = x_pos&3;
+  dy = y_pos&3;
+  x_pos = (x_pos-dx)/4;
+  y_pos = (y_pos-dy)/4;
+
+  maxold_x = dec_picture->size_x-1;
+  maxold_y = dec_picture->size_y-1;
+
+  if (dec_picture->mb_field[img->current_mb_nr])
+    maxold_y = dec_picture->size_y/2 - 1;
+
+  plane = getPaddedRef(worker->ctx->inter, list[ref_frame], maxold_y+1);
+  x_pos = max(-(ERC_PAD-ERC_PAD_BACK), min(maxold_x+ERC_PAD_BACK, x_pos));
+  y_pos = max(-(ERC_PAD-ERC_PAD_BACK), min(maxold_y+ERC_PAD_BACK, y_pos));
+
+  if ((dx || dy) && (p = getSubPelSamples(worker->ctx->inter, plane, (dy<<2)+dx, x_pos, y_pos, img->max_imgpel_value)) != NULL)
+  {
+    for (j = 0; j < BLOCK_SIZE; j++, p += plane->subPelStride)
+      for (i = 0; i < BLOCK_SIZE; i++)
+        block[i][j] = p[i];
+  }
+  else
+    interpolateBlock(plane->imgY, x_pos, y_pos, dx, dy, img->max_imgpel_value, block);
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      H.264 quarter sample luma interpolation of a 4x4 block from a
+ *      padded plane, the arithmetic of get_block() without the clamps.
+ * \param refY
+ *      padded plane, rows contiguous
+ * \param x_pos, y_pos
+ *      full sample position of the block, within the guard band
+ * \param dx, dy
+ *      quarter sample phase
+ * \param maxValue
+ *      largest sample value
+ * \param block
+ *      prediction, block[x][y]
+ ************************************************************************
+ */
+static void interpolateBlock(imgpel **refY, int x_pos, int y_pos, int dx, int dy, int maxValue, int block[BLOCK_SIZE][BLOCK_SIZE])
+{
+  int i, j;
+  int result, stride;
+  int tmp_res[4][9];
+  imgpel *p;
+
+  stride = (int) (refY[1] - refY[0]);
+
+  if (dx == 0 && dy == 0)
+  {  /* fullpel position */
+    for (j = 0; j < BLOCK_SIZE; j++)
+    {
+      p = refY[y_pos+j] + x_pos;
+      for (i = 0; i < BLOCK_SIZE; i++)
+        block[i][j] = p[i];
+    }
+  }
+  else if (dy == 0)
+  {  /* No vertical interpolation */
+    for (j = 0; j < BLOCK_SIZE; j++)
+    {
+      p = refY[y_pos+j] + x_pos;
+      for (i = 0; i < BLOCK_SIZE; i++)
+      {
+        result = TAP6(p+i, 1);
+        block[i][j] = max(0, min(maxValue, (result+16)/32));
+        if ((dx&1) == 1)
+          block[i][j] = (block[i][j] + p[i+dx/2] + 1)/2;
+      }
+    }
+  }
+  else if (dx == 0)
+  {  /* No horizontal interpolation */
+    for (j = 0; j < BLOCK_SIZE; j++)
+    {
+      p = refY[y_pos+j] + x_pos;
+      for (i = 0; i < BLOCK_SIZE; i++)
+      {
+        result = TAP6(p+i, stride);
+        block[i][j] = max(0, min(maxValue, (result+16)/32));
+        if ((dy&1) == 1)
+          block[i][j] = (block[i][j] + p[i+(dy/2)*stride] + 1)/2;
+      }
+    }
+  }
+  else if (dx == 2)
+  {  /* Vertical & horizontal interpolation */
+    for (j = -2; j < BLOCK_SIZE+3; j++)
+    {
+      p = refY[y_pos+j] + x_pos;
+      for (i = 0; i < BLOCK_SIZE; i++)
+        tmp_res[i][j+2] = TAP6(p+i, 1);
+    }
+
+    for (j = 0; j < BLOCK_SIZE; j++)
+    {
+      for (i = 0; i < BLOCK_SIZE; i++)
+      {
+        result = TAP6(&tmp_res[i][j+2], 1);
+        block[i][j] = max(0, min(maxValue, (result+512)/1024));
+        if ((dy&1) == 1)
+          block[i][j] = (block[i][j] + max(0, min(maxValue, (tmp_res[i][j+2+dy/2]+16)/32)) + 1)/2;
+      }
+    }
+  }
+  else if (dy == 2)
+  {  /* Horizontal & vertical interpolation */
+    for (j = 0; j < BLOCK_SIZE; j++)
+    {
+      p = refY[y_pos+j] + x_pos;
+      for (i = -2; i < BLOCK_SIZE+3; i++)
+        tmp_res[j][i+2] = TAP6(p+i, stride);
+    }
+
+    for (j = 0; j < BLOCK_SIZE; j++)
+    {
+      for (i = 0; i < BLOCK_SIZE; i++)
+      {
+        result = TAP6(&tmp_res[j][i+2], 1);
+        block[i][j] = max(0, min(maxValue, (result+512)/1024));
+        if ((dx&1) == 1)
+          block[i][j] = (block[i][j] + max(0, min(maxValue, (tmp_res[j][i+2+dx/2]+16)/32)) + 1)/2;
+      }
+    }
+  }
+  else
+  {  /* Diagonal interpolation */
+    for (j = 0; j < BLOCK_SIZE; j++)
+    {
+      p = refY[dy == 1 ? y_pos+j : y_pos+j+1] + x_pos;
+      for (i = 0; i < BLOCK_SIZE; i++)
+      {
+        result = TAP6(p+i, 1);
+        block[i][j] = max(0, min(maxValue, (result+16)/32));
+      }
+    }
+
+    for (j = 0; j < BLOCK_SIZE; j++)
+    {
+      p = refY[y_pos+j] + (dx == 1 ? x_pos : x_pos+1);
+      for (i = 0; i < BLOCK_SIZE; i++)
+      {
+        result = TAP6(p+i, stride);
+        block[i][j] = (block[i][j] + max(0, min(maxValue, (result+16)/32)) + 1)/2;
+      }
+    }
+  }
+}
+
+//Santosh
+//************************************************************************************************************************
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Builds only the outer boundary ring of a motion compensated MB,
+ *      i.e. the 16 samples above, left of, below and right of it, at
+ *      the sub-pel phase of the candidate MV. This is all OBMA scoring
+ *      needs, so the inner 4x4 blocks and the chroma are not predicted.
+ * \param worker
+ *      the concealing worker
+ * \param mv
+ *      candidate motion vector
+ * \param x
+ *      x coordinate of the concealed MB
+ * \param y
+ *      y coordinate of the concealed MB
+ * \param boundary
+ *      the 64 ring samples: above, left, below and right, 16 each
+ ************************************************************************
+ */
+static void buildOuterBoundary(ercWorker_t *worker, int32 *mv, int x, int y, imgpel *boundary)
+{
+  struct img_par *img = worker->img;
+  int i, j, k, i4, j4, index;
+  int vec1_x, vec1_y;
+  int above[4], left[4], below[4], right[4];
+  int ref_frame = max (mv[2], 0); // !!KS: quick fix, we sometimes seem to get negative ref_pic here, so restrict to zero an above
+
+  /* Update coordinates of the current concealed macroblock */
+  img->mb_x = x/MB_BLOCK_SIZE;
+  img->mb_y = y/MB_BLOCK_SIZE;
+  img->block_y = img->mb_y * BLOCK_SIZE;
+  img->pix_c_y = img->mb_y * img->mb_cr_size_y;
+  img->block_x = img->mb_x * BLOCK_SIZE;
+  img->pix_c_x = img->mb_x * img->mb_cr_size_x;
+
+  for (j = 0; j < MB_BLOCK_SIZE/BLOCK_SIZE; j++)
+  {
+    j4 = img->block_y + j;
+    for (i = 0; i < MB_BLOCK_SIZE/BLOCK_SIZE; i++)
+    {
+      /* the inner 4x4 blocks do not touch the ring */
+      if (i != 0 && i != 3 && j != 0 && j != 3)
+        continue;
+
+      i4 = img->block_x + i;
+      vec1_x = i4*4*4 + mv[0];
+      vec1_y = j4*4*4 + mv[1];
+
+      index = i + 4*j;
+      get_boundary(ref_frame, worker->ctx->list0, vec1_x, vec1_y, worker, index, above, left, below, right);
 
+      for (k = 0; k < 4; k++)
+      {
+        if (j == 0)
+          boundary[4*i+k] = above[k];
+        if (i == 0)
+          boundary[16+4*j+k] = left[k];
+        if (j == 3)
+          boundary[32+4*i+k] = below[k];
+        if (i == 3)
+          boundary[48+4*j+k] = right[k];
+      }
     }
   }
 }
 
 
-void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, struct img_par *img, int index, int above[4], int left[4], int below[4], int right[4])
+static void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, ercWorker_t *worker, int index, int above[4], int left[4], int below[4], int right[4])
 {
+  struct img_par *img = worker->img;
+  StorablePicture *dec_picture = worker->ctx->dec_picture;
   int dx, dy;
   int x, y;
   int i, j;
@@ -2534,6 +4147,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
   int pres_y; 
   int tmp_res[4][9];
   static const int COEF[6] = { 1, -5, 20, 20, -5, 1 };
+  imgpel **refY;
 
   int block[4][4];
 
@@ -2562,6 +4176,10 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
   if (dec_picture->mb_field[img->current_mb_nr])
     maxold_y = dec_picture->size_y/2 - 1;
 
+  refY  = getPaddedRef(worker->ctx->inter, list[ref_frame], maxold_y+1)->imgY;
+  x_pos = max(-(ERC_PAD-ERC_PAD_BACK), min(maxold_x+ERC_PAD_BACK, x_pos));
+  y_pos = max(-(ERC_PAD-ERC_PAD_BACK), min(maxold_y+ERC_PAD_BACK, y_pos));
+
   if (dx == 0 && dy == 0) 
   {  /* fullpel position */
 	 
@@ -2570,7 +4188,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 		  //Above
 		  for(j=0;j<4;j++)
 		  {
-			  above[j] = list[ref_frame]->imgY[max(0,min(maxold_y,y_pos-1))][max(0,min(maxold_x,x_pos+j))];
+			  above[j] = refY[y_pos-1][x_pos+j];
 		  }
 	  }
 
@@ -2579,7 +4197,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 		  //Left
 		  for(i=0;i<4;i++)
 		  {
-			  left[i] = list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+i))][max(0,min(maxold_x,x_pos-1))];
+			  left[i] = refY[y_pos+i][x_pos-1];
 		  }
 	  }
 
@@ -2588,7 +4206,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 		  //Below
 		  for(j=0;j<4;j++)
 		  {
-			  below[j] = list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+BLOCK_SIZE))][max(0,min(maxold_x,x_pos+j))];
+			  below[j] = refY[y_pos+BLOCK_SIZE][x_pos+j];
 		  }
 	  }
 
@@ -2597,7 +4215,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 		  //Right
 		  for(i=0;i<4;i++)
 		  {
-			  right[i] = list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+i))][max(0,min(maxold_x,x_pos+BLOCK_SIZE))];
+			  right[i] = refY[y_pos+i][x_pos+BLOCK_SIZE];
 		  }
 	  }
   }
@@ -2613,7 +4231,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 			for(i=0;i<BLOCK_SIZE;i++)
 			{
 				for (result = 0, x = -2; x < 4; x++)
-					result += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos-1))][max(0,min(maxold_x,x_pos+i+x))]*COEF[x+2];				
+					result += refY[y_pos-1][x_pos+i+x]*COEF[x+2];				
 				above[i] = max(0, min(img->max_imgpel_value, (result+16)/32));
 			}
 
@@ -2621,7 +4239,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 			{
 				for(i=0;i<BLOCK_SIZE;i++)
 				{
-					above[i] = (above[i] + list[ref_frame]->imgY[max(0,min(maxold_y,y_pos-1))][max(0,min(maxold_x,x_pos+i+dx/2))] +1 )/2;
+					above[i] = (above[i] + refY[y_pos-1][x_pos+i+dx/2] +1 )/2;
 				}
 			}
 		}
@@ -2631,7 +4249,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 			for(i=0;i<BLOCK_SIZE;i++)
 			{
 				for (result = 0, x = -2; x < 4; x++)
-					result += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+i))][max(0,min(maxold_x,x_pos+i+x-1))]*COEF[x+2];				
+					result += refY[y_pos+i][x_pos+i+x-1]*COEF[x+2];				
 				left[i] = max(0, min(img->max_imgpel_value, (result+16)/32));
 			}
 
@@ -2639,7 +4257,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 			{
 				for(i=0;i<BLOCK_SIZE;i++)
 				{
-					left[i] = (left[i] + list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+i))][max(0,min(maxold_x,x_pos-1+i+dx/2))] +1 )/2;
+					left[i] = (left[i] + refY[y_pos+i][x_pos-1+i+dx/2] +1 )/2;
 				}
 			}
 		}
@@ -2649,7 +4267,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 			for(i=0;i<BLOCK_SIZE;i++)
 			{
 				for (result = 0, x = -2; x < 4; x++)
-					result += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+BLOCK_SIZE))][max(0,min(maxold_x,x_pos+i+x))]*COEF[x+2];				
+					result += refY[y_pos+BLOCK_SIZE][x_pos+i+x]*COEF[x+2];				
 				below[i] = max(0, min(img->max_imgpel_value, (result+16)/32));
 			}
 
@@ -2657,7 +4275,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 			{
 				for(i=0;i<BLOCK_SIZE;i++)
 				{
-					below[i] = (below[i] + list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+BLOCK_SIZE))][max(0,min(maxold_x,x_pos+i+dx/2))] +1 )/2;
+					below[i] = (below[i] + refY[y_pos+BLOCK_SIZE][x_pos+i+dx/2] +1 )/2;
 				}
 			}
 		}
@@ -2667,7 +4285,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 			for(i=0;i<BLOCK_SIZE;i++)
 			{
 				for (result = 0, x = -2; x < 4; x++)
-					result += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+i))][max(0,min(maxold_x,x_pos+i+x+BLOCK_SIZE))]*COEF[x+2];			
+					result += refY[y_pos+i][x_pos+i+x+BLOCK_SIZE]*COEF[x+2];			
 				right[i] = max(0, min(img->max_imgpel_value, (result+16)/32));
 			}
 
@@ -2675,7 +4293,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 			{
 				for(i=0;i<BLOCK_SIZE;i++)
 				{
-					right[i] = (right[i] + list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+i))][max(0,min(maxold_x,x_pos+BLOCK_SIZE+i+dx/2))] +1 )/2;
+					right[i] = (right[i] + refY[y_pos+i][x_pos+BLOCK_SIZE+i+dx/2] +1 )/2;
 				}
 			}
 		}
@@ -2689,7 +4307,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 			for(i=0;i<BLOCK_SIZE;i++)
 			{
 				for (result = 0, y = -2; y < 4; y++)
-					result += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+y-1))][max(0,min(maxold_x,x_pos+i))]*COEF[y+2];				
+					result += refY[y_pos+y-1][x_pos+i]*COEF[y+2];				
 				above[i] = max(0, min(img->max_imgpel_value, (result+16)/32));
 			}
 
@@ -2697,7 +4315,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 			{
 				for(i=0;i<BLOCK_SIZE;i++)
 				{
-					above[i] = (above[i] + list[ref_frame]->imgY[max(0,min(maxold_y,y_pos-1+dy/2))][max(0,min(maxold_x,x_pos+i))] +1 )/2;
+					above[i] = (above[i] + refY[y_pos-1+dy/2][x_pos+i] +1 )/2;
 				}
 			}
 		}
@@ -2707,7 +4325,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 			for(i=0;i<BLOCK_SIZE;i++)
 			{
 				for (result = 0, y = -2; y < 4; y++)
-					result += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+y+i))][max(0,min(maxold_x,x_pos+i-1))]*COEF[y+2];
+					result += refY[y_pos+y+i][x_pos+i-1]*COEF[y+2];
 				left[i] = max(0, min(img->max_imgpel_value, (result+16)/32));
 			}
 
@@ -2715,7 +4333,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 			{
 				for(i=0;i<BLOCK_SIZE;i++)
 				{
-					left[i] = (left[i] + list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+i+dy/2))][max(0,min(maxold_x,x_pos-1+i))] +1 )/2;
+					left[i] = (left[i] + refY[y_pos+i+dy/2][x_pos-1+i] +1 )/2;
 				}
 			}
 		}
@@ -2725,7 +4343,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 			for(i=0;i<BLOCK_SIZE;i++)
 			{
 				for (result = 0, y = -2; y < 4; y++)
-					result += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+y+BLOCK_SIZE))][max(0,min(maxold_x,x_pos+i))]*COEF[y+2];
+					result += refY[y_pos+y+BLOCK_SIZE][x_pos+i]*COEF[y+2];
 				below[i] = max(0, min(img->max_imgpel_value, (result+16)/32));
 			}
 
@@ -2733,7 +4351,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 			{
 				for(i=0;i<BLOCK_SIZE;i++)
 				{
-					below[i] = (below[i] + list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+BLOCK_SIZE+dy/2))][max(0,min(maxold_x,x_pos+i))] +1 )/2;
+					below[i] = (below[i] + refY[y_pos+BLOCK_SIZE+dy/2][x_pos+i] +1 )/2;
 				}
 			}
 		}
@@ -2743,7 +4361,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 			for(i=0;i<BLOCK_SIZE;i++)
 			{
 				for (result = 0, y = -2; y < 4; y++)
-					result += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+y+i))][max(0,min(maxold_x,x_pos+i+BLOCK_SIZE))]*COEF[y+2];
+					result += refY[y_pos+y+i][x_pos+i+BLOCK_SIZE]*COEF[y+2];
 				right[i] = max(0, min(img->max_imgpel_value, (result+16)/32));
 			}
 
@@ -2751,7 +4369,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 			{
 				for(i=0;i<BLOCK_SIZE;i++)
 				{
-					right[i] = (right[i] + list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+i+dy/2))][max(0,min(maxold_x,x_pos+BLOCK_SIZE+i))] +1 )/2;
+					right[i] = (right[i] + refY[y_pos+i+dy/2][x_pos+BLOCK_SIZE+i] +1 )/2;
 				}
 			}
 		}
@@ -2770,7 +4388,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 				{
 					for (tmp_res[i][j+2] = 0, x = -2; x < 4; x++)
 					{
-						tmp_res[i][j+2] += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos-1+j))][max(0,min(maxold_x,x_pos+i+x))]*COEF[x+2];
+						tmp_res[i][j+2] += refY[y_pos-1+j][x_pos+i+x]*COEF[x+2];
 					}
 				}
 			}
@@ -2802,7 +4420,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 				{
 					for (tmp_res[i][j+2] = 0, x = -2; x < 4; x++)
 					{
-						tmp_res[i][j+2] += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+j))][max(0,min(maxold_x,x_pos-1+i+x))]*COEF[x+2];
+						tmp_res[i][j+2] += refY[y_pos+j][x_pos-1+i+x]*COEF[x+2];
 					}
 				}
 			}
@@ -2835,7 +4453,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 				{
 					for (tmp_res[i][j+2] = 0, x = -2; x < 4; x++)
 					{
-						tmp_res[i][j+2] += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+BLOCK_SIZE+j))][max(0,min(maxold_x,x_pos+i+x))]*COEF[x+2];
+						tmp_res[i][j+2] += refY[y_pos+BLOCK_SIZE+j][x_pos+i+x]*COEF[x+2];
 					}
 				}
 			}
@@ -2867,7 +4485,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 				{
 					for (tmp_res[i][j+2] = 0, x = -2; x < 4; x++)
 					{
-						tmp_res[i][j+2] += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+j))][max(0,min(maxold_x,x_pos+BLOCK_SIZE+i+x))]*COEF[x+2];
+						tmp_res[i][j+2] += refY[y_pos+j][x_pos+BLOCK_SIZE+i+x]*COEF[x+2];
 					}
 				}
 			}
@@ -2902,7 +4520,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 				{
 					for (tmp_res[j][i+2] = 0, y = -2; y < 4; y++)
 					{
-						tmp_res[j][i+2] += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos-1+j+y))][max(0,min(maxold_x,x_pos+i))]*COEF[y+2];
+						tmp_res[j][i+2] += refY[y_pos-1+j+y][x_pos+i]*COEF[y+2];
 					}
 				}
 			}
@@ -2935,7 +4553,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 				{
 					for (tmp_res[j][i+2] = 0, y = -2; y < 4; y++)
 					{
-						tmp_res[j][i+2] += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+j+y))][max(0,min(maxold_x,x_pos-1+i))]*COEF[y+2];
+						tmp_res[j][i+2] += refY[y_pos+j+y][x_pos-1+i]*COEF[y+2];
 					}
 				}
 			}
@@ -2968,7 +4586,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 				{
 					for (tmp_res[j][i+2] = 0, y = -2; y < 4; y++)
 					{
-						tmp_res[j][i+2] += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+BLOCK_SIZE+j+y))][max(0,min(maxold_x,x_pos+i))]*COEF[y+2];
+						tmp_res[j][i+2] += refY[y_pos+BLOCK_SIZE+j+y][x_pos+i]*COEF[y+2];
 					}
 				}
 			}
@@ -3001,7 +4619,7 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 				{
 					for (tmp_res[j][i+2] = 0, y = -2; y < 4; y++)
 					{
-						tmp_res[j][i+2] += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+j+y))][max(0,min(maxold_x,x_pos+BLOCK_SIZE+i))]*COEF[y+2];
+						tmp_res[j][i+2] += refY[y_pos+j+y][x_pos+BLOCK_SIZE+i]*COEF[y+2];
 					}
 				}
 			}
@@ -3038,9 +4656,8 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 				for (i = 0; i < BLOCK_SIZE; i++)
 				{
 					pres_y = dy == 1 ? y_pos-1+j : y_pos-1+j+1;
-					pres_y = max(0,min(maxold_y,pres_y));
 					for (result = 0, x = -2; x < 4; x++)
-						result += list[ref_frame]->imgY[pres_y][max(0,min(maxold_x,x_pos+i+x))]*COEF[x+2];
+						result += refY[pres_y][x_pos+i+x]*COEF[x+2];
 					block[i][j] = max(0, min(img->max_imgpel_value, (result+16)/32));
 				}
 			}
@@ -3050,9 +4667,8 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 				for (i = 0; i < BLOCK_SIZE; i++)
 				{
 					pres_x = dx == 1 ? x_pos+i : x_pos+i+1;
-					pres_x = max(0,min(maxold_x,pres_x));
 					for (result = 0, y = -2; y < 4; y++)
-						result += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+j+y))][pres_x]*COEF[y+2];
+						result += refY[y_pos+j+y][pres_x]*COEF[y+2];
 					block[i][j] = (block[i][j] + max(0, min(img->max_imgpel_value, (result+16)/32)) +1 ) / 2;
 				}
 			}
@@ -3069,9 +4685,8 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 				for (i = 0; i < BLOCK_SIZE; i++)
 				{
 					pres_y = dy == 1 ? y_pos+j : y_pos+j+1;
-					pres_y = max(0,min(maxold_y,pres_y));
 					for (result = 0, x = -2; x < 4; x++)
-						result += list[ref_frame]->imgY[pres_y][max(0,min(maxold_x,x_pos+i+x))]*COEF[x+2];
+						result += refY[pres_y][x_pos+i+x]*COEF[x+2];
 					block[i][j] = max(0, min(img->max_imgpel_value, (result+16)/32));
 				}
 			}
@@ -3081,9 +4696,8 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 				for (i = 0; i < BLOCK_SIZE; i++)
 				{
 					pres_x = dx == 1 ? x_pos-1+i : x_pos-1+i+1;
-					pres_x = max(0,min(maxold_x,pres_x));
 					for (result = 0, y = -2; y < 4; y++)
-						result += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+j+y))][pres_x]*COEF[y+2];
+						result += refY[y_pos+j+y][pres_x]*COEF[y+2];
 					block[i][j] = (block[i][j] + max(0, min(img->max_imgpel_value, (result+16)/32)) +1 ) / 2;
 				}
 			}
@@ -3100,9 +4714,8 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 				for (i = 0; i < BLOCK_SIZE; i++)
 				{
 					pres_y = dy == 1 ? y_pos+BLOCK_SIZE+j : y_pos+BLOCK_SIZE+j+1;
-					pres_y = max(0,min(maxold_y,pres_y));
 					for (result = 0, x = -2; x < 4; x++)
-						result += list[ref_frame]->imgY[pres_y][max(0,min(maxold_x,x_pos+i+x))]*COEF[x+2];
+						result += refY[pres_y][x_pos+i+x]*COEF[x+2];
 					block[i][j] = max(0, min(img->max_imgpel_value, (result+16)/32));
 				}
 			}
@@ -3112,9 +4725,8 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 				for (i = 0; i < BLOCK_SIZE; i++)
 				{
 					pres_x = dx == 1 ? x_pos+i : x_pos+i+1;
-					pres_x = max(0,min(maxold_x,pres_x));
 					for (result = 0, y = -2; y < 4; y++)
-						result += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+j+y))][pres_x]*COEF[y+2];
+						result += refY[y_pos+j+y][pres_x]*COEF[y+2];
 					block[i][j] = (block[i][j] + max(0, min(img->max_imgpel_value, (result+16)/32)) +1 ) / 2;
 				}
 			}
@@ -3131,9 +4743,8 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 				for (i = 0; i < BLOCK_SIZE; i++)
 				{
 					pres_y = dy == 1 ? y_pos+j : y_pos+j+1;
-					pres_y = max(0,min(maxold_y,pres_y));
 					for (result = 0, x = -2; x < 4; x++)
-						result += list[ref_frame]->imgY[pres_y][max(0,min(maxold_x,x_pos+i+x))]*COEF[x+2];
+						result += refY[pres_y][x_pos+i+x]*COEF[x+2];
 					block[i][j] = max(0, min(img->max_imgpel_value, (result+16)/32));
 				}
 			}
@@ -3143,9 +4754,8 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 				for (i = 0; i < BLOCK_SIZE; i++)
 				{
 					pres_x = dx == 1 ? x_pos+BLOCK_SIZE+i : x_pos+BLOCK_SIZE+i+1;
-					pres_x = max(0,min(maxold_x,pres_x));
 					for (result = 0, y = -2; y < 4; y++)
-						result += list[ref_frame]->imgY[max(0,min(maxold_y,y_pos+j+y))][pres_x]*COEF[y+2];
+						result += refY[y_pos+j+y][pres_x]*COEF[y+2];
 					block[i][j] = (block[i][j] + max(0, min(img->max_imgpel_value, (result+16)/32)) +1 ) / 2;
 				}
 			}
@@ -3158,70 +4768,42 @@ void get_boundary(int ref_frame, StorablePicture **list, int x_pos, int y_pos, s
 }
 
 
-static int edgeDistortionOBMA (int predBlocks[], int currYBlockNum, imgpel *predMB, imgpel *recY, int32 picSizeX, int32 regionSize, imgpel *boundary)
+static int edgeDistortionOBMA (int predBlocks[], imgpel *boundary, imgpel *nbRing, int32 regionSize, int maxDist)
 {
-  int i, j, distortion, numOfPredBlocks, threshold = ERC_BLOCK_OK;
-  imgpel *currBlock = NULL, *neighbor = NULL;
-  int32 currBlockOffset = 0;
+  int j, distortion, numOfPredBlocks, limit, threshold;
   
-  currBlock = recY + (yPosYBlock(currYBlockNum,picSizeX)<<3)*picSizeX + (xPosYBlock(currYBlockNum,picSizeX)<<3);
-  
-  do 
-  {    
-    distortion = 0; numOfPredBlocks = 0;
+  numOfPredBlocks = usedNeighbours(predBlocks, 15, &threshold);
+  if(numOfPredBlocks == 0)
+    return 0;
+
+  /* stop as soon as the distortion per neighbour can no longer get below maxDist */
+  limit = (maxDist > INT_MAX/4) ? INT_MAX : maxDist*numOfPredBlocks;
+  distortion = 0;
     
-    /* loop the 4 neighbours */
-    for (j = 4; j < 8; j++) 
+  /* loop the 4 neighbours */
+  for (j = 4; j < 8 && distortion < limit; j++) 
+  {
+    /* if reliable, count boundary pixel difference */
+    if (predBlocks[j] >= threshold) 
     {
-      /* if reliable, count boundary pixel difference */
-      if (predBlocks[j] >= threshold) 
+      
+      switch (j) 
       {
-        
-        switch (j) 
-        {
-        case 4:
-          neighbor = currBlock - picSizeX;
-          for ( i = 0; i < regionSize; i++ ) 
-          {
-            distortion += mabs((int)(boundary[i] - neighbor[i]));
-          }
-          break;          
-        case 5:
-          neighbor = currBlock - 1;
-          for ( i = 0; i < regionSize; i++ ) 
-          {
-            distortion += mabs((int)(boundary[16+i] - neighbor[i*picSizeX]));
-          }
-          break;                
-        case 6:
-          neighbor = currBlock + regionSize*picSizeX;
-          currBlockOffset = (regionSize-1)*16;
-          for ( i = 0; i < regionSize; i++ ) 
-          {
-            distortion += mabs((int)(boundary[32+i] - neighbor[i]));
-          }
-          break;                
-        case 7:
-          neighbor = currBlock + regionSize;
-          currBlockOffset = regionSize-1;
-          for ( i = 0; i < regionSize; i++ ) 
-          {
-            distortion += mabs((int)(boundary[48+i] - neighbor[i*picSizeX]));
-          }
-          break;
-        }
-        
-        numOfPredBlocks++;
+      case 4:
+        distortion += sadRun(boundary, nbRing, regionSize);
+        break;          
+      case 5:
+        distortion += sadRun(boundary + 16, nbRing + 16, regionSize);
+        break;                
+      case 6:
+        distortion += sadRun(boundary + 32, nbRing + 32, regionSize);
+        break;                
+      case 7:
+        distortion += sadRun(boundary + 48, nbRing + 48, regionSize);
+        break;
       }
     }
-    
-    threshold--;
-    if (threshold < ERC_BLOCK_CONCEALED)
-      break;
-  } while (numOfPredBlocks == 0);
-  
-  if(numOfPredBlocks == 0)
-    return 0;
+  }
 
   return (distortion/numOfPredBlocks);
 }
@@ -3238,6 +4820,8 @@ int findaveragemv(int allmv[8][2],int comp)
 			sum+=allmv[i][comp];
 		}
 	}
+	if(count==0)
+		return 0;
 	avg=sum/count;
 	return avg;
 }
@@ -3272,7 +4856,11 @@ int findmedianmv(int allmv[8][2],int comp)
 	}
 
 	//Find the median
-	if(j/2==1)
+	if(j==0)
+	{
+		median = 0;
+	}
+	else if(j%2==1)
 	{
 		median = mvs[j/2];
 	}
@@ -3289,91 +4877,86 @@ int findmedianmv(int allmv[8][2],int comp)
 /**************************************************************************************************************/
 //Adaptive Block Size Temporal Concealment
 
-static int concealABS(frame *recfr, imgpel *predMB, int currMBNum, objectBuffer_t *object_list, 
+static int concealABS(frame *recfr, ercWorker_t *worker, int currMBNum, objectBuffer_t *object_list, 
 					  int predBlocks[], int32 picSizeX, int32 picSizeY, int *yCondition)
 {
 	int numMBPerLine, mb_ecmode=ECMODE1, threshold = ERC_BLOCK_CONCEALED; //default values
 	
 	numMBPerLine = (int) (picSizeX>>4);
 
+	resetMVCandCache(worker);
+
 	//Find the ECMode for this MB from the neighbors
 
-	if(FOURMODES)
-		mb_ecmode = fourmodes_find_mb_ecmode(predBlocks,numMBPerLine,currMBNum);
+	if(ercInter->fourmodes)
+		mb_ecmode = fourmodes_find_mb_ecmode(worker->img,predBlocks,numMBPerLine,currMBNum);
 	else
-		mb_ecmode = find_mb_ecmode(predBlocks,numMBPerLine,currMBNum);
+		mb_ecmode = find_mb_ecmode(worker->img,predBlocks,numMBPerLine,currMBNum);
 
-	printf("%d\t%d\n",currMBNum, mb_ecmode);
+	// Diagnostics, not for the parallel waves: the lines of the workers interleave
+	// printf("%d\t%d\n",currMBNum, mb_ecmode);
 
-	switch(mb_ecmode)
-	{
-	case ECMODE1:
-		concealABS_ECMODE1(recfr,predMB,currMBNum,object_list,predBlocks,picSizeX,picSizeY,yCondition);
-		break;
-	case ECMODE2:
-		concealABS_ECMODE2(recfr,predMB,currMBNum,object_list,predBlocks,picSizeX,picSizeY,yCondition);
-		break;
-	case ECMODE3:
-		concealABS_ECMODE3(recfr,predMB,currMBNum,object_list,predBlocks,picSizeX,picSizeY,yCondition);
-		break;
-	case ECMODE4:
-		concealABS_ECMODE4(recfr,predMB,currMBNum,object_list,predBlocks,picSizeX,picSizeY,yCondition);
-		break;
-	case ECMODE5:
-		concealABS_ECMODE5(recfr,predMB,currMBNum,object_list,predBlocks,picSizeX,picSizeY,yCondition);
-		break;
-	case ECMODE6:
-		concealABS_ECMODE6(recfr,predMB,currMBNum,object_list,predBlocks,picSizeX,picSizeY,yCondition);
-		break;
-	case ECMODE7:
-		concealABS_ECMODE7(recfr,predMB,currMBNum,object_list,predBlocks,picSizeX,picSizeY,yCondition);
-		break;
-	case ECMODE8:
-		concealABS_ECMODE8(recfr,predMB,currMBNum,object_list,predBlocks,picSizeX,picSizeY,yCondition);
-		break;
-	}
+	concealByPartition(recfr,worker,currMBNum,object_list,predBlocks,picSizeX,picSizeY,yCondition,mb_ecmode);
 
 	return 0;
 }
 
-int find_mb_ecmode(int predBlocks[],int numMBPerLine,int currMBNum)
+/*!
+ ************************************************************************
+ * \brief
+ *      Index of an MB into ecmodeTable[], from the classes of its above,
+ *      left, below and right neighbours. Only neighbours that are
+ *      correct or already concealed are available.
+ ************************************************************************
+ */
+static int ecmodeIndex(struct img_par *img, int predBlocks[], int numMBPerLine, int currMBNum)
 {
-	int i, predMBNum=0, numIntraNeighbours=0, threshold=ERC_BLOCK_CONCEALED, mb_ecmode=ECMODE1; //default mode
-	int mode_A=4, mode_L=4, mode_B=4, mode_R=4;
-	int mode_A_available=0, mode_L_available=0, mode_B_available=0, mode_R_available=0;
+  static const int offset[4] = { NUM_ECCLASSES*NUM_ECCLASSES*NUM_ECCLASSES, NUM_ECCLASSES*NUM_ECCLASSES, NUM_ECCLASSES, 1 };
+  int neighbor[4];
+  int i, index = 0;
 
-	for (i = 4; i < 8; i++) 
-    {
-        if (predBlocks[i] >= threshold) 
-        {
-			switch (i) 
-			{
-			case 4:
-				predMBNum = currMBNum-numMBPerLine;
-				mode_A = img->mb_data[predMBNum].mb_type;
-				mode_A_available = 1;
-				break;              
-			case 5:
-				predMBNum = currMBNum-1;
-				mode_L = img->mb_data[predMBNum].mb_type;
-				mode_L_available = 1;
-				break;              
-			case 6:
-				predMBNum = currMBNum+numMBPerLine;
-				mode_B = img->mb_data[predMBNum].mb_type;
-				mode_B_available = 1;
-				break;              
-			case 7:
-				predMBNum = currMBNum+1;
-				mode_R = img->mb_data[predMBNum].mb_type;
-				mode_R_available = 1;
-				break;
-			}
-		}
-	}
+  neighbor[0] = currMBNum-numMBPerLine;
+  neighbor[1] = currMBNum-1;
+  neighbor[2] = currMBNum+numMBPerLine;
+  neighbor[3] = currMBNum+1;
 
-	//Determine if this MB is to be concealed using SEC or TEC
-	if(mode_A_available && mode_A>=9)
+  for (i = 0; i < 4; i++)
+  {
+    if (predBlocks[4+i] >= ERC_BLOCK_CONCEALED)
+      index += offset[i] * ecClassOfType[min(img->mb_data[neighbor[i]].mb_type, 15)];
+  }
+
+  return index;
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Partition mode (ECMODE1..ECMODE8) of the adaptive block size
+ *      concealment for an MB, from the mb_types of its neighbours, see
+ *      ecmodeRules()
+ ************************************************************************
+ */
+int find_mb_ecmode(struct img_par *img, int predBlocks[],int numMBPerLine,int currMBNum)
+{
+  return ecmodeTable[0][ecmodeIndex(img, predBlocks, numMBPerLine, currMBNum)];
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      The rules of find_mb_ecmode() on the mb_types of the above (A),
+ *      left (L), below (B) and right (R) neighbours. Only run by
+ *      buildEcmodeTables().
+ ************************************************************************
+ */
+static int ecmodeRules(int mode_A, int mode_L, int mode_B, int mode_R,
+                       int mode_A_available, int mode_L_available, int mode_B_available, int mode_R_available)
+{
+	int numIntraNeighbours=0, mb_ecmode=ECMODE1; //default mode
+
+	//Determine if this MB is to be concealed using SEC or TEC
+	if(mode_A_available && mode_A>=9)
 		numIntraNeighbours++;
 	if(mode_L_available && mode_L>=9)
 		numIntraNeighbours++;
@@ -3492,6511 +5075,2179 @@ int find_mb_ecmode(int predBlocks[],int numMBPerLine,int currMBNum)
 	//return ECMODE1;
 }
 
-/**********************************************************************************************************************/
-//EC Mode 1
-static int concealABS_ECMODE1(frame *recfr, imgpel *predMB,int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
-                      int32 picSizeX, int32 picSizeY, int *yCondition)
+/*!
+ ************************************************************************
+ * \brief
+ *      Sum of absolute differences of two runs of len (8 or 16)
+ *      consecutive pixels. This is the innermost loop of the candidate
+ *      matching, so it has SSE2 and AVX2 versions; the plain C loop is
+ *      used when neither is available or ERC_NO_SIMD is defined.
+ ************************************************************************
+ */
+static int sadRun(imgpel *a, imgpel *b, int len)
 {
-	//STEPS :- 
-	//1. Adaptively decide the block mode for concealment
-	//2. MV candidates: MVh, MVv, ZMV, AMV, MMV, PMV, MVd
-	//3. OBMA as dsm criterion, use even the concealed internal nbrs i.e. modified OBMA
-	//4. OBMC for block compensation - this will be final concealed block
-	
-	int predMBNum = 0, numMBPerLine, compSplit1 = 0, compSplit2 = 0, compLeft = 1, comp = 0, compPred, order = 1,
-        fInterNeighborExists, numIntraNeighbours, fZeroMotionChecked, predSplitted = 0, threshold = ERC_BLOCK_OK,
-        minDist, currDist, i, k, bestDir;
-	int32 regionSize, mvBest[3] , mvPred[3], *mvptr;
-	objectBuffer_t *currRegion;
-	
-	//Santosh
- 	imgpel *predMB_OBMC;
-	
-	if(OBMC)
-		predMB_OBMC = (imgpel *) malloc ( (256 + (img->mb_cr_size_x*img->mb_cr_size_y)*2) * sizeof (imgpel));
+#if ERC_SIMD_SSE2 && defined(IMGTYPE) && (IMGTYPE == 0)
+  // 8 bit samples: one psadbw per run
+  __m128i sad;
 
-	numMBPerLine = (int) (picSizeX>>4);  
-	comp = 0;
-	regionSize = 16;
+  if (len == 16)
+  {
+    sad = _mm_sad_epu8(_mm_loadu_si128((__m128i *) a), _mm_loadu_si128((__m128i *) b));
+    return _mm_cvtsi128_si32(sad) + _mm_extract_epi16(sad, 4);
+  }
+  sad = _mm_sad_epu8(_mm_loadl_epi64((__m128i *) a), _mm_loadl_epi64((__m128i *) b));
+  return _mm_cvtsi128_si32(sad);
 
-	//Get the current region
-	currRegion = object_list+(currMBNum<<2); //comp=0, since we are working on whole 16x16 MB
+#elif ERC_SIMD_SSE2
+  // 16 bit samples: |a-b| with two saturating subtractions, widened to 32 bit before summing
+  __m128i va, vb, diff, sum, zero = _mm_setzero_si128();
+  int i = 0;
 
-	/* set the position of the region to be concealed */
-    
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
+#if ERC_SIMD_AVX2
+  if (len == 16)
+  {
+    __m256i wa = _mm256_loadu_si256((__m256i *) a);
+    __m256i wb = _mm256_loadu_si256((__m256i *) b);
+    __m256i wdiff = _mm256_or_si256(_mm256_subs_epu16(wa, wb), _mm256_subs_epu16(wb, wa));
+    __m256i wzero = _mm256_setzero_si256();
+    __m256i wsum = _mm256_add_epi32(_mm256_unpacklo_epi16(wdiff, wzero), _mm256_unpackhi_epi16(wdiff, wzero));
+
+    sum = _mm_add_epi32(_mm256_castsi256_si128(wsum), _mm256_extracti128_si256(wsum, 1));
+    i = 16;
+  }
+  else
+#endif
+    sum = zero;
 
-	do
-	{
-		/*Reliability Loop*/
-		minDist = 0; //Minimum Distortion
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;
+  for ( ; i < len; i += 8)
+  {
+    va   = _mm_loadu_si128((__m128i *) (a + i));
+    vb   = _mm_loadu_si128((__m128i *) (b + i));
+    diff = _mm_or_si128(_mm_subs_epu16(va, vb), _mm_subs_epu16(vb, va));
+    sum  = _mm_add_epi32(sum, _mm_unpacklo_epi16(diff, zero));
+    sum  = _mm_add_epi32(sum, _mm_unpackhi_epi16(diff, zero));
+  }
 
-		/*Looping 4 neighbors*/
-		for(i=4;i<8;i++)
-		{
-			/* If reliable, try it */
-			if (predBlocks[i] >= threshold) 
-			{
-				switch (i) 
-				{
-				case 4:
-					predMBNum = currMBNum-numMBPerLine;
-					compSplit1 = 2;
-					compSplit2 = 3;
-					break;              
-				case 5:
-					predMBNum = currMBNum-1;
-					compSplit1 = 1;
-					compSplit2 = 3;
-					break;              
-				case 6:
-					predMBNum = currMBNum+numMBPerLine;
-					compSplit1 = 0;
-					compSplit2 = 1;
-					break;              
-				case 7:
-					predMBNum = currMBNum+1;
-					compSplit1 = 0;
-					compSplit2 = 2;
-					break;
-				}
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+  return _mm_cvtsi128_si32(sum);
 
-				/* Try the concealment with the Motion Info of the current neighbour
-				   only if the neighbour is not Intra */
-				if(isBlock(object_list,predMBNum,compSplit1,INTRA) || isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				} 
-				else
-				{
-					/* If neighbour MB is splitted, try both neighbour blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0;compPred = compSplit2,predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-							 /* If Zero Motion Block, do the copying. This option is tried only once */
-							if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-							{
-								if (fZeroMotionChecked) 
-								{
-									continue;
-								}
-								else 
-								{
-									fZeroMotionChecked = 1;
-									mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-
-									if(OBMA)
-										buildOuterPredRegionYUV(erc_img, mvPred, currRegion->xMin, currRegion->yMin, predMB, boundary);
-									else
-										buildPredRegionYUV(erc_img,mvPred,currRegion->xMin,currRegion->yMin,predMB);
-								}
-							}
-							else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-							{
-								continue;
-							}
-							else
-							{
-								mvptr = getParam(object_list, predMBNum, compPred, mv);                
-								mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-								if(OBMA)
-									buildOuterPredRegionYUV(erc_img, mvPred, currRegion->xMin, currRegion->yMin, predMB, boundary);
-								else
-									buildPredRegionYUV(erc_img,mvPred,currRegion->xMin,currRegion->yMin,predMB);
-							}
-
-							/* Measure absolute boundary pixel difference */
-							if(OBMA)
-								currDist = edgeDistortionOBMA(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize, boundary);
-							else
-								currDist = edgeDistortion(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize);
-							
-							/* If so far best -> store the pixels as the best concealment */
-							if (currDist < minDist || !fInterNeighborExists) 
-							{
-								minDist = currDist;
-								bestDir = i;
-            
-								for (k=0;k<3;k++) 
-									mvBest[k] = mvPred[k];
-            
-								currRegion->regionMode = (isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-														 ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-														 ((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-								
-								if(!OBMC)
-									copyPredMB(MBNum2YBlock(currMBNum,comp,picSizeX), predMB, recfr, picSizeX, regionSize);
-							}
-
-							fInterNeighborExists = 1;
-					}
-				}          
-			}
-		}
+#else
+  int i, sad = 0;
 
-		threshold--;
-	}while((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
+  for (i = 0; i < len; i++)
+    sad += mabs((int)(a[i] - b[i]));
 
-	/* Always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-		mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
+  return sad;
+#endif
+}
 
-		if(OBMA)
-			buildOuterPredRegionYUV(erc_img, mvPred, currRegion->xMin, currRegion->yMin, predMB, boundary);
-		else
-			buildPredRegionYUV(erc_img,mvPred,currRegion->xMin,currRegion->yMin,predMB);
+/*!
+ ************************************************************************
+ * \brief
+ *      Sum of absolute differences along an 8 or 16 pixel boundary
+ *      segment. Segments that are not contiguous in memory (the left
+ *      and right columns) are first gathered into a run, so that
+ *      every side is matched by the same sadRun() kernel.
+ * \param edge
+ *      pixels of the candidate (outer boundary ring or MB edge)
+ * \param strideE
+ *      distance between two consecutive pixels of edge
+ * \param neighbor
+ *      pixels of the neighbouring blocks in the frame
+ * \param strideN
+ *      distance between two consecutive pixels of neighbor
+ * \param len
+ *      number of pixels in the segment, 8 or 16
+ ************************************************************************
+ */
+static int boundarySAD(imgpel *edge, int strideE, imgpel *neighbor, int strideN, int len)
+{
+  imgpel edgeRun[MB_BLOCK_SIZE], neighborRun[MB_BLOCK_SIZE];
+  int i;
 
-		if(OBMA)
-			currDist = edgeDistortionOBMA(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize, boundary);
-		else
-			currDist = edgeDistortion(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),predMB, recfr->yptr, picSizeX, regionSize);
-      
-		if (currDist < minDist || !fInterNeighborExists) 
-		{
-			minDist = currDist;            
-			for (k=0;k<3;k++) 
-				mvBest[k] = mvPred[k];
-        
-			currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-        
-			if(!OBMC)
-				copyPredMB(MBNum2YBlock(currMBNum,comp,picSizeX), predMB, recfr, picSizeX, regionSize);
-		}
-	}
+  if (strideE != 1)
+  {
+    for (i = 0; i < len; i++)
+      edgeRun[i] = edge[i*strideE];
+    edge = edgeRun;
+  }
+  if (strideN != 1)
+  {
+    for (i = 0; i < len; i++)
+      neighborRun[i] = neighbor[i*strideN];
+    neighbor = neighborRun;
+  }
 
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
-    
-	//We found the best MV....now do OBMC
-	if(OBMC)
-	{
-		//construct MB with best mv found above
-		if(mvBest[0]!=NIL)
-		{
-			buildPredRegionYUV(erc_img, mvBest, currRegion->xMin, currRegion->yMin, predMB);
-		}
+  return sadRun(edge, neighbor, len);
+}
 
-		OBMC_MB(predMB,predMB_OBMC,predBlocks,object_list,currMBNum,numMBPerLine,picSizeX);
-		copyPredMB(MBNum2YBlock(currMBNum,0,picSizeX), predMB_OBMC, recfr, picSizeX, regionSize);
-	}
+/*!
+ ************************************************************************
+ * \brief
+ *      Boundary matching distortion of one partition of the MB. Only the
+ *      segments of the MB boundary that the partition touches are
+ *      compared, either the outer boundary ring of the candidate with
+ *      the pixels of the neighbours (OBMA) or the edge pixels of the
+ *      candidate with the neighbours. Correctly received neighbours are
+ *      preferred; the already concealed ones are used only if no
+ *      correct neighbour exists.
+ * \return
+ *      The boundary pixel difference per used neighbour, or a value of
+ *      at least maxDist if the measurement was stopped.
+ * \param part
+ *      the partition, from ecPartitionTable
+ * \param predBlocks
+ *      status array of the neighboring blocks (if they are OK, concealed or lost)
+ * \param cand
+ *      the candidate whose prediction is measured
+ * \param nbRing
+ *      pixels of the neighbours of the MB, see loadNeighbourRing()
+ * \param maxDist
+ *      the distortion to beat, the remaining neighbours are skipped once
+ *      the result cannot get below it (INT_MAX measures all of them)
+ ************************************************************************
+ */
+static int partitionDistortion(const ecPartition_t *part, int predBlocks[], ercMVCandidate_t *cand,
+                               imgpel *nbRing, int maxDist)
+{
+  int s, len, distortion, numOfPredBlocks, limit, threshold, sides = 0;
+  int strideE = 1;
+  imgpel *neighbor = NULL, *edge = NULL;
 
-    yCondition[MBNum2YBlock(currMBNum,0,picSizeX)] = ERC_BLOCK_CONCEALED;
+  for (s = 0; s < 4; s++)
+  {
+    if (part->nbComp[s][0] >= 0)
+      sides |= 1<<s;
+  }
 
-	if(OBMC)
-		free(predMB_OBMC);
+  numOfPredBlocks = usedNeighbours(predBlocks, sides, &threshold);
+  if(numOfPredBlocks == 0)
+    return 0;
 
-	return 0;
-}
+  /* stop as soon as the distortion per neighbour can no longer get below maxDist */
+  limit = (maxDist > INT_MAX/4) ? INT_MAX : maxDist*numOfPredBlocks;
+  distortion = 0;
 
-/**********************************************************************************************************************/
-//EC Mode 2
-static int concealABS_ECMODE2(frame *recfr, imgpel *predMB,int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
-                      int32 picSizeX, int32 picSizeY, int *yCondition)
-{
-	imgpel *pred_ecmodeMB, *upper_pred_ecmodeMB, *lower_pred_ecmodeMB;
+  /* loop the neighbours touched by the partition */
+  for (s = 0; s < 4 && distortion < limit; s++)
+  {
+    if (!(sides & (1<<s)) || predBlocks[4+s] < threshold)
+      continue;
 
-	int predMBNum = 0, numMBPerLine,
-      compSplit1 = 0, compSplit2 = 0, compLeft = 1, comp = 0, compPred, order = 1,
-      fInterNeighborExists, numIntraNeighbours,
-      fZeroMotionChecked, predSplitted = 0,
-      threshold = ERC_BLOCK_OK,
-      minDist, currDist, i, k, j, p, bestDir;
-	int32 regionSize;
-	objectBuffer_t *currRegion;
-	int32 mvBest[3] , mvPred[3], *mvptr;
+    switch (s)
+    {
+    case 0:
+      len = part->width;
+      neighbor = nbRing + part->x0;
+      edge = ercInter->obma ? cand->ring + part->x0 : cand->pred + part->x0;
+      strideE = 1;
+      break;
+    case 1:
+      len = part->height;
+      neighbor = nbRing + MB_BLOCK_SIZE + part->y0;
+      edge = ercInter->obma ? cand->ring + MB_BLOCK_SIZE + part->y0 : cand->pred + part->y0*MB_BLOCK_SIZE;
+      strideE = ercInter->obma ? 1 : MB_BLOCK_SIZE;
+      break;
+    case 2:
+      len = part->width;
+      neighbor = nbRing + 2*MB_BLOCK_SIZE + part->x0;
+      edge = ercInter->obma ? cand->ring + 2*MB_BLOCK_SIZE + part->x0 : cand->pred + (MB_BLOCK_SIZE-1)*MB_BLOCK_SIZE + part->x0;
+      strideE = 1;
+      break;
+    default:
+      len = part->height;
+      neighbor = nbRing + 3*MB_BLOCK_SIZE + part->y0;
+      edge = ercInter->obma ? cand->ring + 3*MB_BLOCK_SIZE + part->y0 : cand->pred + part->y0*MB_BLOCK_SIZE + MB_BLOCK_SIZE-1;
+      strideE = ercInter->obma ? 1 : MB_BLOCK_SIZE;
+      break;
+    }
 
-	//Santosh
-	imgpel *predMB_OBMC;
-	
-	//16x8 for luma and 8x4, 8x4 for chroma
-	pred_ecmodeMB = (imgpel *) malloc ( (128 + (img->mb_cr_size_x*img->mb_cr_size_y/2)*2) * sizeof (imgpel));
-	upper_pred_ecmodeMB = (imgpel *) malloc ( (128 + (img->mb_cr_size_x*img->mb_cr_size_y/2)*2) * sizeof (imgpel));
-	lower_pred_ecmodeMB = (imgpel *) malloc ( (128 + (img->mb_cr_size_x*img->mb_cr_size_y/2)*2) * sizeof (imgpel));
+    distortion += boundarySAD(edge, strideE, neighbor, 1, len);
+  }
 
-	if(OBMC)
-		predMB_OBMC = (imgpel *) malloc ( (256 + (img->mb_cr_size_x*img->mb_cr_size_y)*2) * sizeof (imgpel));
+  return (distortion/numOfPredBlocks);
+}
 
-	numMBPerLine = (int) (picSizeX>>4);
-  	comp = 0;
-	regionSize = 16;
+/*!
+ ************************************************************************
+ * \brief
+ *      Copies the pixels of one partition between two full MB buffers
+ *      (predMB layout, y = predMB, u = predMB+256, v = predMB+320).
+ ************************************************************************
+ */
+static void copyPredPartition(ercContext_t *ctx, imgpel *src, imgpel *dst, const ecPartition_t *part)
+{
+  int j, uv, offset;
 
-	//UPPER HALF
-	threshold = ERC_BLOCK_OK;
-	comp=0;
-	currRegion = object_list+(currMBNum<<2)+comp;
-	
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
+  for (j = part->y0; j < part->y0 + part->height; j++)
+  {
+    offset = j*MB_BLOCK_SIZE + part->x0;
+    memcpy(dst + offset, src + offset, part->width * sizeof(imgpel));
+  }
 
-	do
-	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;	
-
-		/* loop the 3 neighbours */
-		for (i = 4; i < 8; i++) 
-		{
-   			if(i==6)
-				continue;//Below does not exist for upper half
+  if (ctx->dec_picture->chroma_format_idc != YUV400)
+  {
+    for (uv = 0; uv < 2; uv++)
+    {
+      for (j = (part->y0>>1); j < ((part->y0 + part->height)>>1); j++)
+      {
+        offset = 256 + uv*64 + j*8 + (part->x0>>1);
+        memcpy(dst + offset, src + offset, (part->width>>1) * sizeof(imgpel));
+      }
+    }
+  }
+}
 
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
-			{
-				switch (i) 
-				{
-				case 4:
-					predMBNum = currMBNum-numMBPerLine;
-					compSplit1 = 2;
-					compSplit2 = 3;
-					break;              
-				case 5:
-					predMBNum = currMBNum-1;
-					compSplit1 = 1;
-					compSplit2 = 1;
-					break;              
-				case 7:
-					predMBNum = currMBNum+1;
-					compSplit1 = 0;
-					compSplit2 = 0;
-					break;
-				}
+/*!
+ ************************************************************************
+ * \brief
+ *      Builds the prediction of one partition into a compact buffer
+ *      (see extractPredPartition()).
+ ************************************************************************
+ */
+static void buildPartitionPredYUV(ercWorker_t *worker, int32 *mv, int x, int y, imgpel *partMB, const ecPartition_t *part)
+{
+  ercMVCandidate_t *cand = getMVCandidate(worker, mv, x, y, CAND_YUV);
 
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE2(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,0);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE2(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,0);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE2(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 0);
-						
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode =
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<128+32+32;p++)
-							{
-								upper_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-							}
-						}
-              
-						fInterNeighborExists = 1;    
-					}
-				}
-			}
-		}
+  extractPredPartition(worker->ctx, cand->pred, partMB, part->x0, part->y0, part->width, part->height);
+}
 
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE2(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,0);
+/*!
+ ************************************************************************
+ * \brief
+ *      Boundary distortion of a candidate MV, for a partition of the MB
+ *      (partitionDistortion()) or, without one, for the whole region of
+ *      concealByTrial() (edgeDistortion() or edgeDistortionOBMA()). It is
+ *      measured once per distinct candidate and partition.
+ * \return
+ *      The distortion if it is below maxDist, otherwise a value of at
+ *      least maxDist: a candidate that cannot win is not measured to
+ *      the end.
+ * \param part
+ *      the partition, NULL for the whole region
+ * \param p
+ *      index of the partition in its ECMODE, 0 without a partition
+ * \param maxDist
+ *      the distortion of the best candidate so far, INT_MAX if there is none
+ ************************************************************************
+ */
+static int candidateDistortion(ercWorker_t *worker, int32 *mv, int x, int y, int predBlocks[], int32 regionSize,
+                               const ecPartition_t *part, int p, int maxDist)
+{
+  ercMVCandidate_t *cand = getMVCandidate(worker, mv, x, y, ercInter->obma ? CAND_RING : CAND_LUMA);
 
-	  currDist = edgeDistortion_ECMODE2(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 0);
-      
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
+  return measureDistortion(cand, worker->nbRing, predBlocks, regionSize, part, p, maxDist);
+}
 
-		for(p=0;p<128+32+32;p++)
-		{
-			upper_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-		}
-	  }
-    }
+/*!
+ ************************************************************************
+ * \brief
+ *      Boundary distortions of the candidate list of an MB or partition,
+ *      all matched against the neighbour ring the worker loaded for the
+ *      MB (loadNeighbourRing()). Without an early exit the list is
+ *      measured in one batch (batchDistortions()). With one, each
+ *      candidate is measured against the best distortion of the list so
+ *      far (see candidateDistortion()), so the list can stop at the first
+ *      good one. Both give the same choice as measuring them one by one.
+ * \return
+ *      The number of candidates measured: the list stops after the first
+ *      one whose distortion is below stopDist.
+ * \param mvs
+ *      the candidate MVs, in the order they are tried
+ * \param numCand
+ *      the number of candidates
+ * \param maxDist
+ *      the distortion of the best candidate before the list, INT_MAX if
+ *      there is none
+ * \param stopDist
+ *      the distortion that ends the list early, 0 measures all candidates
+ * \param dist
+ *      set to the distortion of each measured candidate
+ ************************************************************************
+ */
+static int candidateDistortions(ercWorker_t *worker, int32 mvs[][3], int numCand, int x, int y, int predBlocks[],
+                                int32 regionSize, const ecPartition_t *part, int p, int maxDist, int stopDist, int dist[])
+{
+  int i;
 
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
-    
-	//LOWER HALF
-	threshold = ERC_BLOCK_OK;
-	comp=2;
-	currRegion = object_list+(currMBNum<<2)+comp;
+  if (stopDist <= 0 && numCand > 1)
+    return batchDistortions(worker, mvs, numCand, x, y, predBlocks, regionSize, part, p, dist);
 
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    
-	do
-	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;
-
-		/* loop the 3 neighbours */ //(No above for below half)
-		for (i = 5; i < 8; i++) 
-		{
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
-			{
-				switch (i) 
-				{
-				case 5:
-					predMBNum = currMBNum-1;
-					compSplit1 = 3;
-					compSplit2 = 3;
-					break;   
-				case 6:
-					predMBNum = currMBNum+numMBPerLine;
-					compSplit1 = 0;
-					compSplit2 = 1;
-					break;
-				case 7:
-					predMBNum = currMBNum+1;
-					compSplit1 = 2;
-					compSplit2 = 2;
-					break;
-				}
+  for (i = 0; i < numCand; i++)
+  {
+    dist[i] = candidateDistortion(worker, mvs[i], x, y, predBlocks, regionSize, part, p, maxDist);
+    if (dist[i] < maxDist)
+      maxDist = dist[i];
+    if (dist[i] < stopDist)
+      return i+1;
+  }
 
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE2(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE2(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE2(predBlocks,MBNum2YBlock(currMBNum,0,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 1);
-
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode = 
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<128+32+32;p++)
-							{
-								lower_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-							}
-						}
-              
-						fInterNeighborExists = 1;
-					}
-				}
-			}
-		}
+  return numCand;
+}
 
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
+/*!
+ ************************************************************************
+ * \brief
+ *      Boundary distortions of a whole candidate list in one pass, for
+ *      candidateDistortions() without an early exit. The boundary pixels
+ *      that the matching compares (the sides and segments of
+ *      edgeDistortion(), edgeDistortionOBMA() or partitionDistortion())
+ *      are gathered from each candidate into worker->candEdges, one row
+ *      per pixel and one column per candidate, and candidateSADs() then
+ *      sums the differences to the neighbour ring of all candidates at
+ *      once. Every candidate is measured to the end: a distortion of at
+ *      least the best one is never chosen, so this gives the same choice
+ *      as the measurement against the best one so far. Candidates whose
+ *      distortion is already known are not measured again.
+ * \return
+ *      numCand, all candidates are measured
+ ************************************************************************
+ */
+static int batchDistortions(ercWorker_t *worker, int32 mvs[][3], int numCand, int x, int y, int predBlocks[],
+                            int32 regionSize, const ecPartition_t *part, int p, int dist[])
+{
+  ercMVCandidate_t *cand[CAND_LANES];
+  int32 key[CAND_LANES][3];
+  int lane[MAX_CAND_LIST], sad[CAND_LANES], offset[4*MB_BLOCK_SIZE];
+  imgpel nb[4*MB_BLOCK_SIZE];
+  imgpel *edges = worker->candEdges, *src;
+  int i, k, r, s, n, len, first, numPos, numLanes, numOfPredBlocks, threshold, sides = 0;
+
+  if (part != NULL)
+  {
+    for (s = 0; s < 4; s++)
     {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE2(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
+      if (part->nbComp[s][0] >= 0)
+        sides |= 1<<s;
+    }
+  }
+  else
+    sides = 15;
 
-	  currDist = edgeDistortion_ECMODE2(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 1);
+  numOfPredBlocks = usedNeighbours(predBlocks, sides, &threshold);
 
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
+  /* the pixels compared, as positions in the neighbour ring and in the candidate */
+  numPos = 0;
+  for (s = 0; s < 4 && numOfPredBlocks > 0; s++)
+  {
+    if (!(sides & (1<<s)) || predBlocks[4+s] < threshold)
+      continue;
 
-		for(p=0;p<128+32+32;p++)
-		{
-			lower_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-		}
+    if (part != NULL)
+    {
+      first = (s & 1) ? part->y0 : part->x0;
+      len   = (s & 1) ? part->height : part->width;
+    }
+    else
+    {
+      first = 0;
+      len   = regionSize;
+    }
+
+    for (k = first; k < first + len; k++)
+    {
+      nb[numPos] = worker->nbRing[s*MB_BLOCK_SIZE + k];
+      if (ercInter->obma)
+        offset[numPos] = s*MB_BLOCK_SIZE + k;
+      else
+      {
+        /* edge pixels of the prediction, the last row and column are those of the region */
+        r = (part != NULL) ? MB_BLOCK_SIZE-1 : regionSize-1;
+        switch (s)
+        {
+        case 0:
+          offset[numPos] = k;
+          break;
+        case 1:
+          offset[numPos] = k*MB_BLOCK_SIZE;
+          break;
+        case 2:
+          offset[numPos] = r*MB_BLOCK_SIZE + k;
+          break;
+        default:
+          offset[numPos] = k*MB_BLOCK_SIZE + r;
+          break;
+        }
       }
+      numPos++;
     }
+  }
 
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
+  /* gather the candidates whose distortion is not known yet, each right after getMVCandidate():
+     a long list can replace an earlier candidate of the batch in the cache */
+  for (i = 0, n = 0; i < numCand; i++)
+  {
+    cand[n] = getMVCandidate(worker, mvs[i], x, y, ercInter->obma ? CAND_RING : CAND_LUMA);
+    if (cand[n]->dist[p] >= 0)
+    {
+      dist[i] = cand[n]->dist[p];
+      lane[i] = -1;
+      continue;
+    }
 
-	//Whole MB concealed at this stage, copy to predMB
+    src = ercInter->obma ? cand[n]->ring : cand[n]->pred;
+    for (r = 0; r < numPos; r++)
+      edges[r*CAND_LANES + n] = src[offset[r]];
+    for (k = 0; k < 3; k++)
+      key[n][k] = cand[n]->mv[k];
+    lane[i] = n++;
+  }
 
-	for(j=0;j<8;j++)
-	{
-		for(i=0;i<16;i++)
-		{
-			predMB[j*16+i] = upper_pred_ecmodeMB[j*16+i];
-			predMB[(j+8)*16+i] = lower_pred_ecmodeMB[j*16+i];
-		}
-	}
+  if (n == 0)
+    return numCand;
 
-	for(j=0;j<4;j++)
-	{
-		for(i=0;i<8;i++)
-		{
-			predMB[256+j*8+i] = upper_pred_ecmodeMB[128+j*8+i];
-			predMB[256+(j+4)*8+i] = lower_pred_ecmodeMB[128+j*8+i];
-			predMB[256+64+j*8+i] = upper_pred_ecmodeMB[160+j*8+i];
-			predMB[256+64+(j+4)*8+i] = lower_pred_ecmodeMB[160+j*8+i];
-		}
-	}
+  /* pad the batch to whole registers */
+  numLanes = (n + 15) & ~15;
+  for (r = 0; r < numPos; r++)
+    memset(edges + r*CAND_LANES + n, 0, (numLanes - n) * sizeof(imgpel));
 
-	if(OBMC)
-	{
-		OBMC_MB(predMB,predMB_OBMC,predBlocks,object_list,currMBNum,numMBPerLine,picSizeX);
-		copyPredMB(MBNum2YBlock(currMBNum,0,picSizeX), predMB_OBMC, recfr, picSizeX, regionSize);
-	}
-	else
-		copyPredMB(MBNum2YBlock(currMBNum,0,picSizeX), predMB, recfr,picSizeX, regionSize);
-
-	yCondition[MBNum2YBlock(currMBNum,0,picSizeX)] = ERC_BLOCK_CONCEALED;
+  if (numPos > 0)
+    candidateSADs(edges, nb, numPos, numLanes, sad);
+  else
+    memset(sad, 0, numLanes * sizeof(int));
 
-	free(pred_ecmodeMB);
-	free(upper_pred_ecmodeMB);
-	free(lower_pred_ecmodeMB);
+  for (i = 0; i < numCand; i++)
+  {
+    if ((k = lane[i]) < 0)
+      continue;
 
-	if(OBMC)
-		free(predMB_OBMC);
+    dist[i] = (numOfPredBlocks > 0) ? sad[k]/numOfPredBlocks : 0;
+    if (cand[k]->mv[0] == key[k][0] && cand[k]->mv[1] == key[k][1] && cand[k]->mv[2] == key[k][2])
+      cand[k]->dist[p] = dist[i];
+  }
 
-	return 0;
+  return numCand;
 }
 
-static void buildOuterPredRegionYUV_ECMODE2(struct img_par *img, int32 *mv, int x, int y, imgpel *predMB, imgpel *boundary, int pos)
+/*!
+ ************************************************************************
+ * \brief
+ *      Sums of absolute differences of a batch of candidates to the
+ *      neighbour pixels, across the candidates: one register holds the
+ *      same boundary pixel of 8 or 16 candidates and is compared with
+ *      that neighbour pixel broadcast. It has SSE2 and AVX2 versions
+ *      like sadRun(); the plain C loop is used when neither is available
+ *      or ERC_NO_SIMD is defined.
+ * \param edges
+ *      boundary pixels, numPos rows of CAND_LANES candidates
+ * \param nb
+ *      the numPos neighbour pixels
+ * \param numLanes
+ *      candidates to sum, a multiple of 16
+ * \param sad
+ *      set to the sum of each candidate
+ ************************************************************************
+ */
+static void candidateSADs(imgpel *edges, imgpel *nb, int numPos, int numLanes, int sad[])
 {
-  int tmp_block[BLOCK_SIZE][BLOCK_SIZE];
-  int i=0,j=0,ii=0,jj=0,i1=0,j1=0,j4=0,i4=0,k=0;
-  int jf=0;
-  int uv;
-  int vec1_x=0,vec1_y=0;
-  int ioff,joff;
-  imgpel *pMB = predMB; //Note: predMB is actually pred_ecmodeMB; for ecmode2, it is upper/lower half, so 16x8 for Y and 8x4,8x4 for UV
-  
-  int ii0,jj0,ii1,jj1,if1,jf1,if0,jf0;
-  int mv_mul;
+#if ERC_SIMD_SSE2 && defined(IMGTYPE) && (IMGTYPE == 0)
+  // 8 bit samples: 16 candidates per register, the sums of at most 64 pixels fit 16 bit
+  __m128i v, n, diff, lo, hi, zero = _mm_setzero_si128();
+  short sum[16];
+  int c, r, i;
 
-  int above[4], left[4], below[4], right[4], index;
-  
-  //FRExt
-  int f1_x, f1_y, f2_x, f2_y, f3, f4, ifx;
-  int b8, b4;
-  int yuv = dec_picture->chroma_format_idc - 1;
-  
-  int ref_frame = max (mv[2], 0); // !!KS: quick fix, we sometimes seem to get negative ref_pic here, so restrict to zero an above
+  for (c = 0; c < numLanes; c += 16)
+  {
+    lo = hi = zero;
+    for (r = 0; r < numPos; r++)
+    {
+      v    = _mm_loadu_si128((__m128i *) (edges + r*CAND_LANES + c));
+      n    = _mm_set1_epi8((char) nb[r]);
+      diff = _mm_or_si128(_mm_subs_epu8(v, n), _mm_subs_epu8(n, v));
+      lo   = _mm_add_epi16(lo, _mm_unpacklo_epi8(diff, zero));
+      hi   = _mm_add_epi16(hi, _mm_unpackhi_epi8(diff, zero));
+    }
+    _mm_storeu_si128((__m128i *) sum, lo);
+    _mm_storeu_si128((__m128i *) (sum + 8), hi);
+    for (i = 0; i < 16; i++)
+      sad[c+i] = (unsigned short) sum[i];
+  }
 
-  /* Update coordinates of the current concealed macroblock */
-  img->mb_x = x/MB_BLOCK_SIZE;
-  img->mb_y = y/MB_BLOCK_SIZE;
-  img->block_y = img->mb_y * BLOCK_SIZE;
-  img->pix_c_y = img->mb_y * img->mb_cr_size_y;
-  img->block_x = img->mb_x * BLOCK_SIZE;
-  img->pix_c_x = img->mb_x * img->mb_cr_size_x;
+#elif ERC_SIMD_AVX2
+  // 16 bit samples: 16 candidates per register, widened to 32 bit before summing
+  __m256i v, n, diff;
+  __m256i lo, hi;
+  int c, r;
 
-  mv_mul=4;
+  for (c = 0; c < numLanes; c += 16)
+  {
+    lo = hi = _mm256_setzero_si256();
+    for (r = 0; r < numPos; r++)
+    {
+      v    = _mm256_loadu_si256((__m256i *) (edges + r*CAND_LANES + c));
+      n    = _mm256_set1_epi16((short) nb[r]);
+      diff = _mm256_or_si256(_mm256_subs_epu16(v, n), _mm256_subs_epu16(n, v));
+      lo   = _mm256_add_epi32(lo, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(diff)));
+      hi   = _mm256_add_epi32(hi, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(diff, 1)));
+    }
+    _mm256_storeu_si256((__m256i *) (sad + c), lo);
+    _mm256_storeu_si256((__m256i *) (sad + c + 8), hi);
+  }
 
-  // luma *******************************************************
+#elif ERC_SIMD_SSE2
+  // 16 bit samples: 8 candidates per register, widened to 32 bit before summing
+  __m128i v, n, diff, lo, hi, zero = _mm_setzero_si128();
+  int c, r;
 
-  for(i=0;i<4;i++)
+  for (c = 0; c < numLanes; c += 8)
   {
-	  above[i]=0;left[i]=0;below[i]=0;right[i]=0;
+    lo = hi = zero;
+    for (r = 0; r < numPos; r++)
+    {
+      v    = _mm_loadu_si128((__m128i *) (edges + r*CAND_LANES + c));
+      n    = _mm_set1_epi16((short) nb[r]);
+      diff = _mm_or_si128(_mm_subs_epu16(v, n), _mm_subs_epu16(n, v));
+      lo   = _mm_add_epi32(lo, _mm_unpacklo_epi16(diff, zero));
+      hi   = _mm_add_epi32(hi, _mm_unpackhi_epi16(diff, zero));
+    }
+    _mm_storeu_si128((__m128i *) (sad + c), lo);
+    _mm_storeu_si128((__m128i *) (sad + c + 4), hi);
   }
 
-  //pos = 0, means upper half, 1 means lower half	
+#else
+  int c, r;
 
-  for(j=0;j<MB_BLOCK_SIZE/BLOCK_SIZE;j++)
+  for (c = 0; c < numLanes; c++)
+    sad[c] = 0;
+  for (r = 0; r < numPos; r++)
   {
-    joff=j*4;
-    j4=img->block_y+j;
-    for(i=0;i<MB_BLOCK_SIZE/BLOCK_SIZE;i++)
+    for (c = 0; c < numLanes; c++)
+      sad[c] += mabs((int)(edges[r*CAND_LANES + c] - nb[r]));
+  }
+#endif
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Keeps the extra MV candidates of an MB (extraMVCandidates()) that
+ *      rank best on the reference pyramid, ercSetCoarseCandidates() of
+ *      them; only those are predicted and measured at full resolution.
+ *      Zero motion is not ranked and always kept, it is the copy of the
+ *      MB. Ties keep the earlier candidate.
+ * \return
+ *      The number of extra candidates left, in their order
+ * \param extraMV
+ *      the extra candidates
+ * \param numExtraMV
+ *      the number of extra candidates
+ * \param recY
+ *      the Y plane of the picture being concealed
+ * \param currYBlockNum
+ *      upper-left 8x8 block of the MB
+ ************************************************************************
+ */
+static int rankExtraCandidates(ercWorker_t *worker, int32 extraMV[][3], int numExtraMV, imgpel *recY, int currYBlockNum,
+                               int x, int y, int predBlocks[], int32 picSizeX, int32 regionSize)
+{
+  int coarse[MAX_MV_CANDIDATES];
+  int i, j, k, n, rank;
+
+  loadCoarseRing(worker, recY + (yPosYBlock(currYBlockNum,picSizeX)<<3)*picSizeX + (xPosYBlock(currYBlockNum,picSizeX)<<3),
+                 predBlocks, picSizeX, regionSize);
+
+  for (i = 0; i < numExtraMV; i++)
+  {
+    if (extraMV[i][0] == 0 && extraMV[i][1] == 0 && extraMV[i][2] == 0)
+      coarse[i] = -1;
+    else
+      coarse[i] = coarseDistortion(worker, extraMV[i], x, y, predBlocks, regionSize);
+  }
+
+  for (i = 0, n = 0; i < numExtraMV; i++)
+  {
+    if (coarse[i] >= 0)
     {
-      ioff=i*4;
-      i4=img->block_x+i;
+      for (j = 0, rank = 0; j < numExtraMV; j++)
+      {
+        if (coarse[j] >= 0 && (coarse[j] < coarse[i] || (coarse[j] == coarse[i] && j < i)))
+          rank++;
+      }
+      if (rank >= coarseCandidates)
+        continue;
+    }
 
-      vec1_x = i4*4*mv_mul + mv[0];
-      vec1_y = j4*4*mv_mul + mv[1];
+    for (k = 0; k < 3; k++)
+      extraMV[n][k] = extraMV[i][k];
+    n++;
+  }
 
-      get_block(ref_frame, listX[0], vec1_x,vec1_y,img,tmp_block);
+  return n;
+}
 
-	  index = i+4*j;
-	  get_boundary(ref_frame, listX[0], vec1_x, vec1_y, img, index, above, left, below, right);
-	  
-	  if(j==0)
-	  {
-		  boundary[4*i+0]=above[0];boundary[4*i+1]=above[1];boundary[4*i+2]=above[2];boundary[4*i+3]=above[3];
-	  }
+/*!
+ ************************************************************************
+ * \brief
+ *      Boundary distortion of a candidate MV on the reference pyramid,
+ *      for the ranking of the extra candidates (rankExtraCandidates()).
+ *      The region and its MV are scaled to the level of
+ *      worker->coarseLevel, the MV rounded to the samples of the level,
+ *      and the samples outside the region (OBMA) or along its edge are
+ *      compared with worker->coarseRing, on the sides of the boundary
+ *      matching at full resolution. Nothing is interpolated.
+ * \return
+ *      The pixel difference per used neighbour, at the coarse level
+ ************************************************************************
+ */
+static int coarseDistortion(ercWorker_t *worker, int32 *mv, int x, int y, int predBlocks[], int32 regionSize)
+{
+  StorablePicture *dec_picture = worker->ctx->dec_picture;
+  struct img_par *img = worker->img;
+  int level = worker->coarseLevel, ref = mv[2];
+  int size_y, width, height, bx, by, n, edge, s, k, cx, cy;
+  int threshold, numOfPredBlocks, distortion = 0;
+  imgpel *coarse, *nb;
+
+  if (ref < 0 || ref >= worker->ctx->list0Size)
+    ref = 0;
+  /* the grey boundary of a missing reference is left to the full resolution */
+  if (worker->ctx->list0[ref] == no_reference_picture && img->framepoc < img->recovery_poc)
+    return 0;
 
-	  if(i==0)
-	  {
-		  boundary[16+4*j+0]=left[0];boundary[16+4*j+1]=left[1];boundary[16+4*j+2]=left[2];boundary[16+4*j+3]=left[3];
-	  }
+  size_y = dec_picture->size_y;
+  if (dec_picture->mb_field[img->current_mb_nr])
+    size_y = dec_picture->size_y/2;
+  coarse = getCoarseLevel(getPaddedRef(worker->ctx->inter, worker->ctx->list0[ref], size_y), level);
+  width  = dec_picture->size_x >> level;
+  height = size_y >> level;
+
+  bx = (x*4 + mv[0] + (2<<level)) >> (level+2);
+  by = (y*4 + mv[1] + (2<<level)) >> (level+2);
+  n = regionSize >> level;
+  edge = ercInter->obma ? 0 : 1;
+
+  numOfPredBlocks = usedNeighbours(predBlocks, 15, &threshold);
+  if (numOfPredBlocks == 0)
+    return 0;
 
-	  if(j==3) //MB_BLOCK_SIZE/BLOCK_SIZE - 1 = 3
-	  {
-		  boundary[32+4*i+0]=below[0];boundary[32+4*i+1]=below[1];boundary[32+4*i+2]=below[2];boundary[32+4*i+3]=below[3];
-	  }
+  for (s = 0; s < 4; s++)
+  {
+    if (predBlocks[4+s] < threshold)
+      continue;
 
-	  if(i==3)
-	  {
-		  boundary[48+4*j+0]=right[0];boundary[48+4*j+1]=right[1];boundary[48+4*j+2]=right[2];boundary[48+4*j+3]=right[3];
-	  }
+    nb = worker->coarseRing + s*(MB_BLOCK_SIZE/2);
 
-      for(ii=0;ii<BLOCK_SIZE;ii++)
-        for(jj=0;jj<MB_BLOCK_SIZE/BLOCK_SIZE;jj++)
-          img->mpr[ii+ioff][jj+joff]=tmp_block[ii][jj];
+    for (k = 0; k < n; k++)
+    {
+      switch (s)
+      {
+      case 0:
+        cx = bx + k;
+        cy = by - 1 + edge;
+        break;
+      case 1:
+        cx = bx - 1 + edge;
+        cy = by + k;
+        break;
+      case 2:
+        cx = bx + k;
+        cy = by + n - edge;
+        break;
+      default:
+        cx = bx + n - edge;
+        cy = by + k;
+        break;
+      }
+      cx = max(0, min(width-1, cx));
+      cy = max(0, min(height-1, cy));
+      distortion += mabs(coarse[cy*width + cx] - nb[k]);
     }
   }
 
-  k=0;
-  for(j=0+8*pos;j<8+8*pos;j++)
-  {
-	  for(i=0;i<16;i++)
-	  {
-		  pMB[k++] = img->mpr[i][j];
-	  }
-  }
+  return (distortion/numOfPredBlocks);
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Loads the pixels around a region into the neighbour ring of the
+ *      worker, in the layout of the OBMA boundary of a candidate: the row
+ *      above, the left column, the row below and the right column, each
+ *      at a multiple of MB_BLOCK_SIZE. The boundary matching of all
+ *      candidates of the region compares with this copy, so the columns
+ *      are gathered from the frame once and not once per candidate.
+ *      Only the sides with a neighbour that can be used are loaded.
+ * \param recY
+ *      pointer to a Y plane of a YUV frame
+ * \param predBlocks
+ *      status array of the neighboring blocks (if they are OK, concealed or lost)
+ * \param currYBlockNum
+ *      index of the upper-left 8x8 block of the region in the Y plane
+ * \param picSizeX
+ *      picture width in pixels
+ * \param regionSize
+ *      dimension of the region, 16 or 8
+ ************************************************************************
+ */
+static void loadNeighbourRing(ercWorker_t *worker, imgpel *recY, int predBlocks[], int currYBlockNum,
+                              int32 picSizeX, int32 regionSize)
+{
+  imgpel *currBlock, *ring = worker->nbRing;
+  int i;
 
-  pMB += 128;
+  currBlock = recY + (yPosYBlock(currYBlockNum,picSizeX)<<3)*picSizeX + (xPosYBlock(currYBlockNum,picSizeX)<<3);
 
-  if (dec_picture->chroma_format_idc != YUV400)
+  if (predBlocks[4] >= ERC_BLOCK_CONCEALED)
+    memcpy(ring, currBlock - picSizeX, regionSize * sizeof(imgpel));
+  if (predBlocks[5] >= ERC_BLOCK_CONCEALED)
   {
-    // chroma *******************************************************
-    f1_x = 64/img->mb_cr_size_x;
-    f2_x=f1_x-1;
+    for (i = 0; i < regionSize; i++)
+      ring[MB_BLOCK_SIZE + i] = currBlock[i*picSizeX - 1];
+  }
+  if (predBlocks[6] >= ERC_BLOCK_CONCEALED)
+    memcpy(ring + 2*MB_BLOCK_SIZE, currBlock + regionSize*picSizeX, regionSize * sizeof(imgpel));
+  if (predBlocks[7] >= ERC_BLOCK_CONCEALED)
+  {
+    for (i = 0; i < regionSize; i++)
+      ring[3*MB_BLOCK_SIZE + i] = currBlock[i*picSizeX + regionSize];
+  }
+}
 
-    f1_y = 64/img->mb_cr_size_y;
-    f2_y=f1_y-1;
+/*!
+ ************************************************************************
+ * \brief
+ *      Loads worker->coarseRing, the neighbour ring of a region at the
+ *      pyramid level of the coarse ranking (coarseLevel()): each sample
+ *      is the rounded mean of the block of the current picture it stands
+ *      for, the same 2x2, 4x4 averaging as in getCoarseLevel(). The
+ *      picture is partly concealed while the frame is concealed, so the
+ *      ring is taken from its current state for every region.
+ * \param currBlock
+ *      upper-left pixel of the region in the Y plane
+ ************************************************************************
+ */
+static void loadCoarseRing(ercWorker_t *worker, imgpel *currBlock, int predBlocks[], int32 picSizeX, int32 regionSize)
+{
+  int level, f, n, s, k, i, j, sum;
+  imgpel *block;
 
-    f3=f1_x*f1_y;
-    f4=f3>>1;
+  level = worker->coarseLevel = coarseLevel(picSizeX);
+  f = 1 << level;
+  n = regionSize >> level;
+
+  for (s = 0; s < 4; s++)
+  {
+    if (predBlocks[4+s] < ERC_BLOCK_CONCEALED)
+      continue;
 
-    for(uv=0;uv<2;uv++)
+    for (k = 0; k < n; k++)
     {
-      for (b8=0;b8<(img->num_blk8x8_uv/2);b8++)
+      switch (s)
       {
-        for(b4=0;b4<4;b4++)
-		{
-          joff = subblk_offset_y[yuv][b8][b4];
-          j4=img->pix_c_y+joff;
-          ioff = subblk_offset_x[yuv][b8][b4];
-          i4=img->pix_c_x+ioff;
-
-          for(jj=0;jj<4;jj++)
-          {
-            jf=(j4+jj)/(img->mb_cr_size_y/4);     // jf  = Subblock_y-coordinate
-            for(ii=0;ii<4;ii++)
-            {
-              ifx=(i4+ii)/(img->mb_cr_size_x/4);  // ifx = Subblock_x-coordinate
-
-              i1=(i4+ii)*f1_x + mv[0];
-              j1=(j4+jj)*f1_y + mv[1];
-            
-              ii0=max (0, min (i1/f1_x,   dec_picture->size_x_cr-1));
-              jj0=max (0, min (j1/f1_y,   dec_picture->size_y_cr-1));
-              ii1=max (0, min ((i1+f2_x)/f1_x, dec_picture->size_x_cr-1));
-              jj1=max (0, min ((j1+f2_y)/f1_y, dec_picture->size_y_cr-1));
-            
-              if1=(i1 & f2_x);
-              jf1=(j1 & f2_y);
-              if0=f1_x-if1;
-              jf0=f1_y-jf1;
-            
-              img->mpr[ii+ioff][jj+joff]=(if0*jf0*listX[0][ref_frame]->imgUV[uv][jj0][ii0]+
-                                          if1*jf0*listX[0][ref_frame]->imgUV[uv][jj0][ii1]+
-                                          if0*jf1*listX[0][ref_frame]->imgUV[uv][jj1][ii0]+
-                                          if1*jf1*listX[0][ref_frame]->imgUV[uv][jj1][ii1]+f4)/f3;
-            }
-          }
-        }
+      case 0:
+        block = currBlock - f*picSizeX + k*f;
+        break;
+      case 1:
+        block = currBlock + k*f*picSizeX - f;
+        break;
+      case 2:
+        block = currBlock + regionSize*picSizeX + k*f;
+        break;
+      default:
+        block = currBlock + k*f*picSizeX + regionSize;
+        break;
       }
 
-	  k=0;
-	  for(j=0+4*pos;j<4+4*pos;j++)
-	  {
-		  for(i=0;i<8;i++)
-		  {
-			  pMB[k++] = img->mpr[i][j];
-		  }
-	  }
-	  pMB += 32;
-
+      for (j = 0, sum = 0; j < f; j++)
+        for (i = 0; i < f; i++)
+          sum += block[j*picSizeX + i];
+      worker->coarseRing[s*(MB_BLOCK_SIZE/2) + k] = (imgpel) ((sum + f*f/2) >> (2*level));
     }
   }
 }
 
-static int edgeDistortion_ECMODE2 (int predBlocks[], int currYBlockNum, imgpel *predMB, imgpel *recY, int32 picSizeX, int32 regionSize, imgpel *boundary, int pos)
+/*!
+ ************************************************************************
+ * \brief
+ *      Boundary distortion of a cached candidate, see candidateDistortion().
+ *      A measurement stopped at maxDist keeps its result as a lower bound,
+ *      which answers later calls with the same or a smaller maxDist.
+ ************************************************************************
+ */
+static int measureDistortion(ercMVCandidate_t *cand, imgpel *nbRing, int predBlocks[], int32 regionSize,
+                             const ecPartition_t *part, int p, int maxDist)
 {
-  int i, j, distortion, numOfPredBlocks, threshold = ERC_BLOCK_OK;
-  imgpel *currBlock = NULL, *neighbor = NULL;
-  int32 currBlockOffset = 0;
-  
-  currBlock = recY + (yPosYBlock(currYBlockNum,picSizeX)<<3)*picSizeX + (xPosYBlock(currYBlockNum,picSizeX)<<3);
-  
-  do 
-  {    
-    distortion = 0; numOfPredBlocks = 0;
-    
-    /* loop the 4 neighbours */
-    for (j = 4; j < 8; j++) 
-    {
-		if(pos==0 && j==6)
-			continue;
-		if(pos==1 && j==4)
-			continue;
+  int dist;
 
-	  /* if reliable, count boundary pixel difference */
-      if (predBlocks[j] >= threshold) 
-      {        
-        switch (j) 
-        {
-        case 4:
-		  neighbor = currBlock - picSizeX;
-		  if(OBMA)
-		  {
-			  for ( i = 0; i < regionSize; i++ ) 
-				distortion += mabs((int)(boundary[i] - neighbor[i]));
-          }
-		  else
-		  {
-			  for ( i = 0; i < regionSize; i++ ) 
-				distortion += mabs((int)(predMB[i] - neighbor[i]));
-		  }
-		  break;          
-        case 5:
-          neighbor = currBlock - 1;
-		  if(OBMA)
-		  {
-			  for ( i = 0+8*pos; i < 8+8*pos; i++ ) 
-				distortion += mabs((int)(boundary[16+i] - neighbor[i*picSizeX]));
-		  }
-		  else
-		  {
-			  for ( i = 0+8*pos; i < 8+8*pos; i++ ) 
-	            distortion += mabs((int)(predMB[(i-8*pos)*16] - neighbor[i*picSizeX]));
-		  }
-          break;                
-        case 6:
-          neighbor = currBlock + regionSize*picSizeX;
-          currBlockOffset = 16*7;
-		  if(OBMA)
-		  {
-			  for ( i = 0; i < regionSize; i++ ) 
-				distortion += mabs((int)(boundary[32+i] - neighbor[i]));
-		  }
-		  else
-		  {
-			  for ( i = 0; i < regionSize; i++ ) 
-				distortion += mabs((int)(predMB[i+currBlockOffset] - neighbor[i]));
-		  }
-          break;                
-        case 7:
-          neighbor = currBlock + regionSize;
-          currBlockOffset = regionSize-1;
-		  if(OBMA)
-		  {
-			  for ( i = 0+8*pos; i < 8+8*pos; i++ ) 
-				distortion += mabs((int)(boundary[48+i] - neighbor[i*picSizeX]));
-		  }
-		  else
-		  {
-			  for ( i = 0+8*pos; i < 8+8*pos; i++ ) 
-				distortion += mabs((int)(predMB[(i-8*pos)*16+currBlockOffset] - neighbor[i*picSizeX]));
-		  }
-          break;
-        }
-        
-        numOfPredBlocks++;
-      }
-    }
-    
-    threshold--;
-    if (threshold < ERC_BLOCK_CONCEALED)
-      break;
-  } while (numOfPredBlocks == 0);
-  
-  if(numOfPredBlocks == 0)
-    return 0;
+  if (cand->dist[p] >= 0)
+    return cand->dist[p];
+  if (cand->bound[p] >= maxDist)
+    return cand->bound[p];
 
-  return (distortion/numOfPredBlocks);
+  if (part != NULL)
+    dist = partitionDistortion(part, predBlocks, cand, nbRing, maxDist);
+  else if (ercInter->obma)
+    dist = edgeDistortionOBMA(predBlocks, cand->ring, nbRing, regionSize, maxDist);
+  else
+    dist = edgeDistortion(predBlocks, cand->pred, nbRing, regionSize, maxDist);
+
+  if (dist < maxDist)
+    cand->dist[p] = dist;
+  else
+    cand->bound[p] = dist;
+
+  return dist;
 }
 
-/**********************************************************************************************************************/
-//EC Mode 3
-static int concealABS_ECMODE3(frame *recfr, imgpel *predMB,int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
-                      int32 picSizeX, int32 picSizeY, int *yCondition)
+/*!
+ ************************************************************************
+ * \brief
+ *      Adaptive block size concealment of one MB. The MB is split into
+ *      the partitions of the given ECMODE (ecPartitionTable); for each
+ *      partition the motion of the neighbouring blocks it touches and
+ *      the zero motion are tried, and the candidate with the smallest
+ *      boundary distortion on the partition's boundary segments is kept,
+ *      optionally refined by refineMV().
+ * \param recfr
+ *      Reconstructed frame buffer
+ * \param worker
+ *      scratch state of the concealing thread, its predMB is the memory area
+ *      for storing temporary pixel values for a macroblock
+ *      the Y,U,V planes are concatenated y = predMB, u = predMB+256, v = predMB+320
+ * \param currMBNum
+ *      current MB index
+ * \param object_list
+ *      Motion info for all MBs in the frame
+ * \param predBlocks
+ *      status array of the neighboring blocks (if they are OK, concealed or lost)
+ * \param picSizeX
+ *      Width of the frame in pixels
+ * \param picSizeY
+ *      Height of the frame in pixels
+ * \param yCondition
+ *      array for conditions of Y blocks from ercVariables_t
+ * \param mb_ecmode
+ *      ECMODE1..ECMODE8, selects the partitioning of the MB
+ ************************************************************************
+ */
+static int concealByPartition(frame *recfr, ercWorker_t *worker, int currMBNum, objectBuffer_t *object_list, int predBlocks[],
+                              int32 picSizeX, int32 picSizeY, int *yCondition, int mb_ecmode)
 {
-	imgpel *pred_ecmodeMB, *left_pred_ecmodeMB, *right_pred_ecmodeMB;
-
-	int predMBNum = 0, numMBPerLine,
-      compSplit1 = 0, compSplit2 = 0, compLeft = 1, comp = 0, compPred, order = 1,
+  const ecPartitionMode_t *ecmode = &ecPartitionTable[mb_ecmode];
+  const ecPartition_t *part;
+  int predMBNum = 0, numMBPerLine,
+      compSplit1 = 0, compSplit2 = 0, compPred,
       fInterNeighborExists, numIntraNeighbours,
       fZeroMotionChecked, predSplitted = 0,
-      threshold = ERC_BLOCK_OK,
-      minDist, currDist, i, k, j, p, bestDir;
-	int32 regionSize;
-	objectBuffer_t *currRegion;
-	int32 mvBest[3] , mvPred[3], *mvptr;
+      threshold, minDist, currYBlockNum, mbX, mbY, i, k, p, numCand;
+  int nbOffset[4];
+  objectBuffer_t *currRegion;
+  ercMVCandidate_t *cand;
+  int32 mvBest[3] , mvPred[3], *mvptr;
+  int32 candMV[MAX_MV_CANDIDATES][3];
+  int candMode[MAX_MV_CANDIDATES], candDist[MAX_MV_CANDIDATES];
+  imgpel *predMB = worker->predMB;
 
-	//Santosh
-	imgpel *predMB_OBMC;
-	
-	//8x16 for luma and 4x8, 4x8 for chroma
-	pred_ecmodeMB = (imgpel *) malloc ( (128 + (img->mb_cr_size_x*img->mb_cr_size_y/2)*2) * sizeof (imgpel));
-	left_pred_ecmodeMB = (imgpel *) malloc ( (128 + (img->mb_cr_size_x*img->mb_cr_size_y/2)*2) * sizeof (imgpel));
-	right_pred_ecmodeMB = (imgpel *) malloc ( (128 + (img->mb_cr_size_x*img->mb_cr_size_y/2)*2) * sizeof (imgpel));
+  numMBPerLine = (int) (picSizeX>>4);
+  nbOffset[0] = -numMBPerLine;
+  nbOffset[1] = -1;
+  nbOffset[2] = numMBPerLine;
+  nbOffset[3] = 1;
 
-	if(OBMC)
-		predMB_OBMC = (imgpel *) malloc ( (256 + (img->mb_cr_size_x*img->mb_cr_size_y)*2) * sizeof (imgpel));
+  currYBlockNum = MBNum2YBlock(currMBNum,0,picSizeX);
+  mbX = (xPosYBlock(currYBlockNum,picSizeX)<<3);
+  mbY = (yPosYBlock(currYBlockNum,picSizeX)<<3);
 
-	numMBPerLine = (int) (picSizeX>>4);
-  	comp = 0;
-	regionSize = 16;
+  loadNeighbourRing(worker, recfr->yptr, predBlocks, currYBlockNum, picSizeX, MB_BLOCK_SIZE);
 
-	//LEFT HALF
-	threshold = ERC_BLOCK_OK;
-	comp=0;
-	currRegion = object_list+(currMBNum<<2)+comp;
-	
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
+  for (p = 0; p < ecmode->numPart; p++)
+  {
+    part = &ecmode->part[p];
+    currRegion = object_list+(currMBNum<<2)+part->comp;
 
-	do
-	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;	
-
-		/* loop the 3 neighbours */
-		for (i = 4; i < 7; i++) //No right nbr for left half
-		{
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
-			{
-				switch (i) 
-				{
-				case 4:
-					predMBNum = currMBNum-numMBPerLine;
-					compSplit1 = 2;
-					compSplit2 = 2;
-					break;              
-				case 5:
-					predMBNum = currMBNum-1;
-					compSplit1 = 1;
-					compSplit2 = 3;
-					break;              
-				case 6:
-					predMBNum = currMBNum+numMBPerLine;
-					compSplit1 = 0;
-					compSplit2 = 0;
-					break;
-				}
+    /* set the position of the region to be concealed */
+    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,part->comp,picSizeX),picSizeX)<<3);
+    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,part->comp,picSizeX),picSizeX)<<3);
 
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE3(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,0);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE3(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,0);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE3(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 0);
-						
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode =
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<128+32+32;p++)
-							{
-								left_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-							}
-							
-							p=0;
-						}
-              
-						fInterNeighborExists = 1;    
-					}
-				}
-			}
-		}
+    threshold = ERC_BLOCK_OK;
 
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE3(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,0);
+    do
+    { /* reliability loop */
 
-	  currDist = edgeDistortion_ECMODE3(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 0);
-      
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
+      minDist = 0;
+      numCand = 0;
+      fInterNeighborExists = 0;
+      numIntraNeighbours = 0;
+      fZeroMotionChecked = 0;
 
-		for(p=0;p<128+32+32;p++)
-		{
-			left_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-		}
-	  }
-    }
+      /* loop the neighbours touched by the partition */
+      for (i = 0; i < 4; i++)
+      {
+        compSplit1 = part->nbComp[i][0];
+        compSplit2 = part->nbComp[i][1];
 
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
-    
-	//RIGHT HALF
-	threshold = ERC_BLOCK_OK;
-	comp=1;
-	currRegion = object_list+(currMBNum<<2)+comp;
+        /* if reliable, try it */
+        if (compSplit1 < 0 || predBlocks[4+i] < threshold)
+          continue;
 
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    
-	do
-	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;
-
-		/* loop the 3 neighbours */ 
-		for (i = 4; i < 8; i++) 
-		{
-			if(i==5) //No left nbr for right half
-				continue;
+        predMBNum = currMBNum + nbOffset[i];
 
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
-			{
-				switch (i) 
-				{
-				case 4:
-					predMBNum = currMBNum-numMBPerLine;
-					compSplit1 = 3;
-					compSplit2 = 3;
-					break;   
-				case 6:
-					predMBNum = currMBNum+numMBPerLine;
-					compSplit1 = 1;
-					compSplit2 = 1;
-					break;
-				case 7:
-					predMBNum = currMBNum+1;
-					compSplit1 = 0;
-					compSplit2 = 2;
-					break;
-				}
+        /* try the concealment with the Motion Info of the current neighbour
+        only try if the neighbour is not Intra */
+        if (isBlock(object_list,predMBNum,compSplit1,INTRA) ||
+          isBlock(object_list,predMBNum,compSplit2,INTRA))
+        {
+          numIntraNeighbours++;
+          continue;
+        }
 
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE3(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE3(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE3(predBlocks,MBNum2YBlock(currMBNum,0,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 1);
-
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode = 
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<128+32+32;p++)
-							{
-								right_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-							}
-
-							p=0;                
-						}
-              
-						fInterNeighborExists = 1;
-					}
-				}
-			}
-		}
+        /* if neighbour MB is splitted, try the neighbour sub-blocks */
+        for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
+             predSplitted >= 0;
+             compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1))
+        {
+          /* if Zero Motion Block, do the copying. This option is tried only once */
+          if (isBlock(object_list, predMBNum, compPred, INTER_COPY))
+          {
+            if (fZeroMotionChecked)
+              continue;
 
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE3(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
+            fZeroMotionChecked = 1;
+            mvPred[0] = mvPred[1] = 0;
+            mvPred[2] = 0;
+          }
+          /* build motion using the neighbour's Motion Parameters */
+          else if (isBlock(object_list,predMBNum,compPred,INTRA))
+          {
+            continue;
+          }
+          else
+          {
+            mvptr = getParam(object_list, predMBNum, compPred, mv);
+            mvPred[0] = mvptr[0];
+            mvPred[1] = mvptr[1];
+            mvPred[2] = mvptr[2];
+          }
 
-	  currDist = edgeDistortion_ECMODE3(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 1);
+          /* the candidate is measured with the others of the list below */
+          for (k=0;k<3;k++)
+            candMV[numCand][k] = mvPred[k];
 
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
+          candMode[numCand++] =
+            (isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? REGMODE_INTER_COPY : REGMODE_INTER_PRED;
 
-		for(p=0;p<128+32+32;p++)
-		{
-			right_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-		}
+          fInterNeighborExists = 1;
+        }
       }
-    }
-
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
 
-	//Whole MB concealed at this stage, copy to predMB
-
-	p=0;
-	for(j=0;j<16;j++)
-	{
-		for(i=0;i<8;i++)
-		{
-			predMB[j*16+i] = left_pred_ecmodeMB[p];
-			predMB[j*16+i+8] = right_pred_ecmodeMB[p];
-			p++;
-		}
-	}
+      threshold--;
 
-	p=0;
-	for(j=0;j<8;j++)
-	{
-		for(i=0;i<4;i++)
-		{
-			predMB[256+j*8+i] = left_pred_ecmodeMB[128+p];
-			predMB[256+j*8+i+4] = right_pred_ecmodeMB[128+p];
-			predMB[256+64+j*8+i] = left_pred_ecmodeMB[160+p];
-			predMB[256+64+j*8+i+4] = right_pred_ecmodeMB[160+p];
-			p++;
-		}
-	}
-	
-	if(OBMC)
-	{
-		OBMC_MB(predMB,predMB_OBMC,predBlocks,object_list,currMBNum,numMBPerLine,picSizeX);
-		copyPredMB(MBNum2YBlock(currMBNum,0,picSizeX), predMB_OBMC, recfr, picSizeX, regionSize);
-	}
-	else
-		copyPredMB(MBNum2YBlock(currMBNum,0,picSizeX), predMB, recfr,picSizeX, regionSize);
+    } while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
 
-	yCondition[MBNum2YBlock(currMBNum,0,picSizeX)] = ERC_BLOCK_CONCEALED;
+    if (clusterTolerance > 0)
+      numCand = clusterCandidates(worker, candMV, candMode, numCand);
 
-	free(pred_ecmodeMB);
-	free(left_pred_ecmodeMB);
-	free(right_pred_ecmodeMB);
+    /* always try zero motion */
+    if (!fZeroMotionChecked)
+    {
+      for (k=0;k<3;k++)
+        candMV[numCand][k] = 0;
 
-	if(OBMC)
-		free(predMB_OBMC);
+      candMode[numCand++] = REGMODE_INTER_COPY;
+    }
 
-	return 0;
-}
+    candidateDistortions(worker, candMV, numCand, mbX, mbY, predBlocks, MB_BLOCK_SIZE, part, p, INT_MAX, 0, candDist);
 
-static void buildOuterPredRegionYUV_ECMODE3(struct img_par *img, int32 *mv, int x, int y, imgpel *predMB, imgpel *boundary, int pos)
-{
-  int tmp_block[BLOCK_SIZE][BLOCK_SIZE];
-  int i=0,j=0,ii=0,jj=0,i1=0,j1=0,j4=0,i4=0,k=0;
-  int jf=0;
-  int uv;
-  int vec1_x=0,vec1_y=0;
-  int ioff,joff;
-  imgpel *pMB = predMB; 
-  
-  int ii0,jj0,ii1,jj1,if1,jf1,if0,jf0;
-  int mv_mul;
+    /* the first one of the best candidates is stored as the concealment */
+    for (i = 0; i < numCand; i++)
+    {
+      if (i == 0 || candDist[i] < minDist)
+      {
+        minDist = candDist[i];
+        for (k=0;k<3;k++)
+          mvBest[k] = candMV[i][k];
 
-  int above[4], left[4], below[4], right[4], index;
-  
-  //FRExt
-  int f1_x, f1_y, f2_x, f2_y, f3, f4, ifx;
-  int b8, b4;
-  int yuv = dec_picture->chroma_format_idc - 1;
-  
-  int ref_frame = max (mv[2], 0); // !!KS: quick fix, we sometimes seem to get negative ref_pic here, so restrict to zero an above
+        currRegion->regionMode = candMode[i];
+      }
+    }
 
-  /* Update coordinates of the current concealed macroblock */
-  img->mb_x = x/MB_BLOCK_SIZE;
-  img->mb_y = y/MB_BLOCK_SIZE;
-  img->block_y = img->mb_y * BLOCK_SIZE;
-  img->pix_c_y = img->mb_y * img->mb_cr_size_y;
-  img->block_x = img->mb_x * BLOCK_SIZE;
-  img->pix_c_x = img->mb_x * img->mb_cr_size_x;
+    /* the best candidates against the other recent references */
+    if (concealRefs > 1 &&
+        tryRecentRefs(worker, predBlocks, mbX, mbY, MB_BLOCK_SIZE, part, p, mvBest, &minDist))
+    {
+      currRegion->regionMode = REGMODE_INTER_PRED;
+    }
 
-  mv_mul=4;
+    /* refine the best candidate */
+    if (refineRange > 0 &&
+        refineMV(worker, predBlocks, mbX, mbY, MB_BLOCK_SIZE, part, p, mvBest, minDist))
+    {
+      currRegion->regionMode = (mvBest[0] == 0 && mvBest[1] == 0 && mvBest[2] == 0) ? REGMODE_INTER_COPY : REGMODE_INTER_PRED;
+    }
 
-  // luma *******************************************************
+    /* store the pixels of the best candidate, its full prediction is built only now */
+    cand = getMVCandidate(worker, mvBest, mbX, mbY, CAND_YUV);
+    copyPredPartition(worker->ctx, cand->pred, predMB, part);
 
-  for(i=0;i<4;i++)
-  {
-	  above[i]=0;left[i]=0;below[i]=0;right[i]=0;
+    for (k=0; k<3; k++)
+      currRegion->mv[k] = mvBest[k];
   }
 
-  for(j=0;j<MB_BLOCK_SIZE/BLOCK_SIZE;j++)
+  //Whole MB concealed at this stage, now do OBMC
+  if(ercInter->obmc)
   {
-    joff=j*4;
-    j4=img->block_y+j;
-    for(i=0;i<MB_BLOCK_SIZE/BLOCK_SIZE;i++)
-    {
-      ioff=i*4;
-      i4=img->block_x+i;
-
-      vec1_x = i4*4*mv_mul + mv[0];
-      vec1_y = j4*4*mv_mul + mv[1];
+    OBMC_MB(worker,predBlocks,object_list,currMBNum,numMBPerLine,picSizeX);
+    copyPredMB(worker->ctx, currYBlockNum, worker->predOBMC, recfr, picSizeX, MB_BLOCK_SIZE);
+  }
+  else
+    copyPredMB(worker->ctx, currYBlockNum, predMB, recfr, picSizeX, MB_BLOCK_SIZE);
 
-      get_block(ref_frame, listX[0], vec1_x,vec1_y,img,tmp_block);
+  yCondition[currYBlockNum] = ERC_BLOCK_CONCEALED;
 
-	  index = i+4*j;
-	  get_boundary(ref_frame, listX[0], vec1_x, vec1_y, img, index, above, left, below, right);
-	  
-	  if(j==0)
-	  {
-		  boundary[4*i+0]=above[0];boundary[4*i+1]=above[1];boundary[4*i+2]=above[2];boundary[4*i+3]=above[3];
-	  }
+  return 0;
+}
 
-	  if(i==0)
-	  {
-		  boundary[16+4*j+0]=left[0];boundary[16+4*j+1]=left[1];boundary[16+4*j+2]=left[2];boundary[16+4*j+3]=left[3];
-	  }
+static void OBMC_MB(ercWorker_t *worker, int predBlocks[], objectBuffer_t *object_list, int currMBNum, int numMBPerLine, int picSizeX)
+{
+	int32 mvLR[3], mvTD[3], *mvptr;
+	int i, j, predMBNum, lower, upper;
+	imgpel *predMB = worker->predMB, *predMB_OBMC = worker->predOBMC;
+	imgpel *predMB_LR = worker->predLR, *predMB_TD = worker->predTD;
+	objectBuffer_t *currRegion;
 
-	  if(j==3) //MB_BLOCK_SIZE/BLOCK_SIZE - 1 = 3
-	  {
-		  boundary[32+4*i+0]=below[0];boundary[32+4*i+1]=below[1];boundary[32+4*i+2]=below[2];boundary[32+4*i+3]=below[3];
-	  }
+	currRegion = object_list+(currMBNum<<2); 
+	currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,0,picSizeX),picSizeX)<<3);
+    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,0,picSizeX),picSizeX)<<3);
 
-	  if(i==3)
-	  {
-		  boundary[48+4*j+0]=right[0];boundary[48+4*j+1]=right[1];boundary[48+4*j+2]=right[2];boundary[48+4*j+3]=right[3];
-	  }
+	//Comp = 0
+	for(i=0;i<2;i++)
+	{
+		 mvLR[i] = NIL; mvTD[i] = NIL;
+	}
+	mvLR[2] = 0; mvTD[2] = 0;
 
-      for(ii=0;ii<BLOCK_SIZE;ii++)
-        for(jj=0;jj<MB_BLOCK_SIZE/BLOCK_SIZE;jj++)
-          img->mpr[ii+ioff][jj+joff]=tmp_block[ii][jj];
-    }
-  }
+	//Above
+	if(predBlocks[4]>=ERC_BLOCK_CONCEALED)
+	{
+		predMBNum = currMBNum-numMBPerLine;
+		if(!(isBlock(object_list, predMBNum, 2, INTER_COPY) || isBlock(object_list,predMBNum,2,INTRA))) 
+		{
+			mvptr = getParam(object_list, predMBNum, 2, mv);
+			mvTD[0]=mvptr[0]; mvTD[1]=mvptr[1];
+		}				
+	}
 
-  k=0;
-  for(j=0;j<16;j++)
-  {
-	  for(i=0+8*pos;i<8+8*pos;i++)
-	  {
-		  pMB[k++] = img->mpr[i][j];
-	  }
-  }
+	//Left
+	if(predBlocks[5]>=ERC_BLOCK_CONCEALED)
+	{
+		predMBNum = currMBNum-1;
+		if(!(isBlock(object_list, predMBNum,1, INTER_COPY) || isBlock(object_list,predMBNum,1,INTRA))) 
+		{
+			mvptr = getParam(object_list, predMBNum, 1, mv);
+			mvLR[0]=mvptr[0]; mvLR[1]=mvptr[1];
+		}
+	}
+	
+	//construct MB with mvTD
+	if(mvTD[0]!=NIL)
+	{
+		buildPartitionPredYUV(worker,mvTD,currRegion->xMin,currRegion->yMin,predMB_TD,&ecPartitionTable[ECMODE4].part[0]);
+	}
+	else
+	{
+		for(i=0;i<8;i++)
+		{
+			for(j=0;j<8;j++)
+			{
+				predMB_TD[i*8+j] = predMB[i*16+j];
+			}
+		}
 
-  pMB += 128;
+		for(i=0;i<4;i++)
+		{
+			for(j=0;j<4;j++)
+			{
+				predMB_TD[64+i*4+j] = predMB[256+i*8+j];
+				predMB_TD[64+16+i*4+j] = predMB[256+64+i*8+j];
+			}
+		}
+	}
 
-  if (dec_picture->chroma_format_idc != YUV400)
-  {
-    // chroma *******************************************************
-    f1_x = 64/img->mb_cr_size_x;
-    f2_x=f1_x-1;
+	//construct MB with mvLR
+	if(mvLR[0]!=NIL)
+	{
+		buildPartitionPredYUV(worker,mvLR,currRegion->xMin,currRegion->yMin,predMB_LR,&ecPartitionTable[ECMODE4].part[0]);
+	}
+	else
+	{
+		for(i=0;i<8;i++)
+		{
+			for(j=0;j<8;j++)
+			{
+				predMB_LR[i*8+j] = predMB[i*16+j];
+			}
+		}
 
-    f1_y = 64/img->mb_cr_size_y;
-    f2_y=f1_y-1;
+		for(i=0;i<4;i++)
+		{
+			for(j=0;j<4;j++)
+			{
+				predMB_LR[64+i*4+j] = predMB[256+i*8+j];
+				predMB_LR[64+16+i*4+j] = predMB[256+64+i*8+j];
+			}
+		}
+	}
+	
+	//apply obmc averaging with weights 
+	for(i=0;i<8;i++)
+	{
+		for(j=0;j<8;j++)
+		{
+			predMB_OBMC[i*16+j] = (predMB[i*16+j]*H_E_8x8[i][j] + predMB_LR[i*8+j]*H_LR_8x8[i][j] + predMB_TD[i*8+j]*H_TD_8x8[i][j]);
+			predMB_OBMC[i*16+j] = (int)floor(predMB_OBMC[i*16+j]/8.0 + 0.5);
 
-    f3=f1_x*f1_y;
-    f4=f3>>1;
+			upper = predMB[i*16+j] + (predMB[i*16+j]*OBMC_TR/100);
+			lower = predMB[i*16+j] - (predMB[i*16+j]*OBMC_TR/100);
+			if(OBMC_THRESHOLD && !(predMB_OBMC[i*16+j]>=lower && predMB_OBMC[i*16+j]<=upper))
+				predMB_OBMC[i*16+j] = predMB[i*16+j];
+		}
+	}
 
-    for(uv=0;uv<2;uv++)
-    {
-      for (b8=0;b8<(img->num_blk8x8_uv/2);b8++)
-      {
-        for(b4=0;b4<4;b4++)
+	for(i=0;i<4;i++)
+	{
+		for(j=0;j<4;j++)
 		{
-          joff = subblk_offset_y[yuv][b8][b4];
-          j4=img->pix_c_y+joff;
-          ioff = subblk_offset_x[yuv][b8][b4];
-          i4=img->pix_c_x+ioff;
+			predMB_OBMC[256+i*8+j] = (predMB[256+i*8+j]*H_E_8x8[i][j] + predMB_LR[64+i*4+j]*H_LR_8x8[i][j] + predMB_TD[64+i*4+j]*H_TD_8x8[i][j]);
+			predMB_OBMC[256+i*8+j] = (int)floor(predMB_OBMC[256+i*8+j]/8.0 + 0.5);
 
-          for(jj=0;jj<4;jj++)
-          {
-            jf=(j4+jj)/(img->mb_cr_size_y/4);     // jf  = Subblock_y-coordinate
-            for(ii=0;ii<4;ii++)
-            {
-              ifx=(i4+ii)/(img->mb_cr_size_x/4);  // ifx = Subblock_x-coordinate
+			upper = predMB[256+i*8+j] + (predMB[256+i*8+j]*OBMC_TR/100);
+			lower = predMB[256+i*8+j] - (predMB[256+i*8+j]*OBMC_TR/100);
+			if(OBMC_THRESHOLD && !(predMB_OBMC[256+i*8+j]>=lower && predMB_OBMC[256+i*8+j]<=upper))
+				predMB_OBMC[256+i*8+j] = predMB[256+i*8+j];
 
-              i1=(i4+ii)*f1_x + mv[0];
-              j1=(j4+jj)*f1_y + mv[1];
-            
-              ii0=max (0, min (i1/f1_x,   dec_picture->size_x_cr-1));
-              jj0=max (0, min (j1/f1_y,   dec_picture->size_y_cr-1));
-              ii1=max (0, min ((i1+f2_x)/f1_x, dec_picture->size_x_cr-1));
-              jj1=max (0, min ((j1+f2_y)/f1_y, dec_picture->size_y_cr-1));
-            
-              if1=(i1 & f2_x);
-              jf1=(j1 & f2_y);
-              if0=f1_x-if1;
-              jf0=f1_y-jf1;
-            
-              img->mpr[ii+ioff][jj+joff]=(if0*jf0*listX[0][ref_frame]->imgUV[uv][jj0][ii0]+
-                                          if1*jf0*listX[0][ref_frame]->imgUV[uv][jj0][ii1]+
-                                          if0*jf1*listX[0][ref_frame]->imgUV[uv][jj1][ii0]+
-                                          if1*jf1*listX[0][ref_frame]->imgUV[uv][jj1][ii1]+f4)/f3;
-            }
-          }
-        }
-      }
-
-	  k=0;
-	  for(j=0;j<8;j++)
-	  {
-		  for(i=0+4*pos;i<4+4*pos;i++)
-		  {
-			  pMB[k++] = img->mpr[i][j];
-		  }
-	  }
-	  pMB += 32;
-
-    }
-  }
-}
-
-static int edgeDistortion_ECMODE3 (int predBlocks[], int currYBlockNum, imgpel *predMB, imgpel *recY, int32 picSizeX, int32 regionSize, imgpel *boundary, int pos)
-{
-  int i, j, distortion, numOfPredBlocks, threshold = ERC_BLOCK_OK;
-  imgpel *currBlock = NULL, *neighbor = NULL;
-  int32 currBlockOffset = 0;
-  
-  currBlock = recY + (yPosYBlock(currYBlockNum,picSizeX)<<3)*picSizeX + (xPosYBlock(currYBlockNum,picSizeX)<<3);
-  
-  do 
-  {    
-    distortion = 0; numOfPredBlocks = 0;
-    
-    /* loop the 4 neighbours */
-    for (j = 4; j < 8; j++) 
-    {
-		if(pos==0 && j==7)
-			continue;
-		if(pos==1 && j==5)
-			continue;
-
-	  /* if reliable, count boundary pixel difference */
-      if (predBlocks[j] >= threshold) 
-      {        
-        switch (j) 
-        {
-        case 4:
-		  neighbor = currBlock - picSizeX;
-		  if(OBMA)
-		  {
-			  for ( i = 0+8*pos; i < 8+8*pos; i++ ) 
-				distortion += mabs((int)(boundary[i] - neighbor[i]));
-		  }
-		  else
-		  {
-			  for ( i = 0+8*pos; i < 8+8*pos; i++ ) 
-				distortion += mabs((int)(predMB[i-8*pos] - neighbor[i]));
-		  }
-		  break;          
-        case 5:
-          neighbor = currBlock - 1;
-          if(OBMA)
-		  {
-			for ( i = 0; i < regionSize; i++ ) 
-				distortion += mabs((int)(boundary[16+i] - neighbor[i*picSizeX]));
-		  }
-		  else
-		  {
-			  for ( i = 0; i < regionSize; i++ ) 
-				distortion += mabs((int)(predMB[i*8] - neighbor[i*picSizeX]));
-		  }
-          break;                
-        case 6:
-          neighbor = currBlock + regionSize*picSizeX;
-          currBlockOffset = 15*8;
-          if(OBMA)
-		  {
-			for ( i = 0+8*pos; i < 8+8*pos; i++ ) 
-				distortion += mabs((int)(boundary[32+i] - neighbor[i]));
-		  }
-		  else
-		  {
-			  for ( i = 0+8*pos; i < 8+8*pos; i++ ) 
-				distortion += mabs((int)(predMB[(i-8*pos)+currBlockOffset] - neighbor[i]));
-		  }
-          break;                
-        case 7:
-          neighbor = currBlock + regionSize;
-          currBlockOffset = 7;
-          if(OBMA)
-		  {
-			for ( i = 0; i < regionSize; i++ ) 
-				distortion += mabs((int)(boundary[48+i] - neighbor[i*picSizeX]));
-		  }
-		  else
-		  {
-			   for ( i = 0; i < regionSize; i++ ) 
-				distortion += mabs((int)(predMB[i*8+currBlockOffset] - neighbor[i*picSizeX]));
-		  }
-          break;
-        }
-        
-        numOfPredBlocks++;
-      }
-    }
-    
-    threshold--;
-    if (threshold < ERC_BLOCK_CONCEALED)
-      break;
-  } while (numOfPredBlocks == 0);
-  
-  if(numOfPredBlocks == 0)
-    return 0;
-  
-  return (distortion/numOfPredBlocks);
-}
-
-/**********************************************************************************************************************/
-//EC Mode 4
-static int concealABS_ECMODE4(frame *recfr, imgpel *predMB,int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
-                      int32 picSizeX, int32 picSizeY, int *yCondition)
-{
-	imgpel *pred_ecmodeMB, *topleft_pred_ecmodeMB, *topright_pred_ecmodeMB, *bottomleft_pred_ecmodeMB, *bottomright_pred_ecmodeMB;
-
-	int predMBNum = 0, numMBPerLine,
-      compSplit1 = 0, compSplit2 = 0, compLeft = 1, comp = 0, compPred, order = 1,
-      fInterNeighborExists, numIntraNeighbours,
-      fZeroMotionChecked, predSplitted = 0,
-      threshold = ERC_BLOCK_OK,
-      minDist, currDist, i, k, j, p, bestDir;
-	int32 regionSize;
-	objectBuffer_t *currRegion;
-	int32 mvBest[3] , mvPred[3], *mvptr;
+			predMB_OBMC[256+64+i*8+j] = (predMB[256+64+i*8+j]*H_E_8x8[i][j] + predMB_LR[64+16+i*4+j]*H_LR_8x8[i][j] + predMB_TD[64+16+i*4+j]*H_TD_8x8[i][j]);
+			predMB_OBMC[256+64+i*8+j] = (int)floor(predMB_OBMC[256+64+i*8+j]/8.0 + 0.5);
 
-	//Santosh
- 	imgpel *predMB_OBMC;
-	
-	if(OBMC)
-		predMB_OBMC = (imgpel *) malloc ( (256 + (img->mb_cr_size_x*img->mb_cr_size_y)*2) * sizeof (imgpel));
+			upper = predMB[256+64+i*8+j] + (predMB[256+64+i*8+j]*OBMC_TR/100);
+			lower = predMB[256+64+i*8+j] - (predMB[256+64+i*8+j]*OBMC_TR/100);
+			if(OBMC_THRESHOLD && !(predMB_OBMC[256+64+i*8+j]>=lower && predMB_OBMC[256+64+i*8+j]<=upper))
+				predMB_OBMC[256+64+i*8+j] = predMB[256+64+i*8+j];
+		}
+	}
 
-	//8x8 for luma and 4x4, 4x4 for chroma
-	pred_ecmodeMB = (imgpel *) malloc ( (64 + (img->mb_cr_size_x*img->mb_cr_size_y/4)*2) * sizeof (imgpel));
-	topleft_pred_ecmodeMB = (imgpel *) malloc ( (64 + (img->mb_cr_size_x*img->mb_cr_size_y/4)*2) * sizeof (imgpel));
-	topright_pred_ecmodeMB = (imgpel *) malloc ( (64 + (img->mb_cr_size_x*img->mb_cr_size_y/4)*2) * sizeof (imgpel));
-	bottomleft_pred_ecmodeMB = (imgpel *) malloc ( (64 + (img->mb_cr_size_x*img->mb_cr_size_y/4)*2) * sizeof (imgpel));
-	bottomright_pred_ecmodeMB = (imgpel *) malloc ( (64 + (img->mb_cr_size_x*img->mb_cr_size_y/4)*2) * sizeof (imgpel));
 
-	numMBPerLine = (int) (picSizeX>>4);
-  	comp = 0;
-	regionSize = 16;
+	//Comp = 1
+	for(i=0;i<2;i++)
+	{
+		 mvLR[i] = NIL; mvTD[i] = NIL;
+	}
+	mvLR[2] = 0; mvTD[2] = 0;
 
-	if(currMBNum==88)
-		currMBNum=88;
+	//Above
+	if(predBlocks[4]>=ERC_BLOCK_CONCEALED)
+	{
+		predMBNum = currMBNum-numMBPerLine;
+		if(!(isBlock(object_list, predMBNum, 3, INTER_COPY) || isBlock(object_list,predMBNum,3,INTRA))) 
+		{
+			mvptr = getParam(object_list, predMBNum, 3, mv);
+			mvTD[0]=mvptr[0]; mvTD[1]=mvptr[1];
+		}				
+	}
 
-	//TOP LEFT
-	threshold = ERC_BLOCK_OK;
-	comp=0;
-	currRegion = object_list+(currMBNum<<2)+comp;
+	//Right
+	if(predBlocks[7]>=ERC_BLOCK_CONCEALED)
+	{
+		predMBNum = currMBNum+1;
+		if(!(isBlock(object_list, predMBNum, 0, INTER_COPY) || isBlock(object_list,predMBNum,0,INTRA))) 
+		{
+			mvptr = getParam(object_list, predMBNum, 0, mv);
+			mvLR[0]=mvptr[0]; mvLR[1]=mvptr[1];
+		}
+	}
 	
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-
-	do
+	//construct MB with mvTD
+	if(mvTD[0]!=NIL)
+	{
+		buildPartitionPredYUV(worker,mvTD,currRegion->xMin,currRegion->yMin,predMB_TD,&ecPartitionTable[ECMODE4].part[1]);
+	}
+	else
 	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;	
-
-		/* loop the 2 neighbours */
-		for (i = 4; i < 6; i++) //only above and left nbrs
+		for(i=0;i<8;i++)
 		{
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
+			for(j=8;j<16;j++)
 			{
-				switch (i) 
-				{
-				case 4:
-					predMBNum = currMBNum-numMBPerLine;
-					compSplit1 = 2;
-					compSplit2 = 2;
-					break;              
-				case 5:
-					predMBNum = currMBNum-1;
-					compSplit1 = 1;
-					compSplit2 = 1;
-					break;              
-				}
-
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE4(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,0);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE4(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,0);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE4(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 0);
-						
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode =
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<64+16+16;p++)
-							{
-								topleft_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-							}
-							
-							p=0;
-						}
-              
-						fInterNeighborExists = 1;    
-					}
-				}
+				predMB_TD[i*8+(j-8)] = predMB[i*16+j];
 			}
 		}
 
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE4(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,0);
-
-	  currDist = edgeDistortion_ECMODE4(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 0);
-      
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-
-		for(p=0;p<64+16+16;p++)
+		for(i=0;i<4;i++)
 		{
-			topleft_pred_ecmodeMB[p] = pred_ecmodeMB[p];
+			for(j=4;j<8;j++)
+			{
+				predMB_TD[64+i*4+(j-4)] = predMB[256+i*8+j];
+				predMB_TD[64+16+i*4+(j-4)] = predMB[256+64+i*8+j];
+			}
 		}
-	  }
-    }
-
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
-
-
-	//TOP RIGHT
-	threshold = ERC_BLOCK_OK;
-	comp=1;
-	currRegion = object_list+(currMBNum<<2)+comp;
-	
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
+	}
 
-	do
+	//construct MB with mvLR
+	if(mvLR[0]!=NIL)
+	{
+		buildPartitionPredYUV(worker,mvLR,currRegion->xMin,currRegion->yMin,predMB_LR,&ecPartitionTable[ECMODE4].part[1]);
+	}
+	else
 	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;	
-
-		/* loop the 2 neighbours */
-		for (i = 4; i < 8; i++) //only above and right nbrs
+		for(i=0;i<8;i++)
 		{
-			if(i==5 || i==6)
-				continue;
-
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
+			for(j=8;j<16;j++)
 			{
-				switch (i) 
-				{
-				case 4:
-					predMBNum = currMBNum-numMBPerLine;
-					compSplit1 = 3;
-					compSplit2 = 3;
-					break;              
-				case 7:
-					predMBNum = currMBNum+1;
-					compSplit1 = 0;
-					compSplit2 = 0;
-					break;              
-				}
-
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE4(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE4(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE4(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 1);
-						
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode =
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<64+16+16;p++)
-							{
-								topright_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-							}
-							
-							p=0;
-						}
-              
-						fInterNeighborExists = 1;    
-					}
-				}
+				predMB_LR[i*8+(j-8)] = predMB[i*16+j];
 			}
 		}
 
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE4(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
-
-	  currDist = edgeDistortion_ECMODE4(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 1);
-      
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-
-		for(p=0;p<64+16+16;p++)
+		for(i=0;i<4;i++)
 		{
-			topright_pred_ecmodeMB[p] = pred_ecmodeMB[p];
+			for(j=4;j<8;j++)
+			{
+				predMB_LR[64+i*4+(j-4)] = predMB[256+i*8+j];
+				predMB_LR[64+16+i*4+(j-4)] = predMB[256+64+i*8+j];
+			}
 		}
-	  }
-    }
-
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
-    
-
-	//BOTTOM LEFT
-	threshold = ERC_BLOCK_OK;
-	comp=2;
-	currRegion = object_list+(currMBNum<<2)+comp;
+	}
 	
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-
-	do
+	//apply obmc averaging with weights 
+	for(i=0;i<8;i++)
 	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;	
-
-		/* loop the 2 neighbours */
-		for (i = 5; i < 7; i++) //only left and below nbrs
+		for(j=8;j<16;j++)
 		{
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
-			{
-				switch (i) 
-				{
-				case 5:
-					predMBNum = currMBNum-1;
-					compSplit1 = 3;
-					compSplit2 = 3;
-					break;  
-				case 6:
-					predMBNum = currMBNum+numMBPerLine;
-					compSplit1 = 0;
-					compSplit2 = 0;
-					break;
-				}
+			predMB_OBMC[i*16+j] = (predMB[i*16+j]*H_E_8x8[i][j-8] + predMB_LR[i*8+(j-8)]*H_LR_8x8[i][j-8] + predMB_TD[i*8+(j-8)]*H_TD_8x8[i][j-8]);
+			predMB_OBMC[i*16+j] = (int)floor(predMB_OBMC[i*16+j]/8.0 + 0.5);
 
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE4(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,2);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE4(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,2);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE4(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 2);
-						
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode =
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<64+16+16;p++)
-							{
-								bottomleft_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-							}
-							
-							p=0;
-						}
-              
-						fInterNeighborExists = 1;    
-					}
-				}
-			}
+			upper = predMB[i*16+j] + (predMB[i*16+j]*OBMC_TR/100);
+			lower = predMB[i*16+j] - (predMB[i*16+j]*OBMC_TR/100);
+			if(OBMC_THRESHOLD && !(predMB_OBMC[i*16+j]>=lower && predMB_OBMC[i*16+j]<=upper))
+				predMB_OBMC[i*16+j] = predMB[i*16+j];
 		}
+	}
 
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE4(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,2);
-
-	  currDist = edgeDistortion_ECMODE4(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 2);
-      
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-
-		for(p=0;p<64+16+16;p++)
+	for(i=0;i<4;i++)
+	{
+		for(j=4;j<8;j++)
 		{
-			bottomleft_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-		}
-	  }
-    }
+			predMB_OBMC[256+i*8+j] = (predMB[256+i*8+j]*H_E_8x8[i][j-4] + predMB_LR[64+i*4+(j-4)]*H_LR_8x8[i][j-4] + predMB_TD[64+i*4+(j-4)]*H_TD_8x8[i][j-4]);
+			predMB_OBMC[256+i*8+j] = (int)floor(predMB_OBMC[256+i*8+j]/8.0 + 0.5);
 
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
+			upper = predMB[256+i*8+j] + (predMB[256+i*8+j]*OBMC_TR/100);
+			lower = predMB[256+i*8+j] - (predMB[256+i*8+j]*OBMC_TR/100);
+			if(OBMC_THRESHOLD && !(predMB_OBMC[256+i*8+j]>=lower && predMB_OBMC[256+i*8+j]<=upper))
+				predMB_OBMC[256+i*8+j] = predMB[256+i*8+j];
 
+			predMB_OBMC[256+64+i*8+j] = (predMB[256+64+i*8+j]*H_E_8x8[i][j-4] + predMB_LR[64+16+i*4+(j-4)]*H_LR_8x8[i][j-4] + predMB_TD[64+16+i*4+(j-4)]*H_TD_8x8[i][j-4]);
+			predMB_OBMC[256+64+i*8+j] = (int)floor(predMB_OBMC[256+64+i*8+j]/8.0 + 0.5);
 
-	//BOTTOM RIGHT
-	threshold = ERC_BLOCK_OK;
-	comp=3;
-	currRegion = object_list+(currMBNum<<2)+comp;
-	
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
+			upper = predMB[256+64+i*8+j] + (predMB[256+64+i*8+j]*OBMC_TR/100);
+			lower = predMB[256+64+i*8+j] - (predMB[256+64+i*8+j]*OBMC_TR/100);
+			if(OBMC_THRESHOLD && !(predMB_OBMC[256+64+i*8+j]>=lower && predMB_OBMC[256+64+i*8+j]<=upper))
+				predMB_OBMC[256+64+i*8+j] = predMB[256+64+i*8+j];
+		}
+	}
 
-	do
+	//Comp = 2
+	for(i=0;i<2;i++)
 	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;	
-
-		/* loop the 2 neighbours */
-		for (i = 6; i < 8; i++) //only below and right nbrs
-		{
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
-			{
-				switch (i) 
-				{
-				case 6:
-					predMBNum = currMBNum+numMBPerLine;
-					compSplit1 = 1;
-					compSplit2 = 1;
-					break;             
-				case 7:
-					predMBNum = currMBNum+1;
-					compSplit1 = 2;
-					compSplit2 = 2;
-					break;              
-				}
+		 mvLR[i] = NIL; mvTD[i] = NIL;
+	}
+	mvLR[2] = 0; mvTD[2] = 0;
 
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE4(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,3);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE4(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,3);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE4(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 3);
-						
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode =
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<64+16+16;p++)
-							{
-								bottomright_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-							}
-							
-							p=0;
-						}
-              
-						fInterNeighborExists = 1;    
-					}
-				}
+	//Left
+	if(predBlocks[5]>=ERC_BLOCK_CONCEALED)
+	{
+		predMBNum = currMBNum-1;
+		if(!(isBlock(object_list, predMBNum,3, INTER_COPY) || isBlock(object_list,predMBNum,3,INTRA))) 
+		{
+			mvptr = getParam(object_list, predMBNum, 3, mv);
+			mvLR[0]=mvptr[0]; mvLR[1]=mvptr[1];
+		}
+	}
+
+	//Below
+	if(predBlocks[6]>=ERC_BLOCK_CONCEALED)
+	{
+		predMBNum = currMBNum+numMBPerLine;
+		if(!(isBlock(object_list, predMBNum, 0, INTER_COPY) || isBlock(object_list,predMBNum,0,INTRA))) 
+		{
+			mvptr = getParam(object_list, predMBNum, 0, mv);
+			mvTD[0]=mvptr[0]; mvTD[1]=mvptr[1];
+		}
+	}
+	
+	//construct MB with mvTD
+	if(mvTD[0]!=NIL)
+	{
+		buildPartitionPredYUV(worker,mvTD,currRegion->xMin,currRegion->yMin,predMB_TD,&ecPartitionTable[ECMODE4].part[2]);
+	}
+	else
+	{
+		for(i=8;i<16;i++)
+		{
+			for(j=0;j<8;j++)
+			{
+				predMB_TD[(i-8)*8+j] = predMB[i*16+j];
 			}
 		}
 
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE4(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,3);
+		for(i=4;i<8;i++)
+		{
+			for(j=0;j<4;j++)
+			{
+				predMB_TD[64+(i-4)*4+j] = predMB[256+i*8+j];
+				predMB_TD[64+16+(i-4)*4+j] = predMB[256+64+i*8+j];
+			}
+		}
+	}
 
-	  currDist = edgeDistortion_ECMODE4(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 3);
-      
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
+	//construct MB with mvLR
+	if(mvLR[0]!=NIL)
+	{
+		buildPartitionPredYUV(worker,mvLR,currRegion->xMin,currRegion->yMin,predMB_LR,&ecPartitionTable[ECMODE4].part[2]);
+	}
+	else
+	{
+		for(i=8;i<16;i++)
+		{
+			for(j=0;j<8;j++)
+			{
+				predMB_LR[(i-8)*8+j] = predMB[i*16+j];
+			}
+		}
 
-		for(p=0;p<64+16+16;p++)
+		for(i=4;i<8;i++)
 		{
-			bottomright_pred_ecmodeMB[p] = pred_ecmodeMB[p];
+			for(j=0;j<4;j++)
+			{
+				predMB_LR[64+(i-4)*4+j] = predMB[256+i*8+j];
+				predMB_LR[64+16+(i-4)*4+j] = predMB[256+64+i*8+j];
+			}
 		}
-	  }
-    }
+	}
+	
+	//apply obmc averaging with weights 
+	for(i=8;i<16;i++)
+	{
+		for(j=0;j<8;j++)
+		{
+			predMB_OBMC[i*16+j] = (predMB[i*16+j]*H_E_8x8[i-8][j] + predMB_LR[(i-8)*8+j]*H_LR_8x8[i-8][j] + predMB_TD[(i-8)*8+j]*H_TD_8x8[i-8][j]);
+			predMB_OBMC[i*16+j] = (int)floor(predMB_OBMC[i*16+j]/8.0 + 0.5);
 
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
+			upper = predMB[i*16+j] + (predMB[i*16+j]*OBMC_TR/100);
+			lower = predMB[i*16+j] - (predMB[i*16+j]*OBMC_TR/100);
+			if(OBMC_THRESHOLD && !(predMB_OBMC[i*16+j]>=lower && predMB_OBMC[i*16+j]<=upper))
+				predMB_OBMC[i*16+j] = predMB[i*16+j];
+		}
+	}
+
+	for(i=4;i<8;i++)
+	{
+		for(j=0;j<4;j++)
+		{
+			predMB_OBMC[256+i*8+j] = (predMB[256+i*8+j]*H_E_8x8[i-4][j] + predMB_LR[64+(i-4)*4+j]*H_LR_8x8[i-4][j] + predMB_TD[64+(i-4)*4+j]*H_TD_8x8[i-4][j]);
+			predMB_OBMC[256+i*8+j] = (int)floor(predMB_OBMC[256+i*8+j]/8.0 + 0.5);
+
+			upper = predMB[256+i*8+j] + (predMB[256+i*8+j]*OBMC_TR/100);
+			lower = predMB[256+i*8+j] - (predMB[256+i*8+j]*OBMC_TR/100);
+			if(OBMC_THRESHOLD && !(predMB_OBMC[256+i*8+j]>=lower && predMB_OBMC[256+i*8+j]<=upper))
+				predMB_OBMC[256+i*8+j] = predMB[256+i*8+j];
+
+			predMB_OBMC[256+64+i*8+j] = (predMB[256+64+i*8+j]*H_E_8x8[i-4][j] + predMB_LR[64+16+(i-4)*4+j]*H_LR_8x8[i-4][j] + predMB_TD[64+16+(i-4)*4+j]*H_TD_8x8[i-4][j]);
+			predMB_OBMC[256+64+i*8+j] = (int)floor(predMB_OBMC[256+64+i*8+j]/8.0 + 0.5);
 
+			upper = predMB[256+64+i*8+j] + (predMB[256+64+i*8+j]*OBMC_TR/100);
+			lower = predMB[256+64+i*8+j] - (predMB[256+64+i*8+j]*OBMC_TR/100);
+			if(OBMC_THRESHOLD && !(predMB_OBMC[256+64+i*8+j]>=lower && predMB_OBMC[256+64+i*8+j]<=upper))
+				predMB_OBMC[256+64+i*8+j] = predMB[256+64+i*8+j];
+		}
+	}
 
-	//Whole MB concealed at this stage, copy to predMB
+	//Comp = 3
+	for(i=0;i<2;i++)
+	{
+		 mvLR[i] = NIL; mvTD[i] = NIL;
+	}
+	mvLR[2] = 0; mvTD[2] = 0;
 
-	p=0;
-	for(j=0;j<8;j++)
+	//Below
+	if(predBlocks[6]>=ERC_BLOCK_CONCEALED)
 	{
-		for(i=0;i<8;i++)
+		predMBNum = currMBNum+numMBPerLine;
+		if(!(isBlock(object_list, predMBNum, 1, INTER_COPY) || isBlock(object_list,predMBNum,1,INTRA))) 
 		{
-			predMB[j*16+i] = topleft_pred_ecmodeMB[p];
-			predMB[j*16+i+8] = topright_pred_ecmodeMB[p];
-			predMB[(j+8)*16+i] = bottomleft_pred_ecmodeMB[p];
-			predMB[(j+8)*16+i+8] = bottomright_pred_ecmodeMB[p];
-			p++;
+			mvptr = getParam(object_list, predMBNum, 1, mv);
+			mvTD[0]=mvptr[0]; mvTD[1]=mvptr[1];
 		}
 	}
 
-	p=0;
-	for(j=0;j<4;j++)
+	//Right
+	if(predBlocks[7]>=ERC_BLOCK_CONCEALED)
 	{
-		for(i=0;i<4;i++)
+		predMBNum = currMBNum+1;
+		if(!(isBlock(object_list, predMBNum, 2, INTER_COPY) || isBlock(object_list,predMBNum,2,INTRA))) 
 		{
-			predMB[256+j*8+i] = topleft_pred_ecmodeMB[64+p];
-			predMB[256+j*8+i+4] = topright_pred_ecmodeMB[64+p];
-			predMB[256+(j+4)*8+i] = bottomleft_pred_ecmodeMB[64+p];
-			predMB[256+(j+4)*8+i+4] = bottomright_pred_ecmodeMB[64+p];
-
-			predMB[256+64+j*8+i] = topleft_pred_ecmodeMB[80+p];
-			predMB[256+64+j*8+i+4] = topright_pred_ecmodeMB[80+p];
-			predMB[256+64+(j+4)*8+i] = bottomleft_pred_ecmodeMB[80+p];
-			predMB[256+64+(j+4)*8+i+4] = bottomright_pred_ecmodeMB[80+p];
+			mvptr = getParam(object_list, predMBNum, 2, mv);
+			mvLR[0]=mvptr[0]; mvLR[1]=mvptr[1];
+		}
+	}
+	
+	//construct MB with mvTD
+	if(mvTD[0]!=NIL)
+	{
+		buildPartitionPredYUV(worker,mvTD,currRegion->xMin,currRegion->yMin,predMB_TD,&ecPartitionTable[ECMODE4].part[3]);
+	}
+	else
+	{
+		for(i=8;i<16;i++)
+		{
+			for(j=8;j<16;j++)
+			{
+				predMB_TD[(i-8)*8+(j-8)] = predMB[i*16+j];
+			}
+		}
 
-			p++;
+		for(i=4;i<8;i++)
+		{
+			for(j=4;j<8;j++)
+			{
+				predMB_TD[64+(i-4)*4+(j-4)] = predMB[256+i*8+j];
+				predMB_TD[64+16+(i-4)*4+(j-4)] = predMB[256+64+i*8+j];
+			}
 		}
 	}
 
-	if(OBMC)
+	//construct MB with mvLR
+	if(mvLR[0]!=NIL)
 	{
-		OBMC_MB(predMB,predMB_OBMC,predBlocks,object_list,currMBNum,numMBPerLine,picSizeX);
-		copyPredMB(MBNum2YBlock(currMBNum,0,picSizeX), predMB_OBMC, recfr, picSizeX, regionSize);
+		buildPartitionPredYUV(worker,mvLR,currRegion->xMin,currRegion->yMin,predMB_LR,&ecPartitionTable[ECMODE4].part[3]);
 	}
 	else
-		copyPredMB(MBNum2YBlock(currMBNum,0,picSizeX), predMB, recfr,picSizeX, regionSize);
-	
-	yCondition[MBNum2YBlock(currMBNum,0,picSizeX)] = ERC_BLOCK_CONCEALED;
+	{
+		for(i=8;i<16;i++)
+		{
+			for(j=8;j<16;j++)
+			{
+				predMB_LR[(i-8)*8+(j-8)] = predMB[i*16+j];
+			}
+		}
 
-	free(pred_ecmodeMB);
-	free(topleft_pred_ecmodeMB);
-	free(topright_pred_ecmodeMB);
-	free(bottomleft_pred_ecmodeMB);
-	free(bottomright_pred_ecmodeMB);
+		for(i=4;i<8;i++)
+		{
+			for(j=4;j<8;j++)
+			{
+				predMB_LR[64+(i-4)*4+(j-4)] = predMB[256+i*8+j];
+				predMB_LR[64+16+(i-4)*4+(j-4)] = predMB[256+64+i*8+j];
+			}
+		}
+	}
+	
+	//apply obmc averaging with weights 
+	for(i=8;i<16;i++)
+	{
+		for(j=8;j<16;j++)
+		{
+			predMB_OBMC[i*16+j] = (predMB[i*16+j]*H_E_8x8[i-8][j-8] + predMB_LR[(i-8)*8+(j-8)]*H_LR_8x8[i-8][j-8] + predMB_TD[(i-8)*8+(j-8)]*H_TD_8x8[i-8][j-8]);
+			predMB_OBMC[i*16+j] = (int)floor(predMB_OBMC[i*16+j]/8.0 + 0.5);
 
-	if(OBMC)
-		free(predMB_OBMC);
+			upper = predMB[i*16+j] + (predMB[i*16+j]*OBMC_TR/100);
+			lower = predMB[i*16+j] - (predMB[i*16+j]*OBMC_TR/100);
+			if(OBMC_THRESHOLD && !(predMB_OBMC[i*16+j]>=lower && predMB_OBMC[i*16+j]<=upper))
+				predMB_OBMC[i*16+j] = predMB[i*16+j];
+		}
+	}
 
-	return 0;
-}
+	for(i=4;i<8;i++)
+	{
+		for(j=4;j<8;j++)
+		{
+			predMB_OBMC[256+i*8+j] = (predMB[256+i*8+j]*H_E_8x8[i-4][j-4] + predMB_LR[64+(i-4)*4+(j-4)]*H_LR_8x8[i-4][j-4] + predMB_TD[64+(i-4)*4+(j-4)]*H_TD_8x8[i-4][j-4]);
+			predMB_OBMC[256+i*8+j] = (int)floor(predMB_OBMC[256+i*8+j]/8.0 + 0.5);
 
-static void buildOuterPredRegionYUV_ECMODE4(struct img_par *img, int32 *mv, int x, int y, imgpel *predMB, imgpel *boundary, int pos)
-{
-  int tmp_block[BLOCK_SIZE][BLOCK_SIZE];
-  int i=0,j=0,ii=0,jj=0,i1=0,j1=0,j4=0,i4=0,k=0;
-  int jf=0;
-  int uv;
-  int vec1_x=0,vec1_y=0;
-  int ioff,joff;
-  imgpel *pMB = predMB; //Note: predMB is actually pred_ecmodeMB; for ecmode2, it is left/right half, so 8x16 for Y and 4x8,4x8 for UV
-  
-  int ii0,jj0,ii1,jj1,if1,jf1,if0,jf0;
-  int mv_mul;
+			upper = predMB[256+i*8+j] + (predMB[256+i*8+j]*OBMC_TR/100);
+			lower = predMB[256+i*8+j] - (predMB[256+i*8+j]*OBMC_TR/100);
+			if(OBMC_THRESHOLD && !(predMB_OBMC[256+i*8+j]>=lower && predMB_OBMC[256+i*8+j]<=upper))
+				predMB_OBMC[256+i*8+j] = predMB[256+i*8+j];
 
-  int above[4], left[4], below[4], right[4], index;
-  
-  //FRExt
-  int f1_x, f1_y, f2_x, f2_y, f3, f4, ifx;
-  int b8, b4;
-  int yuv = dec_picture->chroma_format_idc - 1;
-  
-  int ref_frame = max (mv[2], 0); // !!KS: quick fix, we sometimes seem to get negative ref_pic here, so restrict to zero an above
+			predMB_OBMC[256+64+i*8+j] = (predMB[256+64+i*8+j]*H_E_8x8[i-4][j-4] + predMB_LR[64+16+(i-4)*4+(j-4)]*H_LR_8x8[i-4][j-4] + predMB_TD[64+16+(i-4)*4+(j-4)]*H_TD_8x8[i-4][j-4]);
+			predMB_OBMC[256+64+i*8+j] = (int)floor(predMB_OBMC[256+64+i*8+j]/8.0 + 0.5);
 
-  /* Update coordinates of the current concealed macroblock */
-  img->mb_x = x/MB_BLOCK_SIZE;
-  img->mb_y = y/MB_BLOCK_SIZE;
-  img->block_y = img->mb_y * BLOCK_SIZE;
-  img->pix_c_y = img->mb_y * img->mb_cr_size_y;
-  img->block_x = img->mb_x * BLOCK_SIZE;
-  img->pix_c_x = img->mb_x * img->mb_cr_size_x;
+			upper = predMB[256+64+i*8+j] + (predMB[256+64+i*8+j]*OBMC_TR/100);
+			lower = predMB[256+64+i*8+j] - (predMB[256+64+i*8+j]*OBMC_TR/100);
+			if(OBMC_THRESHOLD && !(predMB_OBMC[256+64+i*8+j]>=lower && predMB_OBMC[256+64+i*8+j]<=upper))
+				predMB_OBMC[256+64+i*8+j] = predMB[256+64+i*8+j];
+		}
+	}
+}
 
-  mv_mul=4;
 
-  // luma *******************************************************
+/*!
+ ************************************************************************
+ * \brief
+ *      Partition mode (ECMODE1..ECMODE4) of the four mode adaptive block
+ *      size concealment for an MB, see fourmodesEcmodeRules()
+ ************************************************************************
+ */
+int fourmodes_find_mb_ecmode(struct img_par *img, int predBlocks[],int numMBPerLine,int currMBNum)
+{
+  return ecmodeTable[1][ecmodeIndex(img, predBlocks, numMBPerLine, currMBNum)];
+}
 
-  for(i=0;i<4;i++)
-  {
-	  above[i]=0;left[i]=0;below[i]=0;right[i]=0;
-  }
+/*!
+ ************************************************************************
+ * \brief
+ *      The rules of fourmodes_find_mb_ecmode(), see ecmodeRules()
+ ************************************************************************
+ */
+static int fourmodesEcmodeRules(int mode_A, int mode_L, int mode_B, int mode_R,
+                                int mode_A_available, int mode_L_available, int mode_B_available, int mode_R_available)
+{
+	int numIntraNeighbours=0, mb_ecmode=ECMODE1; //default mode
 
-  for(j=0;j<MB_BLOCK_SIZE/BLOCK_SIZE;j++)
-  {
-    joff=j*4;
-    j4=img->block_y+j;
-    for(i=0;i<MB_BLOCK_SIZE/BLOCK_SIZE;i++)
-    {
-      ioff=i*4;
-      i4=img->block_x+i;
-
-      vec1_x = i4*4*mv_mul + mv[0];
-      vec1_y = j4*4*mv_mul + mv[1];
+	//Determine if this MB is to be concealed using SEC or TEC
+	if(mode_A_available && mode_A>=9)
+		numIntraNeighbours++;
+	if(mode_L_available && mode_L>=9)
+		numIntraNeighbours++;
+	if(mode_B_available && mode_B>=9)
+		numIntraNeighbours++;
+	if(mode_R_available && mode_R>=9)
+		numIntraNeighbours++;
 
-      get_block(ref_frame, listX[0], vec1_x,vec1_y,img,tmp_block);
+	//DISCUSS - all 4 should be INTRA? 3 is doubtful, even if one nbr has motion, we should use TEC?
+	if(numIntraNeighbours>=3) 
+	{
+		mb_ecmode = SEC;
+		//return mb_ecmode;
+		return ECMODE1; //change this later...TODO
+	}
 
-	  index = i+4*j;
-	  get_boundary(ref_frame, listX[0], vec1_x, vec1_y, img, index, above, left, below, right);
-	  
-	  if(j==0)
-	  {
-		  boundary[4*i+0]=above[0];boundary[4*i+1]=above[1];boundary[4*i+2]=above[2];boundary[4*i+3]=above[3];
-	  }
+	//Else, we are now sure that Temporal Error Concealment (TEC) is to be used
+	
+	//Determine adaptively the block size for this MB to conceal using the nbr mb_type
 
-	  if(i==0)
-	  {
-		  boundary[16+4*j+0]=left[0];boundary[16+4*j+1]=left[1];boundary[16+4*j+2]=left[2];boundary[16+4*j+3]=left[3];
-	  }
+	if( ((mode_A_available && (mode_A!=8 || mode_A!=3)) || !mode_A_available) &&
+		((mode_B_available && (mode_B!=8 || mode_B!=3)) || !mode_B_available) &&
+		(mode_L_available && (mode_L==8 || mode_L==2)) &&
+		(mode_R_available && (mode_R==8 || mode_R==2)) )
+	{
+		mb_ecmode = ECMODE2;
+	}
+	else if( (mode_A_available && (mode_A==8 || mode_A==3)) &&
+			 (mode_B_available && (mode_B==8 || mode_B==3)) &&
+			 ((mode_L_available && (mode_L!=8 || mode_L!=2)) || !mode_L_available) &&
+			 ((mode_R_available && (mode_R!=8 || mode_R!=2)) || !mode_R_available) )
+	{
+		mb_ecmode = ECMODE3;
+	}
+	else if( (mode_A_available && (mode_A==8 || mode_A==3)) &&
+			 (mode_B_available && (mode_B==8 || mode_B==3)) &&
+			 (mode_L_available && (mode_L==8 || mode_L==2)) &&
+			 (mode_R_available && (mode_R==8 || mode_R==2)) )
+	{
+		mb_ecmode = ECMODE4;
+	}
 
-	  if(j==3) //MB_BLOCK_SIZE/BLOCK_SIZE - 1 = 3
-	  {
-		  boundary[32+4*i+0]=below[0];boundary[32+4*i+1]=below[1];boundary[32+4*i+2]=below[2];boundary[32+4*i+3]=below[3];
-	  }
+	return mb_ecmode;
+}
 
-	  if(i==3)
-	  {
-		  boundary[48+4*j+0]=right[0];boundary[48+4*j+1]=right[1];boundary[48+4*j+2]=right[2];boundary[48+4*j+3]=right[3];
-	  }
+/*!
+ ************************************************************************
+ * \brief
+ *      Selects the inter (P) frame concealment strategy used by
+ *      ercConcealInterFrame()
+ * \return
+ *      1, if the strategy exists
+ *      0, otherwise (the active strategy is left unchanged)
+ * \param strategy
+ *      Index into ercInterStrategies[]
+ ************************************************************************
+ */
+int ercSetInterStrategy(int strategy)
+{
+  if (strategy < 0 || strategy >= NUM_INTER_STRATEGIES)
+    return 0;
 
-      for(ii=0;ii<BLOCK_SIZE;ii++)
-        for(jj=0;jj<MB_BLOCK_SIZE/BLOCK_SIZE;jj++)
-          img->mpr[ii+ioff][jj+joff]=tmp_block[ii][jj];
-    }
-  }
+  ercInter = &ercInterStrategies[strategy];
+  return 1;
+}
 
-  switch(pos)
-  {
-  case 0:
-	  k=0;
-	  for(j=0;j<8;j++)
-	  {
-		  for(i=0;i<8;i++)
-		  {
-			  pMB[k++] = img->mpr[i][j];
-		  }
-	  }
-	  break;
-  case 1:
-	  k=0;
-	  for(j=0;j<8;j++)
-	  {
-		  for(i=8;i<16;i++)
-		  {
-			  pMB[k++] = img->mpr[i][j];
-		  }
-	  }
-	  break;
-  case 2:
-	  k=0;
-	  for(j=8;j<16;j++)
-	  {
-		  for(i=0;i<8;i++)
-		  {
-			  pMB[k++] = img->mpr[i][j];
-		  }
-	  }
-	  break;
-  case 3:
-	  k=0;
-	  for(j=8;j<16;j++)
-	  {
-		  for(i=8;i<16;i++)
-		  {
-			  pMB[k++] = img->mpr[i][j];
-		  }
-	  }
-	  break;
-  }
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the index of the active inter concealment strategy
+ ************************************************************************
+ */
+int ercGetInterStrategy(void)
+{
+  return (int) (ercInter - ercInterStrategies);
+}
 
-  pMB += 64;
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the name of an inter concealment strategy, NULL if the
+ *      index is out of range
+ ************************************************************************
+ */
+char *ercInterStrategyName(int strategy)
+{
+  if (strategy < 0 || strategy >= NUM_INTER_STRATEGIES)
+    return NULL;
 
-  if (dec_picture->chroma_format_idc != YUV400)
-  {
-    // chroma *******************************************************
-    f1_x = 64/img->mb_cr_size_x;
-    f2_x=f1_x-1;
+  return ercInterStrategies[strategy].name;
+}
 
-    f1_y = 64/img->mb_cr_size_y;
-    f2_y=f1_y-1;
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the number of inter concealment strategies
+ ************************************************************************
+ */
+int ercNumInterStrategies(void)
+{
+  return NUM_INTER_STRATEGIES;
+}
 
-    f3=f1_x*f1_y;
-    f4=f3>>1;
+/*!
+ ************************************************************************
+ * \brief
+ *      Enables the sub-pel plane cache of the concealment motion
+ *      compensation and bounds its memory.
+ * \return
+ *      1, if the setting was accepted
+ *      0, if it is negative
+ * \param maxKBytes
+ *      memory allowed for the cached phase planes of each context in KB,
+ *      0 disables the cache. A context above the new limit releases its
+ *      phase planes before it conceals its next frame.
+ ************************************************************************
+ */
+int ercSetSubPelCache(int maxKBytes)
+{
+  if (maxKBytes < 0)
+    return 0;
 
-    for(uv=0;uv<2;uv++)
-    {
-      for (b8=0;b8<(img->num_blk8x8_uv/2);b8++)
-      {
-        for(b4=0;b4<4;b4++)
-		{
-          joff = subblk_offset_y[yuv][b8][b4];
-          j4=img->pix_c_y+joff;
-          ioff = subblk_offset_x[yuv][b8][b4];
-          i4=img->pix_c_x+ioff;
+  subPelCacheLimit = maxKBytes*1024;
+  return 1;
+}
 
-          for(jj=0;jj<4;jj++)
-          {
-            jf=(j4+jj)/(img->mb_cr_size_y/4);     // jf  = Subblock_y-coordinate
-            for(ii=0;ii<4;ii++)
-            {
-              ifx=(i4+ii)/(img->mb_cr_size_x/4);  // ifx = Subblock_x-coordinate
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the memory allowed for the sub-pel plane cache in KB,
+ *      0 if the cache is disabled
+ ************************************************************************
+ */
+int ercGetSubPelCache(void)
+{
+  return subPelCacheLimit/1024;
+}
 
-              i1=(i4+ii)*f1_x + mv[0];
-              j1=(j4+jj)*f1_y + mv[1];
-            
-              ii0=max (0, min (i1/f1_x,   dec_picture->size_x_cr-1));
-              jj0=max (0, min (j1/f1_y,   dec_picture->size_y_cr-1));
-              ii1=max (0, min ((i1+f2_x)/f1_x, dec_picture->size_x_cr-1));
-              jj1=max (0, min ((j1+f2_y)/f1_y, dec_picture->size_y_cr-1));
-            
-              if1=(i1 & f2_x);
-              jf1=(j1 & f2_y);
-              if0=f1_x-if1;
-              jf0=f1_y-jf1;
-            
-              img->mpr[ii+ioff][jj+joff]=(if0*jf0*listX[0][ref_frame]->imgUV[uv][jj0][ii0]+
-                                          if1*jf0*listX[0][ref_frame]->imgUV[uv][jj0][ii1]+
-                                          if0*jf1*listX[0][ref_frame]->imgUV[uv][jj1][ii0]+
-                                          if1*jf1*listX[0][ref_frame]->imgUV[uv][jj1][ii1]+f4)/f3;
-            }
-          }
-        }
-      }
+/*!
+ ************************************************************************
+ * \brief
+ *      Sets the time allowed for the concealment of one picture. The MBs
+ *      left after half of it are concealed by plain boundary matching,
+ *      those left after all of it by copy (inter frames) or mean
+ *      interpolation (intra frames), see ercConcealLevel().
+ * \return
+ *      1 on success, 0 if ms is negative
+ * \param ms
+ *      the deadline in ms, 0 disables it
+ ************************************************************************
+ */
+int ercSetConcealDeadline(int ms)
+{
+  if (ms < 0)
+    return 0;
 
-	  switch(pos)
-	  {
-	  case 0:
-		  k=0;
-		  for(j=0;j<4;j++)
-		  {
-			  for(i=0;i<4;i++)
-			  {
-				  pMB[k++] = img->mpr[i][j];
-			  }
-		  }
-		  break;
-	  case 1:
-		  k=0;
-		  for(j=0;j<4;j++)
-		  {
-			  for(i=4;i<8;i++)
-			  {
-				  pMB[k++] = img->mpr[i][j];
-			  }
-		  }
-		  break;
-	  case 2:
-		  k=0;
-		  for(j=4;j<8;j++)
-		  {
-			  for(i=0;i<4;i++)
-			  {
-				  pMB[k++] = img->mpr[i][j];
-			  }
-		  }
-		  break;
-	  case 3:
-		  k=0;
-		  for(j=4;j<8;j++)
-		  {
-			  for(i=4;i<8;i++)
-			  {
-				  pMB[k++] = img->mpr[i][j];
-			  }
-		  }
-		  break;
-	  }
+  concealDeadline = ms;
+  return 1;
+}
 
-	  pMB += 16;
-    }
-  }
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the concealment deadline of a picture in ms, 0 if none
+ ************************************************************************
+ */
+int ercGetConcealDeadline(void)
+{
+  return concealDeadline;
 }
 
-static int edgeDistortion_ECMODE4(int predBlocks[], int currYBlockNum, imgpel *predMB, imgpel *recY, int32 picSizeX, int32 regionSize, imgpel *boundary, int pos)
+/*!
+ ************************************************************************
+ * \brief
+ *      Selects the extra MV candidates the boundary matching of an MB
+ *      tries after the MVs of its neighbours (see concealByTrial()).
+ *      They are not tried at the reduced concealment level.
+ * \return
+ *      1 on success, 0 if the mask holds unknown candidates
+ * \param mask
+ *      ERC_MVCAND_* or-ed together, 0 for the neighbour MVs only
+ ************************************************************************
+ */
+int ercSetMVCandidates(int mask)
 {
-  int i, j, distortion, numOfPredBlocks, threshold = ERC_BLOCK_OK;
-  imgpel *currBlock = NULL, *neighbor = NULL;
-  int32 currBlockOffset = 0;
-  
-  currBlock = recY + (yPosYBlock(currYBlockNum,picSizeX)<<3)*picSizeX + (xPosYBlock(currYBlockNum,picSizeX)<<3);
-  
-  do 
-  {    
-    distortion = 0; numOfPredBlocks = 0;
-    
-    /* loop the 2 neighbours */
-    for (j = 4; j < 8; j++) 
-    {
-		if(pos==0 && (j==6 || j==7))
-			continue;
-		if(pos==1 && (j==5 || j==6))
-			continue;
-		if(pos==2 && (j==4 || j==7))
-			continue;
-		if(pos==3 && (j==4 || j==5))
-			continue;
-
-	  /* if reliable, count boundary pixel difference */
-      if (predBlocks[j] >= threshold) 
-      {
-        
-        switch (j) 
-        {
-        case 4:
-		  neighbor = currBlock - picSizeX;
-		  if(OBMA)
-		  {
-			for(i=0+8*pos;i<8+8*pos;i++) //pos = 0 or 1 for above
-				distortion += mabs((int)(boundary[i] - neighbor[i]));
-		  }
-		  else
-		  {
-			  for ( i=0+8*pos;i<8+8*pos;i++ ) 
-	            distortion += mabs((int)(predMB[i-8*pos] - neighbor[i]));
-    	  }
-		  break;          
-        case 5:
-          neighbor = currBlock - 1;
-		  if(OBMA)
-		  {
-			  if(pos==0)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(boundary[16+i] - neighbor[i*picSizeX]));
-			  }
-			  else if(pos==2)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(boundary[16+i] - neighbor[i*picSizeX]));
-			  }
-		  }
-		  else
-		  {
-			  if(pos==0)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(predMB[i*8] - neighbor[i*picSizeX]));
-			  }
-			  else if(pos==2)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(predMB[(i-8)*8] - neighbor[i*picSizeX]));
-			  }
-		  }		  
-          break;                
-        case 6:
-          neighbor = currBlock + regionSize*picSizeX;
-          currBlockOffset = 8*7;
-		  if(OBMA)
-		  {
-			  if(pos==2)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(boundary[32+i] - neighbor[i]));
-			  }
-			  else if(pos==3)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(boundary[32+i] - neighbor[i]));
-			  }
-		  }
-		  else
-		  {
-			  if(pos==2)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(predMB[i+currBlockOffset] - neighbor[i]));
-			  }
-			  else if(pos==3)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(predMB[i-8+currBlockOffset] - neighbor[i]));
-			  }
-		  }
-          break;                
-        case 7:
-          neighbor = currBlock + regionSize;
-          currBlockOffset = 7;
-		  if(OBMA)
-		  {
-			  if(pos==1)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(boundary[48+i] - neighbor[i*picSizeX]));
-			  }
-			  else if(pos==3)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(boundary[48+i] - neighbor[i*picSizeX]));
-			  }
-		  }
-		  else
-		  {
-			  if(pos==1)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(predMB[i*8+currBlockOffset] - neighbor[i*picSizeX]));
-			  }
-			  else if(pos==3)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(predMB[(i-8)*8+currBlockOffset] - neighbor[i*picSizeX]));
-			  }
-		  }
-          break;
-        }
-        
-        numOfPredBlocks++;
-      }
-    }
-    
-    threshold--;
-    if (threshold < ERC_BLOCK_CONCEALED)
-      break;
-  } while (numOfPredBlocks == 0);
-  
-  if(numOfPredBlocks == 0)
+  if (mask < 0 || mask > ERC_MVCAND_ALL)
     return 0;
 
-  return (distortion/numOfPredBlocks);
+  mvCandidates = mask;
+  return 1;
 }
 
-/**********************************************************************************************************************/
-//EC Mode 5
-static int concealABS_ECMODE5(frame *recfr, imgpel *predMB,int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
-                      int32 picSizeX, int32 picSizeY, int *yCondition)
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the extra MV candidates of the boundary matching
+ ************************************************************************
+ */
+int ercGetMVCandidates(void)
 {
-	imgpel *pred_above_ecmodeMB, *pred_ecmodeMB, *top_pred_ecmodeMB, *bottomleft_pred_ecmodeMB, *bottomright_pred_ecmodeMB;
+  return mvCandidates;
+}
 
-	int predMBNum = 0, numMBPerLine,
-      compSplit1 = 0, compSplit2 = 0, compLeft = 1, comp = 0, compPred, order = 1,
-      fInterNeighborExists, numIntraNeighbours,
-      fZeroMotionChecked, predSplitted = 0,
-      threshold = ERC_BLOCK_OK,
-      minDist, currDist, i, k, j, p, q, bestDir;
-	int32 regionSize;
-	objectBuffer_t *currRegion;
-	int32 mvBest[3] , mvPred[3], *mvptr;
-
-	//Santosh
- 	imgpel *predMB_OBMC;
-	
-	if(OBMC)
-		predMB_OBMC = (imgpel *) malloc ( (256 + (img->mb_cr_size_x*img->mb_cr_size_y)*2) * sizeof (imgpel));
-
-	//16x8 for luma and 8x4, 8x4 for chroma
-	pred_above_ecmodeMB = (imgpel *) malloc( ( 128 + (img->mb_cr_size_x*img->mb_cr_size_y/2)*2) * sizeof (imgpel));
-	top_pred_ecmodeMB = (imgpel *) malloc( ( 128 + (img->mb_cr_size_x*img->mb_cr_size_y/2)*2) * sizeof (imgpel));
-
-	//8x8 for luma and 4x4, 4x4 for chroma
-	pred_ecmodeMB = (imgpel *) malloc ( (64 + (img->mb_cr_size_x*img->mb_cr_size_y/4)*2) * sizeof (imgpel));
-	bottomleft_pred_ecmodeMB = (imgpel *) malloc ( (64 + (img->mb_cr_size_x*img->mb_cr_size_y/4)*2) * sizeof (imgpel));
-	bottomright_pred_ecmodeMB = (imgpel *) malloc ( (64 + (img->mb_cr_size_x*img->mb_cr_size_y/4)*2) * sizeof (imgpel));
-
-	numMBPerLine = (int) (picSizeX>>4);
-  	comp = 0;
-	regionSize = 16;
-
-	//UPPER HALF
-	threshold = ERC_BLOCK_OK;
-	comp=0;
-	currRegion = object_list+(currMBNum<<2)+comp;
-	
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-
-	do
-	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;	
-
-		/* loop the 3 neighbours */
-		for (i = 4; i < 8; i++) //no below nbr for upper half
-		{
-			if(i==6)
-				continue;
-
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
-			{
-				switch (i) 
-				{
-				case 4:
-					predMBNum = currMBNum-numMBPerLine;
-					compSplit1 = 2;
-					compSplit2 = 3;
-					break;              
-				case 5:
-					predMBNum = currMBNum-1;
-					compSplit1 = 1;
-					compSplit2 = 1;
-					break; 
-				case 7:
-					predMBNum = currMBNum+1;
-					compSplit1 = 0;
-					compSplit2 = 0;
-					break;
-				}
-
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE5(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_above_ecmodeMB, boundary,0);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE5(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_above_ecmodeMB, boundary,0);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE5(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_above_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 0);
-						
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode =
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<128+32+32;p++)
-							{
-								top_pred_ecmodeMB[p] = pred_above_ecmodeMB[p];
-							}
-							
-							p=0;
-						}
-              
-						fInterNeighborExists = 1;    
-					}
-				}
-			}
-		}
-
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE5(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_above_ecmodeMB, boundary,0);
-
-	  currDist = edgeDistortion_ECMODE5(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_above_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 0);
-      
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-
-		for(p=0;p<128+32+32;p++)
-		{
-			top_pred_ecmodeMB[p] = pred_above_ecmodeMB[p];
-		}
-	  }
-    }
-
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
-    
-
-	//BOTTOM LEFT
-	threshold = ERC_BLOCK_OK;
-	comp=2;
-	currRegion = object_list+(currMBNum<<2)+comp;
-	
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-
-	do
-	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;	
-
-		/* loop the 2 neighbours */
-		for (i = 5; i < 7; i++) //only left and below nbrs
-		{
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
-			{
-				switch (i) 
-				{
-				case 5:
-					predMBNum = currMBNum-1;
-					compSplit1 = 3;
-					compSplit2 = 3;
-					break;  
-				case 6:
-					predMBNum = currMBNum+numMBPerLine;
-					compSplit1 = 0;
-					compSplit2 = 0;
-					break;
-				}
-
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE5(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE5(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE5(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 1);
-						
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode =
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<64+16+16;p++)
-							{
-								bottomleft_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-							}
-							
-							p=0;
-						}
-              
-						fInterNeighborExists = 1;    
-					}
-				}
-			}
-		}
-
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE5(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
-
-	  currDist = edgeDistortion_ECMODE5(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 1);
-      
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
+/*!
+ ************************************************************************
+ * \brief
+ *      Sets the early exit of the MV search of the boundary matching: the
+ *      first candidate whose boundary difference per pixel is below the
+ *      threshold conceals the MB and no further candidate is tried.
+ * \return
+ *      1 on success, 0 if the threshold is negative
+ * \param sadPerPixel
+ *      the threshold, 0 tries all candidates
+ ************************************************************************
+ */
+int ercSetEarlyExitSAD(int sadPerPixel)
+{
+  if (sadPerPixel < 0)
+    return 0;
 
-		for(p=0;p<64+16+16;p++)
-		{
-			bottomleft_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-		}
-	  }
-    }
+  earlyExitSAD = sadPerPixel;
+  return 1;
+}
 
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the early exit threshold of the boundary matching, 0 if off
+ ************************************************************************
+ */
+int ercGetEarlyExitSAD(void)
+{
+  return earlyExitSAD;
+}
 
+/*!
+ ************************************************************************
+ * \brief
+ *      Enables the refinement of the MV chosen for a concealed MB or
+ *      partition, see refineMV(). It is not done at the reduced
+ *      concealment level.
+ * \return
+ *      1 on success, 0 if the range is out of 0..ERC_MAX_REFINE_RANGE
+ * \param pels
+ *      largest distance of the refined MV from the chosen one in integer
+ *      pels, 0 disables the refinement
+ ************************************************************************
+ */
+int ercSetRefineRange(int pels)
+{
+  if (pels < 0 || pels > ERC_MAX_REFINE_RANGE)
+    return 0;
 
-	//BOTTOM RIGHT
-	threshold = ERC_BLOCK_OK;
-	comp=3;
-	currRegion = object_list+(currMBNum<<2)+comp;
-	
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
+  refineRange = pels;
+  return 1;
+}
 
-	do
-	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;	
-
-		/* loop the 2 neighbours */
-		for (i = 6; i < 8; i++) //only below and right nbrs
-		{
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
-			{
-				switch (i) 
-				{
-				case 6:
-					predMBNum = currMBNum+numMBPerLine;
-					compSplit1 = 1;
-					compSplit2 = 1;
-					break;             
-				case 7:
-					predMBNum = currMBNum+1;
-					compSplit1 = 2;
-					compSplit2 = 2;
-					break;              
-				}
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the range of the MV refinement in integer pels, 0 if off
+ ************************************************************************
+ */
+int ercGetRefineRange(void)
+{
+  return refineRange;
+}
 
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE5(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,2);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE5(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,2);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE5(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 2);
-						
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode =
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<64+16+16;p++)
-							{
-								bottomright_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-							}
-							
-							p=0;
-						}
-              
-						fInterNeighborExists = 1;    
-					}
-				}
-			}
-		}
+/*!
+ ************************************************************************
+ * \brief
+ *      Bounds the MV refinement of a picture. Every refined position
+ *      scored takes one evaluation; when none is left the remaining MBs
+ *      keep the MV of the candidate search. With parallel concealment
+ *      the evaluations left are shared evenly by the MBs of each wave,
+ *      so the result does not depend on the number of threads.
+ * \return
+ *      1 on success, 0 if the budget is negative
+ * \param evaluations
+ *      positions scored per picture, 0 for no limit
+ ************************************************************************
+ */
+int ercSetRefineBudget(int evaluations)
+{
+  if (evaluations < 0)
+    return 0;
 
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE5(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,2);
+  refineBudget = evaluations;
+  return 1;
+}
 
-	  currDist = edgeDistortion_ECMODE5(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 2);
-      
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the MV refinement evaluations allowed per picture, 0 if
+ *      there is no limit
+ ************************************************************************
+ */
+int ercGetRefineBudget(void)
+{
+  return refineBudget;
+}
 
-		for(p=0;p<64+16+16;p++)
-		{
-			bottomright_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-		}
-	  }
-    }
+/*!
+ ************************************************************************
+ * \brief
+ *      Sets the number of the most recent references of list 0 the
+ *      candidate MVs of a concealed MB or partition are also tried
+ *      against, see tryRecentRefs(). Every candidate is always predicted
+ *      from its own reference. It is not done at the reduced concealment
+ *      level.
+ * \return
+ *      1 on success, 0 if the number is out of 1..ERC_MAX_CONCEAL_REFS
+ * \param numRefs
+ *      1 for the own reference of every candidate only
+ ************************************************************************
+ */
+int ercSetConcealRefs(int numRefs)
+{
+  if (numRefs < 1 || numRefs > ERC_MAX_CONCEAL_REFS)
+    return 0;
 
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
+  concealRefs = numRefs;
+  return 1;
+}
 
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the number of recent references the candidate MVs are
+ *      tried against
+ ************************************************************************
+ */
+int ercGetConcealRefs(void)
+{
+  return concealRefs;
+}
 
-	//Whole MB concealed at this stage, copy to predMB
+/*!
+ ************************************************************************
+ * \brief
+ *      Bounds the search over the recent references: the number of
+ *      (MV, reference) pairs tried for an MB or partition besides the
+ *      candidates on their own references.
+ * \return
+ *      1 on success, 0 if the number is below 1
+ * \param numPairs
+ *      pairs tried per MB or partition
+ ************************************************************************
+ */
+int ercSetRefCandidates(int numPairs)
+{
+  if (numPairs < 1)
+    return 0;
 
-	p=0; q=0;
-	for(j=0;j<8;j++)
-	{
-		for(i=0;i<16;i++)
-		{
-			predMB[j*16+i] = top_pred_ecmodeMB[p];
-			p++;
-		}
-		for(i=0;i<8;i++)
-		{
-			predMB[(j+8)*16+i] = bottomleft_pred_ecmodeMB[q];
-			predMB[(j+8)*16+i+8] = bottomright_pred_ecmodeMB[q];
-			q++;
-		}
-	}
+  refCandidates = numPairs;
+  return 1;
+}
 
-	p=0;q=0;
-	for(j=0;j<4;j++)
-	{
-		for(i=0;i<8;i++)
-		{
-			predMB[256+j*8+i] = top_pred_ecmodeMB[128+p];
-			predMB[256+64+j*8+i] = top_pred_ecmodeMB[128+32+p];
-			p++;
-		}
-		for(i=0;i<4;i++)
-		{
-			predMB[256+(j+4)*8+i] = bottomleft_pred_ecmodeMB[64+q];
-			predMB[256+(j+4)*8+i+4] = bottomright_pred_ecmodeMB[64+q];
-			predMB[256+64+(j+4)*8+i] = bottomleft_pred_ecmodeMB[80+q];
-			predMB[256+64+(j+4)*8+i+4] = bottomright_pred_ecmodeMB[80+q];
-			q++;
-		}
-	}
-	
-	if(OBMC)
-	{
-		OBMC_MB(predMB,predMB_OBMC,predBlocks,object_list,currMBNum,numMBPerLine,picSizeX);
-		copyPredMB(MBNum2YBlock(currMBNum,0,picSizeX), predMB_OBMC, recfr, picSizeX, regionSize);
-	}
-	else
-		copyPredMB(MBNum2YBlock(currMBNum,0,picSizeX), predMB, recfr,picSizeX, regionSize);
-	
-	yCondition[MBNum2YBlock(currMBNum,0,picSizeX)] = ERC_BLOCK_CONCEALED;
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the (MV, reference) pairs tried per MB or partition
+ ************************************************************************
+ */
+int ercGetRefCandidates(void)
+{
+  return refCandidates;
+}
 
-	free(pred_ecmodeMB);
-	free(pred_above_ecmodeMB);
-	free(top_pred_ecmodeMB);
-	free(bottomleft_pred_ecmodeMB);
-	free(bottomright_pred_ecmodeMB);
+/*!
+ ************************************************************************
+ * \brief
+ *      Sets the tolerance of the MV candidate clustering: before the
+ *      candidates of an MB or partition are measured, the ones within
+ *      this distance of an earlier candidate are dropped, so a smooth
+ *      motion field costs one prediction per cluster and not one per
+ *      neighbour. The dropped candidates of a frame are reported.
+ * \return
+ *      1 on success, 0 if the tolerance is out of 0..ERC_MAX_CLUSTER_TOLERANCE
+ * \param quarterPels
+ *      largest difference of a component in quarter pels, 0 = off
+ ************************************************************************
+ */
+int ercSetClusterTolerance(int quarterPels)
+{
+  if (quarterPels < 0 || quarterPels > ERC_MAX_CLUSTER_TOLERANCE)
+    return 0;
 
-	if(OBMC)
-		free(predMB_OBMC);
+  clusterTolerance = quarterPels;
+  return 1;
+}
 
-	return 0;
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the tolerance of the MV candidate clustering in quarter pels
+ ************************************************************************
+ */
+int ercGetClusterTolerance(void)
+{
+  return clusterTolerance;
 }
 
-static void buildOuterPredRegionYUV_ECMODE5(struct img_par *img, int32 *mv, int x, int y, imgpel *predMB, imgpel *boundary, int pos)
+/*!
+ ************************************************************************
+ * \brief
+ *      Sets the coarse-to-fine scoring of the extra MV candidates of
+ *      boundary matching (ercSetMVCandidates()): when an MB has more
+ *      than topK of them, they are first ranked on a 1/2 or 1/4
+ *      resolution pyramid of the references (1/4 for pictures of
+ *      ERC_COARSE_QUARTER_WIDTH pixels and wider), and only the topK
+ *      best are predicted with sub-pel interpolation and measured. The
+ *      MVs of the neighbours, zero motion, the other recent references
+ *      and the MV refinement are always measured in full.
+ * \return
+ *      1 on success, 0 if topK is out of 0..ERC_MAX_COARSE_CANDIDATES
+ * \param topK
+ *      extra candidates measured at full resolution, 0 = no ranking
+ ************************************************************************
+ */
+int ercSetCoarseCandidates(int topK)
 {
-  int tmp_block[BLOCK_SIZE][BLOCK_SIZE];
-  int i=0,j=0,ii=0,jj=0,i1=0,j1=0,j4=0,i4=0,k=0;
-  int jf=0;
-  int uv;
-  int vec1_x=0,vec1_y=0;
-  int ioff,joff;
-  imgpel *pMB = predMB; //Note: predMB is actually pred_ecmodeMB; for ecmode2, it is left/right half, so 8x16 for Y and 4x8,4x8 for UV
-  
-  int ii0,jj0,ii1,jj1,if1,jf1,if0,jf0;
-  int mv_mul;
+  if (topK < 0 || topK > ERC_MAX_COARSE_CANDIDATES)
+    return 0;
 
-  int above[4], left[4], below[4], right[4], index;
-  
-  //FRExt
-  int f1_x, f1_y, f2_x, f2_y, f3, f4, ifx;
-  int b8, b4;
-  int yuv = dec_picture->chroma_format_idc - 1;
-  
-  int ref_frame = max (mv[2], 0); // !!KS: quick fix, we sometimes seem to get negative ref_pic here, so restrict to zero an above
+  coarseCandidates = topK;
+  return 1;
+}
 
-  /* Update coordinates of the current concealed macroblock */
-  img->mb_x = x/MB_BLOCK_SIZE;
-  img->mb_y = y/MB_BLOCK_SIZE;
-  img->block_y = img->mb_y * BLOCK_SIZE;
-  img->pix_c_y = img->mb_y * img->mb_cr_size_y;
-  img->block_x = img->mb_x * BLOCK_SIZE;
-  img->pix_c_x = img->mb_x * img->mb_cr_size_x;
-
-  mv_mul=4;
-
-  // luma *******************************************************
-
-  for(i=0;i<4;i++)
-  {
-	  above[i]=0;left[i]=0;below[i]=0;right[i]=0;
-  }
-
-  for(j=0;j<MB_BLOCK_SIZE/BLOCK_SIZE;j++)
-  {
-    joff=j*4;
-    j4=img->block_y+j;
-    for(i=0;i<MB_BLOCK_SIZE/BLOCK_SIZE;i++)
-    {
-      ioff=i*4;
-      i4=img->block_x+i;
-
-      vec1_x = i4*4*mv_mul + mv[0];
-      vec1_y = j4*4*mv_mul + mv[1];
-
-      get_block(ref_frame, listX[0], vec1_x,vec1_y,img,tmp_block);
-
-	  index = i+4*j;
-	  get_boundary(ref_frame, listX[0], vec1_x, vec1_y, img, index, above, left, below, right);
-	  
-	  if(j==0)
-	  {
-		  boundary[4*i+0]=above[0];boundary[4*i+1]=above[1];boundary[4*i+2]=above[2];boundary[4*i+3]=above[3];
-	  }
-
-	  if(i==0)
-	  {
-		  boundary[16+4*j+0]=left[0];boundary[16+4*j+1]=left[1];boundary[16+4*j+2]=left[2];boundary[16+4*j+3]=left[3];
-	  }
-
-	  if(j==3) //MB_BLOCK_SIZE/BLOCK_SIZE - 1 = 3
-	  {
-		  boundary[32+4*i+0]=below[0];boundary[32+4*i+1]=below[1];boundary[32+4*i+2]=below[2];boundary[32+4*i+3]=below[3];
-	  }
-
-	  if(i==3)
-	  {
-		  boundary[48+4*j+0]=right[0];boundary[48+4*j+1]=right[1];boundary[48+4*j+2]=right[2];boundary[48+4*j+3]=right[3];
-	  }
-
-      for(ii=0;ii<BLOCK_SIZE;ii++)
-        for(jj=0;jj<MB_BLOCK_SIZE/BLOCK_SIZE;jj++)
-          img->mpr[ii+ioff][jj+joff]=tmp_block[ii][jj];
-    }
-  }
-
-  switch(pos)
-  {
-  case 0:
-	  k=0;
-	  for(j=0;j<8;j++)
-	  {
-		  for(i=0;i<16;i++)
-		  {
-			  pMB[k++] = img->mpr[i][j];
-		  }
-	  }
-	  pMB += 128;
-	  break;
-  case 1:
-	  k=0;
-	  for(j=8;j<16;j++)
-	  {
-		  for(i=0;i<8;i++)
-		  {
-			  pMB[k++] = img->mpr[i][j];
-		  }
-	  }
-	  pMB += 64;
-	  break;
-  case 2:
-	  k=0;
-	  for(j=8;j<16;j++)
-	  {
-		  for(i=8;i<16;i++)
-		  {
-			  pMB[k++] = img->mpr[i][j];
-		  }
-	  }
-	  pMB += 64;
-	  break;
-  }
-
-  if (dec_picture->chroma_format_idc != YUV400)
-  {
-    // chroma *******************************************************
-    f1_x = 64/img->mb_cr_size_x;
-    f2_x=f1_x-1;
-
-    f1_y = 64/img->mb_cr_size_y;
-    f2_y=f1_y-1;
-
-    f3=f1_x*f1_y;
-    f4=f3>>1;
-
-    for(uv=0;uv<2;uv++)
-    {
-      for (b8=0;b8<(img->num_blk8x8_uv/2);b8++)
-      {
-        for(b4=0;b4<4;b4++)
-		{
-          joff = subblk_offset_y[yuv][b8][b4];
-          j4=img->pix_c_y+joff;
-          ioff = subblk_offset_x[yuv][b8][b4];
-          i4=img->pix_c_x+ioff;
-
-          for(jj=0;jj<4;jj++)
-          {
-            jf=(j4+jj)/(img->mb_cr_size_y/4);     // jf  = Subblock_y-coordinate
-            for(ii=0;ii<4;ii++)
-            {
-              ifx=(i4+ii)/(img->mb_cr_size_x/4);  // ifx = Subblock_x-coordinate
-
-              i1=(i4+ii)*f1_x + mv[0];
-              j1=(j4+jj)*f1_y + mv[1];
-            
-              ii0=max (0, min (i1/f1_x,   dec_picture->size_x_cr-1));
-              jj0=max (0, min (j1/f1_y,   dec_picture->size_y_cr-1));
-              ii1=max (0, min ((i1+f2_x)/f1_x, dec_picture->size_x_cr-1));
-              jj1=max (0, min ((j1+f2_y)/f1_y, dec_picture->size_y_cr-1));
-            
-              if1=(i1 & f2_x);
-              jf1=(j1 & f2_y);
-              if0=f1_x-if1;
-              jf0=f1_y-jf1;
-            
-              img->mpr[ii+ioff][jj+joff]=(if0*jf0*listX[0][ref_frame]->imgUV[uv][jj0][ii0]+
-                                          if1*jf0*listX[0][ref_frame]->imgUV[uv][jj0][ii1]+
-                                          if0*jf1*listX[0][ref_frame]->imgUV[uv][jj1][ii0]+
-                                          if1*jf1*listX[0][ref_frame]->imgUV[uv][jj1][ii1]+f4)/f3;
-            }
-          }
-        }
-      }
-
-	  switch(pos)
-	  {
-	  case 0:
-		  k=0;
-		  for(j=0;j<4;j++)
-		  {
-			  for(i=0;i<8;i++)
-			  {
-				  pMB[k++] = img->mpr[i][j];
-			  }
-		  }
-		  pMB += 32;
-		  break;
-	  case 1:
-		  k=0;
-		  for(j=4;j<8;j++)
-		  {
-			  for(i=0;i<4;i++)
-			  {
-				  pMB[k++] = img->mpr[i][j];
-			  }
-		  }
-		  pMB += 16;
-		  break;
-	  case 2:
-		  k=0;
-		  for(j=4;j<8;j++)
-		  {
-			  for(i=4;i<8;i++)
-			  {
-				  pMB[k++] = img->mpr[i][j];
-			  }
-		  }
-		  pMB += 16;
-		  break;
-	  }
-    }
-  }
-}
-
-static int edgeDistortion_ECMODE5(int predBlocks[], int currYBlockNum, imgpel *predMB, imgpel *recY, int32 picSizeX, int32 regionSize, imgpel *boundary, int pos)
-{
-  int i, j, distortion, numOfPredBlocks, threshold = ERC_BLOCK_OK;
-  imgpel *currBlock = NULL, *neighbor = NULL;
-  int32 currBlockOffset = 0;
-  
-  currBlock = recY + (yPosYBlock(currYBlockNum,picSizeX)<<3)*picSizeX + (xPosYBlock(currYBlockNum,picSizeX)<<3);
-  
-  do 
-  {    
-    distortion = 0; numOfPredBlocks = 0;
-    
-    /* loop the 2/3 neighbours */
-    for (j = 4; j < 8; j++) 
-    {
-		if(pos==0 && j==6)
-			continue;
-		if(pos==1 && (j==4 || j==7))
-			continue;
-		if(pos==2 && (j==4 || j==5))
-			continue;
-
-	  /* if reliable, count boundary pixel difference */
-      if (predBlocks[j] >= threshold) 
-      {        
-        switch (j) 
-        {
-        case 4:
-		  neighbor = currBlock - picSizeX;
-		  if(OBMA)
-		  {
-			for ( i = 0; i < regionSize; i++ ) 
-				distortion += mabs((int)(boundary[i] - neighbor[i]));
-		  }
-		  else
-		  {
-			  for ( i = 0; i < regionSize; i++ ) 
-				distortion += mabs((int)(predMB[i] - neighbor[i]));
-		  }
-		  break;          
-        case 5:
-          neighbor = currBlock - 1;
-		  if(OBMA)
-		  {
-			for ( i = 0+8*pos; i < 8+8*pos; i++ ) 
-				distortion += mabs((int)(boundary[16+i] - neighbor[i*picSizeX]));
-		  }
-		  else
-		  {
-			  if(pos==0)
-			  {
-				  for ( i = 0; i < 8; i++ ) 
-					distortion += mabs((int)(predMB[i*16] - neighbor[i*picSizeX]));
-			  }
-			  else if(pos==1)
-			  {
-				  for ( i = 8; i < 16; i++ ) 
-					distortion += mabs((int)(predMB[(i-8)*8] - neighbor[i*picSizeX]));
-			  }
-		  }
-          break;                
-        case 6:
-          neighbor = currBlock + regionSize*picSizeX;
-          currBlockOffset = 7*8;
-		  if(OBMA)
-		  {
-			  if(pos==1)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(boundary[32+i] - neighbor[i]));
-			  }
-			  else if(pos==2)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(boundary[32+i] - neighbor[i]));
-			  }
-		  }
-		  else
-		  {
-			  if(pos==1)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(predMB[i+currBlockOffset] - neighbor[i]));
-			  }
-			  else if(pos==2)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(predMB[i-8+currBlockOffset] - neighbor[i]));
-			  }
-		  }
-          break;                
-        case 7:
-          neighbor = currBlock + regionSize;
-          currBlockOffset = 7;
-		  if(OBMA)
-		  {
-			  if(pos==0)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(boundary[48+i] - neighbor[i*picSizeX]));
-			  }
-			  else if(pos==2)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(boundary[48+i] - neighbor[i*picSizeX]));
-			  }
-		  }
-		  else
-		  {
-			  if(pos==0)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(predMB[i*8+currBlockOffset] - neighbor[i*picSizeX]));
-			  }
-			  else if(pos==2)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(predMB[(i-8)*8+currBlockOffset] - neighbor[i*picSizeX]));
-			  }
-		  }
-          break;
-        }
-        
-        numOfPredBlocks++;
-      }
-    }
-    
-    threshold--;
-    if (threshold < ERC_BLOCK_CONCEALED)
-      break;
-  } while (numOfPredBlocks == 0);
-  
-  if(numOfPredBlocks == 0)
-    return 0;
-
-  return (distortion/numOfPredBlocks);
-}
-
-/**********************************************************************************************************************/
-//EC Mode 6
-static int concealABS_ECMODE6(frame *recfr, imgpel *predMB,int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
-                      int32 picSizeX, int32 picSizeY, int *yCondition)
-{
-	imgpel *pred_bottom_ecmodeMB, *pred_ecmodeMB, *bottom_pred_ecmodeMB, *topleft_pred_ecmodeMB, *topright_pred_ecmodeMB;
-
-	int predMBNum = 0, numMBPerLine,
-      compSplit1 = 0, compSplit2 = 0, compLeft = 1, comp = 0, compPred, order = 1,
-      fInterNeighborExists, numIntraNeighbours,
-      fZeroMotionChecked, predSplitted = 0,
-      threshold = ERC_BLOCK_OK,
-      minDist, currDist, i, k, j, p, q, bestDir;
-	int32 regionSize;
-	objectBuffer_t *currRegion;
-	int32 mvBest[3] , mvPred[3], *mvptr;
-
- 	imgpel *predMB_OBMC;
-	
-	if(OBMC)
-		predMB_OBMC = (imgpel *) malloc ( (256 + (img->mb_cr_size_x*img->mb_cr_size_y)*2) * sizeof (imgpel));
-
-	//16x8 for luma and 8x4, 8x4 for chroma
-	pred_bottom_ecmodeMB = (imgpel *) malloc( ( 128 + (img->mb_cr_size_x*img->mb_cr_size_y/2)*2) * sizeof (imgpel));
-	bottom_pred_ecmodeMB = (imgpel *) malloc( ( 128 + (img->mb_cr_size_x*img->mb_cr_size_y/2)*2) * sizeof (imgpel));
-
-	//8x8 for luma and 4x4, 4x4 for chroma
-	pred_ecmodeMB = (imgpel *) malloc ( (64 + (img->mb_cr_size_x*img->mb_cr_size_y/4)*2) * sizeof (imgpel));
-	topleft_pred_ecmodeMB = (imgpel *) malloc ( (64 + (img->mb_cr_size_x*img->mb_cr_size_y/4)*2) * sizeof (imgpel));
-	topright_pred_ecmodeMB = (imgpel *) malloc ( (64 + (img->mb_cr_size_x*img->mb_cr_size_y/4)*2) * sizeof (imgpel));
-
-	numMBPerLine = (int) (picSizeX>>4);
-  	comp = 0;
-	regionSize = 16;
-
-	//TOP LEFT
-	threshold = ERC_BLOCK_OK;
-	comp=0;
-	currRegion = object_list+(currMBNum<<2)+comp;
-	
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-
-	do
-	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;	
-
-		/* loop the 2 neighbours */
-		for (i = 4; i < 6; i++) //only above and left nbrs
-		{
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
-			{
-				switch (i) 
-				{
-				case 4:
-					predMBNum = currMBNum-numMBPerLine;
-					compSplit1 = 2;
-					compSplit2 = 2;
-					break;
-				case 5:
-					predMBNum = currMBNum-1;
-					compSplit1 = 1;
-					compSplit2 = 1;
-					break;  
-				}
-
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE6(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,0);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE6(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,0);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE6(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 0);
-						
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode =
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<64+16+16;p++)
-							{
-								topleft_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-							}
-							
-							p=0;
-						}
-              
-						fInterNeighborExists = 1;    
-					}
-				}
-			}
-		}
-
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE6(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,0);
-
-	  currDist = edgeDistortion_ECMODE6(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 0);
-      
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-
-		for(p=0;p<64+16+16;p++)
-		{
-			topleft_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-		}
-	  }
-    }
-
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
-
-
-	//TOP RIGHT
-	threshold = ERC_BLOCK_OK;
-	comp=1;
-	currRegion = object_list+(currMBNum<<2)+comp;
-	
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-
-	do
-	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;	
-
-		/* loop the 2 neighbours */
-		for (i = 4; i < 8; i++) //only above and right nbrs
-		{
-			if(i==5 || i==6)
-				continue;
-
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
-			{
-				switch (i) 
-				{
-				 case 4:
-					predMBNum = currMBNum-numMBPerLine;
-					compSplit1 = 3;
-					compSplit2 = 3;
-					break;          
-				case 7:
-					predMBNum = currMBNum+1;
-					compSplit1 = 0;
-					compSplit2 = 0;
-					break;              
-				}
-
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE6(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE6(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE6(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 1);
-						
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode =
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<64+16+16;p++)
-							{
-								topright_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-							}
-							
-							p=0;
-						}
-              
-						fInterNeighborExists = 1;    
-					}
-				}
-			}
-		}
-
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE6(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
-
-	  currDist = edgeDistortion_ECMODE6(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 1);
-      
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-
-		for(p=0;p<64+16+16;p++)
-		{
-			topright_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-		}
-	  }
-    }
-
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
-
-
-	//LOWER HALF
-	threshold = ERC_BLOCK_OK;
-	comp=2;
-	currRegion = object_list+(currMBNum<<2)+comp;
-	
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-
-	do
-	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;	
-
-		/* loop the 3 neighbours */
-		for (i = 5; i < 8; i++) //no above nbr for lower half
-		{
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
-			{
-				switch (i) 
-				{
-				case 5:
-					predMBNum = currMBNum-1;
-					compSplit1 = 3;
-					compSplit2 = 3;
-					break; 
-				case 6:
-					predMBNum = currMBNum+numMBPerLine;
-					compSplit1 = 0;
-					compSplit2 = 1;
-					break;
-				case 7:
-					predMBNum = currMBNum+1;
-					compSplit1 = 2;
-					compSplit2 = 2;
-					break;
-				}
-
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE6(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_bottom_ecmodeMB, boundary,2);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE6(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_bottom_ecmodeMB, boundary,2);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE6(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_bottom_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 2);
-						
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode =
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<128+32+32;p++)
-							{
-								bottom_pred_ecmodeMB[p] = pred_bottom_ecmodeMB[p];
-							}
-							
-							p=0;
-						}
-              
-						fInterNeighborExists = 1;    
-					}
-				}
-			}
-		}
-
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE6(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_bottom_ecmodeMB, boundary,2);
-
-	  currDist = edgeDistortion_ECMODE6(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_bottom_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 2);
-      
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-
-		for(p=0;p<128+32+32;p++)
-		{
-			bottom_pred_ecmodeMB[p] = pred_bottom_ecmodeMB[p];
-		}
-	  }
-    }
-
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
-    
-
-	//Whole MB concealed at this stage, copy to predMB
-
-	p=0; q=0;
-	for(j=0;j<8;j++)
-	{
-		for(i=0;i<8;i++)
-		{
-			predMB[j*16+i] = topleft_pred_ecmodeMB[q];
-			predMB[j*16+i+8] = topright_pred_ecmodeMB[q];
-			q++;
-		}
-		for(i=0;i<16;i++)
-		{
-			predMB[(j+8)*16+i] = bottom_pred_ecmodeMB[p];
-			p++;
-		}		
-	}
-
-	p=0;q=0;
-	for(j=0;j<4;j++)
-	{
-		for(i=0;i<4;i++)
-		{
-			predMB[256+j*8+i] = topleft_pred_ecmodeMB[64+q];
-			predMB[256+j*8+i+4] = topright_pred_ecmodeMB[64+q];
-			predMB[256+64+j*8+i] = topleft_pred_ecmodeMB[80+q];
-			predMB[256+64+j*8+i+4] = topright_pred_ecmodeMB[80+q];
-			q++;
-		}
-		for(i=0;i<8;i++)
-		{
-			predMB[256+(j+4)*8+i] = bottom_pred_ecmodeMB[128+p];
-			predMB[256+64+(j+4)*8+i] = bottom_pred_ecmodeMB[128+32+p];
-			p++;
-		}		
-	}
-	
-	if(OBMC)
-	{
-		OBMC_MB(predMB,predMB_OBMC,predBlocks,object_list,currMBNum,numMBPerLine,picSizeX);
-		copyPredMB(MBNum2YBlock(currMBNum,0,picSizeX), predMB_OBMC, recfr, picSizeX, regionSize);
-	}
-	else
-		copyPredMB(MBNum2YBlock(currMBNum,0,picSizeX), predMB, recfr,picSizeX, regionSize);
-
-	yCondition[MBNum2YBlock(currMBNum,0,picSizeX)] = ERC_BLOCK_CONCEALED;
-
-	free(pred_ecmodeMB);
-	free(pred_bottom_ecmodeMB);
-	free(bottom_pred_ecmodeMB);
-	free(topleft_pred_ecmodeMB);
-	free(topright_pred_ecmodeMB);
-
-	if(OBMC)
-		free(predMB_OBMC);
-
-	return 0;
-}
-
-static void buildOuterPredRegionYUV_ECMODE6(struct img_par *img, int32 *mv, int x, int y, imgpel *predMB, imgpel *boundary, int pos)
-{
-  int tmp_block[BLOCK_SIZE][BLOCK_SIZE];
-  int i=0,j=0,ii=0,jj=0,i1=0,j1=0,j4=0,i4=0,k=0;
-  int jf=0;
-  int uv;
-  int vec1_x=0,vec1_y=0;
-  int ioff,joff;
-  imgpel *pMB = predMB; //Note: predMB is actually pred_ecmodeMB; for ecmode2, it is left/right half, so 8x16 for Y and 4x8,4x8 for UV
-  
-  int ii0,jj0,ii1,jj1,if1,jf1,if0,jf0;
-  int mv_mul;
-
-  int above[4], left[4], below[4], right[4], index;
-  
-  //FRExt
-  int f1_x, f1_y, f2_x, f2_y, f3, f4, ifx;
-  int b8, b4;
-  int yuv = dec_picture->chroma_format_idc - 1;
-  
-  int ref_frame = max (mv[2], 0); // !!KS: quick fix, we sometimes seem to get negative ref_pic here, so restrict to zero an above
-
-  /* Update coordinates of the current concealed macroblock */
-  img->mb_x = x/MB_BLOCK_SIZE;
-  img->mb_y = y/MB_BLOCK_SIZE;
-  img->block_y = img->mb_y * BLOCK_SIZE;
-  img->pix_c_y = img->mb_y * img->mb_cr_size_y;
-  img->block_x = img->mb_x * BLOCK_SIZE;
-  img->pix_c_x = img->mb_x * img->mb_cr_size_x;
-
-  mv_mul=4;
-
-  // luma *******************************************************
-
-  for(i=0;i<4;i++)
-  {
-	  above[i]=0;left[i]=0;below[i]=0;right[i]=0;
-  }
-
-  for(j=0;j<MB_BLOCK_SIZE/BLOCK_SIZE;j++)
-  {
-    joff=j*4;
-    j4=img->block_y+j;
-    for(i=0;i<MB_BLOCK_SIZE/BLOCK_SIZE;i++)
-    {
-      ioff=i*4;
-      i4=img->block_x+i;
-
-      vec1_x = i4*4*mv_mul + mv[0];
-      vec1_y = j4*4*mv_mul + mv[1];
-
-      get_block(ref_frame, listX[0], vec1_x,vec1_y,img,tmp_block);
-
-	  index = i+4*j;
-	  get_boundary(ref_frame, listX[0], vec1_x, vec1_y, img, index, above, left, below, right);
-	  
-	  if(j==0)
-	  {
-		  boundary[4*i+0]=above[0];boundary[4*i+1]=above[1];boundary[4*i+2]=above[2];boundary[4*i+3]=above[3];
-	  }
-
-	  if(i==0)
-	  {
-		  boundary[16+4*j+0]=left[0];boundary[16+4*j+1]=left[1];boundary[16+4*j+2]=left[2];boundary[16+4*j+3]=left[3];
-	  }
-
-	  if(j==3) //MB_BLOCK_SIZE/BLOCK_SIZE - 1 = 3
-	  {
-		  boundary[32+4*i+0]=below[0];boundary[32+4*i+1]=below[1];boundary[32+4*i+2]=below[2];boundary[32+4*i+3]=below[3];
-	  }
-
-	  if(i==3)
-	  {
-		  boundary[48+4*j+0]=right[0];boundary[48+4*j+1]=right[1];boundary[48+4*j+2]=right[2];boundary[48+4*j+3]=right[3];
-	  }
-
-      for(ii=0;ii<BLOCK_SIZE;ii++)
-        for(jj=0;jj<MB_BLOCK_SIZE/BLOCK_SIZE;jj++)
-          img->mpr[ii+ioff][jj+joff]=tmp_block[ii][jj];
-    }
-  }
-
-  switch(pos)
-  {
-  case 0:
-	  k=0;
-	  for(j=0;j<8;j++)
-	  {
-		  for(i=0;i<8;i++)
-		  {
-			  pMB[k++] = img->mpr[i][j];
-		  }
-	  }
-	  pMB += 64;
-	  break;
-  case 1:
-	  k=0;
-	  for(j=0;j<8;j++)
-	  {
-		  for(i=8;i<16;i++)
-		  {
-			  pMB[k++] = img->mpr[i][j];
-		  }
-	  }
-	  pMB += 64;
-	  break;
-  case 2:
-	  k=0;
-	  for(j=8;j<16;j++)
-	  {
-		  for(i=0;i<16;i++)
-		  {
-			  pMB[k++] = img->mpr[i][j];
-		  }
-	  }
-	  pMB += 128;
-	  break;
-  }
-
-  if (dec_picture->chroma_format_idc != YUV400)
-  {
-    // chroma *******************************************************
-    f1_x = 64/img->mb_cr_size_x;
-    f2_x=f1_x-1;
-
-    f1_y = 64/img->mb_cr_size_y;
-    f2_y=f1_y-1;
-
-    f3=f1_x*f1_y;
-    f4=f3>>1;
-
-    for(uv=0;uv<2;uv++)
-    {
-      for (b8=0;b8<(img->num_blk8x8_uv/2);b8++)
-      {
-        for(b4=0;b4<4;b4++)
-		{
-          joff = subblk_offset_y[yuv][b8][b4];
-          j4=img->pix_c_y+joff;
-          ioff = subblk_offset_x[yuv][b8][b4];
-          i4=img->pix_c_x+ioff;
-
-          for(jj=0;jj<4;jj++)
-          {
-            jf=(j4+jj)/(img->mb_cr_size_y/4);     // jf  = Subblock_y-coordinate
-            for(ii=0;ii<4;ii++)
-            {
-              ifx=(i4+ii)/(img->mb_cr_size_x/4);  // ifx = Subblock_x-coordinate
-
-              i1=(i4+ii)*f1_x + mv[0];
-              j1=(j4+jj)*f1_y + mv[1];
-            
-              ii0=max (0, min (i1/f1_x,   dec_picture->size_x_cr-1));
-              jj0=max (0, min (j1/f1_y,   dec_picture->size_y_cr-1));
-              ii1=max (0, min ((i1+f2_x)/f1_x, dec_picture->size_x_cr-1));
-              jj1=max (0, min ((j1+f2_y)/f1_y, dec_picture->size_y_cr-1));
-            
-              if1=(i1 & f2_x);
-              jf1=(j1 & f2_y);
-              if0=f1_x-if1;
-              jf0=f1_y-jf1;
-            
-              img->mpr[ii+ioff][jj+joff]=(if0*jf0*listX[0][ref_frame]->imgUV[uv][jj0][ii0]+
-                                          if1*jf0*listX[0][ref_frame]->imgUV[uv][jj0][ii1]+
-                                          if0*jf1*listX[0][ref_frame]->imgUV[uv][jj1][ii0]+
-                                          if1*jf1*listX[0][ref_frame]->imgUV[uv][jj1][ii1]+f4)/f3;
-            }
-          }
-        }
-      }
-
-	  switch(pos)
-	  {
-	  case 0:
-		  k=0;
-		  for(j=0;j<4;j++)
-		  {
-			  for(i=0;i<4;i++)
-			  {
-				  pMB[k++] = img->mpr[i][j];
-			  }
-		  }
-		  pMB += 16;
-		  break;
-	  case 1:
-		  k=0;
-		  for(j=0;j<4;j++)
-		  {
-			  for(i=4;i<8;i++)
-			  {
-				  pMB[k++] = img->mpr[i][j];
-			  }
-		  }
-		  pMB += 16;
-		  break;
-	  case 2:
-		  k=0;
-		  for(j=4;j<8;j++)
-		  {
-			  for(i=0;i<8;i++)
-			  {
-				  pMB[k++] = img->mpr[i][j];
-			  }
-		  }
-		  pMB += 32;
-		  break;
-	  }
-    }
-  }
-}
-
-static int edgeDistortion_ECMODE6(int predBlocks[], int currYBlockNum, imgpel *predMB, imgpel *recY, int32 picSizeX, int32 regionSize, imgpel *boundary, int pos)
-{
-  int i, j, distortion, numOfPredBlocks, threshold = ERC_BLOCK_OK;
-  imgpel *currBlock = NULL, *neighbor = NULL;
-  int32 currBlockOffset = 0;
-  
-  currBlock = recY + (yPosYBlock(currYBlockNum,picSizeX)<<3)*picSizeX + (xPosYBlock(currYBlockNum,picSizeX)<<3);
-  
-  do 
-  {    
-    distortion = 0; numOfPredBlocks = 0;
-    
-    /* loop the 2/3 neighbours */
-    for (j = 4; j < 8; j++) 
-    {
-		if(pos==0 && (j==6 || j==7))
-			continue;
-		if(pos==1 && (j==5 || j==6))
-			continue;
-		if(pos==2 && j==4)
-			continue;
-
-	  /* if reliable, count boundary pixel difference */
-      if (predBlocks[j] >= threshold) 
-      {        
-        switch (j) 
-        {
-        case 4:
-		  neighbor = currBlock - picSizeX;
-		  if(OBMA)
-		  {
-			  for ( i = 0+8*pos; i < 8+8*pos; i++ ) 
-				distortion += mabs((int)(boundary[i] - neighbor[i]));
-		  }
-		  else
-		  {
-			  for ( i = 0+8*pos; i < 8+8*pos; i++ ) 
-				distortion += mabs((int)(predMB[i-8*pos] - neighbor[i]));
-		  }
-		  break;          
-        case 5:
-          neighbor = currBlock - 1;
-		  if(OBMA)
-		  {
-			  if(pos==0)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(boundary[16+i] - neighbor[i*picSizeX]));
-			  }
-			  else if(pos==2)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(boundary[16+i] - neighbor[i*picSizeX]));
-			  }
-		  }
-		  else
-		  {
-			  if(pos==0)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(predMB[i*8] - neighbor[i*picSizeX]));
-			  }
-			  else if(pos==2)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(predMB[(i-8)*16] - neighbor[i*picSizeX]));
-			  }
-		  }
-          break;                
-        case 6:
-          neighbor = currBlock + regionSize*picSizeX;
-          currBlockOffset = 7*16;
-		  if(OBMA)
-		  {
-			  for(i=0;i<regionSize;i++)
-				  distortion += mabs((int)(boundary[32+i] - neighbor[i]));
-		  }
-		  else
-		  {
-			  for(i=0;i<regionSize;i++)
-				  distortion += mabs((int)(predMB[i+currBlockOffset] - neighbor[i]));
-		  }
-		  break;                
-        case 7:
-          neighbor = currBlock + regionSize;
-          currBlockOffset = regionSize-1;
-		  if(OBMA)
-		  {
-			  if(pos==1)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(boundary[48+i] - neighbor[i*picSizeX]));
-			  }
-			  else if(pos==2)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(boundary[48+i] - neighbor[i*picSizeX]));
-			  }
-		  }
-		  else
-		  {
-			  if(pos==1)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(predMB[i*8+7] - neighbor[i*picSizeX]));
-			  }
-			  else if(pos==2)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(predMB[(i-8)*16+currBlockOffset] - neighbor[i*picSizeX]));
-			  }
-		  }
-          break;
-        }
-        
-        numOfPredBlocks++;
-      }
-    }
-    
-    threshold--;
-    if (threshold < ERC_BLOCK_CONCEALED)
-      break;
-  } while (numOfPredBlocks == 0);
-  
-  if(numOfPredBlocks == 0)
-    return 0;
-
-  return (distortion/numOfPredBlocks);
-}
-
-/**********************************************************************************************************************/
-//EC Mode 7
-static int concealABS_ECMODE7(frame *recfr, imgpel *predMB,int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
-                      int32 picSizeX, int32 picSizeY, int *yCondition)
-{
-	imgpel *pred_right_ecmodeMB, *pred_ecmodeMB, *right_pred_ecmodeMB, *topleft_pred_ecmodeMB, *bottomleft_pred_ecmodeMB;
-
-	int predMBNum = 0, numMBPerLine,
-      compSplit1 = 0, compSplit2 = 0, compLeft = 1, comp = 0, compPred, order = 1,
-      fInterNeighborExists, numIntraNeighbours,
-      fZeroMotionChecked, predSplitted = 0,
-      threshold = ERC_BLOCK_OK,
-      minDist, currDist, i, k, j, p, q, bestDir;
-	int32 regionSize;
-	objectBuffer_t *currRegion;
-	int32 mvBest[3] , mvPred[3], *mvptr;
-	imgpel *predMB_OBMC;
-	
-	if(OBMC)
-		predMB_OBMC = (imgpel *) malloc ( (256 + (img->mb_cr_size_x*img->mb_cr_size_y)*2) * sizeof (imgpel));
-
-	//8x8 for luma and 4x4, 4x4 for chroma
-	pred_ecmodeMB = (imgpel *) malloc ( (64 + (img->mb_cr_size_x*img->mb_cr_size_y/4)*2) * sizeof (imgpel));
-	topleft_pred_ecmodeMB = (imgpel *) malloc ( (64 + (img->mb_cr_size_x*img->mb_cr_size_y/4)*2) * sizeof (imgpel));
-	bottomleft_pred_ecmodeMB = (imgpel *) malloc ( (64 + (img->mb_cr_size_x*img->mb_cr_size_y/4)*2) * sizeof (imgpel));
-
-	//8x16 for luma and 4x8, 4x8 for chroma
-	pred_right_ecmodeMB = (imgpel *) malloc( ( 128 + (img->mb_cr_size_x*img->mb_cr_size_y/2)*2) * sizeof (imgpel));
-	right_pred_ecmodeMB = (imgpel *) malloc( ( 128 + (img->mb_cr_size_x*img->mb_cr_size_y/2)*2) * sizeof (imgpel));
-	
-	numMBPerLine = (int) (picSizeX>>4);
-  	comp = 0;
-	regionSize = 16;
-
-	//TOP LEFT
-	threshold = ERC_BLOCK_OK;
-	comp=0;
-	currRegion = object_list+(currMBNum<<2)+comp;
-	
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-
-	do
-	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;	
-
-		/* loop the 2 neighbours */
-		for (i = 4; i < 6; i++) //only above and left nbrs
-		{
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
-			{
-				switch (i) 
-				{
-				case 4:
-					predMBNum = currMBNum-numMBPerLine;
-					compSplit1 = 2;
-					compSplit2 = 2;
-					break;
-				case 5:
-					predMBNum = currMBNum-1;
-					compSplit1 = 1;
-					compSplit2 = 1;
-					break;  
-				}
-
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE7(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,0);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE7(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,0);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE7(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 0);
-						
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode =
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<64+16+16;p++)
-							{
-								topleft_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-							}
-							
-							p=0;
-						}
-              
-						fInterNeighborExists = 1;    
-					}
-				}
-			}
-		}
-
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE7(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,0);
-
-	  currDist = edgeDistortion_ECMODE7(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 0);
-      
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-
-		for(p=0;p<64+16+16;p++)
-		{
-			topleft_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-		}
-	  }
-    }
-
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
-
-
-	//BOTTOM LEFT
-	threshold = ERC_BLOCK_OK;
-	comp=2;
-	currRegion = object_list+(currMBNum<<2)+comp;
-	
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-
-	do
-	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;	
-
-		/* loop the 2 neighbours */
-		for (i = 5; i < 7; i++) //only left and below nbrs
-		{
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
-			{
-				switch (i) 
-				{
-				case 5:
-						predMBNum = currMBNum-1;
-						compSplit1 = 3;
-						compSplit2 = 3;
-						break;
-				case 6:
-						predMBNum = currMBNum+numMBPerLine;
-						compSplit1 = 0;
-						compSplit2 = 0;
-						break;
-				}
-
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE7(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE7(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE7(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 1);
-						
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode =
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<64+16+16;p++)
-							{
-								bottomleft_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-							}
-							
-							p=0;
-						}
-              
-						fInterNeighborExists = 1;    
-					}
-				}
-			}
-		}
-
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE7(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
-
-	  currDist = edgeDistortion_ECMODE7(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 1);
-      
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-
-		for(p=0;p<64+16+16;p++)
-		{
-			bottomleft_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-		}
-	  }
-    }
-
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
-
-
-	//RIGHT HALF
-	threshold = ERC_BLOCK_OK;
-	comp=1;
-	currRegion = object_list+(currMBNum<<2)+comp;
-	
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-
-	do
-	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;	
-
-		/* loop the 3 neighbours */
-		for (i = 4; i < 8; i++) //no left nbr for right half
-		{
-			if(i==5)
-				continue;
-
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
-			{
-				switch (i) 
-				{
-				case 4:
-					predMBNum = currMBNum-numMBPerLine;
-					compSplit1 = 3;
-					compSplit2 = 3;
-					break;
-				case 6:
-					predMBNum = currMBNum+numMBPerLine;
-					compSplit1 = 1;
-					compSplit2 = 1;
-					break;
-				case 7:
-					predMBNum = currMBNum+1;
-					compSplit1 = 0;
-					compSplit2 = 2;
-					break;
-				}
-
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE7(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_right_ecmodeMB, boundary,2);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE7(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_right_ecmodeMB, boundary,2);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE7(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_right_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 2);
-						
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode =
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<128+32+32;p++)
-							{
-								right_pred_ecmodeMB[p] = pred_right_ecmodeMB[p];
-							}
-							
-							p=0;
-						}
-              
-						fInterNeighborExists = 1;    
-					}
-				}
-			}
-		}
-
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE7(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_right_ecmodeMB, boundary,2);
-
-	  currDist = edgeDistortion_ECMODE7(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_right_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 2);
-      
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-
-		for(p=0;p<128+32+32;p++)
-		{
-			right_pred_ecmodeMB[p] = pred_right_ecmodeMB[p];
-		}
-	  }
-    }
-
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
-    
-
-	//Whole MB concealed at this stage, copy to predMB
-
-	p=0;q=0;
-	for(j=0;j<8;j++)
-	{
-		for(i=0;i<8;i++)
-		{
-			predMB[j*16+i] = topleft_pred_ecmodeMB[p];
-			predMB[(j+8)*16+i] = bottomleft_pred_ecmodeMB[p];
-			p++;
-		}
-	}
-	for(j=0;j<16;j++)
-	{
-		for(i=8;i<16;i++)
-		{
-			predMB[j*16+i] = right_pred_ecmodeMB[q];
-			q++;
-		}
-	}
-
-	p=0;q=0;
-	for(j=0;j<4;j++)
-	{
-		for(i=0;i<4;i++)
-		{
-			predMB[256+j*8+i] = topleft_pred_ecmodeMB[64+p];
-			predMB[256+(j+4)*8+i] = bottomleft_pred_ecmodeMB[64+p];
-			predMB[256+64+j*8+i] = topleft_pred_ecmodeMB[80+p];
-			predMB[256+64+(j+4)*8+i] = bottomleft_pred_ecmodeMB[80+p];
-			p++;
-		}
-	}
-	for(j=0;j<8;j++)
-	{
-		for(i=4;i<8;i++)
-		{
-			predMB[256+j*8+i] = right_pred_ecmodeMB[128+q];
-			predMB[256+64+j*8+i] = right_pred_ecmodeMB[128+32+q];
-			q++;
-		}
-	}
-
-	if(OBMC)
-	{
-		OBMC_MB(predMB,predMB_OBMC,predBlocks,object_list,currMBNum,numMBPerLine,picSizeX);
-		copyPredMB(MBNum2YBlock(currMBNum,0,picSizeX), predMB_OBMC, recfr, picSizeX, regionSize);
-	}
-	else
-		copyPredMB(MBNum2YBlock(currMBNum,0,picSizeX), predMB, recfr,picSizeX, regionSize);
-	
-	yCondition[MBNum2YBlock(currMBNum,0,picSizeX)] = ERC_BLOCK_CONCEALED;
-
-	free(pred_ecmodeMB);
-	free(pred_right_ecmodeMB);
-	free(right_pred_ecmodeMB);
-	free(topleft_pred_ecmodeMB);
-	free(bottomleft_pred_ecmodeMB);
-	if(OBMC)
-		free(predMB_OBMC);
-
-	return 0;
-}
-
-static void buildOuterPredRegionYUV_ECMODE7(struct img_par *img, int32 *mv, int x, int y, imgpel *predMB, imgpel *boundary, int pos)
-{
-  int tmp_block[BLOCK_SIZE][BLOCK_SIZE];
-  int i=0,j=0,ii=0,jj=0,i1=0,j1=0,j4=0,i4=0,k=0;
-  int jf=0;
-  int uv;
-  int vec1_x=0,vec1_y=0;
-  int ioff,joff;
-  imgpel *pMB = predMB; //Note: predMB is actually pred_ecmodeMB; for ecmode2, it is left/right half, so 8x16 for Y and 4x8,4x8 for UV
-  
-  int ii0,jj0,ii1,jj1,if1,jf1,if0,jf0;
-  int mv_mul;
-
-  int above[4], left[4], below[4], right[4], index;
-  
-  //FRExt
-  int f1_x, f1_y, f2_x, f2_y, f3, f4, ifx;
-  int b8, b4;
-  int yuv = dec_picture->chroma_format_idc - 1;
-  
-  int ref_frame = max (mv[2], 0); // !!KS: quick fix, we sometimes seem to get negative ref_pic here, so restrict to zero an above
-
-  /* Update coordinates of the current concealed macroblock */
-  img->mb_x = x/MB_BLOCK_SIZE;
-  img->mb_y = y/MB_BLOCK_SIZE;
-  img->block_y = img->mb_y * BLOCK_SIZE;
-  img->pix_c_y = img->mb_y * img->mb_cr_size_y;
-  img->block_x = img->mb_x * BLOCK_SIZE;
-  img->pix_c_x = img->mb_x * img->mb_cr_size_x;
-
-  mv_mul=4;
-
-  // luma *******************************************************
-
-  for(i=0;i<4;i++)
-  {
-	  above[i]=0;left[i]=0;below[i]=0;right[i]=0;
-  }
-
-  for(j=0;j<MB_BLOCK_SIZE/BLOCK_SIZE;j++)
-  {
-    joff=j*4;
-    j4=img->block_y+j;
-    for(i=0;i<MB_BLOCK_SIZE/BLOCK_SIZE;i++)
-    {
-      ioff=i*4;
-      i4=img->block_x+i;
-
-      vec1_x = i4*4*mv_mul + mv[0];
-      vec1_y = j4*4*mv_mul + mv[1];
-
-      get_block(ref_frame, listX[0], vec1_x,vec1_y,img,tmp_block);
-
-	  index = i+4*j;
-	  get_boundary(ref_frame, listX[0], vec1_x, vec1_y, img, index, above, left, below, right);
-	  
-	  if(j==0)
-	  {
-		  boundary[4*i+0]=above[0];boundary[4*i+1]=above[1];boundary[4*i+2]=above[2];boundary[4*i+3]=above[3];
-	  }
-
-	  if(i==0)
-	  {
-		  boundary[16+4*j+0]=left[0];boundary[16+4*j+1]=left[1];boundary[16+4*j+2]=left[2];boundary[16+4*j+3]=left[3];
-	  }
-
-	  if(j==3) //MB_BLOCK_SIZE/BLOCK_SIZE - 1 = 3
-	  {
-		  boundary[32+4*i+0]=below[0];boundary[32+4*i+1]=below[1];boundary[32+4*i+2]=below[2];boundary[32+4*i+3]=below[3];
-	  }
-
-	  if(i==3)
-	  {
-		  boundary[48+4*j+0]=right[0];boundary[48+4*j+1]=right[1];boundary[48+4*j+2]=right[2];boundary[48+4*j+3]=right[3];
-	  }
-
-      for(ii=0;ii<BLOCK_SIZE;ii++)
-        for(jj=0;jj<MB_BLOCK_SIZE/BLOCK_SIZE;jj++)
-          img->mpr[ii+ioff][jj+joff]=tmp_block[ii][jj];
-    }
-  }
-
-  switch(pos)
-  {
-  case 0:
-	  k=0;
-	  for(j=0;j<8;j++)
-	  {
-		  for(i=0;i<8;i++)
-		  {
-			  pMB[k++] = img->mpr[i][j];
-		  }
-	  }
-	  pMB += 64;
-	  break;
-  case 1:
-	  k=0;
-	  for(j=8;j<16;j++)
-	  {
-		  for(i=0;i<8;i++)
-		  {
-			  pMB[k++] = img->mpr[i][j];
-		  }
-	  }
-	  pMB += 64;
-	  break;
-  case 2:
-	  k=0;
-	  for(j=0;j<16;j++)
-	  {
-		  for(i=8;i<16;i++)
-		  {
-			  pMB[k++] = img->mpr[i][j];
-		  }
-	  }
-	  pMB += 128;
-	  break;
-  }
-
-  if (dec_picture->chroma_format_idc != YUV400)
-  {
-    // chroma *******************************************************
-    f1_x = 64/img->mb_cr_size_x;
-    f2_x=f1_x-1;
-
-    f1_y = 64/img->mb_cr_size_y;
-    f2_y=f1_y-1;
-
-    f3=f1_x*f1_y;
-    f4=f3>>1;
-
-    for(uv=0;uv<2;uv++)
-    {
-      for (b8=0;b8<(img->num_blk8x8_uv/2);b8++)
-      {
-        for(b4=0;b4<4;b4++)
-		{
-          joff = subblk_offset_y[yuv][b8][b4];
-          j4=img->pix_c_y+joff;
-          ioff = subblk_offset_x[yuv][b8][b4];
-          i4=img->pix_c_x+ioff;
-
-          for(jj=0;jj<4;jj++)
-          {
-            jf=(j4+jj)/(img->mb_cr_size_y/4);     // jf  = Subblock_y-coordinate
-            for(ii=0;ii<4;ii++)
-            {
-              ifx=(i4+ii)/(img->mb_cr_size_x/4);  // ifx = Subblock_x-coordinate
-
-              i1=(i4+ii)*f1_x + mv[0];
-              j1=(j4+jj)*f1_y + mv[1];
-            
-              ii0=max (0, min (i1/f1_x,   dec_picture->size_x_cr-1));
-              jj0=max (0, min (j1/f1_y,   dec_picture->size_y_cr-1));
-              ii1=max (0, min ((i1+f2_x)/f1_x, dec_picture->size_x_cr-1));
-              jj1=max (0, min ((j1+f2_y)/f1_y, dec_picture->size_y_cr-1));
-            
-              if1=(i1 & f2_x);
-              jf1=(j1 & f2_y);
-              if0=f1_x-if1;
-              jf0=f1_y-jf1;
-            
-              img->mpr[ii+ioff][jj+joff]=(if0*jf0*listX[0][ref_frame]->imgUV[uv][jj0][ii0]+
-                                          if1*jf0*listX[0][ref_frame]->imgUV[uv][jj0][ii1]+
-                                          if0*jf1*listX[0][ref_frame]->imgUV[uv][jj1][ii0]+
-                                          if1*jf1*listX[0][ref_frame]->imgUV[uv][jj1][ii1]+f4)/f3;
-            }
-          }
-        }
-      }
-
-	  switch(pos)
-	  {
-	  case 0:
-		  k=0;
-		  for(j=0;j<4;j++)
-		  {
-			  for(i=0;i<4;i++)
-			  {
-				  pMB[k++] = img->mpr[i][j];
-			  }
-		  }
-		  pMB += 16;
-		  break;
-	  case 1:
-		  k=0;
-		  for(j=4;j<8;j++)
-		  {
-			  for(i=0;i<4;i++)
-			  {
-				  pMB[k++] = img->mpr[i][j];
-			  }
-		  }
-		  pMB += 16;
-		  break;
-	  case 2:
-		  k=0;
-		  for(j=0;j<8;j++)
-		  {
-			  for(i=4;i<8;i++)
-			  {
-				  pMB[k++] = img->mpr[i][j];
-			  }
-		  }
-		  pMB += 32;
-		  break;
-	  }
-    }
-  }
-}
-
-static int edgeDistortion_ECMODE7(int predBlocks[], int currYBlockNum, imgpel *predMB, imgpel *recY, int32 picSizeX, int32 regionSize, imgpel *boundary, int pos)
-{
-  int i, j, distortion, numOfPredBlocks, threshold = ERC_BLOCK_OK;
-  imgpel *currBlock = NULL, *neighbor = NULL;
-  int32 currBlockOffset = 0;
-  
-  currBlock = recY + (yPosYBlock(currYBlockNum,picSizeX)<<3)*picSizeX + (xPosYBlock(currYBlockNum,picSizeX)<<3);
-  
-  do 
-  {    
-    distortion = 0; numOfPredBlocks = 0;
-    
-    /* loop the 2/3 neighbours */
-    for (j = 4; j < 8; j++) 
-    {
-		if(pos==0 && (j==6 || j==7))
-			continue;
-		if(pos==1 && (j==4 || j==7))
-			continue;
-		if(pos==2 && j==5)
-			continue;
-
-	  /* if reliable, count boundary pixel difference */
-      if (predBlocks[j] >= threshold) 
-      {        
-        switch (j) 
-        {
-        case 4:
-		  neighbor = currBlock - picSizeX;
-		  if(OBMA)
-		  {
-			  if(pos==0)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(boundary[i] - neighbor[i]));
-			  }
-			  else if(pos==2)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(boundary[i] - neighbor[i]));
-			  }
-		  }
-		  else
-		  {
-			  if(pos==0)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(predMB[i] - neighbor[i]));
-			  }
-			  else if(pos==2)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(predMB[i-8] - neighbor[i]));
-			  }
-		  }
-		  break;          
-        case 5:
-          neighbor = currBlock - 1;
-		  if(OBMA)
-		  {
-			  if(pos==0)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(boundary[16+i] - neighbor[i*picSizeX]));
-			  }
-			  else if(pos==1)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(boundary[16+i] - neighbor[i*picSizeX]));
-			  }
-		  }
-		  else
-		  {
-			  if(pos==0)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(predMB[i*8] - neighbor[i*picSizeX]));
-			  }
-			  else if(pos==1)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(predMB[(i-8)*8] - neighbor[i*picSizeX]));
-			  }
-		  }
-          break;                
-        case 6:
-          neighbor = currBlock + regionSize*picSizeX;
-          currBlockOffset = (regionSize-1)*16;
-		  if(OBMA)
-		  {
-			  if(pos==1)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(boundary[32+i] - neighbor[i]));
-			  }
-			  else if(pos==2)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(boundary[32+i] - neighbor[i]));
-			  }
-		  }
-		  else
-		  {
-			  if(pos==1)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(predMB[i+56] - neighbor[i]));
-			  }
-			  else if(pos==2)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(predMB[(i-8)+15*8] - neighbor[i]));
-			  }
-		  }
-		  break;                
-        case 7:
-          neighbor = currBlock + regionSize;
-          currBlockOffset = 7;
-		  if(OBMA)
-		  {
-			  for(i=0;i<regionSize;i++)
-				  distortion += mabs((int)(boundary[48+i] - neighbor[i*picSizeX]));
-		  }
-		  else
-		  {
-			  for(i=0;i<regionSize;i++)
-				  distortion += mabs((int)(predMB[i*8+currBlockOffset] - neighbor[i*picSizeX]));
-		  }
-          break;
-        }
-        
-        numOfPredBlocks++;
-      }
-    }
-    
-    threshold--;
-    if (threshold < ERC_BLOCK_CONCEALED)
-      break;
-  } while (numOfPredBlocks == 0);
-  
-  if(numOfPredBlocks == 0)
-    return 0;
-
-  return (distortion/numOfPredBlocks);
-}
-
-/**********************************************************************************************************************/
-//EC Mode 8
-static int concealABS_ECMODE8(frame *recfr, imgpel *predMB,int currMBNum, objectBuffer_t *object_list, int predBlocks[], 
-                      int32 picSizeX, int32 picSizeY, int *yCondition)
-{
-	imgpel *pred_left_ecmodeMB, *pred_ecmodeMB, *left_pred_ecmodeMB, *topright_pred_ecmodeMB, *bottomright_pred_ecmodeMB;
-
-	int predMBNum = 0, numMBPerLine,
-      compSplit1 = 0, compSplit2 = 0, compLeft = 1, comp = 0, compPred, order = 1,
-      fInterNeighborExists, numIntraNeighbours,
-      fZeroMotionChecked, predSplitted = 0,
-      threshold = ERC_BLOCK_OK,
-      minDist, currDist, i, k, j, p, q, bestDir;
-	int32 regionSize;
-	objectBuffer_t *currRegion;
-	int32 mvBest[3] , mvPred[3], *mvptr;
-	imgpel *predMB_OBMC;
-	
-	if(OBMC)
-		predMB_OBMC = (imgpel *) malloc ( (256 + (img->mb_cr_size_x*img->mb_cr_size_y)*2) * sizeof (imgpel));
-
-	//8x16 for luma and 4x8, 4x8 for chroma
-	pred_left_ecmodeMB = (imgpel *) malloc( ( 128 + (img->mb_cr_size_x*img->mb_cr_size_y/2)*2) * sizeof (imgpel));
-	left_pred_ecmodeMB = (imgpel *) malloc( ( 128 + (img->mb_cr_size_x*img->mb_cr_size_y/2)*2) * sizeof (imgpel));
-	
-	//8x8 for luma and 4x4, 4x4 for chroma
-	pred_ecmodeMB = (imgpel *) malloc ( (64 + (img->mb_cr_size_x*img->mb_cr_size_y/4)*2) * sizeof (imgpel));
-	topright_pred_ecmodeMB = (imgpel *) malloc ( (64 + (img->mb_cr_size_x*img->mb_cr_size_y/4)*2) * sizeof (imgpel));
-	bottomright_pred_ecmodeMB = (imgpel *) malloc ( (64 + (img->mb_cr_size_x*img->mb_cr_size_y/4)*2) * sizeof (imgpel));
-	
-	numMBPerLine = (int) (picSizeX>>4);
-  	comp = 0;
-	regionSize = 16;
-
-	//LEFT HALF
-	threshold = ERC_BLOCK_OK;
-	comp=0;
-	currRegion = object_list+(currMBNum<<2)+comp;
-	
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-
-	do
-	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;	
-
-		/* loop the 3 neighbours */
-		for (i = 4; i < 7; i++) //no right nbr for left half
-		{
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
-			{
-				switch (i) 
-				{
-				case 4:
-					predMBNum = currMBNum-numMBPerLine;
-					compSplit1 = 2;
-					compSplit2 = 2;
-					break;
-				case 5:
-					predMBNum = currMBNum-1;
-					compSplit1 = 1;
-					compSplit2 = 3;
-					break;
-				case 6:
-					predMBNum = currMBNum+numMBPerLine;
-					compSplit1 = 0;
-					compSplit2 = 0;
-					break;
-				}
-
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE8(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_left_ecmodeMB, boundary,0);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE8(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_left_ecmodeMB, boundary,0);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE8(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_left_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 0);
-						
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode =
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<128+32+32;p++)
-							{
-								left_pred_ecmodeMB[p] = pred_left_ecmodeMB[p];
-							}
-							
-							p=0;
-						}
-              
-						fInterNeighborExists = 1;    
-					}
-				}
-			}
-		}
-
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE8(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_left_ecmodeMB, boundary,0);
-
-	  currDist = edgeDistortion_ECMODE8(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_left_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 0);
-      
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-
-		for(p=0;p<128+32+32;p++)
-		{
-			left_pred_ecmodeMB[p] = pred_left_ecmodeMB[p];
-		}
-	  }
-    }
-
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
-    
-
-	//TOP RIGHT
-	threshold = ERC_BLOCK_OK;
-	comp=1;
-	currRegion = object_list+(currMBNum<<2)+comp;
-	
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-
-	do
-	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;	
-
-		/* loop the 2 neighbours */
-		for (i = 4; i < 8; i++) //only above and right nbrs
-		{
-			if(i==5 || i==6)
-				continue;
-
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
-			{
-				switch (i) 
-				{
-				case 4:
-					predMBNum = currMBNum-numMBPerLine;
-					compSplit1 = 3;
-					compSplit2 = 3;
-					break;
-				case 7:
-					predMBNum = currMBNum+1;
-					compSplit1 = 0;
-					compSplit2 = 0;
-					break; 
-				}
-
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE8(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE8(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE8(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 1);
-						
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode =
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<64+16+16;p++)
-							{
-								topright_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-							}
-							
-							p=0;
-						}
-              
-						fInterNeighborExists = 1;    
-					}
-				}
-			}
-		}
-
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE8(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,1);
-
-	  currDist = edgeDistortion_ECMODE8(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 1);
-      
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-
-		for(p=0;p<64+16+16;p++)
-		{
-			topright_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-		}
-	  }
-    }
-
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
-
-
-	//BOTTOM RIGHT
-	threshold = ERC_BLOCK_OK;
-	comp=3;
-	currRegion = object_list+(currMBNum<<2)+comp;
-	
-	/* set the position of the region to be concealed */
-    currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,comp,picSizeX),picSizeX)<<3);
-
-	do
-	{
-		/* reliability loop */
-		minDist = 0; 
-		fInterNeighborExists = 0; 
-		numIntraNeighbours = 0; 
-		fZeroMotionChecked = 0;	
-
-		/* loop the 2 neighbours */
-		for (i = 6; i < 8; i++) //only right and below nbrs
-		{
-			/* if reliable, try it */
-			if (predBlocks[i] >= threshold) 
-			{
-				switch (i) 
-				{				
-				case 6:
-					predMBNum = currMBNum+numMBPerLine;
-					compSplit1 = 1;
-					compSplit2 = 1;
-					break;
-				case 7:
-					predMBNum = currMBNum+1;
-					compSplit1 = 2;
-					compSplit2 = 2;
-					break;
-				}
-
-				/* try the concealment with the Motion Info of the current neighbour
-				only try if the neighbour is not Intra */
-				if (isBlock(object_list,predMBNum,compSplit1,INTRA) || 
-					isBlock(object_list,predMBNum,compSplit2,INTRA))
-				{            
-					numIntraNeighbours++;
-				}
-				else 
-				{
-					/* if neighbour MB is splitted, try the neighbour sub-blocks */
-					for (predSplitted = isSplitted(object_list, predMBNum), compPred = compSplit1;
-						 predSplitted >= 0; compPred = compSplit2, predSplitted -= ((compSplit1 == compSplit2) ? 2 : 1)) 
-					{
-						/* if Zero Motion Block, do the copying. This option is tried only once */
-						if (isBlock(object_list, predMBNum, compPred, INTER_COPY)) 
-						{
-							if (fZeroMotionChecked) 
-							{
-								continue;
-							}
-							else 
-							{
-								fZeroMotionChecked = 1;
-	  						    mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-								buildOuterPredRegionYUV_ECMODE8(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,2);
-							}
-						}
-						/* build motion using the neighbour's Motion Parameters */
-						else if (isBlock(object_list,predMBNum,compPred,INTRA)) 
-						{
-							continue;
-						}
-						else 
-						{
-							mvptr = getParam(object_list, predMBNum, compPred, mv);                
-							mvPred[0] = mvptr[0]; mvPred[1] = mvptr[1]; mvPred[2] = mvptr[2];		
-
-							buildOuterPredRegionYUV_ECMODE8(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,2);
-						}
-
-						/* measure absolute boundary pixel difference */
-						currDist = edgeDistortion_ECMODE8(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 2);
-						
-						/* if so far best -> store the pixels as the best concealment */
-						if (currDist < minDist || !fInterNeighborExists) 
-						{
-							minDist = currDist;
-							bestDir = i;
-                
-							for (k=0;k<3;k++) 
-								mvBest[k] = mvPred[k];
-                
-							currRegion->regionMode =
-								(isBlock(object_list, predMBNum, compPred, INTER_COPY)) ? 
-								((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8) : 
-								((regionSize == 16) ? REGMODE_INTER_PRED : REGMODE_INTER_PRED_8x8);
-
-							for(p=0;p<64+16+16;p++)
-							{
-								bottomright_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-							}
-							
-							p=0;
-						}
-              
-						fInterNeighborExists = 1;    
-					}
-				}
-			}
-		}
-
-		threshold--;      
-	}while ((threshold >= ERC_BLOCK_CONCEALED) && (fInterNeighborExists == 0));
-    
-	/* always try zero motion */
-    if (!fZeroMotionChecked) 
-    {
-      mvPred[0] = mvPred[1] = 0; mvPred[2] = 0;
-	  buildOuterPredRegionYUV_ECMODE8(erc_img, mvPred, currRegion->xMin, currRegion->yMin, pred_ecmodeMB, boundary,2);
-
-	  currDist = edgeDistortion_ECMODE8(predBlocks,MBNum2YBlock(currMBNum,comp,picSizeX),pred_ecmodeMB,recfr->yptr, picSizeX, regionSize, boundary, 2);
-      
-      if (currDist < minDist || !fInterNeighborExists) 
-      {        
-        minDist = currDist;            
-        for (k=0;k<3;k++) 
-          mvBest[k] = mvPred[k];
-        
-        currRegion->regionMode = ((regionSize == 16) ? REGMODE_INTER_COPY : REGMODE_INTER_COPY_8x8);
-
-		for(p=0;p<64+16+16;p++)
-		{
-			bottomright_pred_ecmodeMB[p] = pred_ecmodeMB[p];
-		}
-	  }
-    }
-
-	for (i=0; i<3; i++)
-      currRegion->mv[i] = mvBest[i];
-
-
-	//Whole MB concealed at this stage, copy to predMB
-
-	p=0;q=0;
-	for(j=0;j<16;j++)
-	{
-		for(i=0;i<8;i++)
-		{
-			predMB[j*16+i] = left_pred_ecmodeMB[q];
-			q++;
-		}
-	}
-	for(j=0;j<8;j++)
-	{
-		for(i=8;i<16;i++)
-		{
-			predMB[j*16+i] = topright_pred_ecmodeMB[p];
-			predMB[(j+8)*16+i] = bottomright_pred_ecmodeMB[p];
-			p++;
-		}
-	}	
-
-	p=0;q=0;
-	for(j=0;j<8;j++)
-	{
-		for(i=0;i<4;i++)
-		{
-			predMB[256+j*8+i] = left_pred_ecmodeMB[128+q];
-			predMB[256+64+j*8+i] = left_pred_ecmodeMB[128+32+q];
-			q++;
-		}
-	}
-	for(j=0;j<4;j++)
-	{
-		for(i=4;i<8;i++)
-		{
-			predMB[256+j*8+i] = topright_pred_ecmodeMB[64+p];
-			predMB[256+(j+4)*8+i] = bottomright_pred_ecmodeMB[64+p];
-			predMB[256+64+j*8+i] = topright_pred_ecmodeMB[80+p];
-			predMB[256+64+(j+4)*8+i] = bottomright_pred_ecmodeMB[80+p];
-			p++;
-		}
-	}
-	
-	if(OBMC)
-	{
-		OBMC_MB(predMB,predMB_OBMC,predBlocks,object_list,currMBNum,numMBPerLine,picSizeX);
-		copyPredMB(MBNum2YBlock(currMBNum,0,picSizeX), predMB_OBMC, recfr, picSizeX, regionSize);
-	}
-	else
-		copyPredMB(MBNum2YBlock(currMBNum,0,picSizeX), predMB, recfr,picSizeX, regionSize);
-	
-	yCondition[MBNum2YBlock(currMBNum,0,picSizeX)] = ERC_BLOCK_CONCEALED;
-
-	free(pred_ecmodeMB);
-	free(pred_left_ecmodeMB);
-	free(left_pred_ecmodeMB);
-	free(topright_pred_ecmodeMB);
-	free(bottomright_pred_ecmodeMB);
-	if(OBMC)
-		free(predMB_OBMC);
-
-	return 0;
-}
-
-static void buildOuterPredRegionYUV_ECMODE8(struct img_par *img, int32 *mv, int x, int y, imgpel *predMB, imgpel *boundary, int pos)
-{
-  int tmp_block[BLOCK_SIZE][BLOCK_SIZE];
-  int i=0,j=0,ii=0,jj=0,i1=0,j1=0,j4=0,i4=0,k=0;
-  int jf=0;
-  int uv;
-  int vec1_x=0,vec1_y=0;
-  int ioff,joff;
-  imgpel *pMB = predMB; //Note: predMB is actually pred_ecmodeMB; for ecmode2, it is left/right half, so 8x16 for Y and 4x8,4x8 for UV
-  
-  int ii0,jj0,ii1,jj1,if1,jf1,if0,jf0;
-  int mv_mul;
-
-  int above[4], left[4], below[4], right[4], index;
-  
-  //FRExt
-  int f1_x, f1_y, f2_x, f2_y, f3, f4, ifx;
-  int b8, b4;
-  int yuv = dec_picture->chroma_format_idc - 1;
-  
-  int ref_frame = max (mv[2], 0); // !!KS: quick fix, we sometimes seem to get negative ref_pic here, so restrict to zero an above
-
-  /* Update coordinates of the current concealed macroblock */
-  img->mb_x = x/MB_BLOCK_SIZE;
-  img->mb_y = y/MB_BLOCK_SIZE;
-  img->block_y = img->mb_y * BLOCK_SIZE;
-  img->pix_c_y = img->mb_y * img->mb_cr_size_y;
-  img->block_x = img->mb_x * BLOCK_SIZE;
-  img->pix_c_x = img->mb_x * img->mb_cr_size_x;
-
-  mv_mul=4;
-
-  // luma *******************************************************
-
-  for(i=0;i<4;i++)
-  {
-	  above[i]=0;left[i]=0;below[i]=0;right[i]=0;
-  }
-
-  for(j=0;j<MB_BLOCK_SIZE/BLOCK_SIZE;j++)
-  {
-    joff=j*4;
-    j4=img->block_y+j;
-    for(i=0;i<MB_BLOCK_SIZE/BLOCK_SIZE;i++)
-    {
-      ioff=i*4;
-      i4=img->block_x+i;
-
-      vec1_x = i4*4*mv_mul + mv[0];
-      vec1_y = j4*4*mv_mul + mv[1];
-
-      get_block(ref_frame, listX[0], vec1_x,vec1_y,img,tmp_block);
-
-	  index = i+4*j;
-	  get_boundary(ref_frame, listX[0], vec1_x, vec1_y, img, index, above, left, below, right);
-	  
-	  if(j==0)
-	  {
-		  boundary[4*i+0]=above[0];boundary[4*i+1]=above[1];boundary[4*i+2]=above[2];boundary[4*i+3]=above[3];
-	  }
-
-	  if(i==0)
-	  {
-		  boundary[16+4*j+0]=left[0];boundary[16+4*j+1]=left[1];boundary[16+4*j+2]=left[2];boundary[16+4*j+3]=left[3];
-	  }
-
-	  if(j==3) //MB_BLOCK_SIZE/BLOCK_SIZE - 1 = 3
-	  {
-		  boundary[32+4*i+0]=below[0];boundary[32+4*i+1]=below[1];boundary[32+4*i+2]=below[2];boundary[32+4*i+3]=below[3];
-	  }
-
-	  if(i==3)
-	  {
-		  boundary[48+4*j+0]=right[0];boundary[48+4*j+1]=right[1];boundary[48+4*j+2]=right[2];boundary[48+4*j+3]=right[3];
-	  }
-
-      for(ii=0;ii<BLOCK_SIZE;ii++)
-        for(jj=0;jj<MB_BLOCK_SIZE/BLOCK_SIZE;jj++)
-          img->mpr[ii+ioff][jj+joff]=tmp_block[ii][jj];
-    }
-  }
-
-  switch(pos)
-  {
-  case 0:
-	  k=0;
-	  for(j=0;j<16;j++)
-	  {
-		  for(i=0;i<8;i++)
-		  {
-			  pMB[k++] = img->mpr[i][j];
-		  }
-	  }
-	  pMB += 128;
-	  break;
-  case 1:
-	  k=0;
-	  for(j=0;j<8;j++)
-	  {
-		  for(i=8;i<16;i++)
-		  {
-			  pMB[k++] = img->mpr[i][j];
-		  }
-	  }
-	  pMB += 64;
-	  break;
-  case 2:
-	  k=0;
-	  for(j=8;j<16;j++)
-	  {
-		  for(i=8;i<16;i++)
-		  {
-			  pMB[k++] = img->mpr[i][j];
-		  }
-	  }
-	  pMB += 64;
-	  break;
-  }
-
-  if (dec_picture->chroma_format_idc != YUV400)
-  {
-    // chroma *******************************************************
-    f1_x = 64/img->mb_cr_size_x;
-    f2_x=f1_x-1;
-
-    f1_y = 64/img->mb_cr_size_y;
-    f2_y=f1_y-1;
-
-    f3=f1_x*f1_y;
-    f4=f3>>1;
-
-    for(uv=0;uv<2;uv++)
-    {
-      for (b8=0;b8<(img->num_blk8x8_uv/2);b8++)
-      {
-        for(b4=0;b4<4;b4++)
-		{
-          joff = subblk_offset_y[yuv][b8][b4];
-          j4=img->pix_c_y+joff;
-          ioff = subblk_offset_x[yuv][b8][b4];
-          i4=img->pix_c_x+ioff;
-
-          for(jj=0;jj<4;jj++)
-          {
-            jf=(j4+jj)/(img->mb_cr_size_y/4);     // jf  = Subblock_y-coordinate
-            for(ii=0;ii<4;ii++)
-            {
-              ifx=(i4+ii)/(img->mb_cr_size_x/4);  // ifx = Subblock_x-coordinate
-
-              i1=(i4+ii)*f1_x + mv[0];
-              j1=(j4+jj)*f1_y + mv[1];
-            
-              ii0=max (0, min (i1/f1_x,   dec_picture->size_x_cr-1));
-              jj0=max (0, min (j1/f1_y,   dec_picture->size_y_cr-1));
-              ii1=max (0, min ((i1+f2_x)/f1_x, dec_picture->size_x_cr-1));
-              jj1=max (0, min ((j1+f2_y)/f1_y, dec_picture->size_y_cr-1));
-            
-              if1=(i1 & f2_x);
-              jf1=(j1 & f2_y);
-              if0=f1_x-if1;
-              jf0=f1_y-jf1;
-            
-              img->mpr[ii+ioff][jj+joff]=(if0*jf0*listX[0][ref_frame]->imgUV[uv][jj0][ii0]+
-                                          if1*jf0*listX[0][ref_frame]->imgUV[uv][jj0][ii1]+
-                                          if0*jf1*listX[0][ref_frame]->imgUV[uv][jj1][ii0]+
-                                          if1*jf1*listX[0][ref_frame]->imgUV[uv][jj1][ii1]+f4)/f3;
-            }
-          }
-        }
-      }
-
-	  switch(pos)
-	  {
-	  case 0:
-		  k=0;
-		  for(j=0;j<8;j++)
-		  {
-			  for(i=0;i<4;i++)
-			  {
-				  pMB[k++] = img->mpr[i][j];
-			  }
-		  }
-		  pMB += 32;
-		  break;
-	  case 1:
-		  k=0;
-		  for(j=0;j<4;j++)
-		  {
-			  for(i=4;i<8;i++)
-			  {
-				  pMB[k++] = img->mpr[i][j];
-			  }
-		  }
-		  pMB += 16;
-		  break;
-	  case 2:
-		  k=0;
-		  for(j=4;j<8;j++)
-		  {
-			  for(i=4;i<8;i++)
-			  {
-				  pMB[k++] = img->mpr[i][j];
-			  }
-		  }
-		  pMB += 16;
-		  break;
-	  }
-    }
-  }
-}
-
-static int edgeDistortion_ECMODE8(int predBlocks[], int currYBlockNum, imgpel *predMB, imgpel *recY, int32 picSizeX, int32 regionSize, imgpel *boundary, int pos)
-{
-  int i, j, distortion, numOfPredBlocks, threshold = ERC_BLOCK_OK;
-  imgpel *currBlock = NULL, *neighbor = NULL;
-  int32 currBlockOffset = 0;
-  
-  currBlock = recY + (yPosYBlock(currYBlockNum,picSizeX)<<3)*picSizeX + (xPosYBlock(currYBlockNum,picSizeX)<<3);
-  
-  do 
-  {    
-    distortion = 0; numOfPredBlocks = 0;
-    
-    /* loop the 2/3 neighbours */
-    for (j = 4; j < 8; j++) 
-    {
-		if(pos==0 && j==7)
-			continue;
-		if(pos==2 && (j==4 || j==5))
-			continue;
-		if(pos==1 && (j==5 || j==6))
-			continue;
-
-	  /* if reliable, count boundary pixel difference */
-      if (predBlocks[j] >= threshold) 
-      {        
-        switch (j) 
-        {
-        case 4:
-		  neighbor = currBlock - picSizeX;
-		  if(OBMA)
-		  {
-			  if(pos==0)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(boundary[i] - neighbor[i]));
-			  }
-			  else if(pos==1)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(boundary[i] - neighbor[i]));
-			  }
-		  }
-		  else
-		  {
-			  if(pos==0)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(predMB[i] - neighbor[i]));
-			  }
-			  else if(pos==1)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(predMB[i-8] - neighbor[i]));
-			  }
-		  }
-		  break;          
-        case 5:
-          neighbor = currBlock - 1;
-		  if(OBMA)
-		  {
-			  for(i=0;i<regionSize;i++)
-				  distortion += mabs((int)(boundary[16+i] - neighbor[i*picSizeX]));
-		  }
-		  else
-		  {
-			  for(i=0;i<regionSize;i++)
-				  distortion += mabs((int)(predMB[i*8] - neighbor[i*picSizeX]));
-		  }
-          break;                
-        case 6:
-          neighbor = currBlock + regionSize*picSizeX;
-          currBlockOffset = (regionSize-1)*16;
-		  if(OBMA)
-		  {
-			  if(pos==0)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(boundary[32+i] - neighbor[i]));
-			  }
-			  else if(pos==2)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(boundary[32+i] - neighbor[i]));
-			  }
-		  }
-		  else
-		  {
-			  if(pos==0)
-			  {
-				  for(i=0;i<8;i++)
-					  distortion += mabs((int)(predMB[i+15*8] - neighbor[i]));
-			  }
-			  else if(pos==2)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(predMB[(i-8)+56] - neighbor[i]));
-			  }
-		  }
-		  break;                
-        case 7:
-          neighbor = currBlock + regionSize;
-          currBlockOffset = 7;
-		  if(OBMA)
-		  {
-			  if(pos==1)
-			  {
-				   for(i=0;i<8;i++)
-					   distortion += mabs((int)(boundary[48+i] - neighbor[i*picSizeX]));
-			  }
-			  else if(pos==2)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(boundary[48+i] - neighbor[i*picSizeX]));
-			  }
-		  }
-		  else
-		  {
-			  if(pos==1)
-			  {
-				   for(i=0;i<8;i++)
-					   distortion += mabs((int)(predMB[i*8+currBlockOffset] - neighbor[i*picSizeX]));
-			  }
-			  else if(pos==2)
-			  {
-				  for(i=8;i<16;i++)
-					  distortion += mabs((int)(predMB[(i-8)*8+currBlockOffset] - neighbor[i*picSizeX]));
-			  }
-		  }
-          break;
-        }
-        
-        numOfPredBlocks++;
-      }
-    }
-    
-    threshold--;
-    if (threshold < ERC_BLOCK_CONCEALED)
-      break;
-  } while (numOfPredBlocks == 0);
-  
-  if(numOfPredBlocks == 0)
-    return 0;
-
-  return (distortion/numOfPredBlocks);
-}
-
-
-static void OBMC_MB(imgpel *predMB, imgpel *predMB_OBMC, int predBlocks[], objectBuffer_t *object_list, int currMBNum, int numMBPerLine, int picSizeX)
-{
-	int32 mvLR[3], mvTD[3], *mvptr;
-	int i, j, predMBNum, lower, upper;
-	imgpel *predMB_LR, *predMB_TD;
-	objectBuffer_t *currRegion;
-
-	predMB_LR = (imgpel *) malloc ( (64 + (img->mb_cr_size_x*img->mb_cr_size_y/4)*2) * sizeof (imgpel));
-	predMB_TD = (imgpel *) malloc ( (64 + (img->mb_cr_size_x*img->mb_cr_size_y/4)*2) * sizeof (imgpel));
-
-	currRegion = object_list+(currMBNum<<2); 
-	currRegion->xMin = (xPosYBlock(MBNum2YBlock(currMBNum,0,picSizeX),picSizeX)<<3);
-    currRegion->yMin = (yPosYBlock(MBNum2YBlock(currMBNum,0,picSizeX),picSizeX)<<3);
-
-	//Comp = 0
-	for(i=0;i<2;i++)
-	{
-		 mvLR[i] = NIL; mvTD[i] = NIL;
-	}
-	mvLR[2] = 0; mvTD[2] = 0;
-
-	//Above
-	if(predBlocks[4]>=ERC_BLOCK_CONCEALED)
-	{
-		predMBNum = currMBNum-numMBPerLine;
-		if(!(isBlock(object_list, predMBNum, 2, INTER_COPY) || isBlock(object_list,predMBNum,2,INTRA))) 
-		{
-			mvptr = getParam(object_list, predMBNum, 2, mv);
-			mvTD[0]=mvptr[0]; mvTD[1]=mvptr[1];
-		}				
-	}
-
-	//Left
-	if(predBlocks[5]>=ERC_BLOCK_CONCEALED)
-	{
-		predMBNum = currMBNum-1;
-		if(!(isBlock(object_list, predMBNum,1, INTER_COPY) || isBlock(object_list,predMBNum,1,INTRA))) 
-		{
-			mvptr = getParam(object_list, predMBNum, 1, mv);
-			mvLR[0]=mvptr[0]; mvLR[1]=mvptr[1];
-		}
-	}
-	
-	//construct MB with mvTD
-	if(mvTD[0]!=NIL)
-	{
-		buildOuterPredRegionYUV_ECMODE4(erc_img,mvTD,currRegion->xMin,currRegion->yMin,predMB_TD,boundary,0);
-	}
-	else
-	{
-		for(i=0;i<8;i++)
-		{
-			for(j=0;j<8;j++)
-			{
-				predMB_TD[i*8+j] = predMB[i*16+j];
-			}
-		}
-
-		for(i=0;i<4;i++)
-		{
-			for(j=0;j<4;j++)
-			{
-				predMB_TD[64+i*4+j] = predMB[256+i*8+j];
-				predMB_TD[64+16+i*4+j] = predMB[256+64+i*8+j];
-			}
-		}
-	}
-
-	//construct MB with mvLR
-	if(mvLR[0]!=NIL)
-	{
-		buildOuterPredRegionYUV_ECMODE4(erc_img,mvLR,currRegion->xMin,currRegion->yMin,predMB_LR,boundary,0);
-	}
-	else
-	{
-		for(i=0;i<8;i++)
-		{
-			for(j=0;j<8;j++)
-			{
-				predMB_LR[i*8+j] = predMB[i*16+j];
-			}
-		}
-
-		for(i=0;i<4;i++)
-		{
-			for(j=0;j<4;j++)
-			{
-				predMB_LR[64+i*4+j] = predMB[256+i*8+j];
-				predMB_LR[64+16+i*4+j] = predMB[256+64+i*8+j];
-			}
-		}
-	}
-	
-	//apply obmc averaging with weights 
-	for(i=0;i<8;i++)
-	{
-		for(j=0;j<8;j++)
-		{
-			predMB_OBMC[i*16+j] = (predMB[i*16+j]*H_E_8x8[i][j] + predMB_LR[i*8+j]*H_LR_8x8[i][j] + predMB_TD[i*8+j]*H_TD_8x8[i][j]);
-			predMB_OBMC[i*16+j] = (int)floor(predMB_OBMC[i*16+j]/8.0 + 0.5);
-
-			upper = predMB[i*16+j] + (predMB[i*16+j]*OBMC_TR/100);
-			lower = predMB[i*16+j] - (predMB[i*16+j]*OBMC_TR/100);
-			if(OBMC_THRESHOLD && !(predMB_OBMC[i*16+j]>=lower && predMB_OBMC[i*16+j]<=upper))
-				predMB_OBMC[i*16+j] = predMB[i*16+j];
-		}
-	}
-
-	for(i=0;i<4;i++)
-	{
-		for(j=0;j<4;j++)
-		{
-			predMB_OBMC[256+i*8+j] = (predMB[256+i*8+j]*H_E_8x8[i][j] + predMB_LR[64+i*4+j]*H_LR_8x8[i][j] + predMB_TD[64+i*4+j]*H_TD_8x8[i][j]);
-			predMB_OBMC[256+i*8+j] = (int)floor(predMB_OBMC[256+i*8+j]/8.0 + 0.5);
-
-			upper = predMB[256+i*8+j] + (predMB[256+i*8+j]*OBMC_TR/100);
-			lower = predMB[256+i*8+j] - (predMB[256+i*8+j]*OBMC_TR/100);
-			if(OBMC_THRESHOLD && !(predMB_OBMC[256+i*8+j]>=lower && predMB_OBMC[256+i*8+j]<=upper))
-				predMB_OBMC[256+i*8+j] = predMB[256+i*8+j];
-
-			predMB_OBMC[256+64+i*8+j] = (predMB[256+64+i*8+j]*H_E_8x8[i][j] + predMB_LR[64+16+i*4+j]*H_LR_8x8[i][j] + predMB_TD[64+16+i*4+j]*H_TD_8x8[i][j]);
-			predMB_OBMC[256+64+i*8+j] = (int)floor(predMB_OBMC[256+64+i*8+j]/8.0 + 0.5);
-
-			upper = predMB[256+64+i*8+j] + (predMB[256+64+i*8+j]*OBMC_TR/100);
-			lower = predMB[256+64+i*8+j] - (predMB[256+64+i*8+j]*OBMC_TR/100);
-			if(OBMC_THRESHOLD && !(predMB_OBMC[256+64+i*8+j]>=lower && predMB_OBMC[256+64+i*8+j]<=upper))
-				predMB_OBMC[256+64+i*8+j] = predMB[256+64+i*8+j];
-		}
-	}
-
-
-	//Comp = 1
-	for(i=0;i<2;i++)
-	{
-		 mvLR[i] = NIL; mvTD[i] = NIL;
-	}
-	mvLR[2] = 0; mvTD[2] = 0;
-
-	//Above
-	if(predBlocks[4]>=ERC_BLOCK_CONCEALED)
-	{
-		predMBNum = currMBNum-numMBPerLine;
-		if(!(isBlock(object_list, predMBNum, 3, INTER_COPY) || isBlock(object_list,predMBNum,3,INTRA))) 
-		{
-			mvptr = getParam(object_list, predMBNum, 3, mv);
-			mvTD[0]=mvptr[0]; mvTD[1]=mvptr[1];
-		}				
-	}
-
-	//Right
-	if(predBlocks[7]>=ERC_BLOCK_CONCEALED)
-	{
-		predMBNum = currMBNum+1;
-		if(!(isBlock(object_list, predMBNum, 0, INTER_COPY) || isBlock(object_list,predMBNum,0,INTRA))) 
-		{
-			mvptr = getParam(object_list, predMBNum, 0, mv);
-			mvLR[0]=mvptr[0]; mvLR[1]=mvptr[1];
-		}
-	}
-	
-	//construct MB with mvTD
-	if(mvTD[0]!=NIL)
-	{
-		buildOuterPredRegionYUV_ECMODE4(erc_img,mvTD,currRegion->xMin,currRegion->yMin,predMB_TD,boundary,1);
-	}
-	else
-	{
-		for(i=0;i<8;i++)
-		{
-			for(j=8;j<16;j++)
-			{
-				predMB_TD[i*8+(j-8)] = predMB[i*16+j];
-			}
-		}
-
-		for(i=0;i<4;i++)
-		{
-			for(j=4;j<8;j++)
-			{
-				predMB_TD[64+i*4+(j-4)] = predMB[256+i*8+j];
-				predMB_TD[64+16+i*4+(j-4)] = predMB[256+64+i*8+j];
-			}
-		}
-	}
-
-	//construct MB with mvLR
-	if(mvLR[0]!=NIL)
-	{
-		buildOuterPredRegionYUV_ECMODE4(erc_img,mvLR,currRegion->xMin,currRegion->yMin,predMB_LR,boundary,1);
-	}
-	else
-	{
-		for(i=0;i<8;i++)
-		{
-			for(j=8;j<16;j++)
-			{
-				predMB_LR[i*8+(j-8)] = predMB[i*16+j];
-			}
-		}
-
-		for(i=0;i<4;i++)
-		{
-			for(j=4;j<8;j++)
-			{
-				predMB_LR[64+i*4+(j-4)] = predMB[256+i*8+j];
-				predMB_LR[64+16+i*4+(j-4)] = predMB[256+64+i*8+j];
-			}
-		}
-	}
-	
-	//apply obmc averaging with weights 
-	for(i=0;i<8;i++)
-	{
-		for(j=8;j<16;j++)
-		{
-			predMB_OBMC[i*16+j] = (predMB[i*16+j]*H_E_8x8[i][j-8] + predMB_LR[i*8+(j-8)]*H_LR_8x8[i][j-8] + predMB_TD[i*8+(j-8)]*H_TD_8x8[i][j-8]);
-			predMB_OBMC[i*16+j] = (int)floor(predMB_OBMC[i*16+j]/8.0 + 0.5);
-
-			upper = predMB[i*16+j] + (predMB[i*16+j]*OBMC_TR/100);
-			lower = predMB[i*16+j] - (predMB[i*16+j]*OBMC_TR/100);
-			if(OBMC_THRESHOLD && !(predMB_OBMC[i*16+j]>=lower && predMB_OBMC[i*16+j]<=upper))
-				predMB_OBMC[i*16+j] = predMB[i*16+j];
-		}
-	}
-
-	for(i=0;i<4;i++)
-	{
-		for(j=4;j<8;j++)
-		{
-			predMB_OBMC[256+i*8+j] = (predMB[256+i*8+j]*H_E_8x8[i][j-4] + predMB_LR[64+i*4+(j-4)]*H_LR_8x8[i][j-4] + predMB_TD[64+i*4+(j-4)]*H_TD_8x8[i][j-4]);
-			predMB_OBMC[256+i*8+j] = (int)floor(predMB_OBMC[256+i*8+j]/8.0 + 0.5);
-
-			upper = predMB[256+i*8+j] + (predMB[256+i*8+j]*OBMC_TR/100);
-			lower = predMB[256+i*8+j] - (predMB[256+i*8+j]*OBMC_TR/100);
-			if(OBMC_THRESHOLD && !(predMB_OBMC[256+i*8+j]>=lower && predMB_OBMC[256+i*8+j]<=upper))
-				predMB_OBMC[256+i*8+j] = predMB[256+i*8+j];
-
-			predMB_OBMC[256+64+i*8+j] = (predMB[256+64+i*8+j]*H_E_8x8[i][j-4] + predMB_LR[64+16+i*4+(j-4)]*H_LR_8x8[i][j-4] + predMB_TD[64+16+i*4+(j-4)]*H_TD_8x8[i][j-4]);
-			predMB_OBMC[256+64+i*8+j] = (int)floor(predMB_OBMC[256+64+i*8+j]/8.0 + 0.5);
-
-			upper = predMB[256+64+i*8+j] + (predMB[256+64+i*8+j]*OBMC_TR/100);
-			lower = predMB[256+64+i*8+j] - (predMB[256+64+i*8+j]*OBMC_TR/100);
-			if(OBMC_THRESHOLD && !(predMB_OBMC[256+64+i*8+j]>=lower && predMB_OBMC[256+64+i*8+j]<=upper))
-				predMB_OBMC[256+64+i*8+j] = predMB[256+64+i*8+j];
-		}
-	}
-
-	//Comp = 2
-	for(i=0;i<2;i++)
-	{
-		 mvLR[i] = NIL; mvTD[i] = NIL;
-	}
-	mvLR[2] = 0; mvTD[2] = 0;
-
-	//Left
-	if(predBlocks[5]>=ERC_BLOCK_CONCEALED)
-	{
-		predMBNum = currMBNum-1;
-		if(!(isBlock(object_list, predMBNum,3, INTER_COPY) || isBlock(object_list,predMBNum,3,INTRA))) 
-		{
-			mvptr = getParam(object_list, predMBNum, 3, mv);
-			mvLR[0]=mvptr[0]; mvLR[1]=mvptr[1];
-		}
-	}
-
-	//Below
-	if(predBlocks[6]>=ERC_BLOCK_CONCEALED)
-	{
-		predMBNum = currMBNum+numMBPerLine;
-		if(!(isBlock(object_list, predMBNum, 0, INTER_COPY) || isBlock(object_list,predMBNum,0,INTRA))) 
-		{
-			mvptr = getParam(object_list, predMBNum, 0, mv);
-			mvTD[0]=mvptr[0]; mvTD[1]=mvptr[1];
-		}
-	}
-	
-	//construct MB with mvTD
-	if(mvTD[0]!=NIL)
-	{
-		buildOuterPredRegionYUV_ECMODE4(erc_img,mvTD,currRegion->xMin,currRegion->yMin,predMB_TD,boundary,2);
-	}
-	else
-	{
-		for(i=8;i<16;i++)
-		{
-			for(j=0;j<8;j++)
-			{
-				predMB_TD[(i-8)*8+j] = predMB[i*16+j];
-			}
-		}
-
-		for(i=4;i<8;i++)
-		{
-			for(j=0;j<4;j++)
-			{
-				predMB_TD[64+(i-4)*4+j] = predMB[256+i*8+j];
-				predMB_TD[64+16+(i-4)*4+j] = predMB[256+64+i*8+j];
-			}
-		}
-	}
-
-	//construct MB with mvLR
-	if(mvLR[0]!=NIL)
-	{
-		buildOuterPredRegionYUV_ECMODE4(erc_img,mvLR,currRegion->xMin,currRegion->yMin,predMB_LR,boundary,2);
-	}
-	else
-	{
-		for(i=8;i<16;i++)
-		{
-			for(j=0;j<8;j++)
-			{
-				predMB_LR[(i-8)*8+j] = predMB[i*16+j];
-			}
-		}
-
-		for(i=4;i<8;i++)
-		{
-			for(j=0;j<4;j++)
-			{
-				predMB_LR[64+(i-4)*4+j] = predMB[256+i*8+j];
-				predMB_LR[64+16+(i-4)*4+j] = predMB[256+64+i*8+j];
-			}
-		}
-	}
-	
-	//apply obmc averaging with weights 
-	for(i=8;i<16;i++)
-	{
-		for(j=0;j<8;j++)
-		{
-			predMB_OBMC[i*16+j] = (predMB[i*16+j]*H_E_8x8[i-8][j] + predMB_LR[(i-8)*8+j]*H_LR_8x8[i-8][j] + predMB_TD[(i-8)*8+j]*H_TD_8x8[i-8][j]);
-			predMB_OBMC[i*16+j] = (int)floor(predMB_OBMC[i*16+j]/8.0 + 0.5);
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the number of candidates measured after the coarse ranking
+ ************************************************************************
+ */
+int ercGetCoarseCandidates(void)
+{
+  return coarseCandidates;
+}
 
-			upper = predMB[i*16+j] + (predMB[i*16+j]*OBMC_TR/100);
-			lower = predMB[i*16+j] - (predMB[i*16+j]*OBMC_TR/100);
-			if(OBMC_THRESHOLD && !(predMB_OBMC[i*16+j]>=lower && predMB_OBMC[i*16+j]<=upper))
-				predMB_OBMC[i*16+j] = predMB[i*16+j];
-		}
-	}
+/*!
+ ************************************************************************
+ * \brief
+ *      Wall clock time in ms
+ ************************************************************************
+ */
+static double clockMs(void)
+{
+#ifdef WIN32
+  struct _timeb tb;
 
-	for(i=4;i<8;i++)
-	{
-		for(j=0;j<4;j++)
-		{
-			predMB_OBMC[256+i*8+j] = (predMB[256+i*8+j]*H_E_8x8[i-4][j] + predMB_LR[64+(i-4)*4+j]*H_LR_8x8[i-4][j] + predMB_TD[64+(i-4)*4+j]*H_TD_8x8[i-4][j]);
-			predMB_OBMC[256+i*8+j] = (int)floor(predMB_OBMC[256+i*8+j]/8.0 + 0.5);
+  _ftime(&tb);
+  return (double) tb.time * 1000.0 + tb.millitm;
+#else
+  struct timeval tv;
 
-			upper = predMB[256+i*8+j] + (predMB[256+i*8+j]*OBMC_TR/100);
-			lower = predMB[256+i*8+j] - (predMB[256+i*8+j]*OBMC_TR/100);
-			if(OBMC_THRESHOLD && !(predMB_OBMC[256+i*8+j]>=lower && predMB_OBMC[256+i*8+j]<=upper))
-				predMB_OBMC[256+i*8+j] = predMB[256+i*8+j];
+  gettimeofday(&tv, NULL);
+  return (double) tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+#endif
+}
 
-			predMB_OBMC[256+64+i*8+j] = (predMB[256+64+i*8+j]*H_E_8x8[i-4][j] + predMB_LR[64+16+(i-4)*4+j]*H_LR_8x8[i-4][j] + predMB_TD[64+16+(i-4)*4+j]*H_TD_8x8[i-4][j]);
-			predMB_OBMC[256+64+i*8+j] = (int)floor(predMB_OBMC[256+64+i*8+j]/8.0 + 0.5);
+/*!
+ ************************************************************************
+ * \brief
+ *      Starts the deadline of the picture a context is about to conceal
+ ************************************************************************
+ */
+void ercStartDeadline(ercContext_t *ctx)
+{
+  ctx->degradedMBs = 0;
+  if (concealDeadline > 0)
+    ctx->frameStart = clockMs();
+}
 
-			upper = predMB[256+64+i*8+j] + (predMB[256+64+i*8+j]*OBMC_TR/100);
-			lower = predMB[256+64+i*8+j] - (predMB[256+64+i*8+j]*OBMC_TR/100);
-			if(OBMC_THRESHOLD && !(predMB_OBMC[256+64+i*8+j]>=lower && predMB_OBMC[256+64+i*8+j]<=upper))
-				predMB_OBMC[256+64+i*8+j] = predMB[256+64+i*8+j];
-		}
-	}
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the level (ERC_LEVEL_*) the next MB of the picture has to
+ *      be concealed at to meet the deadline
+ ************************************************************************
+ */
+int ercConcealLevel(ercContext_t *ctx)
+{
+  double elapsed;
 
-	//Comp = 3
-	for(i=0;i<2;i++)
-	{
-		 mvLR[i] = NIL; mvTD[i] = NIL;
-	}
-	mvLR[2] = 0; mvTD[2] = 0;
+  if (concealDeadline <= 0)
+    return ERC_LEVEL_FULL;
 
-	//Below
-	if(predBlocks[6]>=ERC_BLOCK_CONCEALED)
-	{
-		predMBNum = currMBNum+numMBPerLine;
-		if(!(isBlock(object_list, predMBNum, 1, INTER_COPY) || isBlock(object_list,predMBNum,1,INTRA))) 
-		{
-			mvptr = getParam(object_list, predMBNum, 1, mv);
-			mvTD[0]=mvptr[0]; mvTD[1]=mvptr[1];
-		}
-	}
+  elapsed = clockMs() - ctx->frameStart;
+  if (elapsed >= concealDeadline)
+    return ERC_LEVEL_MINIMAL;
+  if (2*elapsed >= concealDeadline)
+    return ERC_LEVEL_REDUCED;
+  return ERC_LEVEL_FULL;
+}
 
-	//Right
-	if(predBlocks[7]>=ERC_BLOCK_CONCEALED)
-	{
-		predMBNum = currMBNum+1;
-		if(!(isBlock(object_list, predMBNum, 2, INTER_COPY) || isBlock(object_list,predMBNum,2,INTRA))) 
-		{
-			mvptr = getParam(object_list, predMBNum, 2, mv);
-			mvLR[0]=mvptr[0]; mvLR[1]=mvptr[1];
-		}
-	}
-	
-	//construct MB with mvTD
-	if(mvTD[0]!=NIL)
-	{
-		buildOuterPredRegionYUV_ECMODE4(erc_img,mvTD,currRegion->xMin,currRegion->yMin,predMB_TD,boundary,3);
-	}
-	else
-	{
-		for(i=8;i<16;i++)
-		{
-			for(j=8;j<16;j++)
-			{
-				predMB_TD[(i-8)*8+(j-8)] = predMB[i*16+j];
-			}
-		}
+/*!
+ ************************************************************************
+ * \brief
+ *      Fills ecmodeTable[] by running ecmodeRules() and
+ *      fourmodesEcmodeRules() once for every combination of neighbour
+ *      classes, with an mb_type standing for each class
+ ************************************************************************
+ */
+static void buildEcmodeTables(void)
+{
+  static const int classType[NUM_ECCLASSES] = { 0, 0, 1, 2, 3, 4, 8, 9, 10 };
+  int mode[4], available[4];
+  int i, index, rest;
 
-		for(i=4;i<8;i++)
-		{
-			for(j=4;j<8;j++)
-			{
-				predMB_TD[64+(i-4)*4+(j-4)] = predMB[256+i*8+j];
-				predMB_TD[64+16+(i-4)*4+(j-4)] = predMB[256+64+i*8+j];
-			}
-		}
-	}
+  ercPoolLock();
+  if (!ecmodeTableBuilt)
+  {
+    for (index = 0; index < NUM_ECMODE_ENTRIES; index++)
+    {
+      // classes of A, L, B, R, most significant first
+      for (rest = index, i = 3; i >= 0; i--, rest /= NUM_ECCLASSES)
+      {
+        mode[i]      = classType[rest % NUM_ECCLASSES];
+        available[i] = (rest % NUM_ECCLASSES) != ECCLASS_NA;
+      }
+      ecmodeTable[0][index] = (byte) ecmodeRules(mode[0], mode[1], mode[2], mode[3],
+                                                 available[0], available[1], available[2], available[3]);
+      ecmodeTable[1][index] = (byte) fourmodesEcmodeRules(mode[0], mode[1], mode[2], mode[3],
+                                                          available[0], available[1], available[2], available[3]);
+    }
+    ecmodeTableBuilt = 1;
+  }
+  ercPoolUnlock();
+}
 
-	//construct MB with mvLR
-	if(mvLR[0]!=NIL)
-	{
-		buildOuterPredRegionYUV_ECMODE4(erc_img,mvLR,currRegion->xMin,currRegion->yMin,predMB_LR,boundary,3);
-	}
-	else
-	{
-		for(i=8;i<16;i++)
-		{
-			for(j=8;j<16;j++)
-			{
-				predMB_LR[(i-8)*8+(j-8)] = predMB[i*16+j];
-			}
-		}
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the inter concealment state of a context, allocating it
+ *      for the first frame the context conceals
+ ************************************************************************
+ */
+static struct erc_inter_state *getInterState(ercContext_t *ctx)
+{
+  int i, j;
 
-		for(i=4;i<8;i++)
-		{
-			for(j=4;j<8;j++)
-			{
-				predMB_LR[64+(i-4)*4+(j-4)] = predMB[256+i*8+j];
-				predMB_LR[64+16+(i-4)*4+(j-4)] = predMB[256+64+i*8+j];
-			}
-		}
-	}
-	
-	//apply obmc averaging with weights 
-	for(i=8;i<16;i++)
-	{
-		for(j=8;j<16;j++)
-		{
-			predMB_OBMC[i*16+j] = (predMB[i*16+j]*H_E_8x8[i-8][j-8] + predMB_LR[(i-8)*8+(j-8)]*H_LR_8x8[i-8][j-8] + predMB_TD[(i-8)*8+(j-8)]*H_TD_8x8[i-8][j-8]);
-			predMB_OBMC[i*16+j] = (int)floor(predMB_OBMC[i*16+j]/8.0 + 0.5);
+  if (ctx->inter == NULL)
+  {
+    if ((ctx->inter = (struct erc_inter_state *) calloc(1, sizeof(struct erc_inter_state))) == NULL)
+      no_mem_exit("getInterState: inter");
+    for (i = 0; i < MAX_PADDED_REFS; i++)
+      for (j = 0; j < SUBPEL_PHASES; j++)
+        ercPoolMutexInit(&ctx->inter->paddedRef[i].subPelMutex[j]);
+    buildEcmodeTables();
+  }
 
-			upper = predMB[i*16+j] + (predMB[i*16+j]*OBMC_TR/100);
-			lower = predMB[i*16+j] - (predMB[i*16+j]*OBMC_TR/100);
-			if(OBMC_THRESHOLD && !(predMB_OBMC[i*16+j]>=lower && predMB_OBMC[i*16+j]<=upper))
-				predMB_OBMC[i*16+j] = predMB[i*16+j];
-		}
-	}
+  return ctx->inter;
+}
 
-	for(i=4;i<8;i++)
-	{
-		for(j=4;j<8;j++)
-		{
-			predMB_OBMC[256+i*8+j] = (predMB[256+i*8+j]*H_E_8x8[i-4][j-4] + predMB_LR[64+(i-4)*4+(j-4)]*H_LR_8x8[i-4][j-4] + predMB_TD[64+(i-4)*4+(j-4)]*H_TD_8x8[i-4][j-4]);
-			predMB_OBMC[256+i*8+j] = (int)floor(predMB_OBMC[256+i*8+j]/8.0 + 0.5);
+/*!
+ ************************************************************************
+ * \brief
+ *      Releases the memory the inter concealment of a context keeps from
+ *      frame to frame: the worker buffers, the padded reference planes
+ *      with their sub-pel cache and the wave arrays of the parallel
+ *      concealment
+ ************************************************************************
+ */
+void ercFreeInterState(ercContext_t *ctx)
+{
+  struct erc_inter_state *state = ctx->inter;
+  int i, j;
 
-			upper = predMB[256+i*8+j] + (predMB[256+i*8+j]*OBMC_TR/100);
-			lower = predMB[256+i*8+j] - (predMB[256+i*8+j]*OBMC_TR/100);
-			if(OBMC_THRESHOLD && !(predMB_OBMC[256+i*8+j]>=lower && predMB_OBMC[256+i*8+j]<=upper))
-				predMB_OBMC[256+i*8+j] = predMB[256+i*8+j];
+  if (state == NULL)
+    return;
 
-			predMB_OBMC[256+64+i*8+j] = (predMB[256+64+i*8+j]*H_E_8x8[i-4][j-4] + predMB_LR[64+16+(i-4)*4+(j-4)]*H_LR_8x8[i-4][j-4] + predMB_TD[64+16+(i-4)*4+(j-4)]*H_TD_8x8[i-4][j-4]);
-			predMB_OBMC[256+64+i*8+j] = (int)floor(predMB_OBMC[256+64+i*8+j]/8.0 + 0.5);
+  for (i = 0; i < MAX_PADDED_REFS; i++)
+  {
+    freeSubPelPlanes(state, &state->paddedRef[i]);
+    free(state->paddedRef[i].buf);
+    free(state->paddedRef[i].rows);
+    for (j = 0; j < ERC_PYRAMID_LEVELS; j++)
+      free(state->paddedRef[i].coarse[j]);
+    for (j = 0; j < SUBPEL_PHASES; j++)
+      ercPoolMutexFree(&state->paddedRef[i].subPelMutex[j]);
+  }
 
-			upper = predMB[256+64+i*8+j] + (predMB[256+64+i*8+j]*OBMC_TR/100);
-			lower = predMB[256+64+i*8+j] - (predMB[256+64+i*8+j]*OBMC_TR/100);
-			if(OBMC_THRESHOLD && !(predMB_OBMC[256+64+i*8+j]>=lower && predMB_OBMC[256+64+i*8+j]<=upper))
-				predMB_OBMC[256+64+i*8+j] = predMB[256+64+i*8+j];
-		}
-	}
+  free(state->waveScratch.dist);
+  free(state->waveScratch.order);
+  free(state->waveScratch.start);
+  free(state->waveScratch.fill);
 
-	free(predMB_LR); free(predMB_TD);
+  free(state);
+  ctx->inter = NULL;
 }
 
-
-int fourmodes_find_mb_ecmode(int predBlocks[],int numMBPerLine,int currMBNum)
+/*!
+ ************************************************************************
+ * \brief
+ *      Prepares a concealment context for a decoder instance
+ * \param ctx
+ *      the context
+ * \param img
+ *      image parameters of the decoder instance
+ ************************************************************************
+ */
+void ercInitContext(ercContext_t *ctx, struct img_par *img)
 {
-	int i, predMBNum=0, numIntraNeighbours=0, threshold=ERC_BLOCK_CONCEALED, mb_ecmode=ECMODE1; //default mode
-	int mode_A=1, mode_L=1, mode_B=1, mode_R=1;
-	int mode_A_available=0, mode_L_available=0, mode_B_available=0, mode_R_available=0;
-
-	for (i = 4; i < 8; i++) 
-    {
-        if (predBlocks[i] >= threshold) 
-        {
-			switch (i) 
-			{
-			case 4:
-				predMBNum = currMBNum-numMBPerLine;
-				mode_A = img->mb_data[predMBNum].mb_type;
-				mode_A_available = 1;
-				break;              
-			case 5:
-				predMBNum = currMBNum-1;
-				mode_L = img->mb_data[predMBNum].mb_type;
-				mode_L_available = 1;
-				break;              
-			case 6:
-				predMBNum = currMBNum+numMBPerLine;
-				mode_B = img->mb_data[predMBNum].mb_type;
-				mode_B_available = 1;
-				break;              
-			case 7:
-				predMBNum = currMBNum+1;
-				mode_R = img->mb_data[predMBNum].mb_type;
-				mode_R_available = 1;
-				break;
-			}
-		}
-	}
+  memset(ctx, 0, sizeof(ercContext_t));
+  ctx->img = img;
+}
 
-	//Determine if this MB is to be concealed using SEC or TEC
-	if(mode_A_available && mode_A>=9)
-		numIntraNeighbours++;
-	if(mode_L_available && mode_L>=9)
-		numIntraNeighbours++;
-	if(mode_B_available && mode_B>=9)
-		numIntraNeighbours++;
-	if(mode_R_available && mode_R>=9)
-		numIntraNeighbours++;
+/*!
+ ************************************************************************
+ * \brief
+ *      Releases the memory of a concealment context, including the lost
+ *      pictures still waiting for output.
+ ************************************************************************
+ */
+void ercFreeContext(ercContext_t *ctx)
+{
+  ercFreeInterState(ctx);
+  ercFreeIntraState(ctx);
+  ercFreeRunList(&ctx->corruptedRuns);
 
-	//DISCUSS - all 4 should be INTRA? 3 is doubtful, even if one nbr has motion, we should use TEC?
-	if(numIntraNeighbours>=3) 
-	{
-		mb_ecmode = SEC;
-		//return mb_ecmode;
-		return ECMODE1; //change this later...TODO
-	}
+  while (ctx->lostPictures.count > 0)
+    free_storable_picture(pop_lost_picture(&ctx->lostPictures));
+  free(ctx->lostPictures.entry);
 
-	//Else, we are now sure that Temporal Error Concealment (TEC) is to be used
-	
-	//Determine adaptively the block size for this MB to conceal using the nbr mb_type
+  while (ctx->picturePoolSize > 0)
+    free_storable_picture(ctx->picturePool[--ctx->picturePoolSize]);
+}
 
-	if(currMBNum==59)
-		currMBNum=59;
-    
-	if( ((mode_A_available && (mode_A!=8 || mode_A!=3)) || !mode_A_available) &&
-		((mode_B_available && (mode_B!=8 || mode_B!=3)) || !mode_B_available) &&
-		(mode_L_available && (mode_L==8 || mode_L==2)) &&
-		(mode_R_available && (mode_R==8 || mode_R==2)) )
-	{
-		mb_ecmode = ECMODE2;
-	}
-	else if( (mode_A_available && (mode_A==8 || mode_A==3)) &&
-			 (mode_B_available && (mode_B==8 || mode_B==3)) &&
-			 ((mode_L_available && (mode_L!=8 || mode_L!=2)) || !mode_L_available) &&
-			 ((mode_R_available && (mode_R!=8 || mode_R!=2)) || !mode_R_available) )
-	{
-		mb_ecmode = ECMODE3;
-	}
-	else if( (mode_A_available && (mode_A==8 || mode_A==3)) &&
-			 (mode_B_available && (mode_B==8 || mode_B==3)) &&
-			 (mode_L_available && (mode_L==8 || mode_L==2)) &&
-			 (mode_R_available && (mode_R==8 || mode_R==2)) )
-	{
-		mb_ecmode = ECMODE4;
-	}
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the concealment context of the decoder, bound to its
+ *      current global state (dec_picture, listX[0], erc_mvperMB)
+ * \param img
+ *      image parameters of the decoder
+ ************************************************************************
+ */
+ercContext_t *ercDecoderContext(struct img_par *img)
+{
+  decoderContext.img         = img;
+  decoderContext.dec_picture = dec_picture;
+  decoderContext.list0       = listX[0];
+  decoderContext.list0Size   = listXsize[0];
+  decoderContext.mvPerMB     = erc_mvperMB;
 
-	return mb_ecmode;
+  return &decoderContext;
 }
@@ -0,0 +1,338 @@
+
+/*!
+ *****************************************************************************
+ *
+ * \file erc_pool.c
+ *
+ * \brief
+ *    Worker threads of the error concealment
+ *
+ *    The items of a batch are handed out one by one to whichever worker
+ *    is free, so a job must not depend on which worker runs an item or on
+ *    the order of the items. Jobs keep their per thread state indexed by
+ *    the worker number they are given.
+ *
+ *****************************************************************************
+ */
+
+#include <stdlib.h>
+
+#include "global.h"
+#include "erc_pool.h"
+#include "erc_strategy.h"
+
+#ifdef ERC_THREADS
+#include <pthread.h>
+#endif
+
+static int concealThreads = 1;
+
+#ifdef ERC_THREADS
+
+typedef struct
+{
+  pthread_t  thread[ERC_MAX_THREADS];                   //!< pool threads, index 0 unused (calling thread)
+  int        seen[ERC_MAX_THREADS];                     //!< last batch taken up by each thread
+  int        numThreads;                                //!< pool threads started
+  int        batch;                                     //!< number of the current batch
+  int        busy;                                      //!< pool threads not done with the current batch
+  int        quit;                                      //!< set to stop the pool threads
+
+  ercPoolJob job;
+  void      *arg;
+  int        numItems;
+  int        nextItem;                                  //!< next item to hand out
+  int        numWorkers;                                //!< workers allowed on the current batch
+} ercPool_t;
+
+static ercPool_t pool;
+static pthread_mutex_t poolMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  poolStart = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  poolDone  = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t userMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t runMutex  = PTHREAD_MUTEX_INITIALIZER;  //!< held by the thread whose batch uses the pool
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Runs items of the current batch until none is left.
+ *      Called and returns with poolMutex held.
+ ************************************************************************
+ */
+static void runItems(int worker)
+{
+  int item;
+
+  while (pool.nextItem < pool.numItems)
+  {
+    item = pool.nextItem++;
+    pthread_mutex_unlock(&poolMutex);
+    pool.job(pool.arg, item, worker);
+    pthread_mutex_lock(&poolMutex);
+  }
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Main loop of a pool thread
+ ************************************************************************
+ */
+static void *poolThreadMain(void *arg)
+{
+  int worker = (int) (size_t) arg;
+
+  pthread_mutex_lock(&poolMutex);
+  for (;;)
+  {
+    while (pool.batch == pool.seen[worker] && !pool.quit)
+      pthread_cond_wait(&poolStart, &poolMutex);
+    if (pool.quit)
+      break;
+
+    pool.seen[worker] = pool.batch;
+    if (worker < pool.numWorkers)
+      runItems(worker);
+
+    if (--pool.busy == 0)
+      pthread_cond_signal(&poolDone);
+  }
+  pthread_mutex_unlock(&poolMutex);
+
+  return NULL;
+}
+
+#endif
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Runs job(arg, item, worker) for item = 0..numItems-1 on up to
+ *      numWorkers threads and returns when all items are done.
+ *      If the pool is busy with the batch of another thread, the items
+ *      are run on the calling thread as worker 0.
+ * \param numWorkers
+ *      number of threads to use, including the calling one
+ * \param job
+ *      function run for every item
+ * \param arg
+ *      passed to job
+ * \param numItems
+ *      number of items of the batch
+ ************************************************************************
+ */
+void ercPoolRun(int numWorkers, ercPoolJob job, void *arg, int numItems)
+{
+  int i;
+
+  numWorkers = min(numWorkers, ERC_MAX_THREADS);
+
+#ifdef ERC_THREADS
+  if (numWorkers > 1 && numItems > 1 && pthread_mutex_trylock(&runMutex) == 0)
+  {
+    pthread_mutex_lock(&poolMutex);
+
+    // start the missing threads, if that fails the batch runs on fewer
+    while (pool.numThreads < numWorkers-1)
+    {
+      i = pool.numThreads+1;
+      pool.seen[i] = pool.batch;
+      if (pthread_create(&pool.thread[i], NULL, poolThreadMain, (void *) (size_t) i) != 0)
+        break;
+      pool.numThreads++;
+    }
+
+    pool.job        = job;
+    pool.arg        = arg;
+    pool.numItems   = numItems;
+    pool.nextItem   = 0;
+    pool.numWorkers = numWorkers;
+    pool.busy       = pool.numThreads;
+    pool.batch++;
+    pthread_cond_broadcast(&poolStart);
+
+    runItems(0);
+
+    while (pool.busy > 0)
+      pthread_cond_wait(&poolDone, &poolMutex);
+
+    pthread_mutex_unlock(&poolMutex);
+    pthread_mutex_unlock(&runMutex);
+    return;
+  }
+#endif
+
+  for (i = 0; i < numItems; i++)
+    job(arg, i, 0);
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Enters the critical section shared by all workers, for state
+ *      that jobs build lazily
+ ************************************************************************
+ */
+void ercPoolLock(void)
+{
+#ifdef ERC_THREADS
+  pthread_mutex_lock(&userMutex);
+#endif
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Leaves the critical section entered with ercPoolLock()
+ ************************************************************************
+ */
+void ercPoolUnlock(void)
+{
+#ifdef ERC_THREADS
+  pthread_mutex_unlock(&userMutex);
+#endif
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Initializes a lock of shared state that is finer than the
+ *      critical section of ercPoolLock()
+ ************************************************************************
+ */
+void ercPoolMutexInit(ercPoolMutex_t *mutex)
+{
+#ifdef ERC_THREADS
+  pthread_mutex_init(mutex, NULL);
+#else
+  *mutex = 0;
+#endif
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Releases a lock initialized with ercPoolMutexInit()
+ ************************************************************************
+ */
+void ercPoolMutexFree(ercPoolMutex_t *mutex)
+{
+#ifdef ERC_THREADS
+  pthread_mutex_destroy(mutex);
+#endif
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Takes a lock initialized with ercPoolMutexInit()
+ ************************************************************************
+ */
+void ercPoolMutexLock(ercPoolMutex_t *mutex)
+{
+#ifdef ERC_THREADS
+  pthread_mutex_lock(mutex);
+#endif
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Gives back a lock taken with ercPoolMutexLock()
+ ************************************************************************
+ */
+void ercPoolMutexUnlock(ercPoolMutex_t *mutex)
+{
+#ifdef ERC_THREADS
+  pthread_mutex_unlock(mutex);
+#endif
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Reads a flag that marks shared state as built, without a lock.
+ *      Once it reads 1, everything the worker that set the flag
+ *      (ercPoolSetFlag()) wrote before is visible.
+ ************************************************************************
+ */
+int ercPoolTestFlag(volatile unsigned char *flag)
+{
+#ifdef ERC_THREADS
+  return __atomic_load_n(flag, __ATOMIC_ACQUIRE);
+#else
+  return *flag;
+#endif
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Sets a flag read by ercPoolTestFlag(), after the state it marks
+ *      has been written
+ ************************************************************************
+ */
+void ercPoolSetFlag(volatile unsigned char *flag)
+{
+#ifdef ERC_THREADS
+  __atomic_store_n(flag, 1, __ATOMIC_RELEASE);
+#else
+  *flag = 1;
+#endif
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Stops the pool threads
+ ************************************************************************
+ */
+void ercPoolFree(void)
+{
+#ifdef ERC_THREADS
+  int i;
+
+  pthread_mutex_lock(&poolMutex);
+  pool.quit = 1;
+  pthread_cond_broadcast(&poolStart);
+  pthread_mutex_unlock(&poolMutex);
+
+  for (i = 1; i <= pool.numThreads; i++)
+    pthread_join(pool.thread[i], NULL);
+
+  pool.numThreads = 0;
+  pool.quit = 0;
+#endif
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Sets the number of threads of the inter frame concealment.
+ *      1 conceals the MBs one after the other in the original order;
+ *      more threads conceal them in waves of independent MBs (see
+ *      ercConcealInterFrame()), whose result does not depend on the
+ *      number of threads. Without ERC_THREADS the waves run serially.
+ * \return
+ *      1 on success, 0 if the number is out of range
+ ************************************************************************
+ */
+int ercSetConcealThreads(int numThreads)
+{
+  if (numThreads < 1 || numThreads > ERC_MAX_THREADS)
+    return 0;
+
+  concealThreads = numThreads;
+  return 1;
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *      Returns the number of threads of the inter frame concealment
+ ************************************************************************
+ */
+int ercGetConcealThreads(void)
+{
+  return concealThreads;
+}
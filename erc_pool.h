@@ -0,0 +1,53 @@
+
+/*!
+ ************************************************************************
+ * \file erc_pool.h
+ *
+ * \brief
+ *      Worker threads of the error concealment
+ *
+ *      A small pool of threads that runs a job on the items 0..n-1 of a
+ *      batch and returns when all of them are done. The calling thread
+ *      takes part as worker 0, the pool threads are started on first use
+ *      and kept until ercPoolFree(). Threads are only used when the
+ *      decoder is built with ERC_THREADS defined (POSIX threads, link
+ *      with -lpthread); otherwise every batch runs on the calling thread.
+ *      The pool is shared by all concealment contexts of the process: a
+ *      batch started while another one is running is run on its calling
+ *      thread alone.
+ *
+ ************************************************************************
+ */
+
+#ifndef _ERC_POOL_H_
+#define _ERC_POOL_H_
+
+#ifdef ERC_THREADS
+#include <pthread.h>
+#endif
+
+#define ERC_MAX_THREADS  16
+
+typedef void (*ercPoolJob)(void *arg, int item, int worker);
+
+//Lock of state that workers build lazily and share, a pthread mutex with ERC_THREADS
+#ifdef ERC_THREADS
+typedef pthread_mutex_t ercPoolMutex_t;
+#else
+typedef int ercPoolMutex_t;
+#endif
+
+void ercPoolRun(int numWorkers, ercPoolJob job, void *arg, int numItems);
+void ercPoolLock(void);
+void ercPoolUnlock(void);
+void ercPoolFree(void);
+
+void ercPoolMutexInit(ercPoolMutex_t *mutex);
+void ercPoolMutexFree(ercPoolMutex_t *mutex);
+void ercPoolMutexLock(ercPoolMutex_t *mutex);
+void ercPoolMutexUnlock(ercPoolMutex_t *mutex);
+int  ercPoolTestFlag(volatile unsigned char *flag);
+void ercPoolSetFlag(volatile unsigned char *flag);
+
+#endif
+
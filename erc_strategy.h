@@ -0,0 +1,90 @@
+
+/*!
+ ************************************************************************
+ * \file erc_strategy.h
+ *
+ * \brief
+ *      Run-time selection of the error concealment algorithms and options
+ *
+ *      The inter (P) and intra concealment algorithms used to be chosen
+ *      with compile time switches in erc_do_p.c and erc_do_i.c. They are
+ *      now kept in two tables of strategies, and the active entry of each
+ *      table is selected from the decoder configuration file or the
+ *      command line, so that a single decoder binary runs every variant.
+ *      The memory of the sub-pel plane cache used by the inter concealment,
+ *      the number of threads it runs on and the time allowed to conceal
+ *      one picture are set the same way, as are the extra motion vector
+ *      candidates of the boundary matching, its early exit threshold,
+ *      the range and budget of the refinement of the chosen motion vector
+ *      and the recent references the candidates are tried against.
+ *      These options are shared by all concealment contexts
+ *      (erc_context.h) of the process.
+ *
+ ************************************************************************
+ */
+
+#ifndef _ERC_STRATEGY_H_
+#define _ERC_STRATEGY_H_
+
+#define ERC_INTER_STRATEGY_DEFAULT  1   //!< OBMA
+#define ERC_INTRA_STRATEGY_DEFAULT  6   //!< PMODES_UPDATED
+
+int   ercSetInterStrategy(int strategy);
+int   ercSetIntraStrategy(int strategy);
+int   ercGetInterStrategy(void);
+int   ercGetIntraStrategy(void);
+char *ercInterStrategyName(int strategy);
+char *ercIntraStrategyName(int strategy);
+int   ercNumInterStrategies(void);
+int   ercNumIntraStrategies(void);
+
+int   ercSetSubPelCache(int maxKBytes);
+int   ercGetSubPelCache(void);
+
+int   ercSetConcealThreads(int numThreads);
+int   ercGetConcealThreads(void);
+
+int   ercSetConcealDeadline(int ms);
+int   ercGetConcealDeadline(void);
+
+//Extra MV candidates of the boundary matching (concealByTrial), tried after the
+//MVs of the 4 neighbours in the order below, which is that of their expected hit rate
+#define ERC_MVCAND_MEDIAN     1   //!< component-wise median of the neighbour MVs
+#define ERC_MVCAND_COLOCATED  2   //!< MV of the co-located block in the first reference, with its reference index
+#define ERC_MVCAND_AVERAGE    4   //!< average of the neighbour MVs
+#define ERC_MVCAND_DIAGONAL   8   //!< MVs of the 4 diagonal neighbours
+#define ERC_MVCAND_ALL       15
+
+int   ercSetMVCandidates(int mask);
+int   ercGetMVCandidates(void);
+
+int   ercSetEarlyExitSAD(int sadPerPixel);
+int   ercGetEarlyExitSAD(void);
+
+#define ERC_MAX_REFINE_RANGE  16   //!< largest MV refinement range in integer pels
+
+int   ercSetRefineRange(int pels);
+int   ercGetRefineRange(void);
+int   ercSetRefineBudget(int evaluations);
+int   ercGetRefineBudget(void);
+
+#define ERC_MAX_CONCEAL_REFS        4   //!< most recent references the candidate MVs can be tried against
+#define ERC_REF_CANDIDATES_DEFAULT  4   //!< (MV, reference) pairs tried per MB or partition
+
+int   ercSetConcealRefs(int numRefs);
+int   ercGetConcealRefs(void);
+int   ercSetRefCandidates(int numPairs);
+int   ercGetRefCandidates(void);
+
+#define ERC_MAX_CLUSTER_TOLERANCE  4   //!< largest MV clustering tolerance in quarter pels
+
+int   ercSetClusterTolerance(int quarterPels);
+int   ercGetClusterTolerance(void);
+
+#define ERC_MAX_COARSE_CANDIDATES  6    //!< most extra candidates measured in full after the coarse ranking, an MB has up to 7
+
+int   ercSetCoarseCandidates(int topK);
+int   ercGetCoarseCandidates(void);
+
+#endif
+
@@ -66,6 +66,9 @@
 #include "cabac.h"
 
 #include "erc_api.h"
+#include "erc_strategy.h"
+#include "erc_pool.h"
+#include "erc_context.h"
 
 #define JM          "11 (FRExt)"
 #define VERSION     "11.0"
@@ -106,6 +109,8 @@ int myframenumber=-1;
  */
 void JMDecHelpExit ()
 {
+  int i;
+
   fprintf( stderr, "\n   ldecod [-h] {[defdec.cfg] | {[-i bitstream.264]...[-o output.yuv] [-r reference.yuv] [-uv]}}\n\n"    
     "## Parameters\n\n"
 
@@ -116,6 +121,21 @@ void JMDecHelpExit ()
     "   -o  :  Output file name. If not specified default output is set as test_dec.yuv\n\n"
     "   -r  :  Reference file name. If not specified default output is set as test_rec.yuv\n\n"
     "   -uv :  write chroma components for monochrome streams(4:2:0)\n\n"
+    "   -ecp:  Inter (P) frame concealment strategy (see list below)\n"
+    "   -eci:  Intra frame concealment strategy (see list below)\n"
+    "   -ecc:  Sub-pel plane cache of the inter concealment in KB, 0 = off (default)\n"
+    "   -ect:  Threads of the inter concealment, 1 = serial (default)\n"
+    "   -ecd:  Concealment deadline of a picture in ms, 0 = none (default)\n"
+    "   -ecm:  Extra MV candidates of the boundary matching, sum of 1 = median, 2 = co-located,\n"
+    "          4 = average, 8 = diagonal neighbours, 0 = none (default)\n"
+    "   -ece:  Boundary SAD per pixel that ends the MV candidate search, 0 = off (default)\n"
+    "   -ecr:  Range of the concealment MV refinement in integer pels, 0 = off (default)\n"
+    "   -ecb:  MV refinement evaluations per picture, 0 = no limit (default)\n"
+    "   -ecl:  Recent references the concealment MVs are tried against, 1 = own reference only (default)\n"
+    "   -ecn:  (MV, reference) pairs tried per MB or partition (default 4)\n"
+    "   -ecq:  Quarter pels within which neighbour MVs are tried as one candidate, 0 = off (default)\n"
+    "   -eck:  Extra MV candidates measured in full after ranking on a 1/2 or 1/4 resolution pyramid,\n"
+    "          0 = no ranking (default)\n\n"
     
     "## Supported video file formats\n"
     "   Input : .264 -> H.264 bitstream files. \n"
@@ -127,6 +147,12 @@ void JMDecHelpExit ()
     "   ldecod  default.cfg\n"
     "   ldecod  -i bitstream.264 -o output.yuv -r reference.yuv\n");
 
+  fprintf( stderr, "\n## Concealment strategies\n");
+  for (i=0; i<ercNumInterStrategies(); i++)
+    fprintf( stderr, "   -ecp %d : %s%s\n", i, ercInterStrategyName(i), i == ERC_INTER_STRATEGY_DEFAULT ? " (default)" : "");
+  for (i=0; i<ercNumIntraStrategies(); i++)
+    fprintf( stderr, "   -eci %d : %s%s\n", i, ercIntraStrategyName(i), i == ERC_INTRA_STRATEGY_DEFAULT ? " (default)" : "");
+
   exit(-1);
 }
 
@@ -209,6 +235,123 @@ void Configure(int ac, char *av[])
       input->write_uv = 1;
       CLcount ++;
     }
+    else if (0 == strncmp (av[CLcount], "-ecp", 4))  //! Inter concealment strategy
+    {
+      if (CLcount+1 >= ac || !ercSetInterStrategy(atoi(av[CLcount+1])))
+      {
+        snprintf(errortext, ET_SIZE, "Invalid inter concealment strategy. Use ldecod -h for the list");
+        error(errortext, 300);
+      }
+      CLcount += 2;
+    }
+    else if (0 == strncmp (av[CLcount], "-eci", 4))  //! Intra concealment strategy
+    {
+      if (CLcount+1 >= ac || !ercSetIntraStrategy(atoi(av[CLcount+1])))
+      {
+        snprintf(errortext, ET_SIZE, "Invalid intra concealment strategy. Use ldecod -h for the list");
+        error(errortext, 300);
+      }
+      CLcount += 2;
+    }
+    else if (0 == strncmp (av[CLcount], "-ecc", 4))  //! Sub-pel plane cache size
+    {
+      if (CLcount+1 >= ac || !ercSetSubPelCache(atoi(av[CLcount+1])))
+      {
+        snprintf(errortext, ET_SIZE, "Invalid sub-pel cache size. Use ldecod -h for proper usage");
+        error(errortext, 300);
+      }
+      CLcount += 2;
+    }
+    else if (0 == strncmp (av[CLcount], "-ect", 4))  //! Concealment threads
+    {
+      if (CLcount+1 >= ac || !ercSetConcealThreads(atoi(av[CLcount+1])))
+      {
+        snprintf(errortext, ET_SIZE, "Invalid number of concealment threads (1..%d)", ERC_MAX_THREADS);
+        error(errortext, 300);
+      }
+      CLcount += 2;
+    }
+    else if (0 == strncmp (av[CLcount], "-ecd", 4))  //! Concealment deadline
+    {
+      if (CLcount+1 >= ac || !ercSetConcealDeadline(atoi(av[CLcount+1])))
+      {
+        snprintf(errortext, ET_SIZE, "Invalid concealment deadline. Use ldecod -h for proper usage");
+        error(errortext, 300);
+      }
+      CLcount += 2;
+    }
+    else if (0 == strncmp (av[CLcount], "-ecm", 4))  //! Extra MV candidates
+    {
+      if (CLcount+1 >= ac || !ercSetMVCandidates(atoi(av[CLcount+1])))
+      {
+        snprintf(errortext, ET_SIZE, "Invalid MV candidates (0..%d). Use ldecod -h for proper usage", ERC_MVCAND_ALL);
+        error(errortext, 300);
+      }
+      CLcount += 2;
+    }
+    else if (0 == strncmp (av[CLcount], "-ece", 4))  //! Early exit of the MV candidate search
+    {
+      if (CLcount+1 >= ac || !ercSetEarlyExitSAD(atoi(av[CLcount+1])))
+      {
+        snprintf(errortext, ET_SIZE, "Invalid early exit threshold. Use ldecod -h for proper usage");
+        error(errortext, 300);
+      }
+      CLcount += 2;
+    }
+    else if (0 == strncmp (av[CLcount], "-ecr", 4))  //! MV refinement range
+    {
+      if (CLcount+1 >= ac || !ercSetRefineRange(atoi(av[CLcount+1])))
+      {
+        snprintf(errortext, ET_SIZE, "Invalid MV refinement range (0..%d)", ERC_MAX_REFINE_RANGE);
+        error(errortext, 300);
+      }
+      CLcount += 2;
+    }
+    else if (0 == strncmp (av[CLcount], "-ecb", 4))  //! MV refinement budget
+    {
+      if (CLcount+1 >= ac || !ercSetRefineBudget(atoi(av[CLcount+1])))
+      {
+        snprintf(errortext, ET_SIZE, "Invalid MV refinement budget. Use ldecod -h for proper usage");
+        error(errortext, 300);
+      }
+      CLcount += 2;
+    }
+    else if (0 == strncmp (av[CLcount], "-ecl", 4))  //! Recent references of the concealment
+    {
+      if (CLcount+1 >= ac || !ercSetConcealRefs(atoi(av[CLcount+1])))
+      {
+        snprintf(errortext, ET_SIZE, "Invalid number of concealment references (1..%d)", ERC_MAX_CONCEAL_REFS);
+        error(errortext, 300);
+      }
+      CLcount += 2;
+    }
+    else if (0 == strncmp (av[CLcount], "-ecn", 4))  //! (MV, reference) pairs of the concealment
+    {
+      if (CLcount+1 >= ac || !ercSetRefCandidates(atoi(av[CLcount+1])))
+      {
+        snprintf(errortext, ET_SIZE, "Invalid number of (MV, reference) pairs. Use ldecod -h for proper usage");
+        error(errortext, 300);
+      }
+      CLcount += 2;
+    }
+    else if (0 == strncmp (av[CLcount], "-ecq", 4))  //! MV clustering tolerance of the concealment
+    {
+      if (CLcount+1 >= ac || !ercSetClusterTolerance(atoi(av[CLcount+1])))
+      {
+        snprintf(errortext, ET_SIZE, "Invalid MV clustering tolerance (0..%d)", ERC_MAX_CLUSTER_TOLERANCE);
+        error(errortext, 300);
+      }
+      CLcount += 2;
+    }
+    else if (0 == strncmp (av[CLcount], "-eck", 4))  //! Extra candidates measured after the coarse ranking
+    {
+      if (CLcount+1 >= ac || !ercSetCoarseCandidates(atoi(av[CLcount+1])))
+      {
+        snprintf(errortext, ET_SIZE, "Invalid number of coarse ranked candidates (0..%d)", ERC_MAX_COARSE_CANDIDATES);
+        error(errortext, 300);
+      }
+      CLcount += 2;
+    }
     else
     {
       //config_filename=av[CLcount];
@@ -263,6 +406,20 @@ void Configure(int ac, char *av[])
   calc_buffer(input);
   fprintf(stdout,"--------------------------------------------------------------------------\n");
 #endif
+  fprintf(stdout," Inter concealment    : %s \n",ercInterStrategyName(ercGetInterStrategy()));
+  fprintf(stdout," Intra concealment    : %s \n",ercIntraStrategyName(ercGetIntraStrategy()));
+  fprintf(stdout," Sub-pel cache (KB)   : %8d \n",ercGetSubPelCache());
+  fprintf(stdout," Concealment threads  : %8d \n",ercGetConcealThreads());
+  fprintf(stdout," Conceal deadline (ms): %8d \n",ercGetConcealDeadline());
+  fprintf(stdout," Extra MV candidates  : %8d \n",ercGetMVCandidates());
+  fprintf(stdout," Early exit SAD/pixel : %8d \n",ercGetEarlyExitSAD());
+  fprintf(stdout," MV refine range      : %8d \n",ercGetRefineRange());
+  fprintf(stdout," MV refine budget     : %8d \n",ercGetRefineBudget());
+  fprintf(stdout," Conceal references   : %8d \n",ercGetConcealRefs());
+  fprintf(stdout," MV/reference pairs   : %8d \n",ercGetRefCandidates());
+  fprintf(stdout," MV cluster (1/4 pel) : %8d \n",ercGetClusterTolerance());
+  fprintf(stdout," Coarse ranked top-k  : %8d \n",ercGetCoarseCandidates());
+  fprintf(stdout,"--------------------------------------------------------------------------\n");
   fprintf(stdout,"POC must = frame# or field# for SNRs to be correct\n");
   fprintf(stdout,"--------------------------------------------------------------------------\n");
   fprintf(stdout,"  Frame       POC   Pic#   QP   SnrY    SnrU    SnrV   Y:U:V  Time(ms)\n");
@@ -363,6 +520,8 @@ int main(int argc, char **argv)
 #endif
 
   ercClose(erc_errorVar);
+  ercFreeContext(ercDecoderContext(img));
+  ercPoolFree();
 
   free_dpb();
   uninit_out_buffer();
@@ -460,6 +619,8 @@ void init_conf(struct inp_par *inp, char *config_filename)
   // picture error concealment
   long int temp;
   char tempval[100];
+  int strategy, subPelCache, threads, deadline, mvCandidates, earlyExit, refineRange, refineBudget;
+  int concealRefs, refCandidates, clusterTolerance, coarseCandidates;
 
   // read the decoder configuration file
   if((fd=fopen(config_filename,"r")) == NULL)
@@ -551,6 +712,112 @@ void init_conf(struct inp_par *inp, char *config_filename)
   fscanf(fd,"%*[^\n]");
   img->poc_gap = inp->poc_gap;
 
+  // concealment strategies, optional: older configuration files end here
+  strategy = ERC_INTER_STRATEGY_DEFAULT;
+  fscanf(fd,"%d",&strategy);   // Inter (P) frame concealment strategy
+  fscanf(fd,"%*[^\n]");
+  if (!ercSetInterStrategy(strategy))
+  {
+    snprintf(errortext, ET_SIZE, "Inter concealment strategy %d is not supported", strategy);
+    error(errortext,400);
+  }
+  strategy = ERC_INTRA_STRATEGY_DEFAULT;
+  fscanf(fd,"%d",&strategy);   // Intra frame concealment strategy
+  fscanf(fd,"%*[^\n]");
+  if (!ercSetIntraStrategy(strategy))
+  {
+    snprintf(errortext, ET_SIZE, "Intra concealment strategy %d is not supported", strategy);
+    error(errortext,400);
+  }
+  subPelCache = 0;
+  fscanf(fd,"%d",&subPelCache);   // Sub-pel plane cache of the inter concealment in KB
+  fscanf(fd,"%*[^\n]");
+  if (!ercSetSubPelCache(subPelCache))
+  {
+    snprintf(errortext, ET_SIZE, "Sub-pel cache size %d is not supported", subPelCache);
+    error(errortext,400);
+  }
+  threads = 1;
+  fscanf(fd,"%d",&threads);   // Threads of the inter concealment
+  fscanf(fd,"%*[^\n]");
+  if (!ercSetConcealThreads(threads))
+  {
+    snprintf(errortext, ET_SIZE, "%d concealment threads are not supported", threads);
+    error(errortext,400);
+  }
+  deadline = 0;
+  fscanf(fd,"%d",&deadline);   // Concealment deadline of a picture in ms
+  fscanf(fd,"%*[^\n]");
+  if (!ercSetConcealDeadline(deadline))
+  {
+    snprintf(errortext, ET_SIZE, "Concealment deadline %d is not supported", deadline);
+    error(errortext,400);
+  }
+  mvCandidates = 0;
+  fscanf(fd,"%d",&mvCandidates);   // Extra MV candidates of the boundary matching
+  fscanf(fd,"%*[^\n]");
+  if (!ercSetMVCandidates(mvCandidates))
+  {
+    snprintf(errortext, ET_SIZE, "MV candidates %d are not supported", mvCandidates);
+    error(errortext,400);
+  }
+  earlyExit = 0;
+  fscanf(fd,"%d",&earlyExit);   // Early exit of the MV candidate search, boundary SAD per pixel
+  fscanf(fd,"%*[^\n]");
+  if (!ercSetEarlyExitSAD(earlyExit))
+  {
+    snprintf(errortext, ET_SIZE, "Early exit threshold %d is not supported", earlyExit);
+    error(errortext,400);
+  }
+  refineRange = 0;
+  fscanf(fd,"%d",&refineRange);   // Range of the MV refinement in integer pels
+  fscanf(fd,"%*[^\n]");
+  if (!ercSetRefineRange(refineRange))
+  {
+    snprintf(errortext, ET_SIZE, "MV refinement range %d is not supported", refineRange);
+    error(errortext,400);
+  }
+  refineBudget = 0;
+  fscanf(fd,"%d",&refineBudget);   // MV refinement evaluations per picture
+  fscanf(fd,"%*[^\n]");
+  if (!ercSetRefineBudget(refineBudget))
+  {
+    snprintf(errortext, ET_SIZE, "MV refinement budget %d is not supported", refineBudget);
+    error(errortext,400);
+  }
+  concealRefs = 1;
+  fscanf(fd,"%d",&concealRefs);   // Recent references the concealment MVs are tried against
+  fscanf(fd,"%*[^\n]");
+  if (!ercSetConcealRefs(concealRefs))
+  {
+    snprintf(errortext, ET_SIZE, "%d concealment references are not supported", concealRefs);
+    error(errortext,400);
+  }
+  refCandidates = ERC_REF_CANDIDATES_DEFAULT;
+  fscanf(fd,"%d",&refCandidates);   // (MV, reference) pairs tried per MB or partition
+  fscanf(fd,"%*[^\n]");
+  if (!ercSetRefCandidates(refCandidates))
+  {
+    snprintf(errortext, ET_SIZE, "%d (MV, reference) pairs are not supported", refCandidates);
+    error(errortext,400);
+  }
+  clusterTolerance = 0;
+  fscanf(fd,"%d",&clusterTolerance);   // Tolerance of the MV candidate clustering in quarter pels
+  fscanf(fd,"%*[^\n]");
+  if (!ercSetClusterTolerance(clusterTolerance))
+  {
+    snprintf(errortext, ET_SIZE, "MV clustering tolerance %d is not supported", clusterTolerance);
+    error(errortext,400);
+  }
+  coarseCandidates = 0;
+  fscanf(fd,"%d",&coarseCandidates);   // extra MV candidates measured in full after the coarse ranking
+  fscanf(fd,"%*[^\n]");
+  if (!ercSetCoarseCandidates(coarseCandidates))
+  {
+    snprintf(errortext, ET_SIZE, "%d coarse ranked candidates are not supported", coarseCandidates);
+    error(errortext,400);
+  }
+
   fclose (fd);
 }
 
@@ -588,6 +855,10 @@ void report(struct inp_par *inp, struct img_par *img, struct snr_par *snr)
   fprintf(stdout," SNR V(dB)           : %5.2f\n",snr->snr_va);
   fprintf(stdout," Total decoding time : %.3f sec \n",tot_time*0.001);
   fprintf(stdout," Total decoding time : %.3f sec \n",time_sum*0.001);
+  if (ercGetConcealDeadline() > 0)
+    fprintf(stdout," Degraded MBs        : %d\n",ercDecoderContext(img)->degradedTotal);
+  if (ercGetClusterTolerance() > 0)
+    fprintf(stdout," Pruned MV candidates: %d\n",ercDecoderContext(img)->prunedTotal);
   fprintf(stdout,"--------------------------------------------------------------------------\n");
   fprintf(stdout," Exit JM %s decoder, ver %s ",JM, VERSION);
   fprintf(stdout,"\n");